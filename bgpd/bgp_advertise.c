@@ -149,30 +149,34 @@ bool bgp_adj_out_lookup(struct peer *peer, struct bgp_dest *dest,
 {
 	struct bgp_adj_out *adj;
 	struct peer_af *paf;
-	afi_t afi;
-	safi_t safi;
+	struct update_subgroup *subgrp;
+	afi_t afi = bgp_dest_table(dest)->afi;
 	int addpath_capable;
-
-	RB_FOREACH (adj, bgp_adj_out_rb, &dest->adj_out)
-		SUBGRP_FOREACH_PEER (adj->subgroup, paf)
-			if (paf->peer == peer) {
-				afi = SUBGRP_AFI(adj->subgroup);
-				safi = SUBGRP_SAFI(adj->subgroup);
-				addpath_capable =
-					bgp_addpath_encode_tx(peer, afi, safi);
-
-				/* Match on a specific addpath_tx_id if we are
-				 * using addpath for
-				 * this
-				 * peer and if an addpath_tx_id was specified */
-				if (addpath_capable && addpath_tx_id
-				    && adj->addpath_tx_id != addpath_tx_id)
-					continue;
-
-				return (adj->adv
-						? (adj->adv->baa ? true : false)
-						: (adj->attr ? true : false));
-			}
+	uint32_t iter;
+	int af;
+
+	/* the adj-outs are in the peer's subgroups of the dest's afi */
+	AF_FOREACH (af) {
+		paf = peer->peer_af_array[af];
+		if (!paf || paf->afi != afi || !PAF_SUBGRP(paf))
+			continue;
+
+		subgrp = PAF_SUBGRP(paf);
+		addpath_capable = bgp_addpath_encode_tx(peer, afi, paf->safi);
+
+		SUBGRP_FOREACH_DEST_ADJ (subgrp, dest, adj, iter) {
+			/* Match on a specific addpath_tx_id if we are
+			 * using addpath for
+			 * this
+			 * peer and if an addpath_tx_id was specified */
+			if (addpath_capable && addpath_tx_id
+			    && adj->addpath_tx_id != addpath_tx_id)
+				continue;
+
+			return (adj->adv ? (adj->adv->baa ? true : false)
+					 : (adj->attr ? true : false));
+		}
+	}
 
 	return false;
 }
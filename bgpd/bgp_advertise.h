@@ -62,33 +62,34 @@ struct bgp_advertise {
 
 DECLARE_DLIST(bgp_adv_fifo, struct bgp_advertise, fifo)
 
-/* BGP adjacency out.  */
+/*
+ * BGP adjacency out.
+ *
+ * These are kept by the subgroup they were advertised to, see
+ * struct bgp_adj_out_store, and are kept as small as possible: there is one
+ * per prefix and subgroup.
+ */
 struct bgp_adj_out {
-	/* RB Tree of adjacency entries */
-	RB_ENTRY(bgp_adj_out) adj_entry;
+	/* Prefix information, NULL while the entry is unused.  */
+	struct bgp_dest *dest;
 
-	/* Advertised subgroup.  */
-	struct update_subgroup *subgroup;
+	/* Advertised attribute.  */
+	struct attr *attr;
 
-	/* Threading that makes the adj part of subgroup's adj queue */
-	TAILQ_ENTRY(bgp_adj_out) subgrp_adj_train;
+	union {
+		/* Advertisement information.  */
+		struct bgp_advertise *adv;
 
-	/* Prefix information.  */
-	struct bgp_dest *dest;
+		/* Next unused entry of the store.  */
+		struct bgp_adj_out *free_next;
+	};
 
 	uint32_t addpath_tx_id;
 
-	/* Advertised attribute.  */
-	struct attr *attr;
-
-	/* Advertisement information.  */
-	struct bgp_advertise *adv;
+	/* Entry number in the subgroup's store.  */
+	uint32_t idx;
 };
 
-RB_HEAD(bgp_adj_out_rb, bgp_adj_out);
-RB_PROTOTYPE(bgp_adj_out_rb, bgp_adj_out, adj_entry,
-	     bgp_adj_out_compare);
-
 /* BGP adjacency in. */
 struct bgp_adj_in {
 	/* Linked list pointer.  */
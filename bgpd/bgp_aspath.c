@@ -87,6 +87,7 @@ struct assegment_header {
 
 /* Hash for aspath.  This is the top level structure of AS path. */
 static struct hash *ashash;
+static uint32_t aspath_intern_id;
 
 /* Stream for SNMP. See aspath_snmp_pathseg */
 static struct stream *snmp_stream;
@@ -676,6 +677,8 @@ struct aspath *aspath_intern(struct aspath *aspath)
 	find = hash_get(ashash, aspath, hash_alloc_intern);
 	if (find != aspath)
 		aspath_free(aspath);
+	else
+		find->intern_id = ++aspath_intern_id;
 
 	find->refcnt++;
 
@@ -727,6 +730,7 @@ static void *aspath_hash_alloc(void *arg)
 	new->str = aspath->str;
 	new->str_len = aspath->str_len;
 	new->json = aspath->json;
+	new->intern_id = ++aspath_intern_id;
 
 	return new;
 }
@@ -828,6 +832,30 @@ static int assegments_parse(struct stream *s, size_t length,
 	return 0;
 }
 
+/* Decode an AS path without interning it.  The string representation is
+   built as well, so the result can be handed straight to aspath_intern().
+   This does not touch the AS path hash and may be used from any pthread.
+
+   On error NULL is returned.
+ */
+struct aspath *aspath_decode(struct stream *s, size_t length, int use32bit)
+{
+	struct aspath *as;
+
+	if (length % AS16_VALUE_SIZE)
+		return NULL;
+
+	as = aspath_new();
+	if (assegments_parse(s, length, &as->segments, use32bit) < 0) {
+		XFREE(MTYPE_AS_PATH, as);
+		return NULL;
+	}
+
+	aspath_str_update(as, false);
+
+	return as;
+}
+
 /* AS path parse function.  pnt is a pointer to byte stream and length
    is length of byte stream.  If there is same AS path in the the AS
    path hash then return it else make new AS path structure.
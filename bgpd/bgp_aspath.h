@@ -72,6 +72,11 @@ struct aspath {
 	   and AS path regular expression match.  */
 	char *str;
 	unsigned short str_len;
+
+	/* set when interned, tells apart paths that reuse the same memory
+	 * for results cached by as-path access-lists
+	 */
+	uint32_t intern_id;
 };
 
 #define ASPATH_STR_DEFAULT_LEN 32
@@ -80,6 +85,8 @@ struct aspath {
 extern void aspath_init(void);
 extern void aspath_finish(void);
 extern struct aspath *aspath_parse(struct stream *, size_t, int);
+extern struct aspath *aspath_decode(struct stream *s, size_t length,
+				    int use32bit);
 extern struct aspath *aspath_dup(struct aspath *);
 extern struct aspath *aspath_aggregate(struct aspath *, struct aspath *);
 extern struct aspath *aspath_prepend(struct aspath *, struct aspath *);
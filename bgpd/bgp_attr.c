@@ -646,6 +646,9 @@ unsigned int attrhash_key_make(const void *p)
 	uint32_t key = 0;
 #define MIX(val)	key = jhash_1word(val, key)
 #define MIX3(a, b, c)	key = jhash_3words((a), (b), (c), key)
+#define MIXP(ptr)                                                              \
+	key = jhash_2words((uint32_t)(uintptr_t)(ptr),                         \
+			   (uint32_t)((uint64_t)(uintptr_t)(ptr) >> 32), key)
 
 	MIX3(attr->origin, attr->nexthop.s_addr, attr->med);
 	MIX3(attr->local_pref, attr->aggregator_as,
@@ -654,21 +657,17 @@ unsigned int attrhash_key_make(const void *p)
 	     attr->originator_id.s_addr);
 	MIX3(attr->tag, attr->label, attr->label_index);
 
-	if (attr->aspath)
-		MIX(aspath_key_make(attr->aspath));
-	if (attr->community)
-		MIX(community_hash_make(attr->community));
-
-	if (attr->lcommunity)
-		MIX(lcommunity_hash_make(attr->lcommunity));
-	if (attr->ecommunity)
-		MIX(ecommunity_hash_make(attr->ecommunity));
-	if (attr->ipv6_ecommunity)
-		MIX(ecommunity_hash_make(attr->ipv6_ecommunity));
-	if (attr->cluster)
-		MIX(cluster_hash_key_make(attr->cluster));
-	if (attr->transit)
-		MIX(transit_hash_key_make(attr->transit));
+	/* attrhash_cmp() compares these by pointer, i.e. equal attributes
+	 * carry the same intern'd structures.  Hashing the pointers is thus
+	 * enough and saves re-hashing AS paths and communities every time.
+	 */
+	MIXP(attr->aspath);
+	MIXP(attr->community);
+	MIXP(attr->lcommunity);
+	MIXP(attr->ecommunity);
+	MIXP(attr->ipv6_ecommunity);
+	MIXP(attr->cluster);
+	MIXP(attr->transit);
 	if (attr->encap_subtlvs)
 		MIX(encap_hash_key_make(attr->encap_subtlvs));
 #ifdef ENABLE_BGP_VNC
@@ -753,6 +752,7 @@ static void attr_vfree(void *attr)
 
 static void attrhash_finish(void)
 {
+	bgp_attr_intern_batch_end();
 	hash_clean(attrhash, attr_vfree);
 	hash_free(attrhash);
 	attrhash = NULL;
@@ -787,11 +787,14 @@ void attr_show_all(struct vty *vty)
 
 static void *bgp_attr_hash_alloc(void *p)
 {
+	static uint32_t intern_id;
 	struct attr *val = (struct attr *)p;
 	struct attr *attr;
 
 	attr = XMALLOC(MTYPE_ATTR, sizeof(struct attr));
 	*attr = *val;
+	/* lets the update encoding cache tell a reused address apart */
+	attr->intern_id = ++intern_id;
 	if (val->encap_subtlvs) {
 		val->encap_subtlvs = NULL;
 	}
@@ -809,6 +812,29 @@ static void *bgp_attr_hash_alloc(void *p)
 	return attr;
 }
 
+/*
+ * All NLRIs of an UPDATE usually end up with the very same attribute, so
+ * remember the last one intern'd while a batch is open and skip the attrhash
+ * lookup for as long as it keeps matching.  The cache holds a reference of
+ * its own, dropped by bgp_attr_intern_batch_end().
+ */
+static struct attr *attr_intern_last;
+static bool attr_intern_batch;
+
+void bgp_attr_intern_batch_begin(void)
+{
+	attr_intern_batch = true;
+}
+
+void bgp_attr_intern_batch_end(void)
+{
+	attr_intern_batch = false;
+
+	if (attr_intern_last)
+		bgp_attr_unintern(&attr_intern_last);
+	attr_intern_last = NULL;
+}
+
 /* Internet argument attribute. */
 struct attr *bgp_attr_intern(struct attr *attr)
 {
@@ -896,7 +922,19 @@ struct attr *bgp_attr_intern(struct attr *attr)
 	 * If we don't find it, we need to allocate a one because in all
 	 * cases this returns a new reference to a hashed attr, but the input
 	 * wasn't on hash. */
-	find = (struct attr *)hash_get(attrhash, attr, bgp_attr_hash_alloc);
+	if (attr_intern_last && attrhash_cmp(attr_intern_last, attr))
+		find = attr_intern_last;
+	else {
+		find = (struct attr *)hash_get(attrhash, attr,
+					       bgp_attr_hash_alloc);
+
+		if (attr_intern_batch) {
+			if (attr_intern_last)
+				bgp_attr_unintern(&attr_intern_last);
+			attr_intern_last = find;
+			find->refcnt++;
+		}
+	}
 	find->refcnt++;
 
 	return find;
@@ -1422,8 +1460,15 @@ static int bgp_attr_aspath(struct bgp_attr_parser_args *args)
 	 * peer with AS4 => will get 4Byte ASnums
 	 * otherwise, will get 16 Bit
 	 */
-	attr->aspath = aspath_parse(peer->curr, length,
-				    CHECK_FLAG(peer->cap, PEER_CAP_AS4_RCV));
+	if (peer->curr_predecode && peer->curr_predecode->aspath) {
+		/* already decoded on the I/O pthread */
+		attr->aspath = aspath_intern(peer->curr_predecode->aspath);
+		peer->curr_predecode->aspath = NULL;
+		stream_forward_getp(peer->curr, length);
+	} else
+		attr->aspath =
+			aspath_parse(peer->curr, length,
+				     CHECK_FLAG(peer->cap, PEER_CAP_AS4_RCV));
 
 	/* In case of IBGP, length will be zero. */
 	if (!attr->aspath) {
@@ -1862,8 +1907,14 @@ bgp_attr_community(struct bgp_attr_parser_args *args)
 					  args->total);
 	}
 
-	attr->community =
-		community_parse((uint32_t *)stream_pnt(peer->curr), length);
+	if (peer->curr_predecode && peer->curr_predecode->community) {
+		/* already decoded on the I/O pthread */
+		attr->community =
+			community_intern(peer->curr_predecode->community);
+		peer->curr_predecode->community = NULL;
+	} else
+		attr->community = community_parse(
+			(uint32_t *)stream_pnt(peer->curr), length);
 
 	/* XXX: fix community_parse to use stream API and remove this */
 	stream_forward_getp(peer->curr, length);
@@ -3317,6 +3368,123 @@ done:
 	return ret;
 }
 
+/*
+ * Decode the costlier attributes of an UPDATE ahead of bgp_attr_parse().
+ *
+ * Runs on the I/O pthread before the packet is queued on peer->ibuf, so
+ * nothing here may touch the attribute hashes or anything else owned by the
+ * main pthread.  Only the framing needed to locate the attributes is looked
+ * at; anything unexpected simply ends the walk and leaves the rest to
+ * bgp_attr_parse(), which does the full validation.
+ */
+struct bgp_attr_predecode *bgp_attr_predecode(struct peer *peer,
+					      struct stream *pkt)
+{
+	struct bgp_attr_predecode *pd = NULL;
+	uint8_t seen[BGP_ATTR_BITMAP_SIZE];
+	uint16_t withdraw_len, attribute_len;
+	size_t endp, attr_endp;
+	bgp_size_t length;
+	uint8_t flag, type;
+
+	if (stream_get_endp(pkt) < BGP_HEADER_SIZE + 4
+	    || stream_getc_from(pkt, BGP_MARKER_SIZE + 2) != BGP_MSG_UPDATE)
+		return NULL;
+
+	memset(seen, 0, BGP_ATTR_BITMAP_SIZE);
+
+	stream_set_getp(pkt, BGP_HEADER_SIZE);
+	withdraw_len = stream_getw(pkt);
+	if (STREAM_READABLE(pkt) < withdraw_len + 2)
+		goto done;
+	stream_forward_getp(pkt, withdraw_len);
+
+	attribute_len = stream_getw(pkt);
+	if (STREAM_READABLE(pkt) < attribute_len)
+		goto done;
+	endp = stream_get_getp(pkt) + attribute_len;
+
+	while (stream_get_getp(pkt) + BGP_ATTR_MIN_LEN <= endp) {
+		flag = 0xF0 & stream_getc(pkt);
+		type = stream_getc(pkt);
+
+		if (CHECK_FLAG(flag, BGP_ATTR_FLAG_EXTLEN)) {
+			if (stream_get_getp(pkt) + 2 > endp)
+				break;
+			length = stream_getw(pkt);
+		} else
+			length = stream_getc(pkt);
+
+		attr_endp = stream_get_getp(pkt) + length;
+		if (attr_endp > endp || CHECK_BITMAP(seen, type))
+			break;
+		SET_BITMAP(seen, type);
+
+		if ((type == BGP_ATTR_AS_PATH || type == BGP_ATTR_COMMUNITIES)
+		    && !pd) {
+			pd = XCALLOC(MTYPE_BGP_ATTR_PREDECODE, sizeof(*pd));
+			pd->pkt = pkt;
+		}
+
+		switch (type) {
+		case BGP_ATTR_AS_PATH:
+			pd->aspath = aspath_decode(
+				pkt, length,
+				CHECK_FLAG(peer->cap, PEER_CAP_AS4_RCV));
+			break;
+		case BGP_ATTR_COMMUNITIES:
+			if (length)
+				pd->community = community_decode(
+					(uint32_t *)stream_pnt(pkt), length);
+			break;
+		default:
+			break;
+		}
+
+		stream_set_getp(pkt, attr_endp);
+	}
+
+done:
+	/* the main pthread expects to read the packet from the start */
+	stream_set_getp(pkt, 0);
+
+	return pd;
+}
+
+void bgp_attr_predecode_free(struct bgp_attr_predecode **pd)
+{
+	if (!*pd)
+		return;
+
+	if ((*pd)->aspath)
+		aspath_free((*pd)->aspath);
+	if ((*pd)->community)
+		community_free(&(*pd)->community);
+
+	XFREE(MTYPE_BGP_ATTR_PREDECODE, *pd);
+}
+
+/* Caller must hold peer->io_mtx */
+void bgp_attr_predecode_flush(struct peer *peer)
+{
+	struct bgp_attr_predecode *pd;
+
+	while ((pd = bgp_predecode_fifo_pop(&peer->ibuf_predecode)))
+		bgp_attr_predecode_free(&pd);
+}
+
+/* Caller must hold peer->io_mtx; peer->curr has just been dequeued */
+struct bgp_attr_predecode *bgp_attr_predecode_pop(struct peer *peer)
+{
+	struct bgp_attr_predecode *pd;
+
+	pd = bgp_predecode_fifo_first(&peer->ibuf_predecode);
+	if (!pd || pd->pkt != peer->curr)
+		return NULL;
+
+	return bgp_predecode_fifo_pop(&peer->ibuf_predecode);
+}
+
 /*
  * Extract the tunnel type from extended community
  */
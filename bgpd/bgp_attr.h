@@ -294,6 +294,9 @@ struct attr {
 
 	/* SR-TE Color */
 	uint32_t srte_color;
+
+	/* Unique number of the intern'd copy, not part of the hash key */
+	uint32_t intern_id;
 };
 
 /* rmap_change_flags definition */
@@ -349,8 +352,15 @@ extern void bgp_attr_finish(void);
 extern bgp_attr_parse_ret_t bgp_attr_parse(struct peer *, struct attr *,
 					   bgp_size_t, struct bgp_nlri *,
 					   struct bgp_nlri *);
+extern struct bgp_attr_predecode *bgp_attr_predecode(struct peer *peer,
+						     struct stream *pkt);
+extern void bgp_attr_predecode_free(struct bgp_attr_predecode **pd);
+extern void bgp_attr_predecode_flush(struct peer *peer);
+extern struct bgp_attr_predecode *bgp_attr_predecode_pop(struct peer *peer);
 extern void bgp_attr_undup(struct attr *new, struct attr *old);
 extern struct attr *bgp_attr_intern(struct attr *attr);
+extern void bgp_attr_intern_batch_begin(void);
+extern void bgp_attr_intern_batch_end(void);
 extern void bgp_attr_unintern_sub(struct attr *);
 extern void bgp_attr_unintern(struct attr **);
 extern void bgp_attr_flush(struct attr *);
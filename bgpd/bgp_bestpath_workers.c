@@ -0,0 +1,149 @@
+/* BGP best-path selection worker pthreads.
+ * Copyright (C) 2020 FRRouting
+ *
+ * This file is part of FRRouting.
+ *
+ * FRRouting is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * FRRouting is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "frr_pthread.h"
+#include "thread.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_bestpath_workers.h"
+
+struct bgp_bestpath_slice {
+	struct bgp *bgp;
+	struct bgp_bestpath_job *jobs;
+	unsigned int count;
+};
+
+static struct bgp_bestpath_workers {
+	/* protects pending */
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	unsigned int pending;
+
+	unsigned int count;
+	struct frr_pthread *fpt[BGP_BESTPATH_WORKERS_MAX];
+	struct bgp_bestpath_slice slices[BGP_BESTPATH_WORKERS_MAX];
+} bbw = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* Runs on a worker pthread */
+static int bgp_bestpath_worker(struct thread *thread)
+{
+	struct bgp_bestpath_slice *slice = THREAD_ARG(thread);
+	struct bgp_bestpath_job *job;
+	struct bgp_table *table;
+	unsigned int i;
+
+	for (i = 0; i < slice->count; i++) {
+		job = &slice->jobs[i];
+
+		if (!CHECK_FLAG(job->dest->flags, BGP_NODE_SELECT_PRECOMPUTED))
+			continue;
+
+		table = bgp_dest_table(job->dest);
+		bgp_best_selection_compute(
+			slice->bgp, job->dest,
+			&slice->bgp->maxpaths[table->afi][table->safi],
+			&job->result, &job->mp_list, false, table->afi,
+			table->safi);
+	}
+
+	frr_with_mutex(&bbw.mtx) {
+		if (--bbw.pending == 0)
+			pthread_cond_signal(&bbw.cond);
+	}
+
+	return 0;
+}
+
+void bgp_bestpath_workers_run(struct bgp *bgp, struct bgp_bestpath_job *jobs,
+			      unsigned int count)
+{
+	unsigned int i, per_worker, nslices = 0;
+
+	if (!count)
+		return;
+
+	assert(bbw.count);
+	per_worker = (count + bbw.count - 1) / bbw.count;
+
+	for (i = 0; i < bbw.count && i * per_worker < count; i++) {
+		bbw.slices[i].bgp = bgp;
+		bbw.slices[i].jobs = &jobs[i * per_worker];
+		bbw.slices[i].count = MIN(per_worker, count - i * per_worker);
+		nslices++;
+	}
+
+	frr_with_mutex(&bbw.mtx) {
+		bbw.pending = nslices;
+	}
+
+	for (i = 0; i < nslices; i++)
+		thread_add_event(bbw.fpt[i]->master, bgp_bestpath_worker,
+				 &bbw.slices[i], 0, NULL);
+
+	frr_with_mutex(&bbw.mtx) {
+		while (bbw.pending)
+			pthread_cond_wait(&bbw.cond, &bbw.mtx);
+	}
+}
+
+void bgp_bestpath_workers_set(unsigned int count)
+{
+	struct frr_pthread_attr attr = {
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
+	char name[32], os_name[OS_THREAD_NAMELEN];
+
+	count = MIN(count, BGP_BESTPATH_WORKERS_MAX);
+
+	/* workers are idle whenever the main pthread is not in
+	 * bgp_bestpath_workers_run(), so they can be stopped right away
+	 */
+	while (bbw.count > count) {
+		bbw.count--;
+		frr_pthread_stop(bbw.fpt[bbw.count], NULL);
+		frr_pthread_destroy(bbw.fpt[bbw.count]);
+		bbw.fpt[bbw.count] = NULL;
+	}
+
+	while (bbw.count < count) {
+		snprintf(name, sizeof(name), "BGP best-path worker %u",
+			 bbw.count);
+		snprintf(os_name, sizeof(os_name), "bgpd_bp%u", bbw.count);
+
+		bbw.fpt[bbw.count] = frr_pthread_new(&attr, name, os_name);
+		frr_pthread_run(bbw.fpt[bbw.count], NULL);
+		frr_pthread_wait_running(bbw.fpt[bbw.count]);
+		bbw.count++;
+	}
+}
+
+unsigned int bgp_bestpath_workers_count(void)
+{
+	return bbw.count;
+}
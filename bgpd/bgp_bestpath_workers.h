@@ -0,0 +1,60 @@
+/* BGP best-path selection worker pthreads.
+ * Copyright (C) 2020 FRRouting
+ *
+ * This file is part of FRRouting.
+ *
+ * FRRouting is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * FRRouting is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _FRR_BGP_BESTPATH_WORKERS_H
+#define _FRR_BGP_BESTPATH_WORKERS_H
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_route.h"
+
+#define BGP_BESTPATH_WORKERS_MAX 32
+
+/* dests handed to the workers in one go */
+#define BGP_BESTPATH_WORKERS_BATCH 2048
+
+/* smaller work queue items are not worth the handoff */
+#define BGP_BESTPATH_WORKERS_MIN_BATCH 64
+
+/**
+ * Sets the number of best-path worker pthreads.
+ *
+ * Workers are started or stopped as needed; 0 disables the workers and
+ * brings best path selection back entirely onto the main pthread.
+ */
+extern void bgp_bestpath_workers_set(unsigned int count);
+
+/**
+ * Returns the number of running best-path worker pthreads.
+ */
+extern unsigned int bgp_bestpath_workers_count(void);
+
+/**
+ * Runs the path comparison stage of best path selection for a batch.
+ *
+ * Only jobs whose dest is flagged BGP_NODE_SELECT_PRECOMPUTED are computed.
+ * The batch is split evenly over the workers and this function blocks until
+ * all of them are done, so the main pthread does not touch the RIB while the
+ * workers run.
+ */
+extern void bgp_bestpath_workers_run(struct bgp *bgp,
+				     struct bgp_bestpath_job *jobs,
+				     unsigned int count);
+
+#endif /* _FRR_BGP_BESTPATH_WORKERS_H */
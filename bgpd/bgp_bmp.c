@@ -27,7 +27,6 @@
 #include "thread.h"
 #include "linklist.h"
 #include "queue.h"
-#include "pullwr.h"
 #include "memory.h"
 #include "network.h"
 #include "filter.h"
@@ -37,6 +36,7 @@
 #include "version.h"
 #include "jhash.h"
 #include "termtable.h"
+#include "frr_pthread.h"
 
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgpd.h"
@@ -57,6 +57,11 @@ static struct bmp_bgp_peer *bmp_bgp_peer_find(uint64_t peerid);
 static struct bmp_bgp_peer *bmp_bgp_peer_get(struct peer *peer);
 static void bmp_active_disconnected(struct bmp_active *ba);
 static void bmp_active_put(struct bmp_active *ba);
+static int bmp_fill(struct thread *thread);
+static int bmp_reap(struct thread *thread);
+static int bmp_io_error(struct thread *thread);
+static int bmp_io_work(struct thread *thread);
+static int bmp_io_writable(struct thread *thread);
 
 DEFINE_MGROUP(BMP, "BMP (BGP Monitoring Protocol)")
 
@@ -71,6 +76,7 @@ DEFINE_MTYPE_STATIC(BMP, BMP,		"BMP instance state")
 DEFINE_MTYPE_STATIC(BMP, BMP_MIRRORQ,	"BMP route mirroring buffer")
 DEFINE_MTYPE_STATIC(BMP, BMP_PEER,	"BMP per BGP peer data")
 DEFINE_MTYPE_STATIC(BMP, BMP_OPEN,	"BMP stored BGP OPEN message")
+DEFINE_MTYPE_STATIC(BMP, BMP_OUTQ,	"BMP output queue item")
 
 DEFINE_QOBJ_TYPE(bmp_targets)
 
@@ -143,6 +149,8 @@ DECLARE_SORTLIST_UNIQ(bmp_targets, struct bmp_targets, bti, bmp_targets_cmp)
 
 DECLARE_LIST(bmp_session, struct bmp, bsi)
 
+DECLARE_LIST(bmp_outq, struct bmp_outitem, boi)
+
 DECLARE_DLIST(bmp_qlist, struct bmp_queue_entry, bli)
 
 static int bmp_qhash_cmp(const struct bmp_queue_entry *a,
@@ -233,6 +241,320 @@ static void bmp_free(struct bmp *bmp)
 	XFREE(MTYPE_BMP_CONN, bmp);
 }
 
+/*
+ * Output
+ *
+ * The main pthread picks what to send next (bmp_wrfill) and hands it to the
+ * BMP pthread, which encodes route monitoring messages and writes to the
+ * collectors.  Handing over stops while a session has more than
+ * BMP_IO_HIWAT bytes pending, and resumes once the BMP pthread got it down
+ * to BMP_IO_LOWAT.
+ */
+
+#define BMP_IO_HIWAT		(4 * 1024 * 1024)
+#define BMP_IO_LOWAT		(1024 * 1024)
+/* pending bytes accounted per route until it is encoded */
+#define BMP_ROUTE_COST		64
+/* usec spent in bmp_fill before yielding to other tasks */
+#define BMP_FILL_MAXSPIN	2500
+#define BMP_IOV_MAX		64
+
+static struct frr_pthread *bmp_pth;
+
+static void bmp_pthread_start(void)
+{
+	struct frr_pthread_attr attr = {
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
+
+	if (bmp_pth)
+		return;
+
+	bmp_pth = frr_pthread_new(&attr, "BMP I/O", "bgpd_bmp");
+	frr_pthread_run(bmp_pth, NULL);
+	frr_pthread_wait_running(bmp_pth);
+}
+
+static void bmp_outitem_free(struct bmp_outitem *item)
+{
+	unsigned int i;
+
+	for (i = 0; i < item->nattrs; i++) {
+		if (item->attrs[i].attr)
+			bgp_attr_unintern(&item->attrs[i].attr);
+		stream_free(item->attrs[i].s);
+	}
+	XFREE(MTYPE_BMP_OUTQ, item->attrs);
+	stream_free(item->s);
+	XFREE(MTYPE_BMP_OUTQ, item);
+}
+
+static void bmp_io_queue(struct bmp *bmp, struct bmp_outitem *item)
+{
+	frr_with_mutex(&bmp->io_mtx) {
+		bmp_outq_add_tail(&bmp->outq, item);
+		bmp->io_pending += item->cost;
+		bmp->io_pending_max = MAX(bmp->io_pending_max,
+					  bmp->io_pending);
+	}
+
+	thread_add_event(bmp_pth->master, bmp_io_work, bmp, 0, &bmp->t_io);
+}
+
+/* hand the routes collected so far to the BMP pthread */
+static void bmp_batch_flush(struct bmp *bmp)
+{
+	struct bmp_outitem *batch = bmp->batch;
+
+	if (!batch)
+		return;
+
+	bmp->batch = NULL;
+	bmp_io_queue(bmp, batch);
+}
+
+/* queue an encoded message, takes ownership of s */
+static void bmp_io_write(struct bmp *bmp, struct stream *s)
+{
+	struct bmp_outitem *item;
+
+	/* routes collected earlier go out first */
+	bmp_batch_flush(bmp);
+
+	item = XCALLOC(MTYPE_BMP_OUTQ, sizeof(*item));
+	item->s = s;
+	item->cost = stream_get_endp(s);
+	bmp_io_queue(bmp, item);
+}
+
+/* start an UPDATE with the path attributes as encoded for this peer, the
+ * BMP pthread adds the NLRI
+ */
+static void bmp_routeattr_encode(struct bmp_routeattr *ra, struct peer *peer)
+{
+	struct bpacket_attr_vec_arr vecarr;
+	struct stream *s;
+
+	bpacket_attr_vec_arr_reset(&vecarr);
+
+	s = stream_new(BGP_MAX_PACKET_SIZE);
+	bgp_packet_set_marker(s, BGP_MSG_UPDATE);
+
+	/* 2: withdrawn routes length */
+	stream_putw(s, 0);
+
+	/* 3: total attributes length, set once the NLRI are in */
+	stream_putw(s, 0);
+
+	/* 5: Encode all the attributes, except MP_REACH_NLRI attr. */
+	bgp_packet_attribute(NULL, peer, s, ra->attr, &vecarr, NULL, ra->afi,
+			     ra->safi, peer, NULL, NULL, 0, 0, 0);
+
+	/* peer_cap_enhe & add-path removed, MPLS removed for now */
+	if (ra->afi != AFI_IP || ra->safi != SAFI_UNICAST)
+		ra->mpattrlen_pos = bgp_packet_mpattr_start(
+			s, peer, ra->afi, ra->safi, &vecarr, ra->attr);
+
+	ra->s = stream_dup(s);
+	stream_free(s);
+}
+
+/* the attributes passed in are intern'd already, so comparing pointers
+ * finds the routes that can share an UPDATE
+ */
+static unsigned int bmp_routeattr_get(struct bmp_outitem *batch,
+				      struct peer *peer, struct attr *attr,
+				      afi_t afi, safi_t safi)
+{
+	struct bmp_routeattr *ra;
+	unsigned int i;
+
+	/* live updates tend to repeat the previous route's */
+	if (batch->nroutes) {
+		i = batch->routes[batch->nroutes - 1].attridx;
+		ra = &batch->attrs[i];
+		if (ra->peer == peer && ra->attr == attr && ra->afi == afi
+		    && ra->safi == safi)
+			return i;
+	}
+
+	for (i = 0; i < batch->nattrs; i++) {
+		ra = &batch->attrs[i];
+		if (ra->peer == peer && ra->attr == attr && ra->afi == afi
+		    && ra->safi == safi)
+			return i;
+	}
+
+	ra = &batch->attrs[batch->nattrs];
+	ra->peer = peer;
+	ra->attr = attr ? bgp_attr_intern(attr) : NULL;
+	ra->afi = afi;
+	ra->safi = safi;
+	ra->su = peer->su;
+	ra->as = peer->as;
+	ra->remote_id = peer->remote_id;
+	if (ra->attr)
+		bmp_routeattr_encode(ra, peer);
+
+	return batch->nattrs++;
+}
+
+/* queue a route monitoring message;  attr == NULL is a withdraw */
+static void bmp_monitor(struct bmp *bmp, struct peer *peer, uint8_t flags,
+			const struct prefix *p, struct prefix_rd *prd,
+			struct attr *attr, afi_t afi, safi_t safi,
+			time_t uptime, bool regroup)
+{
+	struct bmp_outitem *batch = bmp->batch;
+	struct bmp_route *route;
+
+	if (batch && (batch->regroup != regroup
+		      || batch->nroutes == BMP_BATCH_ROUTES)) {
+		bmp_batch_flush(bmp);
+		batch = NULL;
+	}
+	if (!batch) {
+		batch = XCALLOC(MTYPE_BMP_OUTQ,
+				sizeof(*batch)
+					+ BMP_BATCH_ROUTES
+						  * sizeof(batch->routes[0]));
+		batch->attrs = XCALLOC(MTYPE_BMP_OUTQ,
+				       BMP_BATCH_ROUTES
+					       * sizeof(batch->attrs[0]));
+		batch->regroup = regroup;
+		bmp->batch = batch;
+	}
+
+	route = &batch->routes[batch->nroutes];
+	route->attridx = bmp_routeattr_get(batch, peer, attr, afi, safi);
+	route->seq = batch->nroutes++;
+	prefix_copy(&route->p, p);
+	if (prd) {
+		route->rd = *prd;
+		route->has_rd = true;
+	}
+	route->flags = flags;
+	route->uptime = uptime;
+	batch->cost += BMP_ROUTE_COST;
+}
+
+static void bmp_bump(struct bmp *bmp)
+{
+	thread_add_event(bm->master, bmp_fill, bmp, 0, &bmp->t_fill);
+}
+
+static bool bmp_io_throttle(struct bmp *bmp)
+{
+	size_t pending = bmp->batch ? bmp->batch->cost : 0;
+	bool throttle = false;
+
+	frr_with_mutex(&bmp->io_mtx) {
+		if (bmp->io_throttled) {
+			throttle = true;
+		} else if (bmp->io_pending + pending >= BMP_IO_HIWAT) {
+			bmp->io_throttled = true;
+			bmp->cnt_throttled++;
+			bmp->targets->cnt_throttled++;
+			throttle = true;
+		}
+	}
+	return throttle;
+}
+
+static bool bmp_wrfill(struct bmp *bmp);
+
+static int bmp_fill(struct thread *thread)
+{
+	struct bmp *bmp = THREAD_ARG(thread);
+	struct timeval start;
+
+	monotime(&start);
+
+	while (!bmp_io_throttle(bmp)) {
+		if (!bmp_wrfill(bmp))
+			break;
+
+		if (monotime_since(&start, NULL) > BMP_FILL_MAXSPIN) {
+			bmp_bump(bmp);
+			break;
+		}
+	}
+
+	bmp_batch_flush(bmp);
+	return 0;
+}
+
+/* release what encoded batches held on to, on the main pthread */
+static int bmp_reap(struct thread *thread)
+{
+	struct bmp *bmp = THREAD_ARG(thread);
+	struct bmp_outitem *item;
+
+	do {
+		frr_with_mutex(&bmp->io_mtx) {
+			item = bmp_outq_pop(&bmp->doneq);
+		}
+		if (item)
+			bmp_outitem_free(item);
+	} while (item);
+
+	return 0;
+}
+
+static void bmp_wrerr(struct bmp *bmp, bool eof);
+
+static int bmp_io_error(struct thread *thread)
+{
+	struct bmp *bmp = THREAD_ARG(thread);
+	bool eof;
+
+	frr_with_mutex(&bmp->io_mtx) {
+		eof = bmp->io_eof;
+	}
+	bmp_wrerr(bmp, eof);
+	return 0;
+}
+
+static void bmp_io_init(struct bmp *bmp)
+{
+	bmp_pthread_start();
+
+	pthread_mutex_init(&bmp->io_mtx, NULL);
+	bmp_outq_init(&bmp->outq);
+	bmp_outq_init(&bmp->doneq);
+	stream_fifo_init(&bmp->wrq);
+}
+
+static void bmp_io_fini(struct bmp *bmp)
+{
+	struct bmp_outitem *item;
+
+	/* thread_cancel_async returns once the BMP pthread is between tasks,
+	 * bmp_io_work may schedule t_write but not the other way around
+	 */
+	thread_cancel_async(bmp_pth->master, &bmp->t_io, NULL);
+	thread_cancel_async(bmp_pth->master, &bmp->t_write, NULL);
+
+	THREAD_OFF(bmp->t_fill);
+	THREAD_OFF(bmp->t_reap);
+	THREAD_OFF(bmp->t_error);
+
+	if (bmp->batch) {
+		bmp_outitem_free(bmp->batch);
+		bmp->batch = NULL;
+	}
+	while ((item = bmp_outq_pop(&bmp->outq)))
+		bmp_outitem_free(item);
+	while ((item = bmp_outq_pop(&bmp->doneq)))
+		bmp_outitem_free(item);
+	bmp_outq_fini(&bmp->outq);
+	bmp_outq_fini(&bmp->doneq);
+
+	stream_fifo_deinit(&bmp->wrq);
+	pthread_mutex_destroy(&bmp->io_mtx);
+}
+
 static void bmp_common_hdr(struct stream *s, uint8_t ver, uint8_t type)
 {
 	stream_putc(s, ver);
@@ -240,8 +562,9 @@ static void bmp_common_hdr(struct stream *s, uint8_t ver, uint8_t type)
 	stream_putc(s, type);
 }
 
-static void bmp_per_peer_hdr(struct stream *s, struct peer *peer,
-		uint8_t flags, const struct timeval *tv)
+static void bmp_per_peer_hdr_put(struct stream *s, const union sockunion *su,
+				 as_t as, struct in_addr remote_id,
+				 uint8_t flags, const struct timeval *tv)
 {
 	char peer_distinguisher[8];
 
@@ -257,7 +580,7 @@ static void bmp_per_peer_hdr(struct stream *s, struct peer *peer,
 	stream_putc(s, BMP_PEER_TYPE_GLOBAL_INSTANCE);
 
 	/* Peer Flags */
-	if (peer->su.sa.sa_family == AF_INET6)
+	if (su->sa.sa_family == AF_INET6)
 		SET_FLAG(flags, BMP_PEER_FLAG_V);
 	else
 		UNSET_FLAG(flags, BMP_PEER_FLAG_V);
@@ -268,13 +591,13 @@ static void bmp_per_peer_hdr(struct stream *s, struct peer *peer,
 	stream_put(s, &peer_distinguisher[0], 8);
 
 	/* Peer Address */
-	if (peer->su.sa.sa_family == AF_INET6)
-		stream_put(s, &peer->su.sin6.sin6_addr, 16);
-	else if (peer->su.sa.sa_family == AF_INET) {
+	if (su->sa.sa_family == AF_INET6)
+		stream_put(s, &su->sin6.sin6_addr, 16);
+	else if (su->sa.sa_family == AF_INET) {
 		stream_putl(s, 0);
 		stream_putl(s, 0);
 		stream_putl(s, 0);
-		stream_put_in_addr(s, &peer->su.sin.sin_addr);
+		stream_put_in_addr(s, &su->sin.sin_addr);
 	} else {
 		stream_putl(s, 0);
 		stream_putl(s, 0);
@@ -283,10 +606,10 @@ static void bmp_per_peer_hdr(struct stream *s, struct peer *peer,
 	}
 
 	/* Peer AS */
-	stream_putl(s, peer->as);
+	stream_putl(s, as);
 
 	/* Peer BGP ID */
-	stream_put_in_addr(s, &peer->remote_id);
+	stream_put_in_addr(s, &remote_id);
 
 	/* Timestamp */
 	if (tv) {
@@ -298,6 +621,13 @@ static void bmp_per_peer_hdr(struct stream *s, struct peer *peer,
 	}
 }
 
+static void bmp_per_peer_hdr(struct stream *s, struct peer *peer,
+		uint8_t flags, const struct timeval *tv)
+{
+	bmp_per_peer_hdr_put(s, &peer->su, peer->as, peer->remote_id, flags,
+			     tv);
+}
+
 static void bmp_put_info_tlv(struct stream *s, uint16_t type,
 		const char *string)
 {
@@ -323,8 +653,7 @@ static int bmp_send_initiation(struct bmp *bmp)
 	len = stream_get_endp(s);
 	stream_putl_at(s, BMP_LENGTH_POS, len); //message length is set.
 
-	pullwr_write_stream(bmp->pullwr, s);
-	stream_free(s);
+	bmp_io_write(bmp, s);
 	return 0;
 }
 
@@ -458,14 +787,13 @@ static int bmp_send_peerup(struct bmp *bmp)
 	/* Walk down all peers */
 	for (ALL_LIST_ELEMENTS_RO(bmp->targets->bgp->peer, node, peer)) {
 		s = bmp_peerstate(peer, false);
-		pullwr_write_stream(bmp->pullwr, s);
-		stream_free(s);
+		bmp_io_write(bmp, s);
 	}
 
 	return 0;
 }
 
-/* XXX: kludge - filling the pullwr's buffer */
+/* XXX: kludge - bypasses the fill loop */
 static void bmp_send_all(struct bmp_bgp *bmpbgp, struct stream *s)
 {
 	struct bmp_targets *bt;
@@ -473,7 +801,7 @@ static void bmp_send_all(struct bmp_bgp *bmpbgp, struct stream *s)
 
 	frr_each(bmp_targets, &bmpbgp->targets, bt)
 		frr_each(bmp_session, &bt->sessions, bmp)
-			pullwr_write_stream(bmp->pullwr, s);
+			bmp_io_write(bmp, stream_dup(s));
 	stream_free(s);
 }
 
@@ -530,7 +858,7 @@ static void bmp_mirror_cull(struct bmp_bgp *bmpbgp)
 				zlog_warn("bmp[%s] lost mirror messages due to buffer size limit",
 						bmp->remote);
 				bmp->mirror_lost = true;
-				pullwr_bump(bmp->pullwr);
+				bmp_bump(bmp);
 			}
 		}
 	}
@@ -573,7 +901,7 @@ static int bmp_mirror_packet(struct peer *peer, uint8_t type, bgp_size_t size,
 			qitem->refcount++;
 			if (!bmp->mirrorpos)
 				bmp->mirrorpos = qitem;
-			pullwr_bump(bmp->pullwr);
+			bmp_bump(bmp);
 		}
 	}
 	if (qitem->refcount == 0)
@@ -590,7 +918,7 @@ static int bmp_mirror_packet(struct peer *peer, uint8_t type, bgp_size_t size,
 	return 0;
 }
 
-static void bmp_wrmirror_lost(struct bmp *bmp, struct pullwr *pullwr)
+static void bmp_wrmirror_lost(struct bmp *bmp)
 {
 	struct stream *s;
 	struct timeval tv;
@@ -608,18 +936,17 @@ static void bmp_wrmirror_lost(struct bmp *bmp, struct pullwr *pullwr)
 	stream_putl_at(s, BMP_LENGTH_POS, stream_get_endp(s));
 
 	bmp->cnt_mirror_overruns++;
-	pullwr_write_stream(bmp->pullwr, s);
-	stream_free(s);
+	bmp_io_write(bmp, s);
 }
 
-static bool bmp_wrmirror(struct bmp *bmp, struct pullwr *pullwr)
+static bool bmp_wrmirror(struct bmp *bmp)
 {
 	struct bmp_mirrorq *bmq;
 	struct peer *peer;
 	bool written = false;
 
 	if (bmp->mirror_lost) {
-		bmp_wrmirror_lost(bmp, pullwr);
+		bmp_wrmirror_lost(bmp);
 		bmp->mirror_lost = false;
 		return true;
 	}
@@ -645,11 +972,12 @@ static bool bmp_wrmirror(struct bmp *bmp, struct pullwr *pullwr)
 	stream_putw(s, bmq->len);
 	stream_putl_at(s, BMP_LENGTH_POS, stream_get_endp(s) + bmq->len);
 
-	bmp->cnt_mirror++;
-	pullwr_write_stream(bmp->pullwr, s);
-	pullwr_write(bmp->pullwr, bmq->data, bmq->len);
+	if (STREAM_WRITEABLE(s) < bmq->len)
+		stream_resize_inplace(&s, stream_get_endp(s) + bmq->len);
+	stream_put(s, bmq->data, bmq->len);
 
-	stream_free(s);
+	bmp->cnt_mirror++;
+	bmp_io_write(bmp, s);
 	written = true;
 
 out:
@@ -773,70 +1101,77 @@ static void bmp_eor(struct bmp *bmp, afi_t afi, safi_t safi, uint8_t flags)
 
 		stream_putl_at(s2, BMP_LENGTH_POS,
 				stream_get_endp(s) + stream_get_endp(s2));
+		stream_put(s2, s->data, stream_get_endp(s));
 
-		bmp->cnt_update++;
-		pullwr_write_stream(bmp->pullwr, s2);
-		pullwr_write_stream(bmp->pullwr, s);
-		stream_free(s2);
+		atomic_fetch_add_explicit(&bmp->cnt_update, 1,
+					  memory_order_relaxed);
+		bmp_io_write(bmp, s2);
 	}
 	stream_free(s);
 }
 
-static struct stream *bmp_update(const struct prefix *p, struct prefix_rd *prd,
-				 struct peer *peer, struct attr *attr,
-				 afi_t afi, safi_t safi)
+/*
+ * Route monitoring encoding, on the BMP pthread.  Routes that share the
+ * peer, flags, AFI/SAFI and attributes go into the same UPDATE as long as
+ * it has room for them.  Neither the peer nor the BGP instance are touched
+ * here, the batch carries what is needed from them.
+ */
+
+static struct stream *bmp_update(struct bmp_outitem *item,
+				 struct bmp_route **routes, size_t nroutes,
+				 size_t *used)
 {
-	struct bpacket_attr_vec_arr vecarr;
+	struct bmp_routeattr *ra = &item->attrs[routes[0]->attridx];
+	afi_t afi = ra->afi;
+	safi_t safi = ra->safi;
 	struct stream *s;
-	size_t attrlen_pos = 0, mpattrlen_pos = 0;
-	bgp_size_t total_attr_len = 0;
-
-	bpacket_attr_vec_arr_reset(&vecarr);
+	size_t attrlen_pos = BGP_HEADER_SIZE + 2, i;
 
 	s = stream_new(BGP_MAX_PACKET_SIZE);
-	bgp_packet_set_marker(s, BGP_MSG_UPDATE);
+	stream_put(s, STREAM_DATA(ra->s), stream_get_endp(ra->s));
 
-	/* 2: withdrawn routes length */
-	stream_putw(s, 0);
-
-	/* 3: total attributes length - attrlen_pos stores the position */
-	attrlen_pos = stream_get_endp(s);
-	stream_putw(s, 0);
-
-	/* 5: Encode all the attributes, except MP_REACH_NLRI attr. */
-	total_attr_len = bgp_packet_attribute(NULL, peer, s, attr,
-			&vecarr, NULL, afi, safi, peer, NULL, NULL, 0, 0, 0);
+	for (i = 0; i < nroutes; i++) {
+		if (i && STREAM_WRITEABLE(s) < BGP_NLRI_LENGTH
+			  + bgp_packet_mpattr_prefix_size(
+				    afi, safi, &routes[i]->p))
+			break;
 
-	/* space check? */
+		/* peer_cap_enhe & add-path removed */
+		if (afi == AFI_IP && safi == SAFI_UNICAST)
+			stream_put_prefix(s, &routes[i]->p);
+		else
+			bgp_packet_mpattr_prefix(s, afi, safi, &routes[i]->p,
+						 routes[i]->has_rd
+							 ? &routes[i]->rd
+							 : NULL,
+						 NULL, 0, 0, 0, ra->attr);
+	}
 
-	/* peer_cap_enhe & add-path removed */
+	/* set the total attribute length correctly, IPv4 unicast NLRI
+	 * follow the attributes
+	 */
 	if (afi == AFI_IP && safi == SAFI_UNICAST)
-		stream_put_prefix(s, p);
+		stream_putw_at(s, attrlen_pos,
+			       stream_get_endp(ra->s) - attrlen_pos - 2);
 	else {
-		size_t p1 = stream_get_endp(s);
-
-		/* MPLS removed for now */
-
-		mpattrlen_pos = bgp_packet_mpattr_start(s, peer, afi, safi,
-				&vecarr, attr);
-		bgp_packet_mpattr_prefix(s, afi, safi, p, prd, NULL, 0, 0, 0,
-					 attr);
-		bgp_packet_mpattr_end(s, mpattrlen_pos);
-		total_attr_len += stream_get_endp(s) - p1;
+		bgp_packet_mpattr_end(s, ra->mpattrlen_pos);
+		stream_putw_at(s, attrlen_pos,
+			       stream_get_endp(s) - attrlen_pos - 2);
 	}
-
-	/* set the total attribute length correctly */
-	stream_putw_at(s, attrlen_pos, total_attr_len);
 	bgp_packet_set_size(s);
+
+	*used = i;
 	return s;
 }
 
-static struct stream *bmp_withdraw(const struct prefix *p,
-				   struct prefix_rd *prd, afi_t afi,
-				   safi_t safi)
+static struct stream *bmp_withdraw(struct bmp_outitem *item,
+				   struct bmp_route **routes, size_t nroutes,
+				   size_t *used)
 {
+	afi_t afi = item->attrs[routes[0]->attridx].afi;
+	safi_t safi = item->attrs[routes[0]->attridx].safi;
 	struct stream *s;
-	size_t attrlen_pos = 0, mp_start, mplen_pos;
+	size_t attrlen_pos = 0, mp_start, mplen_pos, i;
 	bgp_size_t total_attr_len = 0;
 	bgp_size_t unfeasible_len;
 
@@ -846,7 +1181,14 @@ static struct stream *bmp_withdraw(const struct prefix *p,
 	stream_putw(s, 0);
 
 	if (afi == AFI_IP && safi == SAFI_UNICAST) {
-		stream_put_prefix(s, p);
+		for (i = 0; i < nroutes; i++) {
+			/* keep room for the total attribute length */
+			if (i && STREAM_WRITEABLE(s) < BGP_NLRI_LENGTH + 2
+				  + bgp_packet_mpattr_prefix_size(
+					    afi, safi, &routes[i]->p))
+				break;
+			stream_put_prefix(s, &routes[i]->p);
+		}
 		unfeasible_len = stream_get_endp(s) - BGP_HEADER_SIZE
 				 - BGP_UNFEASIBLE_LEN;
 		stream_putw_at(s, BGP_HEADER_SIZE, unfeasible_len);
@@ -858,8 +1200,18 @@ static struct stream *bmp_withdraw(const struct prefix *p,
 		mp_start = stream_get_endp(s);
 		mplen_pos = bgp_packet_mpunreach_start(s, afi, safi);
 
-		bgp_packet_mpunreach_prefix(s, p, afi, safi, prd, NULL, 0, 0, 0,
-					    NULL);
+		for (i = 0; i < nroutes; i++) {
+			if (i && STREAM_WRITEABLE(s) < BGP_NLRI_LENGTH
+				  + bgp_packet_mpattr_prefix_size(
+					    afi, safi, &routes[i]->p))
+				break;
+			bgp_packet_mpunreach_prefix(s, &routes[i]->p, afi,
+						    safi,
+						    routes[i]->has_rd
+							    ? &routes[i]->rd
+							    : NULL,
+						    NULL, 0, 0, 0, NULL);
+		}
 		/* Set the mp_unreach attr's length */
 		bgp_packet_mpunreach_end(s, mplen_pos);
 
@@ -869,39 +1221,203 @@ static struct stream *bmp_withdraw(const struct prefix *p,
 	}
 
 	bgp_packet_set_size(s);
+
+	*used = i;
 	return s;
 }
 
-static void bmp_monitor(struct bmp *bmp, struct peer *peer, uint8_t flags,
-			const struct prefix *p, struct prefix_rd *prd,
-			struct attr *attr, afi_t afi, safi_t safi,
-			time_t uptime)
+static bool bmp_route_same(const struct bmp_route *a,
+			   const struct bmp_route *b)
+{
+	return a->attridx == b->attridx && a->flags == b->flags;
+}
+
+static int bmp_route_cmp(const void *va, const void *vb)
 {
+	const struct bmp_route *a = *(const struct bmp_route **)va;
+	const struct bmp_route *b = *(const struct bmp_route **)vb;
+
+	if (a->attridx != b->attridx)
+		return a->attridx < b->attridx ? -1 : 1;
+	if (a->flags != b->flags)
+		return a->flags < b->flags ? -1 : 1;
+	return a->seq < b->seq ? -1 : (a->seq > b->seq);
+}
+
+/* returns the number of bytes queued for writing */
+static size_t bmp_encode_routes(struct bmp *bmp, struct bmp_outitem *item)
+{
+	struct bmp_route *routes[BMP_BATCH_ROUTES];
+	struct bmp_routeattr *ra;
 	struct stream *hdr, *msg;
-	struct timeval tv = { .tv_sec = uptime, .tv_usec = 0 };
-	struct timeval uptime_real;
+	struct timeval tv, uptime_real;
+	size_t i, j, n, used, len = 0;
+	uint64_t msgs = 0;
+
+	for (i = 0; i < item->nroutes; i++)
+		routes[i] = &item->routes[i];
+
+	/* table sync sends every route once, so it may be reordered;  live
+	 * updates for the same prefix have to stay in order
+	 */
+	if (item->regroup)
+		qsort(routes, item->nroutes, sizeof(routes[0]), bmp_route_cmp);
+
+	for (i = 0; i < item->nroutes; i += used) {
+		for (n = 1; i + n < item->nroutes; n++)
+			if (!bmp_route_same(routes[i], routes[i + n]))
+				break;
 
-	monotime_to_realtime(&tv, &uptime_real);
-	if (attr)
-		msg = bmp_update(p, prd, peer, attr, afi, safi);
-	else
-		msg = bmp_withdraw(p, prd, afi, safi);
+		ra = &item->attrs[routes[i]->attridx];
+		if (ra->attr)
+			msg = bmp_update(item, &routes[i], n, &used);
+		else
+			msg = bmp_withdraw(item, &routes[i], n, &used);
+
+		/* the per-peer header carries a single timestamp */
+		tv.tv_sec = 0;
+		tv.tv_usec = 0;
+		for (j = i; j < i + used; j++)
+			tv.tv_sec = MAX(tv.tv_sec, routes[j]->uptime);
+		monotime_to_realtime(&tv, &uptime_real);
+
+		hdr = stream_new(BGP_MAX_PACKET_SIZE);
+		bmp_common_hdr(hdr, BMP_VERSION_3, BMP_TYPE_ROUTE_MONITORING);
+		bmp_per_peer_hdr_put(hdr, &ra->su, ra->as, ra->remote_id,
+				     routes[i]->flags, &uptime_real);
+
+		stream_putl_at(hdr, BMP_LENGTH_POS,
+				stream_get_endp(hdr) + stream_get_endp(msg));
+
+		len += stream_get_endp(hdr) + stream_get_endp(msg);
+		stream_fifo_push(&bmp->wrq, hdr);
+		stream_fifo_push(&bmp->wrq, msg);
+		msgs++;
+	}
+
+	atomic_fetch_add_explicit(&bmp->cnt_update, msgs, memory_order_relaxed);
+	atomic_fetch_add_explicit(&bmp->cnt_routes, item->nroutes,
+				  memory_order_relaxed);
+	return len;
+}
 
-	hdr = stream_new(BGP_MAX_PACKET_SIZE);
-	bmp_common_hdr(hdr, BMP_VERSION_3, BMP_TYPE_ROUTE_MONITORING);
-	bmp_per_peer_hdr(hdr, peer, flags, &uptime_real);
+static void bmp_io_output(struct bmp *bmp)
+{
+	struct iovec iov[BMP_IOV_MAX];
+	struct stream *s;
+	ssize_t nwr;
+	size_t written = 0, len;
+	int iovcnt, err = 0;
+	bool resume = false;
 
-	stream_putl_at(hdr, BMP_LENGTH_POS,
-			stream_get_endp(hdr) + stream_get_endp(msg));
+	if (bmp->io_failed)
+		return;
 
-	bmp->cnt_update++;
-	pullwr_write_stream(bmp->pullwr, hdr);
-	pullwr_write_stream(bmp->pullwr, msg);
-	stream_free(hdr);
-	stream_free(msg);
+	while (stream_fifo_head(&bmp->wrq)) {
+		iovcnt = 0;
+		for (s = stream_fifo_head(&bmp->wrq);
+		     s && iovcnt < BMP_IOV_MAX; s = s->next) {
+			iov[iovcnt].iov_base = stream_pnt(s);
+			iov[iovcnt].iov_len = STREAM_READABLE(s);
+			iovcnt++;
+		}
+
+		nwr = writev(bmp->socket, iov, iovcnt);
+		if (nwr < 0 && ERRNO_IO_RETRY(errno)) {
+			thread_add_write(bmp_pth->master, bmp_io_writable, bmp,
+					 bmp->socket, &bmp->t_write);
+			break;
+		}
+		if (nwr <= 0) {
+			err = nwr < 0 ? errno : 0;
+			bmp->io_failed = true;
+			break;
+		}
+
+		written += nwr;
+		while (nwr > 0) {
+			s = stream_fifo_head(&bmp->wrq);
+			len = STREAM_READABLE(s);
+			if ((size_t)nwr < len) {
+				stream_forward_getp(s, nwr);
+				break;
+			}
+			stream_free(stream_fifo_pop(&bmp->wrq));
+			nwr -= len;
+		}
+	}
+
+	atomic_fetch_add_explicit(&bmp->cnt_bytes, written,
+				  memory_order_relaxed);
+
+	frr_with_mutex(&bmp->io_mtx) {
+		bmp->io_pending -= written;
+
+		if (bmp->io_failed) {
+			bmp->io_eof = (err == 0);
+			bmp->io_errno = err;
+		} else if (bmp->io_throttled
+			   && bmp->io_pending < BMP_IO_LOWAT) {
+			bmp->io_throttled = false;
+			resume = true;
+		}
+	}
+
+	if (bmp->io_failed)
+		thread_add_event(bm->master, bmp_io_error, bmp, 0,
+				 &bmp->t_error);
+	else if (resume)
+		thread_add_event(bm->master, bmp_fill, bmp, 0, &bmp->t_fill);
+}
+
+static int bmp_io_writable(struct thread *thread)
+{
+	struct bmp *bmp = THREAD_ARG(thread);
+
+	bmp_io_output(bmp);
+	return 0;
 }
 
-static bool bmp_wrsync(struct bmp *bmp, struct pullwr *pullwr)
+static int bmp_io_work(struct thread *thread)
+{
+	struct bmp *bmp = THREAD_ARG(thread);
+	struct bmp_outitem *item;
+	size_t len;
+	bool reap = false;
+
+	for (;;) {
+		frr_with_mutex(&bmp->io_mtx) {
+			item = bmp_outq_pop(&bmp->outq);
+		}
+		if (!item)
+			break;
+
+		if (item->s) {
+			stream_fifo_push(&bmp->wrq, item->s);
+			item->s = NULL;
+			XFREE(MTYPE_BMP_OUTQ, item);
+			continue;
+		}
+
+		/* attributes are released on the main pthread */
+		len = bmp_encode_routes(bmp, item);
+		frr_with_mutex(&bmp->io_mtx) {
+			bmp->io_pending += len;
+			bmp->io_pending -= item->cost;
+			bmp_outq_add_tail(&bmp->doneq, item);
+		}
+		reap = true;
+	}
+
+	if (reap)
+		thread_add_event(bm->master, bmp_reap, bmp, 0, &bmp->t_reap);
+
+	if (!bmp->t_write)
+		bmp_io_output(bmp);
+	return 0;
+}
+
+static bool bmp_wrsync(struct bmp *bmp)
 {
 	afi_t afi;
 	safi_t safi;
@@ -1063,10 +1579,10 @@ afibreak:
 
 	if (bpi)
 		bmp_monitor(bmp, bpi->peer, BMP_PEER_FLAG_L, bn_p, prd,
-			    bpi->attr, afi, safi, bpi->uptime);
+			    bpi->attr, afi, safi, bpi->uptime, true);
 	if (adjin)
 		bmp_monitor(bmp, adjin->peer, 0, bn_p, prd, adjin->attr, afi,
-			    safi, adjin->uptime);
+			    safi, adjin->uptime, true);
 
 	return true;
 }
@@ -1089,7 +1605,7 @@ static struct bmp_queue_entry *bmp_pull(struct bmp *bmp)
 	return bqe;
 }
 
-static bool bmp_wrqueue(struct bmp *bmp, struct pullwr *pullwr)
+static bool bmp_wrqueue(struct bmp *bmp)
 {
 	struct bmp_queue_entry *bqe;
 	struct peer *peer;
@@ -1146,7 +1662,7 @@ static bool bmp_wrqueue(struct bmp *bmp, struct pullwr *pullwr)
 
 		bmp_monitor(bmp, peer, BMP_PEER_FLAG_L, &bqe->p, prd,
 			    bpi ? bpi->attr : NULL, afi, safi,
-			    bpi ? bpi->uptime : monotime(NULL));
+			    bpi ? bpi->uptime : monotime(NULL), false);
 		written = true;
 	}
 
@@ -1160,7 +1676,7 @@ static bool bmp_wrqueue(struct bmp *bmp, struct pullwr *pullwr)
 		}
 		bmp_monitor(bmp, peer, BMP_PEER_FLAG_L, &bqe->p, prd,
 			    adjin ? adjin->attr : NULL, afi, safi,
-			    adjin ? adjin->uptime : monotime(NULL));
+			    adjin ? adjin->uptime : monotime(NULL), false);
 		written = true;
 	}
 
@@ -1170,32 +1686,34 @@ out:
 	return written;
 }
 
-static void bmp_wrfill(struct bmp *bmp, struct pullwr *pullwr)
+/* returns false when there is nothing left to send for now */
+static bool bmp_wrfill(struct bmp *bmp)
 {
 	switch(bmp->state) {
 	case BMP_PeerUp:
 		bmp_send_peerup(bmp);
 		bmp->state = BMP_Run;
-		break;
+		return true;
 
 	case BMP_Run:
-		if (bmp_wrmirror(bmp, pullwr))
-			break;
-		if (bmp_wrqueue(bmp, pullwr))
-			break;
-		if (bmp_wrsync(bmp, pullwr))
-			break;
+		if (bmp_wrmirror(bmp))
+			return true;
+		if (bmp_wrqueue(bmp))
+			return true;
+		if (bmp_wrsync(bmp))
+			return true;
 		break;
 	}
+	return false;
 }
 
-static void bmp_wrerr(struct bmp *bmp, struct pullwr *pullwr, bool eof)
+static void bmp_wrerr(struct bmp *bmp, bool eof)
 {
 	if (eof)
 		zlog_info("bmp[%s] disconnected", bmp->remote);
 	else
 		flog_warn(EC_LIB_SYSTEM_CALL, "bmp[%s] connection error: %s",
-				bmp->remote, strerror(errno));
+				bmp->remote, strerror(bmp->io_errno));
 
 	bmp_close(bmp);
 	bmp_free(bmp);
@@ -1261,7 +1779,7 @@ static int bmp_process(struct bgp *bgp, afi_t afi, safi_t safi,
 		bmp_process_one(bt, bgp, afi, safi, bn, peer);
 
 		frr_each(bmp_session, &bt->sessions, bmp) {
-			pullwr_bump(bmp->pullwr);
+			bmp_bump(bmp);
 		}
 	}
 	return 0;
@@ -1398,9 +1916,9 @@ static struct bmp *bmp_open(struct bmp_targets *bt, int bmp_sock)
 	strlcpy(bmp->remote, buf, sizeof(bmp->remote));
 
 	bmp->state = BMP_PeerUp;
-	bmp->pullwr = pullwr_new(bm->master, bmp_sock, bmp, bmp_wrfill,
-			bmp_wrerr);
+	bmp_io_init(bmp);
 	bmp_send_initiation(bmp);
+	bmp_bump(bmp);
 
 	return bmp;
 }
@@ -1443,7 +1961,7 @@ static void bmp_close(struct bmp *bmp)
 			XFREE(MTYPE_BMP_QUEUE, bqe);
 
 	THREAD_OFF(bmp->t_read);
-	pullwr_del(bmp->pullwr);
+	bmp_io_fini(bmp);
 	close(bmp->socket);
 }
 
@@ -2259,29 +2777,45 @@ DEFPY(show_bmp,
 			vty_out(vty, "\n    %zu connected clients:\n",
 					bmp_session_count(&bt->sessions));
 			tt = ttable_new(&ttable_styles[TTSTYLE_BLANK]);
-			ttable_add_row(tt, "remote|uptime|MonSent|MirrSent|MirrLost|ByteSent|ByteQ|ByteQKernel");
+			ttable_add_row(tt, "remote|uptime|MonSent|Routes|MirrSent|MirrLost|ByteSent|ByteQ|ByteQMax|ByteQKernel|Throttled");
 			ttable_rowseps(tt, 0, BOTTOM, true, '-');
 
 			frr_each (bmp_session, &bt->sessions, bmp) {
-				uint64_t total;
-				size_t q, kq;
+				size_t q, qmax;
+				int kq;
 
-				pullwr_stats(bmp->pullwr, &total, &q, &kq);
+				frr_with_mutex(&bmp->io_mtx) {
+					q = bmp->io_pending;
+					qmax = bmp->io_pending_max;
+				}
+				if (ioctl(bmp->socket, TIOCOUTQ, &kq) != 0)
+					kq = 0;
 
 				peer_uptime(bmp->t_up.tv_sec, uptime,
 					    sizeof(uptime), false, NULL);
 
-				ttable_add_row(tt, "%s|%s|%Lu|%Lu|%Lu|%Lu|%zu|%zu",
+				ttable_add_row(tt, "%s|%s|%Lu|%Lu|%Lu|%Lu|%Lu|%zu|%zu|%d|%Lu",
 					       bmp->remote, uptime,
-					       bmp->cnt_update,
+					       atomic_load_explicit(
+						       &bmp->cnt_update,
+						       memory_order_relaxed),
+					       atomic_load_explicit(
+						       &bmp->cnt_routes,
+						       memory_order_relaxed),
 					       bmp->cnt_mirror,
 					       bmp->cnt_mirror_overruns,
-					       total, q, kq);
+					       atomic_load_explicit(
+						       &bmp->cnt_bytes,
+						       memory_order_relaxed),
+					       q, qmax, kq,
+					       bmp->cnt_throttled);
 			}
 			out = ttable_dump(tt, "\n");
 			vty_out(vty, "%s", out);
 			XFREE(MTYPE_TMP, out);
 			ttable_del(tt);
+			vty_out(vty, "\n    Output throttled %Lu times\n",
+				bt->cnt_throttled);
 			vty_out(vty, "\n");
 		}
 	}
@@ -2368,6 +2902,18 @@ static int bgp_bmp_init(struct thread_master *tm)
 	return 0;
 }
 
+/* sessions were closed when the BGP instances went away */
+static int bgp_bmp_fini(void)
+{
+	if (!bmp_pth)
+		return 0;
+
+	frr_pthread_stop(bmp_pth, NULL);
+	frr_pthread_destroy(bmp_pth);
+	bmp_pth = NULL;
+	return 0;
+}
+
 static int bgp_bmp_module_init(void)
 {
 	hook_register(bgp_packet_dump, bmp_mirror_packet);
@@ -2378,6 +2924,7 @@ static int bgp_bmp_module_init(void)
 	hook_register(bgp_inst_config_write, bmp_config_write);
 	hook_register(bgp_inst_delete, bmp_bgp_del);
 	hook_register(frr_late_init, bgp_bmp_init);
+	hook_register(frr_fini, bgp_bmp_fini);
 	return 0;
 }
 
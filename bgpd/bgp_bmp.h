@@ -22,7 +22,7 @@
 
 #include "zebra.h"
 #include "typesafe.h"
-#include "pullwr.h"
+#include "stream.h"
 #include "qobj.h"
 #include "resolver.h"
 
@@ -112,6 +112,66 @@ enum {
 	BMP_AFI_LIVE,
 };
 
+/* Output to the collectors is written on the BMP pthread, which also packs
+ * route monitoring into UPDATEs.  The main pthread decides what to send and
+ * takes everything that depends on the peer or the BGP instance with it:
+ * other messages are handed over encoded, route monitoring as batches of
+ * routes that share a snapshot of their peer and attributes, with the path
+ * attributes already encoded for that peer.  The attribute references are
+ * released on the main pthread once the batch is encoded.
+ */
+#define BMP_BATCH_ROUTES	256
+
+/* peer, attributes and AFI/SAFI shared by routes in a batch */
+struct bmp_routeattr {
+	/* only compared on the main pthread, while the batch is filled */
+	const struct peer *peer;
+	/* NULL for a withdraw */
+	struct attr *attr;
+	afi_t afi;
+	safi_t safi;
+
+	/* per-peer header fields */
+	union sockunion su;
+	as_t as;
+	struct in_addr remote_id;
+
+	/* UPDATE up to where the NLRI go, NULL for a withdraw */
+	struct stream *s;
+	size_t mpattrlen_pos;
+};
+
+struct bmp_route {
+	unsigned int attridx;
+	struct prefix p;
+	struct prefix_rd rd;
+	bool has_rd;
+	uint8_t flags;
+	time_t uptime;
+	unsigned int seq;
+};
+
+PREDECL_LIST(bmp_outq)
+
+struct bmp_outitem {
+	struct bmp_outq_item boi;
+
+	/* pending bytes accounted for this item */
+	size_t cost;
+
+	/* an encoded message, or routes */
+	struct stream *s;
+
+	/* table sync sends each route once and may be reordered into fewer
+	 * UPDATEs, live updates only get merged with their neighbours
+	 */
+	bool regroup;
+	unsigned int nattrs;
+	struct bmp_routeattr *attrs;
+	unsigned int nroutes;
+	struct bmp_route routes[0];
+};
+
 PREDECL_LIST(bmp_session)
 
 struct bmp_active;
@@ -127,7 +187,26 @@ struct bmp {
 	char remote[SU_ADDRSTRLEN + 6];
 	struct thread *t_read;
 
-	struct pullwr *pullwr;
+	/* main pthread: routes not handed over yet, and the fill loop
+	 * picking the next things to send
+	 */
+	struct bmp_outitem *batch;
+	struct thread *t_fill, *t_reap, *t_error;
+
+	/* shared with the BMP pthread */
+	pthread_mutex_t io_mtx;
+	struct bmp_outq_head outq;
+	struct bmp_outq_head doneq;
+	/* bytes not written yet, estimated for routes not encoded yet */
+	size_t io_pending, io_pending_max;
+	/* above the high-water mark, filling resumes at the low-water mark */
+	bool io_throttled;
+	bool io_failed, io_eof;
+	int io_errno;
+
+	/* BMP pthread */
+	struct stream_fifo wrq;
+	struct thread *t_io, *t_write;
 
 	int state;
 
@@ -145,11 +224,18 @@ struct bmp {
 	uint8_t afistate[AFI_MAX][SAFI_MAX];
 
 	/* counters for the various BMP packet types */
-	uint64_t cnt_update, cnt_mirror;
+	_Atomic uint64_t cnt_update;
+	uint64_t cnt_mirror;
 	/* number of times this peer wasn't fast enough in consuming the
 	 * mirror queue
 	 */
 	uint64_t cnt_mirror_overruns;
+	/* output and backpressure: bytes written, routes encoded, and times
+	 * filling stopped at the high-water mark
+	 */
+	_Atomic uint64_t cnt_bytes;
+	_Atomic uint64_t cnt_routes;
+	uint64_t cnt_throttled;
 	struct timeval t_up;
 
 	/* synchronization / startup works by repeatedly finding the next
@@ -244,6 +330,8 @@ struct bmp_targets {
 	struct bmp_qlist_head updlist;
 
 	uint64_t cnt_accept, cnt_aclrefused;
+	/* sessions that hit the output high-water mark */
+	uint64_t cnt_throttled;
 
 	QOBJ_FIELDS
 };
@@ -28,6 +28,7 @@
 #include "stream.h"
 #include "jhash.h"
 #include "frrstr.h"
+#include "typesafe.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_community.h"
@@ -37,6 +38,78 @@
 #include "bgpd/bgp_regex.h"
 #include "bgpd/bgp_clist.h"
 
+PREDECL_HASH(clist_vals)
+
+/* A community value, and the first entries it matches with. */
+struct clist_val {
+	struct clist_vals_item item;
+
+	/* Network byte order, large communities use all of it. */
+	uint8_t val[LCOMMUNITY_SIZE];
+	bool large;
+
+	/* First entry made up of just this value, and first one holding
+	 * it among others.
+	 */
+	uint32_t first_single;
+	uint32_t first_any;
+};
+
+static int clist_val_cmp(const struct clist_val *a, const struct clist_val *b)
+{
+	if (a->large != b->large)
+		return a->large - b->large;
+	return memcmp(a->val, b->val, sizeof(a->val));
+}
+
+static uint32_t clist_val_hash(const struct clist_val *a)
+{
+	return jhash(a->val, sizeof(a->val), a->large ? 0x3c6ef372 : 0);
+}
+
+DECLARE_HASH(clist_vals, struct clist_val, item, clist_val_cmp,
+	     clist_val_hash)
+
+/* Results per interned (large) community, flags below. */
+#define CLIST_MEMO_SLOTS 256
+
+#define CLIST_MEMO_MATCH_SET (1 << 0)
+#define CLIST_MEMO_MATCH (1 << 1)
+#define CLIST_MEMO_EXACT_SET (1 << 2)
+#define CLIST_MEMO_EXACT (1 << 3)
+
+struct clist_memo {
+	const void *com;
+	uint32_t intern_id;
+	uint8_t flags;
+};
+
+/*
+ * Standard community-list entries holding a single value are found through
+ * a hash of values instead of scanning the list; the other entries are
+ * still tried in order, but only up to the best candidate found so far.
+ * Expanded entries are first ruled out together with a single regex.
+ */
+struct community_list_index {
+	/* entries by position, up to and including first_always */
+	struct community_entry **entries;
+	uint32_t count;
+
+	/* first entry matching anything, count if there is none */
+	uint32_t first_always;
+
+	struct clist_vals_head vals;
+
+	/* positions of the entries the value hash can't answer for */
+	uint32_t *others;
+	uint32_t nothers;
+
+	/* all expanded entries or'ed together */
+	regex_t *prefilter;
+
+	struct clist_memo memo[CLIST_MEMO_SLOTS];
+};
+
 /* Calculate new sequential number. */
 static int64_t bgp_clist_new_seq_get(struct community_list *list)
 {
@@ -154,13 +227,185 @@ static struct community_list *community_list_new(void)
 	return XCALLOC(MTYPE_COMMUNITY_LIST, sizeof(struct community_list));
 }
 
+static void community_list_index_free(struct community_list *list)
+{
+	struct community_list_index *idx = list->index;
+	struct clist_val *val;
+
+	if (!idx)
+		return;
+
+	while ((val = clist_vals_pop(&idx->vals)))
+		XFREE(MTYPE_COMMUNITY_LIST_INDEX, val);
+	clist_vals_fini(&idx->vals);
+
+	if (idx->prefilter)
+		bgp_regex_free(idx->prefilter);
+	XFREE(MTYPE_COMMUNITY_LIST_INDEX, idx->others);
+	XFREE(MTYPE_COMMUNITY_LIST_INDEX, idx->entries);
+	XFREE(MTYPE_COMMUNITY_LIST_INDEX, list->index);
+}
+
 /* Free community-list.  */
 static void community_list_free(struct community_list *list)
 {
+	community_list_index_free(list);
 	XFREE(MTYPE_COMMUNITY_LIST_NAME, list->name);
 	XFREE(MTYPE_COMMUNITY_LIST, list);
 }
 
+static struct clist_val *
+community_list_index_find(struct community_list_index *idx, const void *val,
+			  bool large)
+{
+	struct clist_val key = {};
+
+	memcpy(key.val, val, large ? LCOMMUNITY_SIZE : sizeof(uint32_t));
+	key.large = large;
+	return clist_vals_find(&idx->vals, &key);
+}
+
+static void community_list_index_add(struct community_list_index *idx,
+				     const void *val, bool large,
+				     uint32_t pos, bool single)
+{
+	struct clist_val *found;
+
+	found = community_list_index_find(idx, val, large);
+	if (!found) {
+		found = XCALLOC(MTYPE_COMMUNITY_LIST_INDEX, sizeof(*found));
+		memcpy(found->val, val,
+		       large ? LCOMMUNITY_SIZE : sizeof(uint32_t));
+		found->large = large;
+		found->first_single = found->first_any = UINT32_MAX;
+		clist_vals_add(&idx->vals, found);
+	}
+
+	if (found->first_any == UINT32_MAX)
+		found->first_any = pos;
+	if (single && found->first_single == UINT32_MAX)
+		found->first_single = pos;
+}
+
+/* Back-references would be renumbered by or'ing the expressions. */
+static bool community_list_backref(const char *config)
+{
+	for (; *config; config++)
+		if (config[0] == '\\' && config[1] >= '1' && config[1] <= '9')
+			return true;
+	return false;
+}
+
+static void community_list_index_prefilter(struct community_list_index *idx)
+{
+	struct community_entry *entry;
+	unsigned int nexp = 0;
+	size_t len = 1;
+	uint32_t i;
+	char *str;
+
+	for (i = 0; i < idx->nothers; i++) {
+		entry = idx->entries[idx->others[i]];
+		if (entry->style != COMMUNITY_LIST_EXPANDED
+		    && entry->style != LARGE_COMMUNITY_LIST_EXPANDED)
+			continue;
+		if (community_list_backref(entry->config))
+			return;
+		len += strlen(entry->config) + 3;
+		nexp++;
+	}
+
+	/* a single expression is its own prefilter */
+	if (nexp < 2)
+		return;
+
+	str = XMALLOC(MTYPE_TMP, len);
+	str[0] = '\0';
+	for (i = 0; i < idx->nothers; i++) {
+		entry = idx->entries[idx->others[i]];
+		if (entry->style != COMMUNITY_LIST_EXPANDED
+		    && entry->style != LARGE_COMMUNITY_LIST_EXPANDED)
+			continue;
+		if (str[0])
+			strlcat(str, "|", len);
+		strlcat(str, "(", len);
+		strlcat(str, entry->config, len);
+		strlcat(str, ")", len);
+	}
+
+	idx->prefilter = bgp_regcomp(str);
+	XFREE(MTYPE_TMP, str);
+}
+
+static struct community_list_index *
+community_list_index_get(struct community_list *list)
+{
+	struct community_list_index *idx;
+	struct community_entry *entry;
+	uint32_t n = 0, pos;
+	int i;
+
+	if (list->index)
+		return list->index;
+
+	for (entry = list->head; entry; entry = entry->next)
+		n++;
+
+	idx = XCALLOC(MTYPE_COMMUNITY_LIST_INDEX, sizeof(*idx));
+	idx->entries = XCALLOC(MTYPE_COMMUNITY_LIST_INDEX,
+			       MAX(n, 1U) * sizeof(*idx->entries));
+	idx->others = XCALLOC(MTYPE_COMMUNITY_LIST_INDEX,
+			      MAX(n, 1U) * sizeof(*idx->others));
+	idx->first_always = UINT32_MAX;
+	clist_vals_init(&idx->vals);
+
+	for (entry = list->head; entry; entry = entry->next) {
+		pos = idx->count++;
+		idx->entries[pos] = entry;
+
+		/* nothing after this one is ever looked at */
+		if (entry->any
+		    || (entry->style == COMMUNITY_LIST_STANDARD
+			&& community_include(entry->u.com,
+					     COMMUNITY_INTERNET))) {
+			idx->first_always = pos;
+			break;
+		}
+
+		switch (entry->style) {
+		case COMMUNITY_LIST_STANDARD:
+			for (i = 0; i < entry->u.com->size; i++)
+				community_list_index_add(
+					idx, com_nthval(entry->u.com, i), false,
+					pos, entry->u.com->size == 1);
+			if (entry->u.com->size != 1)
+				idx->others[idx->nothers++] = pos;
+			break;
+		case LARGE_COMMUNITY_LIST_STANDARD:
+			for (i = 0; i < entry->u.lcom->size; i++)
+				community_list_index_add(
+					idx,
+					entry->u.lcom->val
+						+ i * LCOMMUNITY_SIZE,
+					true, pos, entry->u.lcom->size == 1);
+			if (entry->u.lcom->size != 1)
+				idx->others[idx->nothers++] = pos;
+			break;
+		default:
+			idx->others[idx->nothers++] = pos;
+			break;
+		}
+	}
+
+	if (idx->first_always == UINT32_MAX)
+		idx->first_always = idx->count;
+
+	community_list_index_prefilter(idx);
+
+	list->index = idx;
+	return idx;
+}
+
 static struct community_list *
 community_list_insert(struct community_list_handler *ch, const char *name,
 		      int master)
@@ -321,6 +566,8 @@ static void community_list_entry_delete(struct community_list_master *cm,
 					struct community_list *list,
 					struct community_entry *entry)
 {
+	community_list_index_free(list);
+
 	if (entry->next)
 		entry->next->prev = entry->prev;
 	else
@@ -373,6 +620,8 @@ static void community_list_entry_add(struct community_list *list,
 	struct community_entry *replace;
 	struct community_entry *point;
 
+	community_list_index_free(list);
+
 	/* Automatic assignment of seq no. */
 	if (entry->seq == COMMUNITY_SEQ_NUMBER_AUTO)
 		entry->seq = bgp_clist_new_seq_get(list);
@@ -734,55 +983,150 @@ community_regexp_delete (struct community *com, regex_t * reg)
 }
 #endif
 
-/* When given community attribute matches to the community-list return
-   1 else return 0.  */
-bool community_list_match(struct community *com, struct community_list *list)
+/* Whether the expanded entries of the list might match at all. */
+static bool community_list_prefilter(struct community_list_index *idx,
+				     void *com, bool large)
 {
-	struct community_entry *entry;
+	struct community *c = large ? NULL : com;
+	struct lcommunity *lcom = large ? com : NULL;
+	const char *str;
 
-	for (entry = list->head; entry; entry = entry->next) {
-		if (entry->any)
-			return entry->direct == COMMUNITY_PERMIT;
+	if (large)
+		str = (lcom && lcom->size) ? lcommunity_str(lcom, false) : "";
+	else
+		str = (c && c->size) ? community_str(c, false) : "";
 
-		if (entry->style == COMMUNITY_LIST_STANDARD) {
-			if (community_include(entry->u.com, COMMUNITY_INTERNET))
-				return entry->direct == COMMUNITY_PERMIT;
+	return regexec(idx->prefilter, str, 0, NULL, 0) == 0;
+}
 
-			if (community_match(com, entry->u.com))
-				return entry->direct == COMMUNITY_PERMIT;
-		} else if (entry->style == COMMUNITY_LIST_EXPANDED) {
-			if (community_regexp_match(com, entry->reg))
-				return entry->direct == COMMUNITY_PERMIT;
-		}
+/* Position of the first entry matching com (or lcom if large), idx->count
+ * if there is none.
+ */
+static uint32_t community_list_index_match(struct community_list_index *idx,
+					   void *com, bool large)
+{
+	struct community *c = large ? NULL : com;
+	struct lcommunity *lcom = large ? com : NULL;
+	struct community_entry *entry;
+	struct clist_val *found;
+	uint32_t best = idx->first_always, i;
+	int size, prefiltered = -1;
+	bool matched;
+
+	size = large ? (lcom ? lcom->size : 0) : (c ? c->size : 0);
+	for (i = 0; i < (uint32_t)size; i++) {
+		found = community_list_index_find(
+			idx,
+			large ? (void *)(lcom->val + i * LCOMMUNITY_SIZE)
+			      : (void *)com_nthval(c, i),
+			large);
+		if (found && found->first_single < best)
+			best = found->first_single;
 	}
-	return false;
+
+	for (i = 0; i < idx->nothers && idx->others[i] < best; i++) {
+		entry = idx->entries[idx->others[i]];
+
+		if (!large && entry->style == COMMUNITY_LIST_STANDARD)
+			matched = community_match(c, entry->u.com);
+		else if (large && entry->style == LARGE_COMMUNITY_LIST_STANDARD)
+			matched = lcommunity_match(lcom, entry->u.lcom);
+		else if (entry->style
+			 == (large ? LARGE_COMMUNITY_LIST_EXPANDED
+				   : COMMUNITY_LIST_EXPANDED)) {
+			if (prefiltered < 0)
+				prefiltered = !idx->prefilter
+					      || community_list_prefilter(
+						      idx, com, large);
+			matched = prefiltered
+				  && (large ? lcommunity_regexp_match(
+						      lcom, entry->reg)
+					    : community_regexp_match(
+						      c, entry->reg));
+		} else
+			matched = false;
+
+		if (matched)
+			return idx->others[i];
+	}
+	return best;
 }
 
-bool lcommunity_list_match(struct lcommunity *lcom, struct community_list *list)
+static bool community_list_exact_scan(struct community *com,
+				      struct community_list *list);
+static bool lcommunity_list_exact_scan(struct lcommunity *lcom,
+				       struct community_list *list);
+
+/* Common to the match functions below: interned communities have their
+ * result remembered until the list changes.
+ */
+static bool community_list_result(struct community_list *list, void *com,
+				  bool large, bool exact)
 {
-	struct community_entry *entry;
+	struct community_list_index *idx = community_list_index_get(list);
+	struct community *c = large ? NULL : com;
+	struct lcommunity *lcom = large ? com : NULL;
+	struct clist_memo *memo = NULL;
+	uint8_t set = exact ? CLIST_MEMO_EXACT_SET : CLIST_MEMO_MATCH_SET;
+	uint8_t hit = exact ? CLIST_MEMO_EXACT : CLIST_MEMO_MATCH;
+	uint32_t intern_id = 0, pos;
+	bool ret;
+
+	if (c && c->refcnt)
+		intern_id = c->intern_id;
+	else if (lcom && lcom->refcnt)
+		intern_id = lcom->intern_id;
+
+	if (intern_id) {
+		memo = &idx->memo[intern_id % CLIST_MEMO_SLOTS];
+		if (memo->com != com || memo->intern_id != intern_id) {
+			memo->com = com;
+			memo->intern_id = intern_id;
+			memo->flags = 0;
+		} else if (CHECK_FLAG(memo->flags, set))
+			return CHECK_FLAG(memo->flags, hit);
+	}
 
-	for (entry = list->head; entry; entry = entry->next) {
-		if (entry->any)
-			return entry->direct == COMMUNITY_PERMIT;
+	if (exact)
+		ret = large ? lcommunity_list_exact_scan(lcom, list)
+			    : community_list_exact_scan(c, list);
+	else {
+		pos = community_list_index_match(idx, com, large);
+		ret = pos < idx->count
+		      && idx->entries[pos]->direct == COMMUNITY_PERMIT;
+	}
 
-		if (entry->style == LARGE_COMMUNITY_LIST_STANDARD) {
-			if (lcommunity_match(lcom, entry->u.lcom))
-				return entry->direct == COMMUNITY_PERMIT;
-		} else if (entry->style == LARGE_COMMUNITY_LIST_EXPANDED) {
-			if (lcommunity_regexp_match(lcom, entry->reg))
-				return entry->direct == COMMUNITY_PERMIT;
-		}
+	if (memo) {
+		SET_FLAG(memo->flags, set);
+		if (ret)
+			SET_FLAG(memo->flags, hit);
 	}
-	return false;
+	return ret;
 }
 
+/* When given community attribute matches to the community-list return
+   1 else return 0.  */
+bool community_list_match(struct community *com, struct community_list *list)
+{
+	return community_list_result(list, com, false, false);
+}
+
+bool lcommunity_list_match(struct lcommunity *lcom, struct community_list *list)
+{
+	return community_list_result(list, lcom, true, false);
+}
 
 /* Perform exact matching.  In case of expanded large-community-list, do
  * same thing as lcommunity_list_match().
  */
 bool lcommunity_list_exact_match(struct lcommunity *lcom,
 				 struct community_list *list)
+{
+	return community_list_result(list, lcom, true, true);
+}
+
+static bool lcommunity_list_exact_scan(struct lcommunity *lcom,
+				       struct community_list *list)
 {
 	struct community_entry *entry;
 
@@ -824,6 +1168,12 @@ bool ecommunity_list_match(struct ecommunity *ecom, struct community_list *list)
    same thing as community_list_match().  */
 bool community_list_exact_match(struct community *com,
 				struct community_list *list)
+{
+	return community_list_result(list, com, false, true);
+}
+
+static bool community_list_exact_scan(struct community *com,
+				      struct community_list *list)
 {
 	struct community_entry *entry;
 
@@ -849,48 +1199,39 @@ bool community_list_exact_match(struct community *com,
 struct community *community_list_match_delete(struct community *com,
 					      struct community_list *list)
 {
+	struct community_list_index *idx = community_list_index_get(list);
 	struct community_entry *entry;
+	struct clist_val *found;
 	uint32_t val;
 	uint32_t com_index_to_delete[com->size];
+	uint32_t best, k;
 	int delete_index = 0;
 	int i;
 
-	/* Loop over each community value and evaluate each against the
-	 * community-list.  If we need to delete a community value add its index
-	 * to com_index_to_delete.
+	/* Evaluate each community value against the community-list.  If we
+	 * need to delete a community value add its index to
+	 * com_index_to_delete.
 	 */
 	for (i = 0; i < com->size; i++) {
-		val = community_val_get(com, i);
-
-		for (entry = list->head; entry; entry = entry->next) {
-			if (entry->any) {
-				if (entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
-
-			else if ((entry->style == COMMUNITY_LIST_STANDARD)
-				 && (community_include(entry->u.com,
-						       COMMUNITY_INTERNET)
-				     || community_include(entry->u.com, val))) {
-				if (entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
+		best = idx->first_always;
+		found = community_list_index_find(idx, com_nthval(com, i),
+						  false);
+		if (found && found->first_any < best)
+			best = found->first_any;
+
+		for (k = 0; k < idx->nothers && idx->others[k] < best; k++) {
+			entry = idx->entries[idx->others[k]];
+			if (entry->style == COMMUNITY_LIST_EXPANDED
+			    && community_regexp_include(entry->reg, com, i)) {
+				best = idx->others[k];
 				break;
 			}
+		}
 
-			else if ((entry->style == COMMUNITY_LIST_EXPANDED)
-				 && community_regexp_include(entry->reg, com,
-							     i)) {
-				if (entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
+		if (best < idx->count
+		    && idx->entries[best]->direct == COMMUNITY_PERMIT) {
+			com_index_to_delete[delete_index] = i;
+			delete_index++;
 		}
 	}
 
@@ -1058,46 +1399,41 @@ int community_list_unset(struct community_list_handler *ch, const char *name,
 struct lcommunity *lcommunity_list_match_delete(struct lcommunity *lcom,
 						struct community_list *list)
 {
+	struct community_list_index *idx = community_list_index_get(list);
 	struct community_entry *entry;
+	struct clist_val *found;
 	uint32_t com_index_to_delete[lcom->size];
+	uint32_t best, k;
 	uint8_t *ptr;
 	int delete_index = 0;
 	int i;
 
-	/* Loop over each lcommunity value and evaluate each against the
-	 * community-list.  If we need to delete a community value add its index
-	 * to com_index_to_delete.
+	/* Evaluate each lcommunity value against the community-list.  If we
+	 * need to delete a community value add its index to
+	 * com_index_to_delete.
 	 */
 	for (i = 0; i < lcom->size; i++) {
 		ptr = lcom->val + (i * LCOMMUNITY_SIZE);
-		for (entry = list->head; entry; entry = entry->next) {
-			if (entry->any) {
-				if (entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
 
-			else if ((entry->style == LARGE_COMMUNITY_LIST_STANDARD)
-				 && lcommunity_include(entry->u.lcom, ptr)) {
-				if (entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
-				break;
-			}
+		best = idx->first_always;
+		found = community_list_index_find(idx, ptr, true);
+		if (found && found->first_any < best)
+			best = found->first_any;
 
-			else if ((entry->style == LARGE_COMMUNITY_LIST_EXPANDED)
-				 && lcommunity_regexp_include(entry->reg, lcom,
-							      i)) {
-				if (entry->direct == COMMUNITY_PERMIT) {
-					com_index_to_delete[delete_index] = i;
-					delete_index++;
-				}
+		for (k = 0; k < idx->nothers && idx->others[k] < best; k++) {
+			entry = idx->entries[idx->others[k]];
+			if (entry->style == LARGE_COMMUNITY_LIST_EXPANDED
+			    && lcommunity_regexp_include(entry->reg, lcom, i)) {
+				best = idx->others[k];
 				break;
 			}
 		}
+
+		if (best < idx->count
+		    && idx->entries[best]->direct == COMMUNITY_PERMIT) {
+			com_index_to_delete[delete_index] = i;
+			delete_index++;
+		}
 	}
 
 	/* Delete all of the communities we flagged for deletion */
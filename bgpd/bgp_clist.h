@@ -67,6 +67,9 @@ struct community_list {
 	/* Community-list entry in this community-list.  */
 	struct community_entry *head;
 	struct community_entry *tail;
+
+	/* Built from the entries on first match, dropped on changes.  */
+	struct community_list_index *index;
 };
 
 /* Each entry in community-list.  */
@@ -30,6 +30,7 @@
 
 /* Hash of community attribute. */
 static struct hash *comhash;
+static uint32_t community_intern_id;
 
 /* Allocate a new communities value.  */
 static struct community *community_new(void)
@@ -481,6 +482,8 @@ struct community *community_intern(struct community *com)
 	   hash, it should be freed.  */
 	if (find != com)
 		community_free(&com);
+	else
+		find->intern_id = ++community_intern_id;
 
 	/* Increment refrence counter.  */
 	find->refcnt++;
@@ -510,11 +513,11 @@ void community_unintern(struct community **com)
 	}
 }
 
-/* Create new community attribute. */
-struct community *community_parse(uint32_t *pnt, unsigned short length)
+/* Decode community attribute without interning it.  This does not touch
+   the community hash and may be used from any pthread. */
+struct community *community_decode(uint32_t *pnt, unsigned short length)
 {
 	struct community tmp;
-	struct community *new;
 
 	/* If length is malformed return NULL. */
 	if (length % COMMUNITY_SIZE)
@@ -524,7 +527,17 @@ struct community *community_parse(uint32_t *pnt, unsigned short length)
 	tmp.size = length / COMMUNITY_SIZE;
 	tmp.val = pnt;
 
-	new = community_uniq_sort(&tmp);
+	return community_uniq_sort(&tmp);
+}
+
+/* Create new community attribute. */
+struct community *community_parse(uint32_t *pnt, unsigned short length)
+{
+	struct community *new;
+
+	new = community_decode(pnt, length);
+	if (!new)
+		return NULL;
 
 	return community_intern(new);
 }
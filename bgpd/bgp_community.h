@@ -41,6 +41,11 @@ struct community {
 	/* String of community attribute.  This sring is used by vty output
 	   and expanded community-list for regular expression match.  */
 	char *str;
+
+	/* Set when interned, tells apart interned communities that reuse an
+	 * address; 0 if never interned.
+	 */
+	uint32_t intern_id;
 };
 
 /* Well-known communities value.  */
@@ -74,6 +79,8 @@ extern void community_finish(void);
 extern void community_free(struct community **comm);
 extern struct community *community_uniq_sort(struct community *);
 extern struct community *community_parse(uint32_t *, unsigned short);
+extern struct community *community_decode(uint32_t *pnt,
+					  unsigned short length);
 extern struct community *community_intern(struct community *);
 extern void community_unintern(struct community **);
 extern char *community_str(struct community *, bool make_json);
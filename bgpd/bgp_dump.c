@@ -19,6 +19,9 @@
  */
 
 #include <zebra.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include "log.h"
 #include "stream.h"
@@ -30,6 +33,7 @@
 #include "queue.h"
 #include "memory.h"
 #include "filter.h"
+#include "frr_pthread.h"
 
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgpd.h"
@@ -90,6 +94,9 @@ struct bgp_dump {
 static int bgp_dump_unset(struct bgp_dump *bgp_dump);
 static int bgp_dump_interval_func(struct thread *);
 
+#define BGP_DUMP_OBUF_SIZE                                                     \
+	((BGP_MAX_PACKET_SIZE << 1) + BGP_DUMP_MSG_HEADER + BGP_DUMP_HEADER_SIZE)
+
 /* BGP packet dump output buffer. */
 struct stream *bgp_dump_obuf;
 
@@ -217,15 +224,14 @@ static void bgp_dump_set_size(struct stream *s, int type)
 	stream_putl_at(s, 8, stream_get_endp(s) - BGP_DUMP_HEADER_SIZE);
 }
 
-static void bgp_dump_routes_index_table(struct bgp *bgp)
+static struct stream *bgp_dump_routes_index_table(struct bgp *bgp)
 {
 	struct peer *peer;
 	struct listnode *node;
 	uint16_t peerno = 1;
 	struct stream *obuf;
 
-	obuf = bgp_dump_obuf;
-	stream_reset(obuf);
+	obuf = stream_new(BGP_DUMP_OBUF_SIZE);
 
 	/* MRT header */
 	bgp_dump_header(obuf, MSG_TABLE_DUMP_V2, TABLE_DUMP_V2_PEER_INDEX_TABLE,
@@ -296,29 +302,207 @@ static void bgp_dump_routes_index_table(struct bgp *bgp)
 
 	bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
 
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump_routes.fp);
-	fflush(bgp_dump_routes.fp);
+	return obuf;
 }
 
 
-static struct bgp_path_info *
-bgp_dump_route_node_record(int afi, struct bgp_dest *dest,
-			   struct bgp_path_info *path, unsigned int seq)
-{
+/*
+ * TABLE_DUMP_V2 dumps.
+ *
+ * The main pthread only takes a snapshot of the RIB: the prefixes, and for
+ * every path a reference on its intern'd attributes plus the peer index and
+ * origination time.  Encoding, compressing and writing the records is done
+ * on the MRT dump pthread, so a periodic full table dump no longer stalls
+ * route processing.  The attribute references are dropped on the main
+ * pthread once the dump is done.
+ */
+struct bgp_dump_snapshot_dest {
+	struct prefix p;
+	afi_t afi;
+	uint32_t npaths;
+};
+
+struct bgp_dump_snapshot_path {
+	struct attr *attr;
+	time_t originated;
+	uint16_t peer_index;
+};
+
+struct bgp_dump_job {
+	FILE *fp;
+#ifdef HAVE_ZLIB
+	gzFile gz;
+#endif
+	bool failed;
+
+	/* peer index table, encoded along with the snapshot */
+	struct stream *index;
 	struct stream *obuf;
+
+	struct bgp_dump_snapshot_dest *dests;
+	uint32_t ndests, dests_size;
+	struct bgp_dump_snapshot_path *paths;
+	uint32_t npaths, paths_size;
+
+	/* filled in by the dump pthread */
+	uint32_t records;
+	unsigned long msecs;
+};
+
+static struct bgp_dump_routes_state {
+	struct frr_pthread *fpt;
+
+	/* dump in progress, owned by the dump pthread until t_done runs */
+	struct bgp_dump_job *job;
+	struct thread *t_done;
+	atomic_bool cancel;
+	struct timeval started;
+
+	/* progress of the dump in progress */
+	_Atomic uint32_t dests_done;
+	_Atomic uint64_t bytes;
+
+	uint32_t dumps;
+	uint32_t skipped;
+	uint32_t failed;
+
+	/* last completed dump */
+	uint32_t last_dests;
+	uint32_t last_records;
+	uint64_t last_bytes;
+	unsigned long last_msecs;
+} bdr;
+
+#ifdef HAVE_ZLIB
+/* table dumps to a file named *.gz are gzip compressed */
+static bool bgp_dump_compressed(const char *filename)
+{
+	size_t len = strlen(filename);
+
+	return len > 3 && strcmp(filename + len - 3, ".gz") == 0;
+}
+#endif
+
+static void bgp_dump_job_write(struct bgp_dump_job *job, struct stream *s)
+{
+	size_t len = stream_get_endp(s);
+
+	atomic_fetch_add_explicit(&bdr.bytes, len, memory_order_relaxed);
+
+#ifdef HAVE_ZLIB
+	if (job->gz) {
+		if (gzwrite(job->gz, STREAM_DATA(s), len) != (int)len)
+			job->failed = true;
+		return;
+	}
+#endif
+	if (fwrite(STREAM_DATA(s), len, 1, job->fp) != 1)
+		job->failed = true;
+}
+
+static void bgp_dump_job_close(struct bgp_dump_job *job)
+{
+#ifdef HAVE_ZLIB
+	if (job->gz) {
+		if (gzclose(job->gz) != Z_OK)
+			job->failed = true;
+		job->gz = NULL;
+	}
+#endif
+	if (job->fp) {
+		if (fclose(job->fp))
+			job->failed = true;
+		job->fp = NULL;
+	}
+}
+
+static void bgp_dump_job_free(struct bgp_dump_job *job)
+{
+	uint32_t i;
+
+	bgp_dump_job_close(job);
+
+	for (i = 0; i < job->npaths; i++)
+		bgp_attr_unintern(&job->paths[i].attr);
+
+	XFREE(MTYPE_BGP_DUMP_SNAPSHOT, job->dests);
+	XFREE(MTYPE_BGP_DUMP_SNAPSHOT, job->paths);
+	stream_free(job->index);
+	stream_free(job->obuf);
+	XFREE(MTYPE_BGP_DUMP_SNAPSHOT, job);
+}
+
+/* Runs on the main pthread. */
+static void bgp_dump_routes_snapshot(struct bgp_dump_job *job, struct bgp *bgp,
+				     afi_t afi)
+{
+	struct bgp_dump_snapshot_dest *sdest;
+	struct bgp_dump_snapshot_path *spath;
+	struct bgp_path_info *path;
+	struct bgp_dest *dest;
+	time_t uptime_base;
+
+	/* path->uptime is on the bgp_clock() */
+	uptime_base = time(NULL) - bgp_clock();
+
+	for (dest = bgp_table_top(bgp->rib[afi][SAFI_UNICAST]); dest;
+	     dest = bgp_route_next(dest)) {
+		path = bgp_dest_get_bgp_path_info(dest);
+		if (!path)
+			continue;
+
+		if (job->ndests == job->dests_size) {
+			job->dests_size = MAX(1024, job->dests_size * 2);
+			job->dests = XREALLOC(MTYPE_BGP_DUMP_SNAPSHOT,
+					      job->dests,
+					      job->dests_size
+						      * sizeof(*job->dests));
+		}
+		sdest = &job->dests[job->ndests++];
+		prefix_copy(&sdest->p, bgp_dest_get_prefix(dest));
+		sdest->afi = afi;
+		sdest->npaths = 0;
+
+		for (; path; path = path->next) {
+			if (job->npaths == job->paths_size) {
+				job->paths_size =
+					MAX(1024, job->paths_size * 2);
+				job->paths = XREALLOC(
+					MTYPE_BGP_DUMP_SNAPSHOT, job->paths,
+					job->paths_size * sizeof(*job->paths));
+			}
+			spath = &job->paths[job->npaths++];
+			spath->attr = bgp_attr_intern(path->attr);
+			spath->originated = uptime_base + path->uptime;
+			spath->peer_index = path->peer->table_dump_index;
+			sdest->npaths++;
+		}
+	}
+}
+
+/*
+ * Encode a RIB entry record for as many of the given paths as fit and
+ * return how many were consumed; the rest go into further records for the
+ * same prefix.
+ */
+static uint32_t bgp_dump_route_node_record(struct stream *obuf,
+					   struct bgp_dump_snapshot_dest *sdest,
+					   struct bgp_dump_snapshot_path *paths,
+					   uint32_t npaths, unsigned int seq)
+{
 	size_t sizep;
 	size_t endp;
-	const struct prefix *p = bgp_dest_get_prefix(dest);
+	const struct prefix *p = &sdest->p;
+	uint16_t entry_count = 0;
 
-	obuf = bgp_dump_obuf;
 	stream_reset(obuf);
 
 	/* MRT header */
-	if (afi == AFI_IP)
+	if (sdest->afi == AFI_IP)
 		bgp_dump_header(obuf, MSG_TABLE_DUMP_V2,
 				TABLE_DUMP_V2_RIB_IPV4_UNICAST,
 				BGP_DUMP_ROUTES);
-	else if (afi == AFI_IP6)
+	else if (sdest->afi == AFI_IP6)
 		bgp_dump_header(obuf, MSG_TABLE_DUMP_V2,
 				TABLE_DUMP_V2_RIB_IPV6_UNICAST,
 				BGP_DUMP_ROUTES);
@@ -330,12 +514,12 @@ bgp_dump_route_node_record(int afi, struct bgp_dest *dest,
 	stream_putc(obuf, p->prefixlen);
 
 	/* Prefix */
-	if (afi == AFI_IP) {
+	if (sdest->afi == AFI_IP) {
 		/* We'll dump only the useful bits (those not 0), but have to
 		 * align on 8 bits */
 		stream_write(obuf, (uint8_t *)&p->u.prefix4,
 			     (p->prefixlen + 7) / 8);
-	} else if (afi == AFI_IP6) {
+	} else if (sdest->afi == AFI_IP6) {
 		/* We'll dump only the useful bits (those not 0), but have to
 		 * align on 8 bits */
 		stream_write(obuf, (uint8_t *)&p->u.prefix6,
@@ -345,25 +529,22 @@ bgp_dump_route_node_record(int afi, struct bgp_dest *dest,
 	/* Save where we are now, so we can overwride the entry count later */
 	sizep = stream_get_endp(obuf);
 
-	/* Entry count */
-	uint16_t entry_count = 0;
-
 	/* Entry count, note that this is overwritten later */
 	stream_putw(obuf, 0);
 
 	endp = stream_get_endp(obuf);
-	for (; path; path = path->next) {
+	for (; entry_count < npaths; entry_count++) {
 		size_t cur_endp;
 
 		/* Peer index */
-		stream_putw(obuf, path->peer->table_dump_index);
+		stream_putw(obuf, paths[entry_count].peer_index);
 
 		/* Originated */
-		stream_putl(obuf, time(NULL) - (bgp_clock() - path->uptime));
+		stream_putl(obuf, paths[entry_count].originated);
 
 		/* Dump attribute. */
 		/* Skip prefix & AFI/SAFI for MP_NLRI */
-		bgp_dump_routes_attr(obuf, path->attr, p);
+		bgp_dump_routes_attr(obuf, paths[entry_count].attr, p);
 
 		cur_endp = stream_get_endp(obuf);
 		if (cur_endp > BGP_MAX_PACKET_SIZE + BGP_DUMP_MSG_HEADER
@@ -372,7 +553,6 @@ bgp_dump_route_node_record(int afi, struct bgp_dest *dest,
 			break;
 		}
 
-		entry_count++;
 		endp = cur_endp;
 	}
 
@@ -380,49 +560,154 @@ bgp_dump_route_node_record(int afi, struct bgp_dest *dest,
 	stream_putw_at(obuf, sizep, entry_count);
 
 	bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump_routes.fp);
 
-	return path;
+	/* a single path too large for a record is skipped */
+	return MAX(entry_count, 1);
 }
 
+static int bgp_dump_routes_done(struct thread *t)
+{
+	struct bgp_dump_job *job = THREAD_ARG(t);
+
+	assert(job == bdr.job);
 
-/* Runs under child process. */
-static unsigned int bgp_dump_routes_func(int afi, int first_run,
-					 unsigned int seq)
+	if (job->failed) {
+		flog_warn(EC_BGP_DUMP, "MRT table dump could not be written");
+		bdr.failed++;
+	} else {
+		bdr.dumps++;
+		bdr.last_dests = job->ndests;
+		bdr.last_records = job->records;
+		bdr.last_bytes = atomic_load_explicit(&bdr.bytes,
+						      memory_order_relaxed);
+		bdr.last_msecs = job->msecs;
+	}
+
+	bgp_dump_job_free(job);
+	bdr.job = NULL;
+	return 0;
+}
+
+/* Runs on the MRT dump pthread. */
+static int bgp_dump_routes_worker(struct thread *t)
 {
-	struct bgp_path_info *path;
-	struct bgp_dest *dest;
+	struct bgp_dump_job *job = THREAD_ARG(t);
+	struct bgp_dump_snapshot_dest *sdest;
+	uint32_t i, pathno = 0, done;
+	unsigned int seq = 0;
+
+	bgp_dump_job_write(job, job->index);
+
+	for (i = 0; i < job->ndests; i++) {
+		if (atomic_load_explicit(&bdr.cancel, memory_order_relaxed))
+			return 0;
+
+		sdest = &job->dests[i];
+		for (done = 0; done < sdest->npaths; seq++) {
+			done += bgp_dump_route_node_record(
+				job->obuf, sdest, &job->paths[pathno + done],
+				sdest->npaths - done, seq);
+			bgp_dump_job_write(job, job->obuf);
+			job->records++;
+		}
+		pathno += sdest->npaths;
+
+		atomic_fetch_add_explicit(&bdr.dests_done, 1,
+					  memory_order_relaxed);
+	}
+
+	bgp_dump_job_close(job);
+
+	job->msecs = monotime_since(&bdr.started, NULL) / 1000;
+
+	thread_add_event(bm->master, bgp_dump_routes_done, job, 0,
+			 &bdr.t_done);
+	return 0;
+}
+
+/* Only called while no table dump is running. */
+static void bgp_dump_routes_start(struct bgp_dump *bgp_dump)
+{
+	struct bgp_dump_job *job;
 	struct bgp *bgp;
-	struct bgp_table *table;
 
 	bgp = bgp_get_default();
-	if (!bgp)
-		return seq;
-
-	if (bgp_dump_routes.fp == NULL)
-		return seq;
+	if (!bgp || !bgp_dump->fp)
+		return;
 
-	/* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-	   so this should only be done on the first call to
-	   bgp_dump_routes_func.
-	   ( this function will be called once for ipv4 and once for ipv6 ) */
-	if (first_run)
-		bgp_dump_routes_index_table(bgp);
+	job = XCALLOC(MTYPE_BGP_DUMP_SNAPSHOT, sizeof(*job));
+	job->fp = bgp_dump->fp;
+	bgp_dump->fp = NULL;
 
-	/* Walk down each BGP route. */
-	table = bgp->rib[afi][SAFI_UNICAST];
+#ifdef HAVE_ZLIB
+	if (bgp_dump_compressed(bgp_dump->filename)) {
+		int fd = dup(fileno(job->fp));
+		int err = errno;
 
-	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
-		path = bgp_dest_get_bgp_path_info(dest);
-		while (path) {
-			path = bgp_dump_route_node_record(afi, dest, path, seq);
-			seq++;
+		/* gzdopen() takes over the fd only if it succeeds */
+		if (fd >= 0) {
+			job->gz = gzdopen(fd, "wb");
+			if (!job->gz)
+				close(fd);
+		}
+		fclose(job->fp);
+		job->fp = NULL;
+		if (!job->gz) {
+			flog_warn(EC_BGP_DUMP,
+				  "MRT table dump: cannot set up compression: %s",
+				  fd < 0 ? safe_strerror(err)
+					 : "gzdopen failed");
+			bdr.failed++;
+			XFREE(MTYPE_BGP_DUMP_SNAPSHOT, job);
+			return;
 		}
 	}
+#endif
 
-	fflush(bgp_dump_routes.fp);
+	/* Note that this assigns the peers' table_dump_index, which the
+	 * snapshot picks up
+	 */
+	job->index = bgp_dump_routes_index_table(bgp);
+	job->obuf = stream_new(BGP_DUMP_OBUF_SIZE);
+	bgp_dump_routes_snapshot(job, bgp, AFI_IP);
+	bgp_dump_routes_snapshot(job, bgp, AFI_IP6);
+
+	if (!bdr.fpt) {
+		struct frr_pthread_attr attr = {
+			.start = frr_pthread_attr_default.start,
+			.stop = frr_pthread_attr_default.stop,
+		};
+
+		bdr.fpt = frr_pthread_new(&attr, "BGP MRT dump", "bgpd_mrt");
+		frr_pthread_run(bdr.fpt, NULL);
+		frr_pthread_wait_running(bdr.fpt);
+	}
+
+	bdr.job = job;
+	atomic_store_explicit(&bdr.cancel, false, memory_order_relaxed);
+	atomic_store_explicit(&bdr.dests_done, 0, memory_order_relaxed);
+	atomic_store_explicit(&bdr.bytes, 0, memory_order_relaxed);
+	monotime(&bdr.started);
 
-	return seq;
+	thread_add_event(bdr.fpt->master, bgp_dump_routes_worker, job, 0,
+			 NULL);
+}
+
+static void bgp_dump_routes_stop(void)
+{
+	if (!bdr.fpt)
+		return;
+
+	atomic_store_explicit(&bdr.cancel, true, memory_order_relaxed);
+	frr_pthread_stop(bdr.fpt, NULL);
+	frr_pthread_destroy(bdr.fpt);
+	bdr.fpt = NULL;
+
+	THREAD_OFF(bdr.t_done);
+	if (bdr.job) {
+		bgp_dump_job_free(bdr.job);
+		bdr.job = NULL;
+	}
 }
 
 static int bgp_dump_interval_func(struct thread *t)
@@ -431,18 +716,26 @@ static int bgp_dump_interval_func(struct thread *t)
 	bgp_dump = THREAD_ARG(t);
 	bgp_dump->t_interval = NULL;
 
-	/* Reschedule dump even if file couldn't be opened this time... */
-	if (bgp_dump_open_file(bgp_dump) != NULL) {
-		/* In case of bgp_dump_routes, we need special route dump
-		 * function. */
+	/* Reschedule dump even if file couldn't be opened this time...
+	 * While a table dump is still running, its file may well be the one
+	 * this interval would open, so it is not touched at all.
+	 */
+	if (bgp_dump->type == BGP_DUMP_ROUTES && bdr.job) {
+		flog_warn(EC_BGP_DUMP,
+			  "MRT table dump still running, skipping this one");
+		bdr.skipped++;
+	} else if (bgp_dump_open_file(bgp_dump) != NULL) {
+		/* In case of bgp_dump_routes, the table is written out by the
+		 * MRT dump pthread, which also closes the file.  For a RIB
+		 * dump there's no point in leaving it open until the next
+		 * scheduled dump starts.
+		 */
 		if (bgp_dump->type == BGP_DUMP_ROUTES) {
-			unsigned int seq = bgp_dump_routes_func(AFI_IP, 1, 0);
-			bgp_dump_routes_func(AFI_IP6, 0, seq);
-			/* Close the file now. For a RIB dump there's no point
-			 * in leaving
-			 * it open until the next scheduled dump starts. */
-			fclose(bgp_dump->fp);
-			bgp_dump->fp = NULL;
+			bgp_dump_routes_start(bgp_dump);
+			if (bgp_dump->fp) {
+				fclose(bgp_dump->fp);
+				bgp_dump->fp = NULL;
+			}
 		}
 	}
 
@@ -778,6 +1071,45 @@ DEFUN (no_dump_bgp_all,
 	return bgp_dump_unset(bgp_dump_struct);
 }
 
+DEFUN (show_bgp_mrt_dump,
+       show_bgp_mrt_dump_cmd,
+       "show bgp mrt-dump",
+       SHOW_STR
+       BGP_STR
+       "MRT table dump progress and statistics\n")
+{
+	uint64_t bytes, msecs;
+	uint32_t done;
+
+	if (bdr.job) {
+		done = atomic_load_explicit(&bdr.dests_done,
+					    memory_order_relaxed);
+		bytes = atomic_load_explicit(&bdr.bytes, memory_order_relaxed);
+		msecs = monotime_since(&bdr.started, NULL) / 1000;
+
+		vty_out(vty, "Table dump running for %" PRIu64 ".%03" PRIu64
+			     " seconds\n",
+			msecs / 1000, msecs % 1000);
+		vty_out(vty, "  Prefixes: %u of %u\n", done, bdr.job->ndests);
+		vty_out(vty, "  Bytes written: %" PRIu64 " (%" PRIu64
+			     " KiB/s)\n",
+			bytes, msecs ? bytes * 1000 / 1024 / msecs : 0);
+	} else
+		vty_out(vty, "No table dump running\n");
+
+	vty_out(vty, "Table dumps completed: %u, failed: %u, skipped: %u\n",
+		bdr.dumps, bdr.failed, bdr.skipped);
+	if (bdr.dumps) {
+		vty_out(vty,
+			"Last table dump: %u prefixes, %u records, %" PRIu64
+			" bytes in %lu.%03lu seconds\n",
+			bdr.last_dests, bdr.last_records, bdr.last_bytes,
+			bdr.last_msecs / 1000, bdr.last_msecs % 1000);
+	}
+
+	return CMD_SUCCESS;
+}
+
 static int config_write_bgp_dump(struct vty *vty);
 /* BGP node structure. */
 static struct cmd_node bgp_dump_node = {
@@ -834,14 +1166,13 @@ void bgp_dump_init(void)
 	memset(&bgp_dump_updates, 0, sizeof(struct bgp_dump));
 	memset(&bgp_dump_routes, 0, sizeof(struct bgp_dump));
 
-	bgp_dump_obuf =
-		stream_new((BGP_MAX_PACKET_SIZE << 1) + BGP_DUMP_MSG_HEADER
-			   + BGP_DUMP_HEADER_SIZE);
+	bgp_dump_obuf = stream_new(BGP_DUMP_OBUF_SIZE);
 
 	install_node(&bgp_dump_node);
 
 	install_element(CONFIG_NODE, &dump_bgp_all_cmd);
 	install_element(CONFIG_NODE, &no_dump_bgp_all_cmd);
+	install_element(VIEW_NODE, &show_bgp_mrt_dump_cmd);
 
 	hook_register(bgp_packet_dump, bgp_dump_packet);
 	hook_register(peer_status_changed, bgp_dump_state);
@@ -849,6 +1180,7 @@ void bgp_dump_init(void)
 
 void bgp_dump_finish(void)
 {
+	bgp_dump_routes_stop();
 	bgp_dump_unset(&bgp_dump_all);
 	bgp_dump_unset(&bgp_dump_updates);
 	bgp_dump_unset(&bgp_dump_routes);
@@ -60,10 +60,21 @@ struct as_filter {
 
 	enum as_filter_type type;
 
-	regex_t *reg;
+	struct bgp_asregex *reg;
 	char *reg_str;
 };
 
+/* Results of as_list_apply() per interned AS path, direct-mapped on the
+ * path's intern_id.  Dropped whenever the list changes.
+ */
+#define AS_LIST_MEMO_SLOTS 1024
+
+struct as_list_memo {
+	const struct aspath *aspath;
+	uint32_t intern_id;
+	enum as_filter_type type;
+};
+
 /* AS path filter list. */
 struct as_list {
 	char *name;
@@ -75,6 +86,9 @@ struct as_list {
 
 	struct as_filter *head;
 	struct as_filter *tail;
+
+	struct as_list_memo *memo;
+	uint64_t memo_hits, memo_misses;
 };
 
 /* as-path access-list 10 permit AS1. */
@@ -94,13 +108,14 @@ static struct as_filter *as_filter_new(void)
 static void as_filter_free(struct as_filter *asfilter)
 {
 	if (asfilter->reg)
-		bgp_regex_free(asfilter->reg);
+		bgp_asregex_free(asfilter->reg);
 	XFREE(MTYPE_AS_FILTER_STR, asfilter->reg_str);
 	XFREE(MTYPE_AS_FILTER, asfilter);
 }
 
 /* Make new AS filter. */
-static struct as_filter *as_filter_make(regex_t *reg, const char *reg_str,
+static struct as_filter *as_filter_make(struct bgp_asregex *reg,
+					const char *reg_str,
 					enum as_filter_type type)
 {
 	struct as_filter *asfilter;
@@ -125,9 +140,16 @@ static struct as_filter *as_filter_lookup(struct as_list *aslist,
 	return NULL;
 }
 
+static void as_list_memo_flush(struct as_list *aslist)
+{
+	XFREE(MTYPE_AS_LIST_MEMO, aslist->memo);
+}
+
 static void as_list_filter_add(struct as_list *aslist,
 			       struct as_filter *asfilter)
 {
+	as_list_memo_flush(aslist);
+
 	asfilter->next = NULL;
 	asfilter->prev = aslist->tail;
 
@@ -168,6 +190,7 @@ static struct as_list *as_list_new(void)
 
 static void as_list_free(struct as_list *aslist)
 {
+	XFREE(MTYPE_AS_LIST_MEMO, aslist->memo);
 	XFREE(MTYPE_AS_STR, aslist->name);
 	XFREE(MTYPE_AS_LIST, aslist);
 }
@@ -312,6 +335,8 @@ static void as_list_filter_delete(struct as_list *aslist,
 {
 	char *name = XSTRDUP(MTYPE_AS_STR, aslist->name);
 
+	as_list_memo_flush(aslist);
+
 	if (asfilter->next)
 		asfilter->next->prev = asfilter->prev;
 	else
@@ -336,13 +361,25 @@ static void as_list_filter_delete(struct as_list *aslist,
 
 static bool as_filter_match(struct as_filter *asfilter, struct aspath *aspath)
 {
-	return bgp_regexec(asfilter->reg, aspath) != REG_NOMATCH;
+	return bgp_asregexec(asfilter->reg, aspath);
+}
+
+static enum as_filter_type as_list_eval(struct as_list *aslist,
+					struct aspath *aspath)
+{
+	struct as_filter *asfilter;
+
+	for (asfilter = aslist->head; asfilter; asfilter = asfilter->next) {
+		if (as_filter_match(asfilter, aspath))
+			return asfilter->type;
+	}
+	return AS_FILTER_DENY;
 }
 
 /* Apply AS path filter to AS. */
 enum as_filter_type as_list_apply(struct as_list *aslist, void *object)
 {
-	struct as_filter *asfilter;
+	struct as_list_memo *memo;
 	struct aspath *aspath;
 
 	aspath = (struct aspath *)object;
@@ -350,11 +387,25 @@ enum as_filter_type as_list_apply(struct as_list *aslist, void *object)
 	if (aslist == NULL)
 		return AS_FILTER_DENY;
 
-	for (asfilter = aslist->head; asfilter; asfilter = asfilter->next) {
-		if (as_filter_match(asfilter, aspath))
-			return asfilter->type;
+	/* paths that aren't interned can change under us */
+	if (!aspath->intern_id || !aspath->refcnt)
+		return as_list_eval(aslist, aspath);
+
+	if (!aslist->memo)
+		aslist->memo = XCALLOC(MTYPE_AS_LIST_MEMO,
+				       AS_LIST_MEMO_SLOTS * sizeof(*memo));
+
+	memo = &aslist->memo[aspath->intern_id % AS_LIST_MEMO_SLOTS];
+	if (memo->aspath == aspath && memo->intern_id == aspath->intern_id) {
+		aslist->memo_hits++;
+		return memo->type;
 	}
-	return AS_FILTER_DENY;
+
+	aslist->memo_misses++;
+	memo->aspath = aspath;
+	memo->intern_id = aspath->intern_id;
+	memo->type = as_list_eval(aslist, aspath);
+	return memo->type;
 }
 
 /* Add hook function. */
@@ -404,7 +455,7 @@ DEFUN(as_path, bgp_as_path_cmd,
 	enum as_filter_type type;
 	struct as_filter *asfilter;
 	struct as_list *aslist;
-	regex_t *regex;
+	struct bgp_asregex *regex;
 	char *regstr;
 
 	/* Retrieve access list name */
@@ -419,7 +470,7 @@ DEFUN(as_path, bgp_as_path_cmd,
 	argv_find(argv, argc, "LINE", &idx);
 	regstr = argv_concat(argv, argc, idx);
 
-	regex = bgp_regcomp(regstr);
+	regex = bgp_asregcomp(regstr);
 	if (!regex) {
 		vty_out(vty, "can't compile regexp %s\n", regstr);
 		XFREE(MTYPE_TMP, regstr);
@@ -558,34 +609,22 @@ static void as_list_show(struct vty *vty, struct as_list *aslist)
 		vty_out(vty, "    %s %s\n", filter_type_str(asfilter->type),
 			asfilter->reg_str);
 	}
+
+	if (aslist->memo_hits || aslist->memo_misses)
+		vty_out(vty, "    result cache: %" PRIu64 " hits, %" PRIu64
+			" misses\n",
+			aslist->memo_hits, aslist->memo_misses);
 }
 
 static void as_list_show_all(struct vty *vty)
 {
 	struct as_list *aslist;
-	struct as_filter *asfilter;
-
-	for (aslist = as_list_master.num.head; aslist; aslist = aslist->next) {
-		vty_out(vty, "AS path access list %s\n", aslist->name);
-
-		for (asfilter = aslist->head; asfilter;
-		     asfilter = asfilter->next) {
-			vty_out(vty, "    %s %s\n",
-				filter_type_str(asfilter->type),
-				asfilter->reg_str);
-		}
-	}
 
-	for (aslist = as_list_master.str.head; aslist; aslist = aslist->next) {
-		vty_out(vty, "AS path access list %s\n", aslist->name);
+	for (aslist = as_list_master.num.head; aslist; aslist = aslist->next)
+		as_list_show(vty, aslist);
 
-		for (asfilter = aslist->head; asfilter;
-		     asfilter = asfilter->next) {
-			vty_out(vty, "    %s %s\n",
-				filter_type_str(asfilter->type),
-				asfilter->reg_str);
-		}
-	}
+	for (aslist = as_list_master.str.head; aslist; aslist = aslist->next)
+		as_list_show(vty, aslist);
 }
 
 DEFUN (show_as_path_access_list,
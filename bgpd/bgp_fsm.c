@@ -194,6 +194,7 @@ static struct peer *peer_xfer_conn(struct peer *from_peer)
 
 		stream_fifo_clean(peer->ibuf);
 		stream_fifo_clean(peer->obuf);
+		bgp_attr_predecode_flush(peer);
 
 		/*
 		 * this should never happen, since bgp_process_packet() is the
@@ -212,6 +213,7 @@ static struct peer *peer_xfer_conn(struct peer *from_peer)
 			 */
 			stream_free(peer->curr);
 			peer->curr = NULL;
+			bgp_attr_predecode_free(&peer->curr_predecode);
 		}
 
 		// copy each packet from old peer's output queue to new peer
@@ -223,6 +225,8 @@ static struct peer *peer_xfer_conn(struct peer *from_peer)
 		while (from_peer->ibuf->head)
 			stream_fifo_push(peer->ibuf,
 					 stream_fifo_pop(from_peer->ibuf));
+		/* decoded with from_peer's capabilities, let them be reparsed */
+		bgp_attr_predecode_flush(from_peer);
 
 		ringbuf_wipe(peer->ibuf_work);
 		ringbuf_copy(peer->ibuf_work, from_peer->ibuf_work,
@@ -1299,6 +1303,7 @@ int bgp_stop(struct peer *peer)
 	frr_with_mutex(&peer->io_mtx) {
 		if (peer->ibuf)
 			stream_fifo_clean(peer->ibuf);
+		bgp_attr_predecode_flush(peer);
 		if (peer->obuf)
 			stream_fifo_clean(peer->obuf);
 
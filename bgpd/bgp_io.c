@@ -35,6 +35,7 @@
 #include "zassert.h"		// for assert
 
 #include "bgpd/bgp_io.h"
+#include "bgpd/bgp_attr.h"	// for bgp_attr_predecode
 #include "bgpd/bgp_debug.h"	// for bgp_debug_neighbor_events, bgp_type_str
 #include "bgpd/bgp_errors.h"	// for expanded error reference information
 #include "bgpd/bgp_fsm.h"	// for BGP_EVENT_ADD, bgp_event
@@ -205,6 +206,8 @@ static int bgp_process_reads(struct thread *thread)
 		struct ringbuf *ibw = peer->ibuf_work;
 		/* packet size as given by header */
 		uint16_t pktsize = 0;
+		/* attributes decoded ahead of the main pthread */
+		struct bgp_attr_predecode *pd;
 
 		/* check that we have enough data for a header */
 		if (ringbuf_remain(ibw) < BGP_HEADER_SIZE)
@@ -234,8 +237,16 @@ static int bgp_process_reads(struct thread *thread)
 			assert(ringbuf_get(ibw, pkt->data, pktsize) == pktsize);
 			stream_set_endp(pkt, pktsize);
 
+			/* get the costlier UPDATE attributes decoded here, off
+			 * the main pthread
+			 */
+			pd = bgp_attr_predecode(peer, pkt);
+
 			frr_with_mutex(&peer->io_mtx) {
 				stream_fifo_push(peer->ibuf, pkt);
+				if (pd)
+					bgp_predecode_fifo_add_tail(
+						&peer->ibuf_predecode, pd);
 			}
 
 			added_pkt = true;
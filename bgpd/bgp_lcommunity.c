@@ -34,6 +34,7 @@
 
 /* Hash of community attribute. */
 static struct hash *lcomhash;
+static uint32_t lcommunity_intern_id;
 
 /* Allocate a new lcommunities.  */
 static struct lcommunity *lcommunity_new(void)
@@ -261,6 +262,8 @@ struct lcommunity *lcommunity_intern(struct lcommunity *lcom)
 
 	if (find != lcom)
 		lcommunity_free(&lcom);
+	else
+		find->intern_id = ++lcommunity_intern_id;
 
 	find->refcnt++;
 
@@ -43,6 +43,9 @@ struct lcommunity {
 
 	/* Human readable format string.  */
 	char *str;
+
+	/* Set when interned, see struct community.  */
+	uint32_t intern_id;
 };
 
 /* Large community value is 12 octets.  */
@@ -50,6 +50,7 @@
 #include "bgpd/bgp_dump.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_nexthop.h"
+#include "bgpd/bgp_nht.h"
 #include "bgpd/bgp_regex.h"
 #include "bgpd/bgp_clist.h"
 #include "bgpd/bgp_debug.h"
@@ -244,6 +245,7 @@ static __attribute__((__noreturn__)) void bgp_exit(int status)
 #ifdef ENABLE_BGP_VNC
 	vnc_zebra_destroy();
 #endif
+	bgp_nht_finish();
 	bgp_zebra_destroy();
 
 	bf_free(bm->rd_idspace);
@@ -43,13 +43,13 @@ DEFINE_MTYPE(BGPD, BGP_UPDGRP, "BGP update group")
 DEFINE_MTYPE(BGPD, BGP_UPD_SUBGRP, "BGP update subgroup")
 DEFINE_MTYPE(BGPD, BGP_PACKET, "BGP packet")
 DEFINE_MTYPE(BGPD, ATTR, "BGP attribute")
+DEFINE_MTYPE(BGPD, BGP_ATTR_PREDECODE, "BGP predecoded attributes")
 DEFINE_MTYPE(BGPD, AS_PATH, "BGP aspath")
 DEFINE_MTYPE(BGPD, AS_SEG, "BGP aspath seg")
 DEFINE_MTYPE(BGPD, AS_SEG_DATA, "BGP aspath segment data")
 DEFINE_MTYPE(BGPD, AS_STR, "BGP aspath str")
 
 DEFINE_MTYPE(BGPD, BGP_TABLE, "BGP table")
-DEFINE_MTYPE(BGPD, BGP_NODE, "BGP node")
 DEFINE_MTYPE(BGPD, BGP_ROUTE, "BGP route")
 DEFINE_MTYPE(BGPD, BGP_ROUTE_EXTRA, "BGP ancillary route info")
 DEFINE_MTYPE(BGPD, BGP_CONN, "BGP connected")
@@ -59,11 +59,17 @@ DEFINE_MTYPE(BGPD, BGP_ADVERTISE, "BGP adv")
 DEFINE_MTYPE(BGPD, BGP_SYNCHRONISE, "BGP synchronise")
 DEFINE_MTYPE(BGPD, BGP_ADJ_IN, "BGP adj in")
 DEFINE_MTYPE(BGPD, BGP_ADJ_OUT, "BGP adj out")
+DEFINE_MTYPE(BGPD, BGP_ADJ_OUT_INDEX, "BGP adj out index")
+DEFINE_MTYPE(BGPD, BGP_ATTR_ENCODE, "BGP encoded attributes")
 DEFINE_MTYPE(BGPD, BGP_MPATH_INFO, "BGP multipath info")
+DEFINE_MTYPE(BGPD, BGP_BESTPATH_JOB, "BGP best-path worker job")
+DEFINE_MTYPE(BGPD, BGP_UPDATE_JOB, "BGP update worker job")
 
 DEFINE_MTYPE(BGPD, AS_LIST, "BGP AS list")
 DEFINE_MTYPE(BGPD, AS_FILTER, "BGP AS filter")
 DEFINE_MTYPE(BGPD, AS_FILTER_STR, "BGP AS filter str")
+DEFINE_MTYPE(BGPD, AS_LIST_MEMO, "BGP AS list results")
+DEFINE_MTYPE(BGPD, BGP_ROUTE_MAP_MEMO, "BGP route-map result cache key")
 
 DEFINE_MTYPE(BGPD, COMMUNITY, "community")
 DEFINE_MTYPE(BGPD, COMMUNITY_VAL, "community val")
@@ -78,6 +84,7 @@ DEFINE_MTYPE(BGPD, COMMUNITY_LIST_NAME, "community-list name")
 DEFINE_MTYPE(BGPD, COMMUNITY_LIST_ENTRY, "community-list entry")
 DEFINE_MTYPE(BGPD, COMMUNITY_LIST_CONFIG, "community-list config")
 DEFINE_MTYPE(BGPD, COMMUNITY_LIST_HANDLER, "community-list handler")
+DEFINE_MTYPE(BGPD, COMMUNITY_LIST_INDEX, "community-list index")
 
 DEFINE_MTYPE(BGPD, CLUSTER, "Cluster list")
 DEFINE_MTYPE(BGPD, CLUSTER_VAL, "Cluster list val")
@@ -93,6 +100,7 @@ DEFINE_MTYPE(BGPD, BGP_DEBUG_STR, "BGP debug filter string")
 
 DEFINE_MTYPE(BGPD, BGP_DISTANCE, "BGP distance")
 DEFINE_MTYPE(BGPD, BGP_NEXTHOP_CACHE, "BGP nexthop")
+DEFINE_MTYPE(BGPD, BGP_NHT_QUEUE, "BGP nexthop registration queue")
 DEFINE_MTYPE(BGPD, BGP_CONFED_LIST, "BGP confed list")
 DEFINE_MTYPE(BGPD, PEER_UPDATE_SOURCE, "BGP peer update interface")
 DEFINE_MTYPE(BGPD, PEER_CONF_IF, "BGP peer config interface")
@@ -106,6 +114,7 @@ DEFINE_MTYPE(BGPD, TIP_ADDR, "BGP own tunnel-ip address")
 DEFINE_MTYPE(BGPD, BGP_REDIST, "BGP redistribution")
 DEFINE_MTYPE(BGPD, BGP_FILTER_NAME, "BGP Filter Information")
 DEFINE_MTYPE(BGPD, BGP_DUMP_STR, "BGP Dump String Information")
+DEFINE_MTYPE(BGPD, BGP_DUMP_SNAPSHOT, "BGP MRT dump snapshot")
 DEFINE_MTYPE(BGPD, ENCAP_TLV, "ENCAP TLV")
 
 DEFINE_MTYPE(BGPD, BGP_TEA_OPTIONS, "BGP TEA Options")
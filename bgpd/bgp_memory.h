@@ -39,13 +39,13 @@ DECLARE_MTYPE(BGP_UPDGRP)
 DECLARE_MTYPE(BGP_UPD_SUBGRP)
 DECLARE_MTYPE(BGP_PACKET)
 DECLARE_MTYPE(ATTR)
+DECLARE_MTYPE(BGP_ATTR_PREDECODE)
 DECLARE_MTYPE(AS_PATH)
 DECLARE_MTYPE(AS_SEG)
 DECLARE_MTYPE(AS_SEG_DATA)
 DECLARE_MTYPE(AS_STR)
 
 DECLARE_MTYPE(BGP_TABLE)
-DECLARE_MTYPE(BGP_NODE)
 DECLARE_MTYPE(BGP_ROUTE)
 DECLARE_MTYPE(BGP_ROUTE_EXTRA)
 DECLARE_MTYPE(BGP_CONN)
@@ -55,11 +55,17 @@ DECLARE_MTYPE(BGP_ADVERTISE)
 DECLARE_MTYPE(BGP_SYNCHRONISE)
 DECLARE_MTYPE(BGP_ADJ_IN)
 DECLARE_MTYPE(BGP_ADJ_OUT)
+DECLARE_MTYPE(BGP_ADJ_OUT_INDEX)
+DECLARE_MTYPE(BGP_ATTR_ENCODE)
 DECLARE_MTYPE(BGP_MPATH_INFO)
+DECLARE_MTYPE(BGP_BESTPATH_JOB)
+DECLARE_MTYPE(BGP_UPDATE_JOB)
 
 DECLARE_MTYPE(AS_LIST)
 DECLARE_MTYPE(AS_FILTER)
 DECLARE_MTYPE(AS_FILTER_STR)
+DECLARE_MTYPE(AS_LIST_MEMO)
+DECLARE_MTYPE(BGP_ROUTE_MAP_MEMO)
 
 DECLARE_MTYPE(COMMUNITY)
 DECLARE_MTYPE(COMMUNITY_VAL)
@@ -74,6 +80,7 @@ DECLARE_MTYPE(COMMUNITY_LIST_NAME)
 DECLARE_MTYPE(COMMUNITY_LIST_ENTRY)
 DECLARE_MTYPE(COMMUNITY_LIST_CONFIG)
 DECLARE_MTYPE(COMMUNITY_LIST_HANDLER)
+DECLARE_MTYPE(COMMUNITY_LIST_INDEX)
 
 DECLARE_MTYPE(CLUSTER)
 DECLARE_MTYPE(CLUSTER_VAL)
@@ -89,6 +96,7 @@ DECLARE_MTYPE(BGP_DEBUG_STR)
 
 DECLARE_MTYPE(BGP_DISTANCE)
 DECLARE_MTYPE(BGP_NEXTHOP_CACHE)
+DECLARE_MTYPE(BGP_NHT_QUEUE)
 DECLARE_MTYPE(BGP_CONFED_LIST)
 DECLARE_MTYPE(PEER_UPDATE_SOURCE)
 DECLARE_MTYPE(PEER_CONF_IF)
@@ -102,6 +110,7 @@ DECLARE_MTYPE(TIP_ADDR)
 DECLARE_MTYPE(BGP_REDIST)
 DECLARE_MTYPE(BGP_FILTER_NAME)
 DECLARE_MTYPE(BGP_DUMP_STR)
+DECLARE_MTYPE(BGP_DUMP_SNAPSHOT)
 DECLARE_MTYPE(ENCAP_TLV)
 
 DECLARE_MTYPE(BGP_TEA_OPTIONS)
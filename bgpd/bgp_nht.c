@@ -45,9 +45,18 @@
 #include "bgpd/bgp_flowspec_util.h"
 #include "bgpd/bgp_evpn.h"
 #include "bgpd/bgp_rd.h"
+#include "bgpd/bgp_memory.h"
 
 extern struct zclient *zclient;
 
+/* Nexthop (un)registrations made while handling an event, sent to zebra in
+ * bulk once the event is done.
+ */
+static struct zapi_rnh *nht_reg_queue;
+static unsigned int nht_reg_count;
+static unsigned int nht_reg_size;
+static struct thread *t_nht_reg;
+
 static void register_zebra_rnh(struct bgp_nexthop_cache *bnc,
 			       int is_bgp_static_route);
 static void unregister_zebra_rnh(struct bgp_nexthop_cache *bnc,
@@ -585,6 +594,60 @@ static int make_prefix(int afi, struct bgp_path_info *pi, struct prefix *p)
 	return 0;
 }
 
+static int bgp_nht_reg_flush(struct thread *thread)
+{
+	unsigned int count = nht_reg_count;
+
+	nht_reg_count = 0;
+	if (!zclient || !count)
+		return 0;
+
+	if (BGP_DEBUG(zebra, ZEBRA))
+		zlog_debug("%s: sending %u nexthop (un)registrations",
+			   __func__, count);
+
+	/* TBD: handle the failure */
+	if (zclient_send_rnh_list(zclient, nht_reg_queue, count) < 0)
+		flog_warn(EC_BGP_ZEBRA_SEND,
+			  "sendmsg_nexthop: zclient_send_message() failed");
+
+	return 0;
+}
+
+/*
+ * Queue a nexthop (un)registration.  Zebra takes any number of them in one
+ * message, so everything queued while handling the current event is sent
+ * together, keeping the order in which it was queued.
+ */
+static void bgp_nht_reg_queue(int command, const struct prefix *p,
+			      bool exact_match, vrf_id_t vrf_id)
+{
+	struct zapi_rnh *rnh;
+
+	if (nht_reg_count == nht_reg_size) {
+		nht_reg_size = MAX(64U, nht_reg_size * 2);
+		nht_reg_queue =
+			XREALLOC(MTYPE_BGP_NHT_QUEUE, nht_reg_queue,
+				 nht_reg_size * sizeof(*nht_reg_queue));
+	}
+
+	rnh = &nht_reg_queue[nht_reg_count++];
+	rnh->command = command;
+	rnh->vrf_id = vrf_id;
+	prefix_copy(&rnh->prefix, p);
+	rnh->exact_match = exact_match;
+
+	thread_add_event(bm->master, bgp_nht_reg_flush, NULL, 0, &t_nht_reg);
+}
+
+void bgp_nht_finish(void)
+{
+	THREAD_OFF(t_nht_reg);
+	XFREE(MTYPE_BGP_NHT_QUEUE, nht_reg_queue);
+	nht_reg_count = 0;
+	nht_reg_size = 0;
+}
+
 /**
  * sendmsg_zebra_rnh -- Format and send a nexthop register/Unregister
  *   command to Zebra.
@@ -597,7 +660,6 @@ static int make_prefix(int afi, struct bgp_path_info *pi, struct prefix *p)
 static void sendmsg_zebra_rnh(struct bgp_nexthop_cache *bnc, int command)
 {
 	bool exact_match = false;
-	int ret;
 
 	if (!zclient)
 		return;
@@ -628,12 +690,8 @@ static void sendmsg_zebra_rnh(struct bgp_nexthop_cache *bnc, int command)
 			   zserv_command_string(command), &bnc->prefix,
 			   bnc->bgp->name_pretty);
 
-	ret = zclient_send_rnh(zclient, command, &bnc->prefix, exact_match,
-			       bnc->bgp->vrf_id);
-	/* TBD: handle the failure */
-	if (ret < 0)
-		flog_warn(EC_BGP_ZEBRA_SEND,
-			  "sendmsg_nexthop: zclient_send_message() failed");
+	bgp_nht_reg_queue(command, &bnc->prefix, exact_match,
+			  bnc->bgp->vrf_id);
 
 	if ((command == ZEBRA_NEXTHOP_REGISTER)
 	    || (command == ZEBRA_IMPORT_ROUTE_REGISTER))
@@ -684,6 +742,58 @@ static void unregister_zebra_rnh(struct bgp_nexthop_cache *bnc,
 		sendmsg_zebra_rnh(bnc, ZEBRA_NEXTHOP_UNREGISTER);
 }
 
+static uint32_t bgp_nht_local_pref(struct bgp *bgp, struct attr *attr)
+{
+	if (attr->flag & ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF))
+		return attr->local_pref;
+	return bgp->default_local_pref;
+}
+
+/*
+ * Whether a nexthop update that leaves the validity of a path unchanged can
+ * still change the outcome of best path selection or the route installed
+ * for its dest.  A path depends on its nexthop's reachability (and label
+ * reachability, both covered by the validity check of the caller), on the
+ * resolving nexthops, and on the IGP metric.  The metric is compared only
+ * after weight and local preference, so a metric change matters only if
+ * another candidate for the dest ties with the path on both of them.
+ */
+static bool bgp_nht_path_affected(struct bgp_nexthop_cache *bnc,
+				  struct bgp_path_info *path, struct bgp *bgp,
+				  safi_t safi)
+{
+	struct bgp_path_info *pi;
+	uint32_t local_pref;
+
+	if (CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_CHANGED)
+	    || path->attr->srte_color != 0)
+		return true;
+
+	if (!CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_METRIC_CHANGED))
+		return false;
+
+	/* An unusable path is not a candidate, whatever its metric */
+	if (!CHECK_FLAG(path->flags, BGP_PATH_VALID))
+		return false;
+
+	/* EVPN compares MAC mobility and ESI before the weight */
+	if (safi == SAFI_EVPN)
+		return true;
+
+	local_pref = bgp_nht_local_pref(bgp, path->attr);
+	for (pi = bgp_dest_get_bgp_path_info(path->net); pi; pi = pi->next) {
+		if (pi == path || !CHECK_FLAG(pi->flags, BGP_PATH_VALID)
+		    || BGP_PATH_HOLDDOWN(pi))
+			continue;
+
+		if (pi->attr->weight == path->attr->weight
+		    && bgp_nht_local_pref(bgp, pi->attr) == local_pref)
+			return true;
+	}
+
+	return false;
+}
+
 /**
  * evaluate_paths - Evaluate the paths/nets associated with a nexthop.
  * ARGUMENTS:
@@ -794,12 +904,21 @@ static void evaluate_paths(struct bgp_nexthop_cache *bnc)
 		else if (path->extra)
 			path->extra->igpmetric = 0;
 
+		path_valid = !!CHECK_FLAG(path->flags, BGP_PATH_VALID);
+		if (path_valid == bnc_is_valid_nexthop
+		    && !bgp_nht_path_affected(bnc, path, bgp_path, safi)) {
+			if (BGP_DEBUG(nht, NHT))
+				zlog_debug(
+					"... skip path %pRN %s, nexthop change does not affect it",
+					dest, bgp_path->name_pretty);
+			continue;
+		}
+
 		if (CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_METRIC_CHANGED)
 		    || CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_CHANGED)
 		    || path->attr->srte_color != 0)
 			SET_FLAG(path->flags, BGP_PATH_IGP_CHANGED);
 
-		path_valid = !!CHECK_FLAG(path->flags, BGP_PATH_VALID);
 		if (path_valid != bnc_is_valid_nexthop) {
 			if (path_valid) {
 				/* No longer valid, clear flag; also for EVPN
@@ -90,4 +90,9 @@ extern void bgp_nht_register_nexthops(struct bgp *bgp);
 extern void bgp_nht_reg_enhe_cap_intfs(struct peer *peer);
 extern void bgp_nht_dereg_enhe_cap_intfs(struct peer *peer);
 
+/*
+ * Drop nexthop registrations not yet sent to zebra, on shutdown.
+ */
+extern void bgp_nht_finish(void);
+
 #endif /* _BGP_NHT_H */
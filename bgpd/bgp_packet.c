@@ -63,6 +63,7 @@
 #include "bgpd/bgp_io.h"
 #include "bgpd/bgp_keepalives.h"
 #include "bgpd/bgp_flowspec.h"
+#include "bgpd/bgp_update_workers.h"
 
 DEFINE_HOOK(bgp_packet_dump,
 		(struct peer *peer, uint8_t type, bgp_size_t size,
@@ -429,6 +430,13 @@ int bgp_generate_updgrp_packets(struct thread *thread)
 			if (!next_pkt || !next_pkt->buffer) {
 				next_pkt = subgroup_withdraw_packet(
 					PAF_SUBGRP(paf));
+				if (!next_pkt || !next_pkt->buffer) {
+					/* encode all subgroups at once when
+					 * there are update workers
+					 */
+					bgp_update_workers_run(peer->bgp);
+					next_pkt = paf->next_pkt_to_send;
+				}
 				if (!next_pkt || !next_pkt->buffer)
 					subgroup_update_packet(PAF_SUBGRP(paf));
 				next_pkt = paf->next_pkt_to_send;
@@ -1648,6 +1656,9 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size)
 		zlog_debug("%s rcvd UPDATE wlen %d attrlen %d alen %d",
 			   peer->host, withdraw_len, attribute_len, update_len);
 
+	/* All NLRIs below share the attributes parsed above */
+	bgp_attr_intern_batch_begin();
+
 	/* Parse any given NLRIs */
 	for (int i = NLRI_UPDATE; i < NLRI_TYPE_MAX; i++) {
 		if (!nlris[i].nlri)
@@ -1690,11 +1701,14 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size)
 					i <= NLRI_WITHDRAW
 						? BGP_NOTIFY_UPDATE_INVAL_NETWORK
 						: BGP_NOTIFY_UPDATE_OPT_ATTR_ERR);
+			bgp_attr_intern_batch_end();
 			bgp_attr_unintern_sub(&attr);
 			return BGP_Stop;
 		}
 	}
 
+	bgp_attr_intern_batch_end();
+
 	/* EoR checks
 	 *
 	 * Non-MP IPv4/Unicast EoR is a completely empty UPDATE
@@ -2345,6 +2359,7 @@ int bgp_process_packet(struct thread *thread)
 
 		frr_with_mutex(&peer->io_mtx) {
 			peer->curr = stream_fifo_pop(peer->ibuf);
+			peer->curr_predecode = bgp_attr_predecode_pop(peer);
 		}
 
 		if (peer->curr == NULL) // no packets to process, hmm...
@@ -2445,6 +2460,7 @@ int bgp_process_packet(struct thread *thread)
 		/* delete processed packet */
 		stream_free(peer->curr);
 		peer->curr = NULL;
+		bgp_attr_predecode_free(&peer->curr_predecode);
 		processed++;
 
 		/* Update FSM */
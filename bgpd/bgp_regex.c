@@ -25,6 +25,7 @@
 #include "memory.h"
 #include "queue.h"
 #include "filter.h"
+#include "jhash.h"
 
 #include "bgpd.h"
 #include "bgp_aspath.h"
@@ -87,3 +88,742 @@ void bgp_regex_free(regex_t *regex)
 	regfree(regex);
 	XFREE(MTYPE_BGP_REGEXP, regex);
 }
+
+/* Compiled AS path expressions
+ *
+ * AS path filters match against the string form of the path, e.g.
+ * "64500 {64501,64502} (64503 64504)".  Rather than handing that string to
+ * regexec(), the expression is compiled into a DFA over the few characters
+ * such a string can contain, and the characters are produced directly from
+ * the segment ASN arrays while matching.  Expressions using anything the
+ * compiler does not handle keep using regexec() on the string.
+ */
+
+/* input symbols: the digits, then separators and segment delimiters */
+#define ASRE_SYM_SPACE		10
+#define ASRE_SYM_COMMA		11
+#define ASRE_SYM_SET_START	12
+#define ASRE_SYM_SET_END	13
+#define ASRE_SYM_CONFED_START	14
+#define ASRE_SYM_CONFED_END	15
+#define ASRE_SYM_CONFSET_START	16
+#define ASRE_SYM_CONFSET_END	17
+#define ASRE_NSYM		18
+
+static const char asre_chars[ASRE_NSYM] = {
+	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+	' ', ',', '{', '}', '(', ')', '[', ']',
+};
+
+#define ASRE_NFA_MAX		1024
+#define ASRE_DFA_MAX		1024
+#define ASRE_DUP_MAX		255
+#define ASRE_DEPTH_MAX		64
+
+/* DFA state flags */
+#define ASRE_ACCEPT		(1 << 0)
+#define ASRE_ACCEPT_EOL		(1 << 1)
+
+struct bgp_asregex {
+	/* set if the expression is matched with regexec() */
+	regex_t *posix;
+
+	/* state 0 is the start state; accepting states are final */
+	unsigned int nstates;
+	uint16_t *trans;
+	uint8_t *flags;
+};
+
+typedef uint32_t asre_set_t;
+
+static asre_set_t asre_char_set(char c)
+{
+	int i;
+
+	for (i = 0; i < ASRE_NSYM; i++)
+		if (asre_chars[i] == c)
+			return 1U << i;
+	/* can't occur in an AS path, never matches */
+	return 0;
+}
+
+/* `_' is (^|[,{}() ]|$) */
+#define ASRE_SET_MAGIC                                                         \
+	((1U << ASRE_SYM_SPACE) | (1U << ASRE_SYM_COMMA)                       \
+	 | (1U << ASRE_SYM_SET_START) | (1U << ASRE_SYM_SET_END)               \
+	 | (1U << ASRE_SYM_CONFED_START) | (1U << ASRE_SYM_CONFED_END))
+#define ASRE_SET_ALL ((1U << ASRE_NSYM) - 1)
+
+/* Parser, builds a syntax tree */
+
+enum asre_op {
+	ASRE_OP_EMPTY,
+	ASRE_OP_CHAR,
+	ASRE_OP_BOL,
+	ASRE_OP_EOL,
+	ASRE_OP_CAT,
+	ASRE_OP_ALT,
+	ASRE_OP_REPEAT,
+};
+
+struct asre_node {
+	enum asre_op op;
+	asre_set_t set;
+	/* max < 0 is unbounded */
+	int min, max;
+	struct asre_node *a, *b;
+};
+
+struct asre_parse {
+	const char *str;
+	size_t pos;
+	int depth;
+	bool fail;
+
+	struct asre_node *nodes;
+	size_t nnodes, maxnodes;
+};
+
+static struct asre_node *asre_node(struct asre_parse *p, enum asre_op op,
+				   struct asre_node *a, struct asre_node *b)
+{
+	struct asre_node *node;
+
+	if (p->nnodes == p->maxnodes) {
+		p->fail = true;
+		return NULL;
+	}
+	node = &p->nodes[p->nnodes++];
+	node->op = op;
+	node->a = a;
+	node->b = b;
+	return node;
+}
+
+static struct asre_node *asre_charnode(struct asre_parse *p, asre_set_t set)
+{
+	struct asre_node *node = asre_node(p, ASRE_OP_CHAR, NULL, NULL);
+
+	if (node)
+		node->set = set;
+	return node;
+}
+
+static struct asre_node *asre_parse_alt(struct asre_parse *p);
+
+static struct asre_node *asre_parse_bracket(struct asre_parse *p)
+{
+	const char *s = p->str;
+	asre_set_t set = 0;
+	bool negate = false, first = true;
+	char lo, hi;
+	int i;
+
+	if (s[p->pos] == '^') {
+		negate = true;
+		p->pos++;
+	}
+
+	while (s[p->pos] != ']' || first) {
+		lo = s[p->pos];
+		/* character classes, collating elements, and backslashes
+		 * which PCRE treats differently
+		 */
+		if (lo == '\0' || lo == '\\'
+		    || (lo == '[' && strchr(":.=", s[p->pos + 1]))) {
+			p->fail = true;
+			return NULL;
+		}
+		first = false;
+		p->pos++;
+
+		hi = lo;
+		if (s[p->pos] == '-' && s[p->pos + 1] != ']'
+		    && s[p->pos + 1] != '\0') {
+			hi = s[p->pos + 1];
+			if (hi == '\\' || hi == '[' || hi < lo) {
+				p->fail = true;
+				return NULL;
+			}
+			p->pos += 2;
+		}
+
+		for (i = 0; i < ASRE_NSYM; i++)
+			if (asre_chars[i] >= lo && asre_chars[i] <= hi)
+				set |= 1U << i;
+	}
+	p->pos++;
+
+	return asre_charnode(p, negate ? ASRE_SET_ALL & ~set : set);
+}
+
+static struct asre_node *asre_parse_atom(struct asre_parse *p, bool *quant)
+{
+	struct asre_node *node, *magic;
+	char c = p->str[p->pos];
+
+	*quant = true;
+
+	switch (c) {
+	case '(':
+		if (++p->depth > ASRE_DEPTH_MAX) {
+			p->fail = true;
+			return NULL;
+		}
+		p->pos++;
+		node = asre_parse_alt(p);
+		if (p->fail || p->str[p->pos] != ')') {
+			p->fail = true;
+			return NULL;
+		}
+		p->pos++;
+		p->depth--;
+		return node;
+	case '[':
+		p->pos++;
+		return asre_parse_bracket(p);
+	case '.':
+		p->pos++;
+		return asre_charnode(p, ASRE_SET_ALL);
+	case '^':
+	case '$':
+		p->pos++;
+		*quant = false;
+		return asre_node(p, c == '^' ? ASRE_OP_BOL : ASRE_OP_EOL, NULL,
+				 NULL);
+	case '_':
+		p->pos++;
+		magic = asre_node(p, ASRE_OP_BOL, NULL, NULL);
+		magic = asre_node(p, ASRE_OP_ALT, magic,
+				  asre_charnode(p, ASRE_SET_MAGIC));
+		return asre_node(p, ASRE_OP_ALT, magic,
+				 asre_node(p, ASRE_OP_EOL, NULL, NULL));
+	case '\\':
+		c = p->str[p->pos + 1];
+		if (c == '\0' || !strchr("^.[]$()|*+?{}\\", c)) {
+			p->fail = true;
+			return NULL;
+		}
+		p->pos += 2;
+		return asre_charnode(p, asre_char_set(c));
+	case '*':
+	case '+':
+	case '?':
+	case '{':
+	case '}':
+	case ')':
+		/* implementations disagree on what these mean here */
+		p->fail = true;
+		return NULL;
+	default:
+		p->pos++;
+		return asre_charnode(p, asre_char_set(c));
+	}
+}
+
+static bool asre_parse_int(struct asre_parse *p, int *val)
+{
+	const char *s = p->str;
+
+	if (!isdigit((unsigned char)s[p->pos]))
+		return false;
+
+	*val = 0;
+	while (isdigit((unsigned char)s[p->pos])) {
+		*val = *val * 10 + (s[p->pos++] - '0');
+		if (*val > ASRE_DUP_MAX)
+			return false;
+	}
+	return true;
+}
+
+/* {m}, {m,} and {m,n} */
+static bool asre_parse_interval(struct asre_parse *p, int *min, int *max)
+{
+	if (!asre_parse_int(p, min))
+		return false;
+
+	*max = *min;
+	if (p->str[p->pos] == ',') {
+		p->pos++;
+		*max = -1;
+		if (p->str[p->pos] != '}' && !asre_parse_int(p, max))
+			return false;
+	}
+	if (p->str[p->pos] != '}' || (*max >= 0 && *max < *min))
+		return false;
+	p->pos++;
+	return true;
+}
+
+static struct asre_node *asre_parse_piece(struct asre_parse *p)
+{
+	struct asre_node *node;
+	bool quant;
+	int min = 0, max = -1;
+
+	node = asre_parse_atom(p, &quant);
+	if (p->fail)
+		return NULL;
+
+	switch (p->str[p->pos]) {
+	case '*':
+		break;
+	case '+':
+		min = 1;
+		break;
+	case '?':
+		max = 1;
+		break;
+	case '{':
+		break;
+	default:
+		return node;
+	}
+
+	if (!quant) {
+		p->fail = true;
+		return NULL;
+	}
+
+	if (p->str[p->pos++] == '{' && !asre_parse_interval(p, &min, &max)) {
+		p->fail = true;
+		return NULL;
+	}
+
+	/* stacked repetitions */
+	if (p->str[p->pos] && strchr("*+?{", p->str[p->pos])) {
+		p->fail = true;
+		return NULL;
+	}
+
+	node = asre_node(p, ASRE_OP_REPEAT, node, NULL);
+	if (node) {
+		node->min = min;
+		node->max = max;
+	}
+	return node;
+}
+
+static struct asre_node *asre_parse_cat(struct asre_parse *p)
+{
+	struct asre_node *node = NULL, *piece;
+	char c;
+
+	while ((c = p->str[p->pos]) && c != '|' && c != ')') {
+		piece = asre_parse_piece(p);
+		if (p->fail)
+			return NULL;
+		node = node ? asre_node(p, ASRE_OP_CAT, node, piece) : piece;
+	}
+	return node ? node : asre_node(p, ASRE_OP_EMPTY, NULL, NULL);
+}
+
+static struct asre_node *asre_parse_alt(struct asre_parse *p)
+{
+	struct asre_node *node;
+
+	node = asre_parse_cat(p);
+	while (!p->fail && p->str[p->pos] == '|') {
+		p->pos++;
+		node = asre_node(p, ASRE_OP_ALT, node, asre_parse_cat(p));
+	}
+	return p->fail ? NULL : node;
+}
+
+/* Thompson NFA, built back to front from the continuation state */
+
+enum asre_nop {
+	ASRE_NFA_MATCH,
+	ASRE_NFA_CHAR,
+	ASRE_NFA_SPLIT,
+	ASRE_NFA_BOL,
+	ASRE_NFA_EOL,
+};
+
+struct asre_nstate {
+	enum asre_nop op;
+	asre_set_t set;
+	int out, out1;
+};
+
+struct asre_nfa {
+	struct asre_nstate s[ASRE_NFA_MAX];
+	int n;
+	bool fail;
+};
+
+static int asre_nstate(struct asre_nfa *nfa, enum asre_nop op, asre_set_t set,
+		       int out, int out1)
+{
+	if (nfa->n == ASRE_NFA_MAX) {
+		nfa->fail = true;
+		return 0;
+	}
+	nfa->s[nfa->n].op = op;
+	nfa->s[nfa->n].set = set;
+	nfa->s[nfa->n].out = out;
+	nfa->s[nfa->n].out1 = out1;
+	return nfa->n++;
+}
+
+static int asre_nfa_build(struct asre_nfa *nfa, const struct asre_node *node,
+			  int next)
+{
+	int i, loop;
+
+	if (nfa->fail)
+		return 0;
+
+	switch (node->op) {
+	case ASRE_OP_EMPTY:
+		return next;
+	case ASRE_OP_CHAR:
+		return asre_nstate(nfa, ASRE_NFA_CHAR, node->set, next, -1);
+	case ASRE_OP_BOL:
+		return asre_nstate(nfa, ASRE_NFA_BOL, 0, next, -1);
+	case ASRE_OP_EOL:
+		return asre_nstate(nfa, ASRE_NFA_EOL, 0, next, -1);
+	case ASRE_OP_CAT:
+		return asre_nfa_build(nfa, node->a,
+				      asre_nfa_build(nfa, node->b, next));
+	case ASRE_OP_ALT:
+		return asre_nstate(nfa, ASRE_NFA_SPLIT, 0,
+				   asre_nfa_build(nfa, node->a, next),
+				   asre_nfa_build(nfa, node->b, next));
+	case ASRE_OP_REPEAT:
+		if (node->max < 0) {
+			loop = asre_nstate(nfa, ASRE_NFA_SPLIT, 0, -1, next);
+			if (nfa->fail)
+				return 0;
+			nfa->s[loop].out = asre_nfa_build(nfa, node->a, loop);
+			next = loop;
+		} else {
+			for (i = node->min; i < node->max; i++)
+				next = asre_nstate(
+					nfa, ASRE_NFA_SPLIT, 0,
+					asre_nfa_build(nfa, node->a, next),
+					next);
+		}
+		for (i = 0; i < node->min; i++)
+			next = asre_nfa_build(nfa, node->a, next);
+		return next;
+	}
+	return next;
+}
+
+/* subset construction */
+
+#define ASRE_WORDS ((ASRE_NFA_MAX + 63) / 64)
+#define ASRE_HASH_SLOTS (2 * ASRE_DFA_MAX)
+
+struct asre_dfa_build {
+	const struct asre_nfa *nfa;
+	size_t nwords;
+
+	uint64_t *sets;
+	unsigned int nstates;
+	int hash[ASRE_HASH_SLOTS];
+
+	struct bgp_asregex *re;
+};
+
+#define ASRE_SET_HAS(set, i) ((set)[(i) / 64] & (1ULL << ((i) % 64)))
+#define ASRE_SET_ADD(set, i) ((set)[(i) / 64] |= 1ULL << ((i) % 64))
+
+/* add everything reachable without consuming input;  `^' and `$' are only
+ * passed at the start and end of the input respectively
+ */
+static void asre_closure(const struct asre_nfa *nfa, uint64_t *set, bool bol,
+			 bool eol)
+{
+	int stack[2 * ASRE_NFA_MAX], sp = 0, i;
+	const struct asre_nstate *ns;
+
+	for (i = 0; i < nfa->n; i++)
+		if (ASRE_SET_HAS(set, i))
+			stack[sp++] = i;
+
+	while (sp) {
+		ns = &nfa->s[stack[--sp]];
+
+		switch (ns->op) {
+		case ASRE_NFA_MATCH:
+		case ASRE_NFA_CHAR:
+			continue;
+		case ASRE_NFA_BOL:
+			if (!bol)
+				continue;
+			break;
+		case ASRE_NFA_EOL:
+			if (!eol)
+				continue;
+			break;
+		case ASRE_NFA_SPLIT:
+			if (!ASRE_SET_HAS(set, ns->out1)) {
+				ASRE_SET_ADD(set, ns->out1);
+				stack[sp++] = ns->out1;
+			}
+			break;
+		}
+		if (!ASRE_SET_HAS(set, ns->out)) {
+			ASRE_SET_ADD(set, ns->out);
+			stack[sp++] = ns->out;
+		}
+	}
+}
+
+/* the match state is always NFA state 0 */
+#define ASRE_SET_MATCH(set) ((set)[0] & 1)
+
+/* returns the DFA state for the closed set, adding it if new;  -1 if there
+ * are too many states
+ */
+static int asre_dfa_state(struct asre_dfa_build *b, const uint64_t *set,
+			  bool bol)
+{
+	const struct asre_nfa *nfa = b->nfa;
+	struct bgp_asregex *re = b->re;
+	uint64_t eolset[ASRE_WORDS];
+	uint32_t key;
+	unsigned int slot, st;
+	int idx;
+
+	key = jhash(set, b->nwords * sizeof(uint64_t), 0);
+	slot = key % ASRE_HASH_SLOTS;
+
+	/* the start state is never shared, only it may pass `^' */
+	while (!bol && (idx = b->hash[slot]) >= 0) {
+		if (!memcmp(&b->sets[idx * b->nwords], set,
+			    b->nwords * sizeof(uint64_t)))
+			return idx;
+		slot = (slot + 1) % ASRE_HASH_SLOTS;
+	}
+
+	if (b->nstates == ASRE_DFA_MAX)
+		return -1;
+
+	st = b->nstates++;
+	memcpy(&b->sets[st * b->nwords], set, b->nwords * sizeof(uint64_t));
+	if (!bol)
+		b->hash[slot] = st;
+
+	re->flags[st] = 0;
+	if (ASRE_SET_MATCH(set))
+		re->flags[st] |= ASRE_ACCEPT;
+
+	memcpy(eolset, set, b->nwords * sizeof(uint64_t));
+	asre_closure(nfa, eolset, bol, true);
+	if (ASRE_SET_MATCH(eolset))
+		re->flags[st] |= ASRE_ACCEPT_EOL;
+
+	return st;
+}
+
+static bool asre_dfa_build(struct bgp_asregex *re, const struct asre_nfa *nfa,
+			   int start)
+{
+	struct asre_dfa_build b = {};
+	uint64_t set[ASRE_WORDS];
+	const struct asre_nstate *ns;
+	unsigned int st, sym;
+	int i, next;
+	bool ok = true;
+
+	b.nfa = nfa;
+	b.re = re;
+	b.nwords = (nfa->n + 63) / 64;
+	b.sets = XCALLOC(MTYPE_TMP,
+			 ASRE_DFA_MAX * b.nwords * sizeof(uint64_t));
+	memset(b.hash, 0xff, sizeof(b.hash));
+
+	re->trans = XCALLOC(MTYPE_BGP_REGEXP,
+			    ASRE_DFA_MAX * ASRE_NSYM * sizeof(re->trans[0]));
+	re->flags = XCALLOC(MTYPE_BGP_REGEXP, ASRE_DFA_MAX);
+
+	memset(set, 0, sizeof(set));
+	ASRE_SET_ADD(set, start);
+	asre_closure(nfa, set, true, false);
+	asre_dfa_state(&b, set, true);
+
+	/* the search is unanchored, so every step also restarts the
+	 * expression from its start state
+	 */
+	for (st = 0; ok && st < b.nstates; st++) {
+		for (sym = 0; sym < ASRE_NSYM; sym++) {
+			if (re->flags[st] & ASRE_ACCEPT) {
+				re->trans[st * ASRE_NSYM + sym] = st;
+				continue;
+			}
+
+			memset(set, 0, sizeof(set));
+			ASRE_SET_ADD(set, start);
+			for (i = 0; i < nfa->n; i++) {
+				if (!ASRE_SET_HAS(&b.sets[st * b.nwords], i))
+					continue;
+				ns = &nfa->s[i];
+				if (ns->op == ASRE_NFA_CHAR
+				    && (ns->set & (1U << sym)))
+					ASRE_SET_ADD(set, ns->out);
+			}
+			asre_closure(nfa, set, false, false);
+
+			next = asre_dfa_state(&b, set, false);
+			if (next < 0) {
+				ok = false;
+				break;
+			}
+			re->trans[st * ASRE_NSYM + sym] = next;
+		}
+	}
+	re->nstates = b.nstates;
+	re->trans = XREALLOC(MTYPE_BGP_REGEXP, re->trans,
+			     re->nstates * ASRE_NSYM * sizeof(re->trans[0]));
+	re->flags = XREALLOC(MTYPE_BGP_REGEXP, re->flags, re->nstates);
+
+	XFREE(MTYPE_TMP, b.sets);
+	return ok;
+}
+
+static bool asre_compile(struct bgp_asregex *re, const char *regstr)
+{
+	struct asre_parse p = {};
+	struct asre_nfa *nfa;
+	struct asre_node *root;
+	int start;
+	bool ok = false;
+
+	p.str = regstr;
+	p.maxnodes = 8 * strlen(regstr) + 8;
+	p.nodes = XCALLOC(MTYPE_TMP, p.maxnodes * sizeof(p.nodes[0]));
+
+	root = asre_parse_alt(&p);
+	if (p.fail || !root || p.str[p.pos] != '\0')
+		goto out_parse;
+
+	nfa = XCALLOC(MTYPE_TMP, sizeof(*nfa));
+	asre_nstate(nfa, ASRE_NFA_MATCH, 0, -1, -1);
+	start = asre_nfa_build(nfa, root, 0);
+	if (!nfa->fail)
+		ok = asre_dfa_build(re, nfa, start);
+	XFREE(MTYPE_TMP, nfa);
+
+out_parse:
+	XFREE(MTYPE_TMP, p.nodes);
+	return ok;
+}
+
+struct bgp_asregex *bgp_asregcomp(const char *regstr)
+{
+	struct bgp_asregex *re;
+	regex_t *posix;
+
+	/* whatever regcomp() refuses stays an error */
+	posix = bgp_regcomp(regstr);
+	if (!posix)
+		return NULL;
+
+	re = XCALLOC(MTYPE_BGP_REGEXP, sizeof(*re));
+	if (asre_compile(re, regstr)) {
+		bgp_regex_free(posix);
+		return re;
+	}
+
+	XFREE(MTYPE_BGP_REGEXP, re->trans);
+	XFREE(MTYPE_BGP_REGEXP, re->flags);
+	re->nstates = 0;
+	re->posix = posix;
+	return re;
+}
+
+/* advance by one symbol, true once the expression has matched */
+static inline bool asre_step(const struct bgp_asregex *re, unsigned int *st,
+			     unsigned int sym)
+{
+	*st = re->trans[*st * ASRE_NSYM + sym];
+	return re->flags[*st] & ASRE_ACCEPT;
+}
+
+static bool asre_step_asn(const struct bgp_asregex *re, unsigned int *st,
+			  as_t asn)
+{
+	uint8_t digits[10];
+	int n = 0;
+
+	do {
+		digits[n++] = asn % 10;
+		asn /= 10;
+	} while (asn);
+
+	while (n--)
+		if (asre_step(re, st, digits[n]))
+			return true;
+	return false;
+}
+
+bool bgp_asregexec(const struct bgp_asregex *re, const struct aspath *aspath)
+{
+	const struct assegment *seg;
+	unsigned int st = 0, start, end, sep;
+	int i;
+
+	if (re->posix)
+		return aspath->str
+		       && regexec(re->posix, aspath->str, 0, NULL, 0)
+				  != REG_NOMATCH;
+
+	if (re->flags[st] & ASRE_ACCEPT)
+		return true;
+
+	/* same layout as aspath_make_str_count() */
+	for (seg = aspath->segments; seg; seg = seg->next) {
+		switch (seg->type) {
+		case AS_SEQUENCE:
+			start = end = ASRE_NSYM;
+			sep = ASRE_SYM_SPACE;
+			break;
+		case AS_SET:
+			start = ASRE_SYM_SET_START;
+			end = ASRE_SYM_SET_END;
+			sep = ASRE_SYM_COMMA;
+			break;
+		case AS_CONFED_SEQUENCE:
+			start = ASRE_SYM_CONFED_START;
+			end = ASRE_SYM_CONFED_END;
+			sep = ASRE_SYM_SPACE;
+			break;
+		case AS_CONFED_SET:
+			start = ASRE_SYM_CONFSET_START;
+			end = ASRE_SYM_CONFSET_END;
+			sep = ASRE_SYM_COMMA;
+			break;
+		default:
+			/* no string form either */
+			return false;
+		}
+
+		if (start != ASRE_NSYM && asre_step(re, &st, start))
+			return true;
+		for (i = 0; i < seg->length; i++) {
+			if (asre_step_asn(re, &st, seg->as[i]))
+				return true;
+			if (i < seg->length - 1 && asre_step(re, &st, sep))
+				return true;
+		}
+		if (end != ASRE_NSYM && asre_step(re, &st, end))
+			return true;
+		if (seg->next && asre_step(re, &st, ASRE_SYM_SPACE))
+			return true;
+	}
+
+	return re->flags[st] & ASRE_ACCEPT_EOL;
+}
+
+void bgp_asregex_free(struct bgp_asregex *re)
+{
+	if (re->posix)
+		bgp_regex_free(re->posix);
+	XFREE(MTYPE_BGP_REGEXP, re->trans);
+	XFREE(MTYPE_BGP_REGEXP, re->flags);
+	XFREE(MTYPE_BGP_REGEXP, re);
+}
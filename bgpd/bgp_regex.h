@@ -33,4 +33,12 @@ extern void bgp_regex_free(regex_t *regex);
 extern regex_t *bgp_regcomp(const char *str);
 extern int bgp_regexec(regex_t *regex, struct aspath *aspath);
 
+/* AS path expressions compiled for matching on the segments directly */
+struct bgp_asregex;
+
+extern struct bgp_asregex *bgp_asregcomp(const char *regstr);
+extern bool bgp_asregexec(const struct bgp_asregex *re,
+			  const struct aspath *aspath);
+extern void bgp_asregex_free(struct bgp_asregex *re);
+
 #endif /* _QUAGGA_BGP_REGEX_H */
@@ -84,6 +84,7 @@
 #include "bgpd/bgp_flowspec.h"
 #include "bgpd/bgp_flowspec_util.h"
 #include "bgpd/bgp_pbr.h"
+#include "bgpd/bgp_bestpath_workers.h"
 
 #ifndef VTYSH_EXTRACT_PL
 #include "bgpd/bgp_route_clippy.c"
@@ -395,6 +396,9 @@ void bgp_path_info_add(struct bgp_dest *dest, struct bgp_path_info *pi)
    completion callback *only* */
 void bgp_path_info_reap(struct bgp_dest *dest, struct bgp_path_info *pi)
 {
+	if (CHECK_FLAG(dest->flags, BGP_NODE_SELECT_PRECOMPUTED))
+		SET_FLAG(dest->flags, BGP_NODE_SELECT_STALE);
+
 	if (pi->next)
 		pi->next->prev = pi->prev;
 	if (pi->prev)
@@ -2176,10 +2180,20 @@ static int bgp_route_select_timer_expire(struct thread *thread)
 	return bgp_best_path_select_defer(bgp, afi, safi);
 }
 
-void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
-			struct bgp_maxpaths_cfg *mpath_cfg,
-			struct bgp_path_info_pair *result, afi_t afi,
-			safi_t safi)
+/*
+ * Path comparison stage of best path selection.
+ *
+ * Only the paths hanging off dest (and dest itself) are modified, so this
+ * may run for distinct dests concurrently on the best-path worker pthreads
+ * while the main pthread waits.  When reap is false, REMOVED paths in
+ * holddown are left in place and must be reaped by the caller before
+ * bgp_best_selection_finish().
+ */
+void bgp_best_selection_compute(struct bgp *bgp, struct bgp_dest *dest,
+				struct bgp_maxpaths_cfg *mpath_cfg,
+				struct bgp_path_info_pair *result,
+				struct list *mp_list, bool reap, afi_t afi,
+				safi_t safi)
 {
 	struct bgp_path_info *new_select;
 	struct bgp_path_info *old_select;
@@ -2188,11 +2202,9 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
 	struct bgp_path_info *pi2;
 	struct bgp_path_info *nextpi = NULL;
 	int paths_eq, do_mpath, debug;
-	struct list mp_list;
 	char pfx_buf[PREFIX2STR_BUFFER];
 	char path_buf[PATH_ADDPATH_STR_BUFFER];
 
-	bgp_mp_list_init(&mp_list);
 	do_mpath =
 		(mpath_cfg->maxpaths_ebgp > 1 || mpath_cfg->maxpaths_ibgp > 1);
 
@@ -2290,7 +2302,7 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
 			/* reap REMOVED routes, if needs be
 			 * selected route must stay for a while longer though
 			 */
-			if (CHECK_FLAG(pi->flags, BGP_PATH_REMOVED)
+			if (reap && CHECK_FLAG(pi->flags, BGP_PATH_REMOVED)
 			    && (pi != old_select))
 				bgp_path_info_reap(dest, pi);
 
@@ -2363,7 +2375,7 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
 					zlog_debug(
 						"%s: %s is the bestpath, add to the multipath list",
 						pfx_buf, path_buf);
-				bgp_mp_list_add(&mp_list, pi);
+				bgp_mp_list_add(mp_list, pi);
 				continue;
 			}
 
@@ -2393,22 +2405,44 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
 					zlog_debug(
 						"%s: %s is equivalent to the bestpath, add to the multipath list",
 						pfx_buf, path_buf);
-				bgp_mp_list_add(&mp_list, pi);
+				bgp_mp_list_add(mp_list, pi);
 			}
 		}
 	}
 
-	bgp_path_info_mpath_update(dest, new_select, old_select, &mp_list,
+	result->old = old_select;
+	result->new = new_select;
+}
+
+/*
+ * Second stage of best path selection: multipath and addpath bookkeeping.
+ * This touches state shared between dests and must run on the main pthread.
+ */
+void bgp_best_selection_finish(struct bgp *bgp, struct bgp_dest *dest,
+			       struct bgp_maxpaths_cfg *mpath_cfg,
+			       struct bgp_path_info_pair *result,
+			       struct list *mp_list, afi_t afi, safi_t safi)
+{
+	bgp_path_info_mpath_update(dest, result->new, result->old, mp_list,
 				   mpath_cfg);
-	bgp_path_info_mpath_aggregate_update(new_select, old_select);
-	bgp_mp_list_clear(&mp_list);
+	bgp_path_info_mpath_aggregate_update(result->new, result->old);
+	bgp_mp_list_clear(mp_list);
 
 	bgp_addpath_update_ids(bgp, dest, afi, safi);
+}
 
-	result->old = old_select;
-	result->new = new_select;
+void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
+			struct bgp_maxpaths_cfg *mpath_cfg,
+			struct bgp_path_info_pair *result, afi_t afi,
+			safi_t safi)
+{
+	struct list mp_list;
 
-	return;
+	bgp_mp_list_init(&mp_list);
+	bgp_best_selection_compute(bgp, dest, mpath_cfg, result, &mp_list,
+				   true, afi, safi);
+	bgp_best_selection_finish(bgp, dest, mpath_cfg, result, &mp_list, afi,
+				  safi);
 }
 
 /*
@@ -2589,7 +2623,8 @@ static void bgp_process_evpn_route_injection(struct bgp *bgp, afi_t afi,
  *     is being removed.
  */
 static void bgp_process_main_one(struct bgp *bgp, struct bgp_dest *dest,
-				 afi_t afi, safi_t safi)
+				 afi_t afi, safi_t safi,
+				 struct bgp_bestpath_job *job)
 {
 	struct bgp_path_info *new_select;
 	struct bgp_path_info *old_select;
@@ -2637,9 +2672,39 @@ static void bgp_process_main_one(struct bgp *bgp, struct bgp_dest *dest,
 		return;
 	}
 
-	/* Best path selection. */
-	bgp_best_selection(bgp, dest, &bgp->maxpaths[afi][safi], &old_and_new,
-			   afi, safi);
+	/* Best path selection.  If the path comparison was already done on a
+	 * best-path worker pthread and nothing touched the dest since, only
+	 * the main pthread part of the selection is left to do.
+	 */
+	if (job && CHECK_FLAG(dest->flags, BGP_NODE_SELECT_PRECOMPUTED)
+	    && !CHECK_FLAG(dest->flags, BGP_NODE_SELECT_STALE)) {
+		struct bgp_path_info *pi, *nextpi;
+
+		UNSET_FLAG(dest->flags, BGP_NODE_SELECT_PRECOMPUTED);
+		old_and_new = job->result;
+
+		/* reap REMOVED routes skipped by the worker */
+		for (pi = bgp_dest_get_bgp_path_info(dest);
+		     (pi != NULL) && (nextpi = pi->next, 1); pi = nextpi)
+			if (BGP_PATH_HOLDDOWN(pi)
+			    && CHECK_FLAG(pi->flags, BGP_PATH_REMOVED)
+			    && pi != old_and_new.old)
+				bgp_path_info_reap(dest, pi);
+
+		bgp_best_selection_finish(bgp, dest, &bgp->maxpaths[afi][safi],
+					  &old_and_new, &job->mp_list, afi,
+					  safi);
+		bgp_dest_table(dest)->bestpath_offloaded++;
+	} else {
+		if (job && CHECK_FLAG(dest->flags, BGP_NODE_SELECT_STALE)) {
+			bgp_mp_list_clear(&job->mp_list);
+			bgp_dest_table(dest)->bestpath_reselected++;
+		}
+		UNSET_FLAG(dest->flags, BGP_NODE_SELECT_PRECOMPUTED
+						| BGP_NODE_SELECT_STALE);
+		bgp_best_selection(bgp, dest, &bgp->maxpaths[afi][safi],
+				   &old_and_new, afi, safi);
+	}
 	old_select = old_and_new.old;
 	new_select = old_and_new.new;
 
@@ -2870,7 +2935,7 @@ int bgp_best_path_select_defer(struct bgp *bgp, afi_t afi, safi_t safi)
 
 		if (CHECK_FLAG(dest->flags, BGP_NODE_SELECT_DEFER)) {
 			UNSET_FLAG(dest->flags, BGP_NODE_SELECT_DEFER);
-			bgp_process_main_one(bgp, dest, afi, safi);
+			bgp_process_main_one(bgp, dest, afi, safi, NULL);
 			cnt++;
 			if (cnt >= BGP_MAX_BEST_ROUTE_SELECT)
 				break;
@@ -2902,6 +2967,67 @@ int bgp_best_path_select_defer(struct bgp *bgp, afi_t afi, safi_t safi)
 	return 0;
 }
 
+/*
+ * Work queue item processing with the best-path worker pthreads.
+ *
+ * Dests are pulled off the queue in batches.  The path comparison for the
+ * whole batch is run on the workers while the main pthread waits, then the
+ * rest of the processing (zebra, update-groups, leaking, ...) is done here,
+ * in queue order.  Anything that touches a dest of the batch in between
+ * marks it stale, in which case the selection is simply redone inline.
+ */
+static wq_item_status bgp_process_wq_batch(struct bgp_process_queue *pqnode)
+{
+	struct bgp *bgp = pqnode->bgp;
+	struct bgp_bestpath_job *jobs;
+	struct bgp_table *table;
+	struct bgp_dest *dest;
+	unsigned int i, count;
+
+	jobs = XCALLOC(MTYPE_BGP_BESTPATH_JOB,
+		       sizeof(*jobs) * BGP_BESTPATH_WORKERS_BATCH);
+
+	while (!STAILQ_EMPTY(&pqnode->pqueue)) {
+		count = 0;
+		while (count < BGP_BESTPATH_WORKERS_BATCH
+		       && !STAILQ_EMPTY(&pqnode->pqueue)) {
+			dest = STAILQ_FIRST(&pqnode->pqueue);
+			STAILQ_REMOVE_HEAD(&pqnode->pqueue, pq);
+			STAILQ_NEXT(dest, pq) = NULL; /* complete unlink */
+
+			jobs[count].dest = dest;
+			bgp_mp_list_init(&jobs[count].mp_list);
+			if (!CHECK_FLAG(dest->flags, BGP_NODE_SELECT_DEFER)
+			    && !CHECK_FLAG(bgp->flags,
+					   BGP_FLAG_DELETE_IN_PROGRESS))
+				SET_FLAG(dest->flags,
+					 BGP_NODE_SELECT_PRECOMPUTED);
+			count++;
+		}
+
+		bgp_bestpath_workers_run(bgp, jobs, count);
+
+		for (i = 0; i < count; i++) {
+			dest = jobs[i].dest;
+			table = bgp_dest_table(dest);
+			/* note, new DESTs may be added as part of processing */
+			bgp_process_main_one(bgp, dest, table->afi,
+					     table->safi, &jobs[i]);
+
+			/* early returns above leave the result unused */
+			UNSET_FLAG(dest->flags, BGP_NODE_SELECT_PRECOMPUTED
+							| BGP_NODE_SELECT_STALE);
+			bgp_mp_list_clear(&jobs[i].mp_list);
+
+			bgp_dest_unlock_node(dest);
+			bgp_table_unlock(table);
+		}
+	}
+
+	XFREE(MTYPE_BGP_BESTPATH_JOB, jobs);
+	return WQ_SUCCESS;
+}
+
 static wq_item_status bgp_process_wq(struct work_queue *wq, void *data)
 {
 	struct bgp_process_queue *pqnode = data;
@@ -2911,19 +3037,23 @@ static wq_item_status bgp_process_wq(struct work_queue *wq, void *data)
 
 	/* eoiu marker */
 	if (CHECK_FLAG(pqnode->flags, BGP_PROCESS_QUEUE_EOIU_MARKER)) {
-		bgp_process_main_one(bgp, NULL, 0, 0);
+		bgp_process_main_one(bgp, NULL, 0, 0, NULL);
 		/* should always have dedicated wq call */
 		assert(STAILQ_FIRST(&pqnode->pqueue) == NULL);
 		return WQ_SUCCESS;
 	}
 
+	if (bgp_bestpath_workers_count()
+	    && pqnode->queued >= BGP_BESTPATH_WORKERS_MIN_BATCH)
+		return bgp_process_wq_batch(pqnode);
+
 	while (!STAILQ_EMPTY(&pqnode->pqueue)) {
 		dest = STAILQ_FIRST(&pqnode->pqueue);
 		STAILQ_REMOVE_HEAD(&pqnode->pqueue, pq);
 		STAILQ_NEXT(dest, pq) = NULL; /* complete unlink */
 		table = bgp_dest_table(dest);
 		/* note, new DESTs may be added as part of processing */
-		bgp_process_main_one(bgp, dest, table->afi, table->safi);
+		bgp_process_main_one(bgp, dest, table->afi, table->safi, NULL);
 
 		bgp_dest_unlock_node(dest);
 		bgp_table_unlock(table);
@@ -2977,8 +3107,12 @@ void bgp_process(struct bgp *bgp, struct bgp_dest *dest, afi_t afi, safi_t safi)
 	int pqnode_reuse = 0;
 
 	/* already scheduled for processing? */
-	if (CHECK_FLAG(dest->flags, BGP_NODE_PROCESS_SCHEDULED))
+	if (CHECK_FLAG(dest->flags, BGP_NODE_PROCESS_SCHEDULED)) {
+		/* invalidate a best path selected ahead of time by a worker */
+		if (CHECK_FLAG(dest->flags, BGP_NODE_SELECT_PRECOMPUTED))
+			SET_FLAG(dest->flags, BGP_NODE_SELECT_STALE);
 		return;
+	}
 
 	/* If the flag BGP_NODE_SELECT_DEFER is set, do not add route to
 	 * the workqueue
@@ -12052,6 +12186,23 @@ static int bgp_table_stats_single(struct vty *vty, struct bgp *bgp, afi_t afi,
 		if (!json)
 			vty_out(vty, "\n");
 	}
+
+	/* best path selection offloaded to the worker pthreads */
+	if (!json) {
+		vty_out(vty, "%-30s: %12u\n", "Best-path workers",
+			bgp_bestpath_workers_count());
+		vty_out(vty, "%-30s: %12" PRIu64 "\n", "Best-path offloaded",
+			ts.table->bestpath_offloaded);
+		vty_out(vty, "%-30s: %12" PRIu64 "\n", "Best-path reselected",
+			ts.table->bestpath_reselected);
+	} else {
+		json_object_int_add(json, "bestpathWorkers",
+				    bgp_bestpath_workers_count());
+		json_object_int_add(json, "bestpathOffloaded",
+				    ts.table->bestpath_offloaded);
+		json_object_int_add(json, "bestpathReselected",
+				    ts.table->bestpath_reselected);
+	}
 end_table_stats:
 	if (json)
 		json_object_array_add(json_array, json);
@@ -12464,7 +12615,7 @@ static void show_adj_route(struct vty *vty, struct peer *peer, afi_t afi,
 	json_object *json_scode = NULL;
 	json_object *json_ocode = NULL;
 	json_object *json_ar = NULL;
-	struct peer_af *paf;
+	uint32_t iter;
 	bool route_filtered;
 	bool use_json = CHECK_FLAG(show_flags, BGP_SHOW_OPT_JSON);
 	bool wide = CHECK_FLAG(show_flags, BGP_SHOW_OPT_WIDE);
@@ -12593,37 +12744,36 @@ static void show_adj_route(struct vty *vty, struct peer *peer, afi_t afi,
 				bgp_attr_undup(&attr, ain->attr);
 				output_count++;
 			}
-		} else if (type == bgp_show_adj_route_advertised) {
-			RB_FOREACH (adj, bgp_adj_out_rb, &dest->adj_out)
-				SUBGRP_FOREACH_PEER (adj->subgroup, paf) {
-					if (paf->peer != peer || !adj->attr)
-						continue;
+		} else if (type == bgp_show_adj_route_advertised && subgrp) {
+			SUBGRP_FOREACH_DEST_ADJ (subgrp, dest, adj, iter) {
+				if (!adj->attr)
+					continue;
 
-					show_adj_route_header(
-						vty, bgp, table, &header1,
-						&header2, json, json_scode,
-						json_ocode, wide);
-
-					const struct prefix *rn_p =
-						bgp_dest_get_prefix(dest);
-
-					attr = *adj->attr;
-					ret = bgp_output_modifier(
-						peer, rn_p, &attr, afi, safi,
-						rmap_name);
-
-					if (ret != RMAP_DENY) {
-						route_vty_out_tmp(
-							vty, rn_p, &attr, safi,
-							use_json, json_ar,
-							wide);
-						output_count++;
-					} else {
-						filtered_count++;
-					}
+				show_adj_route_header(
+					vty, bgp, table, &header1,
+					&header2, json, json_scode,
+					json_ocode, wide);
+
+				const struct prefix *rn_p =
+					bgp_dest_get_prefix(dest);
 
-					bgp_attr_undup(&attr, adj->attr);
+				attr = *adj->attr;
+				ret = bgp_output_modifier(
+					peer, rn_p, &attr, afi, safi,
+					rmap_name);
+
+				if (ret != RMAP_DENY) {
+					route_vty_out_tmp(
+						vty, rn_p, &attr, safi,
+						use_json, json_ar,
+						wide);
+					output_count++;
+				} else {
+					filtered_count++;
 				}
+
+				bgp_attr_undup(&attr, adj->attr);
+			}
 		} else if (type == bgp_show_adj_route_bestpath) {
 			struct bgp_path_info *pi;
 
@@ -270,6 +270,13 @@ struct bgp_path_info_pair {
 	struct bgp_path_info *new;
 };
 
+/* Best path selection handed to a best-path worker pthread */
+struct bgp_bestpath_job {
+	struct bgp_dest *dest;
+	struct bgp_path_info_pair result;
+	struct list mp_list;
+};
+
 /* BGP static route configuration. */
 struct bgp_static {
 	/* Backdoor configuration.  */
@@ -689,6 +696,16 @@ extern void bgp_best_selection(struct bgp *bgp, struct bgp_dest *dest,
 			       struct bgp_maxpaths_cfg *mpath_cfg,
 			       struct bgp_path_info_pair *result, afi_t afi,
 			       safi_t safi);
+extern void bgp_best_selection_compute(struct bgp *bgp, struct bgp_dest *dest,
+				       struct bgp_maxpaths_cfg *mpath_cfg,
+				       struct bgp_path_info_pair *result,
+				       struct list *mp_list, bool reap,
+				       afi_t afi, safi_t safi);
+extern void bgp_best_selection_finish(struct bgp *bgp, struct bgp_dest *dest,
+				      struct bgp_maxpaths_cfg *mpath_cfg,
+				      struct bgp_path_info_pair *result,
+				      struct list *mp_list, afi_t afi,
+				      safi_t safi);
 extern void bgp_zebra_clear_route_change_flags(struct bgp_dest *dest);
 extern bool bgp_zebra_has_route_changed(struct bgp_path_info *selected);
 
@@ -37,6 +37,7 @@
 #include "buffer.h"
 #include "sockunion.h"
 #include "hash.h"
+#include "jhash.h"
 #include "queue.h"
 #include "frrstr.h"
 #include "network.h"
@@ -1181,7 +1182,8 @@ static const struct route_map_rule_cmd route_match_local_pref_cmd = {
 	"local-preference",
 	route_match_local_pref,
 	route_match_local_pref_compile,
-	route_match_local_pref_free
+	route_match_local_pref_free,
+	.memo = true
 };
 
 /* `match metric METRIC' */
@@ -1208,6 +1210,7 @@ static const struct route_map_rule_cmd route_match_metric_cmd = {
 	route_match_metric,
 	route_value_compile,
 	route_value_free,
+	.memo = true
 };
 
 /* `match as-path ASPATH' */
@@ -1254,7 +1257,8 @@ static const struct route_map_rule_cmd route_match_aspath_cmd = {
 	"as-path",
 	route_match_aspath,
 	route_match_aspath_compile,
-	route_match_aspath_free
+	route_match_aspath_free,
+	.memo = true
 };
 
 /* `match community COMMUNIY' */
@@ -1350,7 +1354,8 @@ static const struct route_map_rule_cmd route_match_community_cmd = {
 	route_match_community,
 	route_match_community_compile,
 	route_match_community_free,
-	route_match_get_community_key
+	route_match_get_community_key,
+	.memo = true
 };
 
 /* Match function for lcommunity match. */
@@ -1425,7 +1430,8 @@ static const struct route_map_rule_cmd route_match_lcommunity_cmd = {
 	route_match_lcommunity,
 	route_match_lcommunity_compile,
 	route_match_lcommunity_free,
-	route_match_get_community_key
+	route_match_get_community_key,
+	.memo = true
 };
 
 
@@ -1479,7 +1485,8 @@ static const struct route_map_rule_cmd route_match_ecommunity_cmd = {
 	"extcommunity",
 	route_match_ecommunity,
 	route_match_ecommunity_compile,
-	route_match_ecommunity_free
+	route_match_ecommunity_free,
+	.memo = true
 };
 
 /* `match nlri` and `set nlri` are replaced by `address-family ipv4`
@@ -1531,7 +1538,8 @@ static const struct route_map_rule_cmd route_match_origin_cmd = {
 	"origin",
 	route_match_origin,
 	route_match_origin_compile,
-	route_match_origin_free
+	route_match_origin_free,
+	.memo = true
 };
 
 /* match probability  { */
@@ -5684,9 +5692,114 @@ DEFUN (no_set_originator_id,
 
 
 /* Initialization of route map. */
+/*
+ * What the memo match rules above (as-path, community, large-community,
+ * extcommunity, metric, origin and local-preference) look at.  The interned
+ * parts are referenced so their addresses can't be reused while cached.
+ */
+struct bgp_rmap_memo_key {
+	struct aspath *aspath;
+	struct community *community;
+	struct ecommunity *ecommunity;
+	struct lcommunity *lcommunity;
+	uint32_t med;
+	uint32_t local_pref;
+	uint8_t origin;
+};
+
+static bool bgp_rmap_memo_key_set(struct bgp_rmap_memo_key *key,
+				  route_map_object_t type, void *object)
+{
+	struct bgp_path_info *path = object;
+	struct attr *attr = path->attr;
+
+	/* attributes a set clause just built aren't interned yet */
+	if (type != RMAP_BGP || (attr->aspath && !attr->aspath->refcnt)
+	    || (attr->community && !attr->community->refcnt)
+	    || (attr->ecommunity && !attr->ecommunity->refcnt)
+	    || (attr->lcommunity && !attr->lcommunity->refcnt))
+		return false;
+
+	memset(key, 0, sizeof(*key));
+	key->aspath = attr->aspath;
+	key->community = attr->community;
+	key->ecommunity = attr->ecommunity;
+	key->lcommunity = attr->lcommunity;
+	key->med = attr->med;
+	key->local_pref = attr->local_pref;
+	key->origin = attr->origin;
+	return true;
+}
+
+static bool bgp_rmap_memo_hash(route_map_object_t type, void *object,
+			       uint32_t *hash)
+{
+	struct bgp_rmap_memo_key key;
+
+	if (!bgp_rmap_memo_key_set(&key, type, object))
+		return false;
+
+	*hash = jhash(&key, sizeof(key), 0x2f1b5c3d);
+	return true;
+}
+
+static bool bgp_rmap_memo_cmp(const void *arg, route_map_object_t type,
+			      void *object)
+{
+	const struct bgp_rmap_memo_key *key = arg;
+	struct bgp_rmap_memo_key cur;
+
+	return bgp_rmap_memo_key_set(&cur, type, object)
+	       && !memcmp(key, &cur, sizeof(cur));
+}
+
+static void *bgp_rmap_memo_get(route_map_object_t type, void *object)
+{
+	struct bgp_rmap_memo_key *key;
+
+	key = XMALLOC(MTYPE_BGP_ROUTE_MAP_MEMO, sizeof(*key));
+	if (!bgp_rmap_memo_key_set(key, type, object)) {
+		XFREE(MTYPE_BGP_ROUTE_MAP_MEMO, key);
+		return NULL;
+	}
+
+	if (key->aspath)
+		key->aspath->refcnt++;
+	if (key->community)
+		key->community->refcnt++;
+	if (key->ecommunity)
+		key->ecommunity->refcnt++;
+	if (key->lcommunity)
+		key->lcommunity->refcnt++;
+	return key;
+}
+
+static void bgp_rmap_memo_put(void *arg)
+{
+	struct bgp_rmap_memo_key *key = arg;
+
+	if (key->aspath)
+		aspath_unintern(&key->aspath);
+	if (key->community)
+		community_unintern(&key->community);
+	if (key->ecommunity)
+		ecommunity_unintern(&key->ecommunity);
+	if (key->lcommunity)
+		lcommunity_unintern(&key->lcommunity);
+	XFREE(MTYPE_BGP_ROUTE_MAP_MEMO, key);
+}
+
+static const struct route_map_memo_ops bgp_rmap_memo_ops = {
+	.hash = bgp_rmap_memo_hash,
+	.cmp = bgp_rmap_memo_cmp,
+	.get = bgp_rmap_memo_get,
+	.put = bgp_rmap_memo_put,
+};
+
 void bgp_route_map_init(void)
 {
 	route_map_init();
+	route_map_memo_register(&bgp_rmap_memo_ops);
 
 	route_map_add_hook(bgp_route_map_add);
 	route_map_delete_hook(bgp_route_map_delete);
@@ -59,6 +59,14 @@ void bgp_table_finish(struct bgp_table **rt)
 	}
 }
 
+/* Number of nodes in all BGP tables, for "show bgp memory" */
+static _Atomic unsigned long bgp_node_count;
+
+unsigned long bgp_table_node_count(void)
+{
+	return atomic_load_explicit(&bgp_node_count, memory_order_relaxed);
+}
+
 /*
  * bgp_node_create
  */
@@ -66,9 +74,9 @@ static struct route_node *bgp_node_create(route_table_delegate_t *delegate,
 					  struct route_table *table)
 {
 	struct bgp_node *node;
-	node = XCALLOC(MTYPE_BGP_NODE, sizeof(struct bgp_node));
+	node = route_table_node_alloc(table, sizeof(struct bgp_node));
+	atomic_fetch_add_explicit(&bgp_node_count, 1, memory_order_relaxed);
 
-	RB_INIT(bgp_adj_out_rb, &node->adj_out);
 	return bgp_dest_to_rnode(node);
 }
 
@@ -89,7 +97,8 @@ static void bgp_node_destroy(route_table_delegate_t *delegate,
 					 rt->afi, rt->safi);
 	}
 
-	XFREE(MTYPE_BGP_NODE, bgp_node);
+	route_table_node_free(table, bgp_node);
+	atomic_fetch_sub_explicit(&bgp_node_count, 1, memory_order_relaxed);
 }
 
 /*
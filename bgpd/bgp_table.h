@@ -44,6 +44,10 @@ struct bgp_table {
 
 	struct route_table *route_table;
 	uint64_t version;
+
+	/* best-path worker pthread statistics */
+	uint64_t bestpath_offloaded;
+	uint64_t bestpath_reselected;
 };
 
 enum bgp_path_selection_reason {
@@ -84,8 +88,6 @@ struct bgp_node {
 	 */
 	ROUTE_NODE_FIELDS
 
-	struct bgp_adj_out_rb adj_out;
-
 	struct bgp_adj_in *adj_in;
 
 	struct bgp_dest *pdest;
@@ -102,6 +104,8 @@ struct bgp_node {
 #define BGP_NODE_LABEL_CHANGED          (1 << 2)
 #define BGP_NODE_REGISTERED_FOR_LABEL   (1 << 3)
 #define BGP_NODE_SELECT_DEFER           (1 << 4)
+#define BGP_NODE_SELECT_PRECOMPUTED     (1 << 5)
+#define BGP_NODE_SELECT_STALE           (1 << 6)
 	/* list node pointer */
 	struct listnode *rt_node;
 	struct bgp_addpath_node_data tx_addpath;
@@ -121,6 +125,7 @@ typedef struct bgp_table_iter_t_ {
 } bgp_table_iter_t;
 
 extern struct bgp_table *bgp_table_init(struct bgp *bgp, afi_t, safi_t);
+extern unsigned long bgp_table_node_count(void);
 extern void bgp_table_lock(struct bgp_table *);
 extern void bgp_table_unlock(struct bgp_table *);
 extern void bgp_table_finish(struct bgp_table **);
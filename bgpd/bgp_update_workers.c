@@ -0,0 +1,212 @@
+/* BGP UPDATE encoding worker pthreads.
+ * Copyright (C) 2020 FRRouting
+ *
+ * This file is part of FRRouting.
+ *
+ * FRRouting is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * FRRouting is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "frr_pthread.h"
+#include "frratomic.h"
+#include "memory.h"
+#include "thread.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_update_workers.h"
+
+struct bgp_update_job {
+	struct update_subgroup *subgrp;
+	struct bpacket_encode enc;
+};
+
+static struct bgp_update_workers {
+	/* protects pending */
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	unsigned int pending;
+
+	unsigned int count;
+	struct frr_pthread *fpt[BGP_UPDATE_WORKERS_MAX];
+
+	/* jobs of the current run, handed out one at a time */
+	struct bgp_update_job *jobs;
+	unsigned int njobs;
+	unsigned int jobs_size;
+	_Atomic unsigned int next_job;
+} buw = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* Runs on a worker pthread */
+static int bgp_update_worker(struct thread *thread)
+{
+	unsigned int i;
+
+	/* subgroups differ a lot in size, so take jobs as they come rather
+	 * than splitting the run up front
+	 */
+	while ((i = atomic_fetch_add_explicit(&buw.next_job, 1,
+					      memory_order_relaxed))
+	       < buw.njobs)
+		subgroup_update_packet_encode(buw.jobs[i].subgrp,
+					      &buw.jobs[i].enc);
+
+	frr_with_mutex(&buw.mtx) {
+		if (--buw.pending == 0)
+			pthread_cond_signal(&buw.cond);
+	}
+
+	return 0;
+}
+
+/*
+ * Whether bgp_generate_updgrp_packets() would encode the next UPDATE of a
+ * subgroup right now: one of its peers must be established, past its MRAI
+ * timer and at the end of the subgroup's packet queue.  Other subgroups are
+ * left to their own peers' write events, so advertisement pacing is the
+ * same as without workers.
+ */
+static bool bgp_update_workers_subgrp_ready(struct update_subgroup *subgrp)
+{
+	struct peer_af *paf;
+	struct peer *peer;
+
+	if (subgrp->t_coalesce)
+		return false;
+
+	SUBGRP_FOREACH_PEER (subgrp, paf) {
+		peer = PAF_PEER(paf);
+
+		if (peer->status != Established || peer->t_routeadv)
+			continue;
+		if (paf->next_pkt_to_send && paf->next_pkt_to_send->buffer)
+			continue;
+
+		return true;
+	}
+
+	return false;
+}
+
+static int bgp_update_workers_collect(struct update_group *updgrp, void *arg)
+{
+	struct update_subgroup *subgrp;
+
+	UPDGRP_FOREACH_SUBGRP (updgrp, subgrp) {
+		/* withdraws go out first, and are cheap to encode inline */
+		if (bgp_adv_fifo_count(&subgrp->sync->withdraw)
+		    || !bgp_adv_fifo_count(&subgrp->sync->update))
+			continue;
+		if (bpacket_queue_is_full(SUBGRP_INST(subgrp),
+					  SUBGRP_PKTQ(subgrp)))
+			continue;
+		if (!bgp_update_workers_subgrp_ready(subgrp))
+			continue;
+
+		if (buw.njobs == buw.jobs_size) {
+			buw.jobs_size = MAX(64, 2 * buw.jobs_size);
+			buw.jobs = XREALLOC(MTYPE_BGP_UPDATE_JOB, buw.jobs,
+					    buw.jobs_size * sizeof(*buw.jobs));
+		}
+		buw.jobs[buw.njobs++].subgrp = subgrp;
+	}
+
+	return UPDWALK_CONTINUE;
+}
+
+void bgp_update_workers_run(struct bgp *bgp)
+{
+	unsigned int i, nworkers;
+
+	if (!buw.count || bgp->main_peers_update_hold)
+		return;
+
+	buw.njobs = 0;
+	update_group_walk(bgp, bgp_update_workers_collect, NULL);
+	if (buw.njobs < 2)
+		return;
+
+	nworkers = MIN(buw.count, buw.njobs);
+	atomic_store_explicit(&buw.next_job, 0, memory_order_relaxed);
+
+	frr_with_mutex(&buw.mtx) {
+		buw.pending = nworkers;
+	}
+
+	for (i = 0; i < nworkers; i++)
+		thread_add_event(buw.fpt[i]->master, bgp_update_worker, NULL, 0,
+				 NULL);
+
+	frr_with_mutex(&buw.mtx) {
+		while (buw.pending)
+			pthread_cond_wait(&buw.cond, &buw.mtx);
+	}
+
+	for (i = 0; i < buw.njobs; i++) {
+		subgroup_update_packet_commit(buw.jobs[i].subgrp,
+					      &buw.jobs[i].enc);
+		if (buw.jobs[i].enc.packet)
+			bgp->update_group_stats.updates_offloaded++;
+	}
+	bgp->update_group_stats.update_worker_runs++;
+}
+
+void bgp_update_workers_set(unsigned int count)
+{
+	struct frr_pthread_attr attr = {
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
+	char name[32], os_name[OS_THREAD_NAMELEN];
+
+	count = MIN(count, BGP_UPDATE_WORKERS_MAX);
+
+	/* workers are idle whenever the main pthread is not in
+	 * bgp_update_workers_run(), so they can be stopped right away
+	 */
+	while (buw.count > count) {
+		buw.count--;
+		frr_pthread_stop(buw.fpt[buw.count], NULL);
+		frr_pthread_destroy(buw.fpt[buw.count]);
+		buw.fpt[buw.count] = NULL;
+	}
+
+	while (buw.count < count) {
+		snprintf(name, sizeof(name), "BGP update worker %u", buw.count);
+		snprintf(os_name, sizeof(os_name), "bgpd_upd%u", buw.count);
+
+		buw.fpt[buw.count] = frr_pthread_new(&attr, name, os_name);
+		frr_pthread_run(buw.fpt[buw.count], NULL);
+		frr_pthread_wait_running(buw.fpt[buw.count]);
+		buw.count++;
+	}
+
+	if (!buw.count) {
+		XFREE(MTYPE_BGP_UPDATE_JOB, buw.jobs);
+		buw.jobs_size = 0;
+	}
+}
+
+unsigned int bgp_update_workers_count(void)
+{
+	return buw.count;
+}
@@ -0,0 +1,54 @@
+/* BGP UPDATE encoding worker pthreads.
+ * Copyright (C) 2020 FRRouting
+ *
+ * This file is part of FRRouting.
+ *
+ * FRRouting is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * FRRouting is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _FRR_BGP_UPDATE_WORKERS_H
+#define _FRR_BGP_UPDATE_WORKERS_H
+
+#include "bgpd/bgpd.h"
+
+#define BGP_UPDATE_WORKERS_MAX 32
+
+/**
+ * Sets the number of UPDATE encoding worker pthreads.
+ *
+ * Workers are started or stopped as needed; 0 disables the workers and
+ * brings UPDATE encoding back entirely onto the main pthread.
+ */
+extern void bgp_update_workers_set(unsigned int count);
+
+/**
+ * Returns the number of running UPDATE encoding worker pthreads.
+ */
+extern unsigned int bgp_update_workers_count(void);
+
+/**
+ * Encodes the next UPDATE of every subgroup of a bgp instance that has
+ * updates but no withdraws pending, room in its packet queue, and a peer
+ * that may send packets now (established, past its MRAI timer and out of
+ * packets to send), with no coalesce timer running.
+ *
+ * The subgroups are encoded in parallel on the workers while the main
+ * pthread waits, then the packets are queued on the main pthread.  Does
+ * nothing without workers or with fewer than two such subgroups, in which
+ * case the caller encodes inline as usual.
+ */
+extern void bgp_update_workers_run(struct bgp *bgp);
+
+#endif /* _FRR_BGP_UPDATE_WORKERS_H */
@@ -55,6 +55,7 @@
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_filter.h"
 #include "bgpd/bgp_io.h"
+#include "bgpd/bgp_update_workers.h"
 
 /********************
  * PRIVATE FUNCTIONS
@@ -258,6 +259,7 @@ static void *updgrp_hash_alloc(void *p)
 	memcpy(updgrp, in, sizeof(struct update_group));
 	updgrp->conf = XCALLOC(MTYPE_BGP_PEER, sizeof(struct peer));
 	conf_copy(updgrp->conf, in->conf, in->afi, in->safi);
+	updgrp->attr_cache = bgp_attr_encode_cache_new();
 	return updgrp;
 }
 
@@ -739,6 +741,7 @@ static void update_group_delete(struct update_group *updgrp)
 	XFREE(MTYPE_BGP_PEER_IFNAME, updgrp->conf->ifname);
 
 	XFREE(MTYPE_BGP_PEER, updgrp->conf);
+	bgp_attr_encode_cache_free(&updgrp->attr_cache);
 	XFREE(MTYPE_BGP_UPDGRP, updgrp);
 }
 
@@ -775,7 +778,6 @@ update_subgroup_create(struct update_group *updgrp)
 	sync_init(subgrp);
 	bpacket_queue_init(SUBGRP_PKTQ(subgrp));
 	bpacket_queue_add(SUBGRP_PKTQ(subgrp), NULL, NULL);
-	TAILQ_INIT(&(subgrp->adjq));
 	if (BGP_DEBUG(update_groups, UPDATE_GROUPS))
 		zlog_debug("create subgroup u%" PRIu64 ":s%" PRIu64, updgrp->id,
 			   subgrp->id);
@@ -1596,6 +1598,15 @@ void update_group_show_stats(struct bgp *bgp, struct vty *vty)
 		bgp->update_group_stats.peer_refreshes_combined);
 	vty_out(vty, "Merge checks triggered: %u\n",
 		bgp->update_group_stats.merge_checks_triggered);
+	vty_out(vty, "Update workers: %u\n", bgp_update_workers_count());
+	vty_out(vty, "Update worker runs: %u\n",
+		bgp->update_group_stats.update_worker_runs);
+	vty_out(vty, "Updates encoded by workers: %u\n",
+		bgp->update_group_stats.updates_offloaded);
+	vty_out(vty, "Attribute encoding cache hits: %u\n",
+		bgp->update_group_stats.attr_encode_hits);
+	vty_out(vty, "Attribute encoding cache misses: %u\n",
+		bgp->update_group_stats.attr_encode_misses);
 }
 
 /*
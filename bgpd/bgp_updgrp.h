@@ -106,6 +106,56 @@ struct bpacket {
 	unsigned int ver;
 };
 
+/* An UPDATE encoded off the subgroup, see subgroup_update_packet_encode() */
+struct bpacket_encode {
+	/* the packet, NULL if no prefix could be sent */
+	struct stream *packet;
+	bpacket_attr_vec_arr vecarr;
+
+	/* advertisements from the head of the update FIFO that are done */
+	unsigned int nadv;
+
+	bool attr_too_long;
+
+	/* whether the attributes were encoded, and came from the cache */
+	bool attr_encoded;
+	bool attr_cache_hit;
+};
+
+/*
+ * Path attributes as last encoded for an update group.
+ *
+ * All peers of an update group are sent the same attributes, so once the
+ * intern'd attr is known the encoded block only depends on the peer the
+ * path was learned from.  Direct mapped on the attr pointer; the intern id
+ * guards against a freed attr's address being reused.
+ */
+#define BGP_ATTR_ENCODE_CACHE_SLOTS 64
+
+struct bgp_attr_encode_entry {
+	const struct attr *attr;
+	uint32_t intern_id;
+
+	/* inputs taken from the originating peer */
+	const struct peer *from;
+	struct in_addr from_id;
+	int from_sort;
+	bool from_enhe;
+
+	/* offsets relative to the start of the block */
+	bpacket_attr_vec_arr vecarr;
+
+	bgp_size_t len;
+	bgp_size_t size;
+	uint8_t *data;
+};
+
+struct bgp_attr_encode_cache {
+	/* the subgroups of a group may be encoded by several workers */
+	pthread_mutex_t mtx;
+	struct bgp_attr_encode_entry slots[BGP_ATTR_ENCODE_CACHE_SLOTS];
+};
+
 struct bpacket_queue {
 	TAILQ_HEAD(pkt_queue, bpacket) pkts;
 
@@ -152,6 +202,8 @@ struct update_group {
 	uint32_t subgrps_deleted;
 
 	uint32_t num_dbg_en_peers;
+
+	struct bgp_attr_encode_cache *attr_cache;
 };
 
 /*
@@ -175,6 +227,35 @@ struct update_group {
  */
 #define UPDGRP_INCR_STAT(subgrp, stat) UPDGRP_INCR_STAT_BY(subgrp, stat, 1)
 
+/*
+ * Adj-outs of a subgroup.
+ *
+ * The entries are carved out of fixed size chunks, so they never move and
+ * cost no allocator overhead, and can be walked linearly.  They are found by
+ * dest through an open addressing index of entry numbers; all adj-outs of a
+ * dest (one per addpath id) are on the same probe sequence.
+ */
+#define BGP_ADJ_OUT_CHUNK_BITS 8
+#define BGP_ADJ_OUT_CHUNK_SIZE (1 << BGP_ADJ_OUT_CHUNK_BITS)
+
+struct bgp_adj_out_store {
+	struct bgp_adj_out **chunks;
+	uint32_t nchunks;
+
+	/* entries handed out so far; higher entry numbers were never used */
+	uint32_t fresh;
+	/* entries in use */
+	uint32_t count;
+	/* unused entries below fresh */
+	struct bgp_adj_out *free;
+
+	/* entry number + 1 per slot, 0 if empty or UINT32_MAX if deleted */
+	uint32_t *index;
+	uint32_t index_size;
+	/* slots that are not empty, including deleted ones */
+	uint32_t index_used;
+};
+
 struct update_subgroup {
 	/* back pointer to the parent update group */
 	struct update_group *update_group;
@@ -189,11 +270,11 @@ struct update_subgroup {
 	struct bpacket_queue pkt_queue;
 
 	/*
-	 * List of adj-out structures for this subgroup.
+	 * The adj-out structures of this subgroup.
 	 * It essentially represents the snapshot of every prefix that
 	 * has been advertised to the members of the subgroup
 	 */
-	TAILQ_HEAD(adjout_queue, bgp_adj_out) adjq;
+	struct bgp_adj_out_store adj_store;
 
 	/* packet buffer for update generation */
 	struct stream *work;
@@ -353,10 +434,21 @@ struct updwalk_context {
 	LIST_FOREACH_SAFE (paf, &(subgrp->peers), subgrp_train, temp_paf)
 
 #define SUBGRP_FOREACH_ADJ(subgrp, adj)                                        \
-	TAILQ_FOREACH (adj, &(subgrp->adjq), subgrp_adj_train)
+	for ((adj) = bgp_adj_out_first(subgrp); (adj);                         \
+	     (adj) = bgp_adj_out_next(subgrp, adj))
 
 #define SUBGRP_FOREACH_ADJ_SAFE(subgrp, adj, adj_temp)                         \
-	TAILQ_FOREACH_SAFE (adj, &(subgrp->adjq), subgrp_adj_train, adj_temp)
+	for ((adj) = bgp_adj_out_first(subgrp);                                \
+	     (adj) && ((adj_temp) = bgp_adj_out_next(subgrp, adj), 1);         \
+	     (adj) = (adj_temp))
+
+/*
+ * The adj-outs of one dest in a subgroup, one per addpath id.  The current
+ * adj-out may be freed while walking; none may be added.
+ */
+#define SUBGRP_FOREACH_DEST_ADJ(subgrp, dest, adj, iter)                       \
+	for ((adj) = bgp_adj_out_dest_first(subgrp, dest, &(iter)); (adj);    \
+	     (adj) = bgp_adj_out_dest_next(subgrp, dest, &(iter)))
 
 /* Prototypes.  */
 /* bgp_updgrp.c */
@@ -412,6 +504,11 @@ unsigned int bpacket_queue_virtual_length(struct peer_af *paf);
 extern void bpacket_queue_show_vty(struct bpacket_queue *q, struct vty *vty);
 bool subgroup_packets_to_build(struct update_subgroup *subgrp);
 extern struct bpacket *subgroup_update_packet(struct update_subgroup *s);
+extern void subgroup_update_packet_encode(struct update_subgroup *subgrp,
+					  struct bpacket_encode *enc);
+extern struct bpacket *
+subgroup_update_packet_commit(struct update_subgroup *subgrp,
+			      struct bpacket_encode *enc);
 extern struct bpacket *subgroup_withdraw_packet(struct update_subgroup *s);
 extern struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 						struct peer_af *paf);
@@ -423,6 +520,9 @@ extern void subgroup_default_update_packet(struct update_subgroup *subgrp,
 					   struct attr *attr,
 					   struct peer *from);
 extern void subgroup_default_withdraw_packet(struct update_subgroup *subgrp);
+extern struct bgp_attr_encode_cache *bgp_attr_encode_cache_new(void);
+extern void bgp_attr_encode_cache_flush(struct bgp_attr_encode_cache *cache);
+extern void bgp_attr_encode_cache_free(struct bgp_attr_encode_cache **cache);
 
 /* bgp_updgrp_adv.c */
 extern struct bgp_advertise *
@@ -448,6 +548,15 @@ extern void subgroup_clear_table(struct update_subgroup *subgrp);
 extern void update_group_announce(struct bgp *bgp);
 extern void update_group_announce_rrclients(struct bgp *bgp);
 extern void peer_af_announce_route(struct peer_af *paf, int combine);
+extern struct bgp_adj_out *bgp_adj_out_first(struct update_subgroup *subgrp);
+extern struct bgp_adj_out *bgp_adj_out_next(struct update_subgroup *subgrp,
+					    struct bgp_adj_out *adj);
+extern struct bgp_adj_out *
+bgp_adj_out_dest_first(struct update_subgroup *subgrp,
+		       const struct bgp_dest *dest, uint32_t *iter);
+extern struct bgp_adj_out *
+bgp_adj_out_dest_next(struct update_subgroup *subgrp,
+		      const struct bgp_dest *dest, uint32_t *iter);
 extern struct bgp_adj_out *bgp_adj_out_alloc(struct update_subgroup *subgrp,
 					     struct bgp_dest *dest,
 					     uint32_t addpath_tx_id);
@@ -34,6 +34,7 @@
 #include "hash.h"
 #include "thread.h"
 #include "queue.h"
+#include "jhash.h"
 #include "routemap.h"
 #include "filter.h"
 
@@ -55,54 +56,124 @@
 /********************
  * PRIVATE FUNCTIONS
  ********************/
-static int bgp_adj_out_compare(const struct bgp_adj_out *o1,
-			       const struct bgp_adj_out *o2)
+#define ADJ_INDEX_DELETED UINT32_MAX
+#define ADJ_INDEX_MIN_SIZE 64
+
+static inline struct bgp_adj_out *adj_store_entry(struct bgp_adj_out_store *store,
+						  uint32_t n)
+{
+	return &store->chunks[n >> BGP_ADJ_OUT_CHUNK_BITS]
+			     [n & (BGP_ADJ_OUT_CHUNK_SIZE - 1)];
+}
+
+static inline uint32_t adj_index_key(const struct bgp_dest *dest)
 {
-	if (o1->subgroup < o2->subgroup)
-		return -1;
+	uint64_t val = (uintptr_t)dest;
 
-	if (o1->subgroup > o2->subgroup)
-		return 1;
+	return jhash_2words(val, val >> 32, 0);
+}
 
-	if (o1->addpath_tx_id < o2->addpath_tx_id)
-		return -1;
+static void adj_index_insert(struct bgp_adj_out_store *store,
+			     struct bgp_adj_out *adj)
+{
+	uint32_t mask = store->index_size - 1;
+	uint32_t i = adj_index_key(adj->dest) & mask;
 
-	if (o1->addpath_tx_id > o2->addpath_tx_id)
-		return 1;
+	while (store->index[i] && store->index[i] != ADJ_INDEX_DELETED)
+		i = (i + 1) & mask;
 
-	return 0;
+	if (!store->index[i])
+		store->index_used++;
+	store->index[i] = adj->idx + 1;
+}
+
+/* Rebuilds the index, which also drops the deleted slots */
+static void adj_index_resize(struct bgp_adj_out_store *store, uint32_t size)
+{
+	uint32_t *old = store->index;
+	uint32_t old_size = store->index_size;
+	uint32_t i;
+
+	store->index = XCALLOC(MTYPE_BGP_ADJ_OUT_INDEX,
+			       size * sizeof(*store->index));
+	store->index_size = size;
+	store->index_used = 0;
+
+	for (i = 0; i < old_size; i++)
+		if (old[i] && old[i] != ADJ_INDEX_DELETED)
+			adj_index_insert(store,
+					 adj_store_entry(store, old[i] - 1));
+
+	XFREE(MTYPE_BGP_ADJ_OUT_INDEX, old);
+}
+
+static void adj_index_delete(struct bgp_adj_out_store *store,
+			     struct bgp_adj_out *adj)
+{
+	uint32_t mask = store->index_size - 1;
+	uint32_t i = adj_index_key(adj->dest) & mask;
+
+	/* deleted slots stay until the next resize, so that walks over the
+	 * adj-outs of a dest are not disturbed
+	 */
+	while (store->index[i] != adj->idx + 1)
+		i = (i + 1) & mask;
+	store->index[i] = ADJ_INDEX_DELETED;
 }
-RB_GENERATE(bgp_adj_out_rb, bgp_adj_out, adj_entry, bgp_adj_out_compare);
 
 static inline struct bgp_adj_out *adj_lookup(struct bgp_dest *dest,
 					     struct update_subgroup *subgrp,
 					     uint32_t addpath_tx_id)
 {
-	struct bgp_adj_out lookup;
+	struct bgp_adj_out *adj;
+	uint32_t iter;
 
 	if (!dest || !subgrp)
 		return NULL;
 
 	/* update-groups that do not support addpath will pass 0 for
 	 * addpath_tx_id. */
-	lookup.subgroup = subgrp;
-	lookup.addpath_tx_id = addpath_tx_id;
+	SUBGRP_FOREACH_DEST_ADJ (subgrp, dest, adj, iter)
+		if (adj->addpath_tx_id == addpath_tx_id)
+			return adj;
 
-	return RB_FIND(bgp_adj_out_rb, &dest->adj_out, &lookup);
+	return NULL;
 }
 
-static void adj_free(struct bgp_adj_out *adj)
+static void adj_free(struct update_subgroup *subgrp, struct bgp_adj_out *adj)
 {
-	TAILQ_REMOVE(&(adj->subgroup->adjq), adj, subgrp_adj_train);
-	SUBGRP_DECR_STAT(adj->subgroup, adj_count);
-	XFREE(MTYPE_BGP_ADJ_OUT, adj);
+	struct bgp_adj_out_store *store = &subgrp->adj_store;
+
+	adj_index_delete(store, adj);
+
+	adj->dest = NULL;
+	adj->attr = NULL;
+	adj->free_next = store->free;
+	store->free = adj;
+	store->count--;
+
+	SUBGRP_DECR_STAT(subgrp, adj_count);
+}
+
+/* Releases the memory of a subgroup's adj-outs, all of which must be freed */
+static void adj_store_reset(struct bgp_adj_out_store *store)
+{
+	uint32_t i;
+
+	assert(store->count == 0);
+
+	for (i = 0; i < store->nchunks; i++)
+		XFREE(MTYPE_BGP_ADJ_OUT, store->chunks[i]);
+	XFREE(MTYPE_BGP_ADJ_OUT, store->chunks);
+	XFREE(MTYPE_BGP_ADJ_OUT_INDEX, store->index);
+	memset(store, 0, sizeof(*store));
 }
 
 static void subgrp_withdraw_stale_addpath(struct updwalk_context *ctx,
 					  struct update_subgroup *subgrp)
 {
-	struct bgp_adj_out *adj, *adj_next;
-	uint32_t id;
+	struct bgp_adj_out *adj;
+	uint32_t id, iter;
 	struct bgp_path_info *pi;
 	afi_t afi = SUBGRP_AFI(subgrp);
 	safi_t safi = SUBGRP_SAFI(subgrp);
@@ -110,24 +181,20 @@ static void subgrp_withdraw_stale_addpath(struct updwalk_context *ctx,
 
 	/* Look through all of the paths we have advertised for this rn and send
 	 * a withdraw for the ones that are no longer present */
-	RB_FOREACH_SAFE (adj, bgp_adj_out_rb, &ctx->dest->adj_out, adj_next) {
-
-		if (adj->subgroup == subgrp) {
-			for (pi = bgp_dest_get_bgp_path_info(ctx->dest); pi;
-			     pi = pi->next) {
-				id = bgp_addpath_id_for_peer(peer, afi, safi,
-					&pi->tx_addpath);
+	SUBGRP_FOREACH_DEST_ADJ (subgrp, ctx->dest, adj, iter) {
+		for (pi = bgp_dest_get_bgp_path_info(ctx->dest); pi;
+		     pi = pi->next) {
+			id = bgp_addpath_id_for_peer(peer, afi, safi,
+						     &pi->tx_addpath);
 
-				if (id == adj->addpath_tx_id) {
-					break;
-				}
+			if (id == adj->addpath_tx_id) {
+				break;
 			}
+		}
 
-			if (!pi) {
-				subgroup_process_announce_selected(
-					subgrp, NULL, ctx->dest,
-					adj->addpath_tx_id);
-			}
+		if (!pi) {
+			subgroup_process_announce_selected(
+				subgrp, NULL, ctx->dest, adj->addpath_tx_id);
 		}
 	}
 }
@@ -140,7 +207,8 @@ static int group_announce_route_walkcb(struct update_group *updgrp, void *arg)
 	afi_t afi;
 	safi_t safi;
 	struct peer *peer;
-	struct bgp_adj_out *adj, *adj_next;
+	struct bgp_adj_out *adj;
+	uint32_t iter;
 	int addpath_capable;
 
 	afi = UPDGRP_AFI(updgrp);
@@ -202,16 +270,13 @@ static int group_announce_route_walkcb(struct update_group *updgrp, void *arg)
 					/* Find the addpath_tx_id of the path we
 					 * had advertised and
 					 * send a withdraw */
-					RB_FOREACH_SAFE (adj, bgp_adj_out_rb,
-							 &ctx->dest->adj_out,
-							 adj_next) {
-						if (adj->subgroup == subgrp) {
-							subgroup_process_announce_selected(
-								subgrp, NULL,
-								ctx->dest,
-								adj->addpath_tx_id);
-						}
-					}
+					SUBGRP_FOREACH_DEST_ADJ (subgrp,
+								 ctx->dest, adj,
+								 iter)
+						subgroup_process_announce_selected(
+							subgrp, NULL,
+							ctx->dest,
+							adj->addpath_tx_id);
 				}
 			}
 		}
@@ -227,6 +292,7 @@ static void subgrp_show_adjq_vty(struct update_subgroup *subgrp,
 	struct bgp_adj_out *adj;
 	unsigned long output_count;
 	struct bgp_dest *dest;
+	uint32_t iter;
 	int header1 = 1;
 	struct bgp *bgp;
 	int header2 = 1;
@@ -242,38 +308,37 @@ static void subgrp_show_adjq_vty(struct update_subgroup *subgrp,
 	for (dest = bgp_table_top(table); dest; dest = bgp_route_next(dest)) {
 		const struct prefix *dest_p = bgp_dest_get_prefix(dest);
 
-		RB_FOREACH (adj, bgp_adj_out_rb, &dest->adj_out)
-			if (adj->subgroup == subgrp) {
-				if (header1) {
-					vty_out(vty,
-						"BGP table version is %" PRIu64", local router ID is %s\n",
-						table->version,
-						inet_ntoa(bgp->router_id));
-					vty_out(vty, BGP_SHOW_SCODE_HEADER);
-					vty_out(vty, BGP_SHOW_OCODE_HEADER);
-					header1 = 0;
-				}
-				if (header2) {
-					vty_out(vty, BGP_SHOW_HEADER);
-					header2 = 0;
-				}
-				if ((flags & UPDWALK_FLAGS_ADVQUEUE) && adj->adv
-				    && adj->adv->baa) {
-					route_vty_out_tmp(vty, dest_p,
-							  adj->adv->baa->attr,
-							  SUBGRP_SAFI(subgrp),
-							  0, NULL, false);
-					output_count++;
-				}
-				if ((flags & UPDWALK_FLAGS_ADVERTISED)
-				    && adj->attr) {
-					route_vty_out_tmp(vty, dest_p,
-							  adj->attr,
-							  SUBGRP_SAFI(subgrp),
-							  0, NULL, false);
-					output_count++;
-				}
+		SUBGRP_FOREACH_DEST_ADJ (subgrp, dest, adj, iter) {
+			if (header1) {
+				vty_out(vty,
+					"BGP table version is %" PRIu64", local router ID is %s\n",
+					table->version,
+					inet_ntoa(bgp->router_id));
+				vty_out(vty, BGP_SHOW_SCODE_HEADER);
+				vty_out(vty, BGP_SHOW_OCODE_HEADER);
+				header1 = 0;
+			}
+			if (header2) {
+				vty_out(vty, BGP_SHOW_HEADER);
+				header2 = 0;
+			}
+			if ((flags & UPDWALK_FLAGS_ADVQUEUE) && adj->adv
+			    && adj->adv->baa) {
+				route_vty_out_tmp(vty, dest_p,
+						  adj->adv->baa->attr,
+						  SUBGRP_SAFI(subgrp),
+						  0, NULL, false);
+				output_count++;
 			}
+			if ((flags & UPDWALK_FLAGS_ADVERTISED)
+			    && adj->attr) {
+				route_vty_out_tmp(vty, dest_p,
+						  adj->attr,
+						  SUBGRP_SAFI(subgrp),
+						  0, NULL, false);
+				output_count++;
+			}
+		}
 	}
 	if (output_count != 0)
 		vty_out(vty, "\nTotal number of prefixes %ld\n", output_count);
@@ -381,6 +446,77 @@ static int update_group_announce_rrc_walkcb(struct update_group *updgrp,
  * PUBLIC FUNCTIONS
  ********************/
 
+/*
+ * Linear walk over the adj-outs of a subgroup, in no particular order.
+ */
+struct bgp_adj_out *bgp_adj_out_first(struct update_subgroup *subgrp)
+{
+	struct bgp_adj_out_store *store = &subgrp->adj_store;
+	struct bgp_adj_out *adj;
+	uint32_t n;
+
+	for (n = 0; n < store->fresh; n++) {
+		adj = adj_store_entry(store, n);
+		if (adj->dest)
+			return adj;
+	}
+
+	return NULL;
+}
+
+struct bgp_adj_out *bgp_adj_out_next(struct update_subgroup *subgrp,
+				     struct bgp_adj_out *adj)
+{
+	struct bgp_adj_out_store *store = &subgrp->adj_store;
+	uint32_t n;
+
+	for (n = adj->idx + 1; n < store->fresh; n++) {
+		adj = adj_store_entry(store, n);
+		if (adj->dest)
+			return adj;
+	}
+
+	return NULL;
+}
+
+/*
+ * Walk over the adj-outs of a dest in a subgroup, following the dest's
+ * probe sequence in the index up to the next empty slot.
+ */
+struct bgp_adj_out *bgp_adj_out_dest_next(struct update_subgroup *subgrp,
+					  const struct bgp_dest *dest,
+					  uint32_t *iter)
+{
+	struct bgp_adj_out_store *store = &subgrp->adj_store;
+	struct bgp_adj_out *adj;
+	uint32_t slot;
+
+	while ((slot = store->index[*iter])) {
+		*iter = (*iter + 1) & (store->index_size - 1);
+		if (slot == ADJ_INDEX_DELETED)
+			continue;
+
+		adj = adj_store_entry(store, slot - 1);
+		if (adj->dest == dest)
+			return adj;
+	}
+
+	return NULL;
+}
+
+struct bgp_adj_out *bgp_adj_out_dest_first(struct update_subgroup *subgrp,
+					   const struct bgp_dest *dest,
+					   uint32_t *iter)
+{
+	struct bgp_adj_out_store *store = &subgrp->adj_store;
+
+	if (!store->index)
+		return NULL;
+
+	*iter = adj_index_key(dest) & (store->index_size - 1);
+	return bgp_adj_out_dest_next(subgrp, dest, iter);
+}
+
 /**
  * Allocate an adj-out object. Do proper initialization of its fields,
  * primarily its association with the subgroup and the prefix.
@@ -389,19 +525,45 @@ struct bgp_adj_out *bgp_adj_out_alloc(struct update_subgroup *subgrp,
 				      struct bgp_dest *dest,
 				      uint32_t addpath_tx_id)
 {
+	struct bgp_adj_out_store *store = &subgrp->adj_store;
 	struct bgp_adj_out *adj;
+	uint32_t size;
 
-	adj = XCALLOC(MTYPE_BGP_ADJ_OUT, sizeof(struct bgp_adj_out));
-	adj->subgroup = subgrp;
-	adj->addpath_tx_id = addpath_tx_id;
+	assert(dest);
 
-	if (dest) {
-		RB_INSERT(bgp_adj_out_rb, &dest->adj_out, adj);
-		bgp_dest_lock_node(dest);
-		adj->dest = dest;
+	if (store->free) {
+		adj = store->free;
+		store->free = adj->free_next;
+	} else {
+		if (store->fresh == store->nchunks * BGP_ADJ_OUT_CHUNK_SIZE) {
+			store->chunks = XREALLOC(
+				MTYPE_BGP_ADJ_OUT, store->chunks,
+				(store->nchunks + 1) * sizeof(*store->chunks));
+			store->chunks[store->nchunks++] = XMALLOC(
+				MTYPE_BGP_ADJ_OUT,
+				BGP_ADJ_OUT_CHUNK_SIZE
+					* sizeof(struct bgp_adj_out));
+		}
+		adj = adj_store_entry(store, store->fresh);
+		adj->idx = store->fresh++;
+	}
+
+	adj->dest = dest;
+	adj->attr = NULL;
+	adj->adv = NULL;
+	adj->addpath_tx_id = addpath_tx_id;
+	store->count++;
+
+	/* keep the index at most 3/4 full, deleted slots included */
+	if ((store->index_used + 1) * 4 > store->index_size * 3) {
+		size = MAX(store->index_size, ADJ_INDEX_MIN_SIZE);
+		while (store->count * 2 > size)
+			size *= 2;
+		adj_index_resize(store, size);
 	}
+	adj_index_insert(store, adj);
 
-	TAILQ_INSERT_TAIL(&(subgrp->adjq), adj, subgrp_adj_train);
+	bgp_dest_lock_node(dest);
 	SUBGRP_INCR_STAT(subgrp, adj_count);
 	return adj;
 }
@@ -559,11 +721,8 @@ void bgp_adj_out_unset_subgroup(struct bgp_dest *dest,
 			if (trigger_write)
 				subgroup_trigger_write(subgrp);
 		} else {
-			/* Remove myself from adjacency. */
-			RB_REMOVE(bgp_adj_out_rb, &dest->adj_out, adj);
-
 			/* Free allocated information.  */
-			adj_free(adj);
+			adj_free(subgrp, adj);
 
 			bgp_dest_unlock_node(dest);
 		}
@@ -581,8 +740,7 @@ void bgp_adj_out_remove_subgroup(struct bgp_dest *dest, struct bgp_adj_out *adj,
 	if (adj->adv)
 		bgp_advertise_clean_subgroup(subgrp, adj);
 
-	RB_REMOVE(bgp_adj_out_rb, &dest->adj_out, adj);
-	adj_free(adj);
+	adj_free(subgrp, adj);
 }
 
 /*
@@ -598,10 +756,16 @@ void subgroup_clear_table(struct update_subgroup *subgrp)
 		bgp_adj_out_remove_subgroup(dest, aout, subgrp);
 		bgp_dest_unlock_node(dest);
 	}
+
+	adj_store_reset(&subgrp->adj_store);
 }
 
 /*
  * subgroup_announce_table
+ *
+ * This walks the RIB rather than the subgroup's adj-out store: the store
+ * only holds what was already advertised, while an announce has to find
+ * every selected path, including those the subgroup has never sent.
  */
 void subgroup_announce_table(struct update_subgroup *subgrp,
 			     struct bgp_table *table)
@@ -625,6 +789,9 @@ void subgroup_announce_table(struct update_subgroup *subgrp,
 	if (!table)
 		table = peer->bgp->rib[afi][safi];
 
+	/* the whole table is sent again, don't trust earlier encodings */
+	bgp_attr_encode_cache_flush(subgrp->update_group->attr_cache);
+
 	if (safi != SAFI_MPLS_VPN && safi != SAFI_ENCAP && safi != SAFI_EVPN
 	    && CHECK_FLAG(peer->af_flags[afi][safi],
 			  PEER_FLAG_DEFAULT_ORIGINATE))
@@ -856,12 +1023,8 @@ void subgroup_default_originate(struct update_subgroup *subgrp, int withdraw)
 						bgp_advertise_clean_subgroup(
 							subgrp, adj);
 
-					/* Remove  from adjacency. */
-					RB_REMOVE(bgp_adj_out_rb,
-						  &dest->adj_out, adj);
-
 					/* Free allocated information.  */
-					adj_free(adj);
+					adj_free(subgrp, adj);
 
 					bgp_dest_unlock_node(dest);
 				}
@@ -43,6 +43,7 @@
 #include "hash.h"
 #include "queue.h"
 #include "mpls.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_debug.h"
@@ -688,17 +689,174 @@ bool subgroup_packets_to_build(struct update_subgroup *subgrp)
 	return false;
 }
 
-/* Make BGP update packet.  */
-struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
+/*
+ * Next advertisement to go into the UPDATE being encoded, without removing
+ * anything from the subgroup: 'first' is the head of the update FIFO, the
+ * other advertisements sharing its attributes follow.  This is the order
+ * bgp_advertise_clean_subgroup() hands them out in.
+ */
+static struct bgp_advertise *
+subgroup_update_packet_next(struct bgp_advertise *first,
+			    struct bgp_advertise *adv)
+{
+	struct bgp_advertise *next;
+
+	next = (adv == first) ? first->baa->adv : adv->next;
+	if (next == first)
+		next = next->next;
+
+	return next;
+}
+
+struct bgp_attr_encode_cache *bgp_attr_encode_cache_new(void)
+{
+	struct bgp_attr_encode_cache *cache;
+
+	cache = XCALLOC(MTYPE_BGP_ATTR_ENCODE, sizeof(*cache));
+	pthread_mutex_init(&cache->mtx, NULL);
+	return cache;
+}
+
+/* Called whenever a subgroup announces its whole table, which is what
+ * configuration changes affecting the encoding (max-med, cluster-id...)
+ * end up doing.
+ */
+void bgp_attr_encode_cache_flush(struct bgp_attr_encode_cache *cache)
+{
+	unsigned int i;
+
+	frr_with_mutex(&cache->mtx) {
+		for (i = 0; i < BGP_ATTR_ENCODE_CACHE_SLOTS; i++)
+			cache->slots[i].attr = NULL;
+	}
+}
+
+void bgp_attr_encode_cache_free(struct bgp_attr_encode_cache **cache)
+{
+	unsigned int i;
+
+	if (!*cache)
+		return;
+
+	for (i = 0; i < BGP_ATTR_ENCODE_CACHE_SLOTS; i++)
+		XFREE(MTYPE_BGP_ATTR_ENCODE, (*cache)->slots[i].data);
+	pthread_mutex_destroy(&(*cache)->mtx);
+	XFREE(MTYPE_BGP_ATTR_ENCODE, *cache);
+}
+
+static bool attr_encode_entry_match(const struct bgp_attr_encode_entry *entry,
+				    const struct attr *attr,
+				    struct peer *from, afi_t afi,
+				    safi_t safi)
+{
+	if (entry->attr != attr || entry->intern_id != attr->intern_id
+	    || entry->from != from)
+		return false;
+
+	if (!from)
+		return true;
+
+	return entry->from_id.s_addr == from->remote_id.s_addr
+	       && entry->from_sort == from->sort
+	       && entry->from_enhe == !!peer_cap_enhe(from, afi, safi);
+}
+
+/*
+ * Encode the path attributes of an UPDATE, except MP_REACH_NLRI, into 's'
+ * like bgp_packet_attribute() does, reusing the block another subgroup of
+ * the update group (or an earlier packet) encoded for the same attr.
+ */
+static bgp_size_t subgroup_packet_attribute(struct update_subgroup *subgrp,
+					    struct stream *s, struct attr *attr,
+					    struct bpacket_attr_vec_arr *vecarr,
+					    struct peer *from, bool *hit)
+{
+	struct bgp_attr_encode_cache *cache = subgrp->update_group->attr_cache;
+	struct bgp_attr_encode_entry *entry;
+	afi_t afi = SUBGRP_AFI(subgrp);
+	safi_t safi = SUBGRP_SAFI(subgrp);
+	size_t cp = stream_get_endp(s);
+	bgp_size_t len = 0;
+	unsigned int i;
+
+	*hit = false;
+	entry = &cache->slots[jhash_1word((uintptr_t)attr, 0)
+			      % BGP_ATTR_ENCODE_CACHE_SLOTS];
+
+	frr_with_mutex(&cache->mtx) {
+		if (!attr_encode_entry_match(entry, attr, from, afi, safi))
+			break;
+
+		stream_put(s, entry->data, entry->len);
+		for (i = 0; i < BGP_ATTR_VEC_MAX; i++) {
+			if (!CHECK_FLAG(entry->vecarr.entries[i].flags,
+					BPKT_ATTRVEC_FLAGS_UPDATED))
+				continue;
+			vecarr->entries[i].flags =
+				entry->vecarr.entries[i].flags;
+			vecarr->entries[i].offset =
+				cp + entry->vecarr.entries[i].offset;
+		}
+		len = entry->len;
+		*hit = true;
+	}
+
+	if (*hit)
+		return len;
+
+	len = bgp_packet_attribute(NULL, SUBGRP_PEER(subgrp), s, attr, vecarr,
+				   NULL, afi, safi, from, NULL, NULL, 0, 0, 0);
+
+	frr_with_mutex(&cache->mtx) {
+		if (entry->size < len) {
+			entry->data = XREALLOC(MTYPE_BGP_ATTR_ENCODE,
+					       entry->data, len);
+			entry->size = len;
+		}
+		memcpy(entry->data, STREAM_DATA(s) + cp, len);
+		entry->len = len;
+
+		bpacket_attr_vec_arr_reset(&entry->vecarr);
+		for (i = 0; i < BGP_ATTR_VEC_MAX; i++) {
+			if (!CHECK_FLAG(vecarr->entries[i].flags,
+					BPKT_ATTRVEC_FLAGS_UPDATED))
+				continue;
+			entry->vecarr.entries[i].flags =
+				vecarr->entries[i].flags;
+			entry->vecarr.entries[i].offset =
+				vecarr->entries[i].offset - cp;
+		}
+
+		entry->attr = attr;
+		entry->intern_id = attr->intern_id;
+		entry->from = from;
+		if (from) {
+			entry->from_id = from->remote_id;
+			entry->from_sort = from->sort;
+			entry->from_enhe = !!peer_cap_enhe(from, afi, safi);
+		}
+	}
+
+	return len;
+}
+
+/*
+ * Encode the next BGP update packet of a subgroup.
+ *
+ * Only the subgroup's own scratch streams are written to, so the update
+ * groups of a bgp instance can be encoded in parallel while the main
+ * pthread waits.  Nothing is removed from the subgroup's update FIFO, that
+ * is left to subgroup_update_packet_commit().
+ */
+void subgroup_update_packet_encode(struct update_subgroup *subgrp,
+				   struct bpacket_encode *enc)
 {
-	struct bpacket_attr_vec_arr vecarr;
-	struct bpacket *pkt;
 	struct peer *peer;
 	struct stream *s;
 	struct stream *snlri;
 	struct stream *packet;
 	struct bgp_adj_out *adj;
-	struct bgp_advertise *adv;
+	struct bgp_advertise *adv, *first;
 	struct bgp_dest *dest = NULL;
 	struct bgp_path_info *path = NULL;
 	bgp_size_t total_attr_len = 0;
@@ -715,15 +873,17 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 	int addpath_encode = 0;
 	int addpath_overhead = 0;
 	uint32_t addpath_tx_id = 0;
+	uint32_t scount;
 	struct prefix_rd *prd = NULL;
 	mpls_label_t label = MPLS_INVALID_LABEL, *label_pnt = NULL;
 	uint32_t num_labels = 0;
 
-	if (!subgrp)
-		return NULL;
-
-	if (bpacket_queue_is_full(SUBGRP_INST(subgrp), SUBGRP_PKTQ(subgrp)))
-		return NULL;
+	enc->packet = NULL;
+	enc->nadv = 0;
+	enc->attr_too_long = false;
+	enc->attr_encoded = false;
+	enc->attr_cache_hit = false;
+	bpacket_attr_vec_arr_reset(&enc->vecarr);
 
 	peer = SUBGRP_PEER(subgrp);
 	afi = SUBGRP_AFI(subgrp);
@@ -732,13 +892,12 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 	stream_reset(s);
 	snlri = subgrp->scratch;
 	stream_reset(snlri);
-
-	bpacket_attr_vec_arr_reset(&vecarr);
+	scount = subgrp->scount;
 
 	addpath_encode = bgp_addpath_encode_tx(peer, afi, safi);
 	addpath_overhead = addpath_encode ? BGP_ADDPATH_ID_LEN : 0;
 
-	adv = bgp_adv_fifo_first(&subgrp->sync->update);
+	first = adv = bgp_adv_fifo_first(&subgrp->sync->update);
 	while (adv) {
 		const struct prefix *dest_p;
 
@@ -754,7 +913,7 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 		 */
 		if (CHECK_FLAG(peer->af_flags[afi][safi],
 			       PEER_FLAG_MAX_PREFIX_OUT)
-		    && subgrp->scount >= peer->pmax_out[afi][safi]) {
+		    && scount >= peer->pmax_out[afi][safi]) {
 			if (BGP_DEBUG(update, UPDATE_OUT)
 			    || BGP_DEBUG(update, UPDATE_PREFIX)) {
 				zlog_debug(
@@ -805,9 +964,10 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 
 			/* 5: Encode all the attributes, except MP_REACH_NLRI
 			 * attr. */
-			total_attr_len = bgp_packet_attribute(
-				NULL, peer, s, adv->baa->attr, &vecarr, NULL,
-				afi, safi, from, NULL, NULL, 0, 0, 0);
+			total_attr_len = subgroup_packet_attribute(
+				subgrp, s, adv->baa->attr, &enc->vecarr, from,
+				&enc->attr_cache_hit);
+			enc->attr_encoded = true;
 
 			space_remaining =
 				STREAM_CONCAT_REMAIN(s, snlri, STREAM_SIZE(s))
@@ -825,11 +985,9 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 					"u%" PRIu64 ":s%" PRIu64" attributes too long, cannot send UPDATE",
 					subgrp->update_group->id, subgrp->id);
 
-				/* Flush the FIFO update queue */
-				while (adv)
-					adv = bgp_advertise_clean_subgroup(
-						subgrp, adj);
-				return NULL;
+				stream_reset(s);
+				enc->attr_too_long = true;
+				return;
 			}
 
 			if (BGP_DEBUG(update, UPDATE_OUT)
@@ -863,7 +1021,7 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 
 			if (stream_empty(snlri))
 				mpattrlen_pos = bgp_packet_mpattr_start(
-					snlri, peer, afi, safi, &vecarr,
+					snlri, peer, afi, safi, &enc->vecarr,
 					adv->baa->attr);
 
 			bgp_packet_mpattr_prefix(snlri, afi, safi, dest_p, prd,
@@ -905,15 +1063,12 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 				   pfx_buf);
 		}
 
-		/* Synchnorize attribute.  */
-		if (adj->attr)
-			bgp_attr_unintern(&adj->attr);
-		else
-			subgrp->scount++;
-
-		adj->attr = bgp_attr_intern(adv->baa->attr);
+		/* the attribute is synchronized on commit */
+		if (!adj->attr)
+			scount++;
 next:
-		adv = bgp_advertise_clean_subgroup(subgrp, adj);
+		enc->nadv++;
+		adv = subgroup_update_packet_next(first, adv);
 	}
 
 	if (!stream_empty(s)) {
@@ -927,7 +1082,7 @@ next:
 
 		if (!stream_empty(snlri)) {
 			packet = stream_dupcat(s, snlri, mpattr_pos);
-			bpacket_attr_vec_arr_update(&vecarr, mpattr_pos);
+			bpacket_attr_vec_arr_update(&enc->vecarr, mpattr_pos);
 		} else
 			packet = stream_dup(s);
 		bgp_packet_set_size(packet);
@@ -937,12 +1092,90 @@ next:
 				   (stream_get_endp(packet)
 				    - stream_get_getp(packet)),
 				   num_pfx);
-		pkt = bpacket_queue_add(SUBGRP_PKTQ(subgrp), packet, &vecarr);
+		enc->packet = packet;
 		stream_reset(s);
 		stream_reset(snlri);
-		return pkt;
 	}
-	return NULL;
+}
+
+/*
+ * Synchronize the adjacencies of the advertisements that went into an
+ * encoded UPDATE, remove them from the subgroup and queue the packet.
+ * Runs on the main pthread.
+ */
+struct bpacket *subgroup_update_packet_commit(struct update_subgroup *subgrp,
+					      struct bpacket_encode *enc)
+{
+	struct bgp_adj_out *adj;
+	struct bgp_advertise *adv;
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
+	unsigned int i;
+
+	peer = SUBGRP_PEER(subgrp);
+	afi = SUBGRP_AFI(subgrp);
+	safi = SUBGRP_SAFI(subgrp);
+
+	adv = bgp_adv_fifo_first(&subgrp->sync->update);
+
+	if (enc->attr_encoded) {
+		if (enc->attr_cache_hit)
+			UPDGRP_GLOBAL_STAT(subgrp->update_group,
+					   attr_encode_hits)++;
+		else
+			UPDGRP_GLOBAL_STAT(subgrp->update_group,
+					   attr_encode_misses)++;
+	}
+
+	if (enc->attr_too_long) {
+		/* Flush the FIFO update queue */
+		while (adv)
+			adv = bgp_advertise_clean_subgroup(subgrp, adv->adj);
+		return NULL;
+	}
+
+	for (i = 0; i < enc->nadv; i++) {
+		assert(adv);
+		adj = adv->adj;
+
+		/* skipped by the encoder because of maximum-prefix-out */
+		if (CHECK_FLAG(peer->af_flags[afi][safi],
+			       PEER_FLAG_MAX_PREFIX_OUT)
+		    && subgrp->scount >= peer->pmax_out[afi][safi])
+			goto next;
+
+		/* Synchnorize attribute.  */
+		if (adj->attr)
+			bgp_attr_unintern(&adj->attr);
+		else
+			subgrp->scount++;
+
+		adj->attr = bgp_attr_intern(adv->baa->attr);
+next:
+		adv = bgp_advertise_clean_subgroup(subgrp, adj);
+	}
+
+	if (!enc->packet)
+		return NULL;
+
+	return bpacket_queue_add(SUBGRP_PKTQ(subgrp), enc->packet,
+				 &enc->vecarr);
+}
+
+/* Make BGP update packet.  */
+struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
+{
+	struct bpacket_encode enc;
+
+	if (!subgrp)
+		return NULL;
+
+	if (bpacket_queue_is_full(SUBGRP_INST(subgrp), SUBGRP_PKTQ(subgrp)))
+		return NULL;
+
+	subgroup_update_packet_encode(subgrp, &enc);
+	return subgroup_update_packet_commit(subgrp, &enc);
 }
 
 /* Make BGP withdraw packet.  */
@@ -39,6 +39,7 @@ int show_adj_route_vpn(struct vty *vty, struct peer *peer,
 	struct bgp_table *table;
 	struct bgp_dest *dest;
 	struct bgp_dest *rm;
+	struct update_subgroup *subgrp;
 	int rd_header;
 	int header = 1;
 	json_object *json = NULL;
@@ -58,6 +59,8 @@ int show_adj_route_vpn(struct vty *vty, struct peer *peer,
 		return CMD_WARNING;
 	}
 
+	subgrp = peer_subgroup(peer, afi, safi);
+
 	if (use_json) {
 		json_scode = json_object_new_object();
 		json_ocode = json_object_new_object();
@@ -98,16 +101,16 @@ int show_adj_route_vpn(struct vty *vty, struct peer *peer,
 		for (rm = bgp_table_top(table); rm; rm = bgp_route_next(rm)) {
 			struct bgp_adj_out *adj = NULL;
 			struct attr *attr = NULL;
-			struct peer_af *paf = NULL;
+			uint32_t iter;
 
-			RB_FOREACH (adj, bgp_adj_out_rb, &rm->adj_out)
-				SUBGRP_FOREACH_PEER (adj->subgroup, paf) {
-					if (paf->peer != peer || !adj->attr)
+			if (subgrp)
+				SUBGRP_FOREACH_DEST_ADJ (subgrp, rm, adj, iter) {
+					if (!adj->attr)
 						continue;
 
 					attr = adj->attr;
 					break;
-			}
+				}
 
 			if (bgp_dest_get_bgp_path_info(rm) == NULL)
 				continue;
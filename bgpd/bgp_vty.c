@@ -69,6 +69,8 @@
 #include "bgpd/bgp_addpath.h"
 #include "bgpd/bgp_mac.h"
 #include "bgpd/bgp_flowspec.h"
+#include "bgpd/bgp_bestpath_workers.h"
+#include "bgpd/bgp_update_workers.h"
 #ifdef ENABLE_BGP_VNC
 #include "bgpd/rfapi/bgp_rfapi_cfg.h"
 #endif
@@ -1909,6 +1911,54 @@ DEFPY (no_bgp_global_update_delay,
 	return bgp_global_update_delay_deconfig_vty(vty);
 }
 
+/* Best-path worker pthreads */
+DEFPY (bgp_bestpath_workers,
+       bgp_bestpath_workers_cmd,
+       "bgp bestpath-workers (1-32)$workers",
+       BGP_STR
+       "Run best path selection on worker pthreads\n"
+       "Number of worker pthreads\n")
+{
+	bgp_bestpath_workers_set(workers);
+	return CMD_SUCCESS;
+}
+
+DEFPY (no_bgp_bestpath_workers,
+       no_bgp_bestpath_workers_cmd,
+       "no bgp bestpath-workers [(1-32)]",
+       NO_STR
+       BGP_STR
+       "Run best path selection on worker pthreads\n"
+       "Number of worker pthreads\n")
+{
+	bgp_bestpath_workers_set(0);
+	return CMD_SUCCESS;
+}
+
+/* UPDATE encoding worker pthreads */
+DEFPY (bgp_update_workers,
+       bgp_update_workers_cmd,
+       "bgp update-workers (1-32)$workers",
+       BGP_STR
+       "Encode UPDATE packets on worker pthreads\n"
+       "Number of worker pthreads\n")
+{
+	bgp_update_workers_set(workers);
+	return CMD_SUCCESS;
+}
+
+DEFPY (no_bgp_update_workers,
+       no_bgp_update_workers_cmd,
+       "no bgp update-workers [(1-32)]",
+       NO_STR
+       BGP_STR
+       "Encode UPDATE packets on worker pthreads\n"
+       "Number of worker pthreads\n")
+{
+	bgp_update_workers_set(0);
+	return CMD_SUCCESS;
+}
+
 /* Update-delay configuration */
 
 DEFPY (bgp_update_delay,
@@ -9207,9 +9257,11 @@ DEFUN (show_bgp_memory,
 {
 	char memstrbuf[MTYPE_MEMSTR_LEN];
 	unsigned long count;
+	struct listnode *node;
+	struct bgp *bgp;
 
 	/* RIB related usage stats */
-	count = mtype_stats_alloc(MTYPE_BGP_NODE);
+	count = bgp_table_node_count();
 	vty_out(vty, "%ld RIB nodes, using %s of memory\n", count,
 		mtype_memstr(memstrbuf, sizeof(memstrbuf),
 			     count * sizeof(struct bgp_dest)));
@@ -9240,7 +9292,11 @@ DEFUN (show_bgp_memory,
 		vty_out(vty, "%ld Adj-In entries, using %s of memory\n", count,
 			mtype_memstr(memstrbuf, sizeof(memstrbuf),
 				     count * sizeof(struct bgp_adj_in)));
-	if ((count = mtype_stats_alloc(MTYPE_BGP_ADJ_OUT)))
+	/* adj-outs are allocated in chunks by the subgroups */
+	count = 0;
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		count += bgp->update_group_stats.adj_count;
+	if (count)
 		vty_out(vty, "%ld Adj-Out entries, using %s of memory\n", count,
 			mtype_memstr(memstrbuf, sizeof(memstrbuf),
 				     count * sizeof(struct bgp_adj_out)));
@@ -15868,6 +15924,14 @@ int bgp_config_write(struct vty *vty)
 	if (CHECK_FLAG(bm->flags, BM_FLAG_GRACEFUL_SHUTDOWN))
 		vty_out(vty, "bgp graceful-shutdown\n");
 
+	if (bgp_bestpath_workers_count())
+		vty_out(vty, "bgp bestpath-workers %u\n",
+			bgp_bestpath_workers_count());
+
+	if (bgp_update_workers_count())
+		vty_out(vty, "bgp update-workers %u\n",
+			bgp_update_workers_count());
+
 	/* No-RIB (Zebra) option flag configuration */
 	if (bgp_option_check(BGP_OPT_NO_FIB))
 		vty_out(vty, "bgp no-rib\n");
@@ -16394,6 +16458,12 @@ void bgp_vty_init(void)
 	install_element(CONFIG_NODE, &bgp_global_update_delay_cmd);
 	install_element(CONFIG_NODE, &no_bgp_global_update_delay_cmd);
 
+	/* global bgp bestpath-workers command */
+	install_element(CONFIG_NODE, &bgp_bestpath_workers_cmd);
+	install_element(CONFIG_NODE, &no_bgp_bestpath_workers_cmd);
+	install_element(CONFIG_NODE, &bgp_update_workers_cmd);
+	install_element(CONFIG_NODE, &no_bgp_update_workers_cmd);
+
 	/* global bgp graceful-shutdown command */
 	install_element(CONFIG_NODE, &bgp_graceful_shutdown_cmd);
 	install_element(CONFIG_NODE, &no_bgp_graceful_shutdown_cmd);
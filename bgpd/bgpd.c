@@ -1298,6 +1298,7 @@ struct peer *peer_new(struct bgp *bgp)
 	/* Create buffers.  */
 	peer->ibuf = stream_fifo_new();
 	peer->obuf = stream_fifo_new();
+	bgp_predecode_fifo_init(&peer->ibuf_predecode);
 	pthread_mutex_init(&peer->io_mtx, NULL);
 
 	/* We use a larger buffer for peer->obuf_work in the event that:
@@ -2367,6 +2368,9 @@ int peer_delete(struct peer *peer)
 		peer->ibuf = NULL;
 	}
 
+	bgp_attr_predecode_flush(peer);
+	bgp_predecode_fifo_fini(&peer->ibuf_predecode);
+
 	if (peer->obuf) {
 		stream_fifo_free(peer->obuf);
 		peer->obuf = NULL;
@@ -3004,7 +3008,6 @@ static struct bgp *bgp_create(as_t *as, const char *name,
 	bgp->peer->cmp = (int (*)(void *, void *))peer_cmp;
 	bgp->peerhash = hash_create(peer_hash_key_make, peer_hash_same,
 				    "BGP Peer Hash");
-	bgp->peerhash->max_size = BGP_PEER_MAX_HASH_SIZE;
 
 	bgp->group = list_new();
 	bgp->group->cmp = (int (*)(void *, void *))peer_group_cmp;
@@ -45,7 +45,6 @@
 #include "bgp_nexthop.h"
 
 #define BGP_MAX_HOSTNAME 64	/* Linux max, is larger than most other sys */
-#define BGP_PEER_MAX_HASH_SIZE 16384
 
 /* Default interval for IPv6 RAs when triggered by BGP unnumbered neighbor. */
 #define BGP_UNNUM_DEFAULT_RA_INTERVAL 10
@@ -360,6 +359,16 @@ struct bgp {
 		uint32_t updgrps_deleted;
 		uint32_t subgrps_created;
 		uint32_t subgrps_deleted;
+
+		/* UPDATEs encoded on the update worker pthreads */
+		uint32_t update_worker_runs;
+		uint32_t updates_offloaded;
+
+		/* attribute blocks taken from the update group encoding
+		 * cache, or encoded and added to it
+		 */
+		uint32_t attr_encode_hits;
+		uint32_t attr_encode_misses;
 	} update_group_stats;
 
 	/* BGP configuration.  */
@@ -902,6 +911,20 @@ enum bgp_fsm_status {
 	BGP_STATUS_MAX,
 };
 
+/* UPDATE attributes decoded by the I/O pthread, see bgp_attr_predecode() */
+PREDECL_LIST(bgp_predecode_fifo)
+struct bgp_attr_predecode {
+	struct bgp_predecode_fifo_item fifo;
+
+	/* packet on peer->ibuf this belongs to */
+	const struct stream *pkt;
+
+	/* decoded but not interned */
+	struct aspath *aspath;
+	struct community *community;
+};
+DECLARE_LIST(bgp_predecode_fifo, struct bgp_attr_predecode, fifo)
+
 /* BGP neighbor structure. */
 struct peer {
 	/* BGP structure.  */
@@ -943,11 +966,13 @@ struct peer {
 	pthread_mutex_t io_mtx;   // guards ibuf, obuf
 	struct stream_fifo *ibuf; // packets waiting to be processed
 	struct stream_fifo *obuf; // packets waiting to be written
+	struct bgp_predecode_fifo_head ibuf_predecode; // for UPDATEs on ibuf
 
 	struct ringbuf *ibuf_work; // WiP buffer used by bgp_read() only
 	struct stream *obuf_work;  // WiP buffer used to construct packets
 
 	struct stream *curr; // the current packet being parsed
+	struct bgp_attr_predecode *curr_predecode; // and its decoded attrs
 
 	/* We use a separate stream to encode MP_REACH_NLRI for efficient
 	 * NLRI packing. peer->obuf_work stores all the other attributes. The
@@ -150,8 +150,108 @@ typedef enum fpm_msg_type_e_ {
 	 */
 	FPM_MSG_TYPE_NETLINK = 1,
 	FPM_MSG_TYPE_PROTOBUF = 2,
+
+	/*
+	 * Session resume bookkeeping, the payload is a
+	 * fpm_generation_msg_t. Only exchanged when session resume is
+	 * configured on the zebra side.
+	 */
+	FPM_MSG_TYPE_GENERATION = 3,
+
+	/*
+	 * Flow control, the payload is a fpm_window_msg_t. Only exchanged
+	 * when flow control is configured on the zebra side.
+	 */
+	FPM_MSG_TYPE_WINDOW = 4,
 } fpm_msg_type_e;
 
+/*
+ * Every route change zebra hands to the FPM carries a generation number,
+ * which only ever grows during the life of a zebra process. The FPM tells
+ * zebra which generation it has applied, so that after a reconnection zebra
+ * only replays the routes that changed since then instead of the whole
+ * table.
+ */
+typedef enum fpm_generation_op_e_ {
+	/*
+	 * FPM -> zebra, first message of a session: the last generation
+	 * the FPM has applied, 0 if it has no state.
+	 */
+	FPM_GENERATION_RESUME = 1,
+
+	/*
+	 * zebra -> FPM, answers FPM_GENERATION_RESUME: the routes that
+	 * follow are the changes since the given generation, or the whole
+	 * table if it is 0. In the latter case the FPM must drop the routes
+	 * it had but did not receive again before the next marker.
+	 */
+	FPM_GENERATION_REPLAY = 2,
+
+	/*
+	 * zebra -> FPM: every change up to and including the given
+	 * generation was sent before this message.
+	 */
+	FPM_GENERATION_MARKER = 3,
+
+	/*
+	 * FPM -> zebra: every change up to and including the given
+	 * generation was applied. Should be sent in reply to markers, zebra
+	 * holds on to deleted prefixes until they are acknowledged.
+	 */
+	FPM_GENERATION_ACK = 4,
+} fpm_generation_op_e;
+
+#ifdef __SUNPRO_C
+#pragma pack(1)
+#endif
+
+typedef struct fpm_generation_msg_t_ {
+	/*
+	 * One of fpm_generation_op_e.
+	 */
+	uint8_t op;
+
+	/*
+	 * Keeps the message netlink aligned.
+	 */
+	uint8_t reserved[3];
+
+	/*
+	 * Generation, in network byte order.
+	 */
+	uint64_t generation;
+} __attribute__((packed)) fpm_generation_msg_t;
+
+/*
+ * Sent by the FPM to pace zebra on one connection. zebra counts the
+ * messages it sends on each connection, starting over with every new
+ * connection, and keeps at most 'window' of them past 'acked'
+ * outstanding. zebra does not limit a connection until the FPM sends
+ * the first of these.
+ */
+typedef struct fpm_window_msg_t_ {
+	/*
+	 * Amount of messages the FPM takes beyond 'acked', in network byte
+	 * order.
+	 */
+	uint32_t window;
+
+	/*
+	 * Keeps 'acked' aligned.
+	 */
+	uint32_t reserved;
+
+	/*
+	 * Amount of messages received on this connection the FPM is done
+	 * with, in network byte order.
+	 */
+	uint64_t acked;
+} __attribute__((packed)) fpm_window_msg_t;
+
+#ifdef __SUNPRO_C
+#pragma pack()
+#endif
+
 /*
  * The FPM message header is aligned to the same boundary as netlink
  * messages (4). This means that a netlink message does not need
@@ -27,7 +27,7 @@ static struct route_node *agg_node_create(route_table_delegate_t *delegate,
 {
 	struct agg_node *node;
 
-	node = XCALLOC(MTYPE_TMP, sizeof(struct agg_node));
+	node = route_table_node_alloc(table, sizeof(struct agg_node));
 
 	return agg_node_to_rnode(node);
 }
@@ -38,7 +38,7 @@ static void agg_node_destroy(route_table_delegate_t *delegate,
 {
 	struct agg_node *anode = agg_node_from_rnode(node);
 
-	XFREE(MTYPE_TMP, anode);
+	route_table_node_free(table, anode);
 }
 
 static route_table_delegate_t agg_table_delegate = {
@@ -398,12 +398,43 @@ static int distribute_print(struct vty *vty, char *tab[], int is_prefix,
 	return has_print;
 }
 
+struct distribute_show_arg {
+	struct vty *vty;
+	enum distribute_type v4;
+	enum distribute_type v6;
+};
+
+static void distribute_show_iface(struct hash_bucket *hb, void *arg)
+{
+	struct distribute_show_arg *show_arg = arg;
+	struct vty *vty = show_arg->vty;
+	struct distribute *dist = hb->data;
+	int has_print;
+
+	if (!dist->ifname)
+		return;
+
+	vty_out(vty, "    %s filtered by", dist->ifname);
+	has_print = 0;
+	has_print = distribute_print(vty, dist->list, 0, show_arg->v4,
+				     has_print);
+	has_print = distribute_print(vty, dist->prefix, 1, show_arg->v4,
+				     has_print);
+	has_print = distribute_print(vty, dist->list, 0, show_arg->v6,
+				     has_print);
+	has_print = distribute_print(vty, dist->prefix, 1, show_arg->v6,
+				     has_print);
+	if (has_print)
+		vty_out(vty, "\n");
+	else
+		vty_out(vty, " nothing\n");
+}
+
 int config_show_distribute(struct vty *vty, struct distribute_ctx *dist_ctxt)
 {
-	unsigned int i;
 	int has_print = 0;
-	struct hash_bucket *mp;
 	struct distribute *dist;
+	struct distribute_show_arg show_arg = {.vty = vty};
 
 	/* Output filter configuration. */
 	dist = distribute_lookup(dist_ctxt, NULL);
@@ -424,31 +455,9 @@ int config_show_distribute(struct vty *vty, struct distribute_ctx *dist_ctxt)
 	else
 		vty_out(vty, " not set\n");
 
-	for (i = 0; i < dist_ctxt->disthash->size; i++)
-		for (mp = dist_ctxt->disthash->index[i]; mp; mp = mp->next) {
-			dist = mp->data;
-			if (dist->ifname) {
-				vty_out(vty, "    %s filtered by",
-					dist->ifname);
-				has_print = 0;
-				has_print = distribute_print(vty, dist->list, 0,
-							     DISTRIBUTE_V4_OUT,
-							     has_print);
-				has_print = distribute_print(
-					vty, dist->prefix, 1, DISTRIBUTE_V4_OUT,
-					has_print);
-				has_print = distribute_print(vty, dist->list, 0,
-							     DISTRIBUTE_V6_OUT,
-							     has_print);
-				has_print = distribute_print(
-					vty, dist->prefix, 1, DISTRIBUTE_V6_OUT,
-					has_print);
-				if (has_print)
-					vty_out(vty, "\n");
-				else
-					vty_out(vty, " nothing\n");
-			}
-		}
+	show_arg.v4 = DISTRIBUTE_V4_OUT;
+	show_arg.v6 = DISTRIBUTE_V6_OUT;
+	hash_iterate(dist_ctxt->disthash, distribute_show_iface, &show_arg);
 
 
 	/* Input filter configuration. */
@@ -470,83 +479,58 @@ int config_show_distribute(struct vty *vty, struct distribute_ctx *dist_ctxt)
 	else
 		vty_out(vty, " not set\n");
 
-	for (i = 0; i < dist_ctxt->disthash->size; i++)
-		for (mp = dist_ctxt->disthash->index[i]; mp; mp = mp->next) {
-			dist = mp->data;
-			if (dist->ifname) {
-				vty_out(vty, "    %s filtered by",
-					dist->ifname);
-				has_print = 0;
-				has_print = distribute_print(vty, dist->list, 0,
-							     DISTRIBUTE_V4_IN,
-							     has_print);
-				has_print = distribute_print(
-					vty, dist->prefix, 1, DISTRIBUTE_V4_IN,
-					has_print);
-				has_print = distribute_print(vty, dist->list, 0,
-							     DISTRIBUTE_V6_IN,
-							     has_print);
-				has_print = distribute_print(
-					vty, dist->prefix, 1, DISTRIBUTE_V6_IN,
-					has_print);
-				if (has_print)
-					vty_out(vty, "\n");
-				else
-					vty_out(vty, " nothing\n");
-			}
-		}
+	show_arg.v4 = DISTRIBUTE_V4_IN;
+	show_arg.v6 = DISTRIBUTE_V6_IN;
+	hash_iterate(dist_ctxt->disthash, distribute_show_iface, &show_arg);
 	return 0;
 }
 
-/* Configuration write function. */
-int config_write_distribute(struct vty *vty,
-			    struct distribute_ctx *dist_ctxt)
+struct distribute_write_arg {
+	struct vty *vty;
+	int write;
+};
+
+static void distribute_write_iface(struct hash_bucket *hb, void *arg)
 {
-	unsigned int i;
+	struct distribute_write_arg *write_arg = arg;
+	struct vty *vty = write_arg->vty;
+	struct distribute *dist = hb->data;
 	int j;
 	int output, v6;
-	struct hash_bucket *mp;
-	int write = 0;
-
-	for (i = 0; i < dist_ctxt->disthash->size; i++)
-		for (mp = dist_ctxt->disthash->index[i]; mp; mp = mp->next) {
-			struct distribute *dist;
-
-			dist = mp->data;
-
-			for (j = 0; j < DISTRIBUTE_MAX; j++)
-				if (dist->list[j]) {
-					output = j == DISTRIBUTE_V4_OUT
-						 || j == DISTRIBUTE_V6_OUT;
-					v6 = j == DISTRIBUTE_V6_IN
-					     || j == DISTRIBUTE_V6_OUT;
-					vty_out(vty,
-						" %sdistribute-list %s %s %s\n",
-						v6 ? "ipv6 " : "",
-						dist->list[j],
-						output ? "out" : "in",
-						dist->ifname ? dist->ifname
-							     : "");
-					write++;
-				}
-
-			for (j = 0; j < DISTRIBUTE_MAX; j++)
-				if (dist->prefix[j]) {
-					output = j == DISTRIBUTE_V4_OUT
-						 || j == DISTRIBUTE_V6_OUT;
-					v6 = j == DISTRIBUTE_V6_IN
-					     || j == DISTRIBUTE_V6_OUT;
-					vty_out(vty,
-						" %sdistribute-list prefix %s %s %s\n",
-						v6 ? "ipv6 " : "",
-						dist->prefix[j],
-						output ? "out" : "in",
-						dist->ifname ? dist->ifname
-							     : "");
-					write++;
-				}
+
+	for (j = 0; j < DISTRIBUTE_MAX; j++)
+		if (dist->list[j]) {
+			output = j == DISTRIBUTE_V4_OUT
+				 || j == DISTRIBUTE_V6_OUT;
+			v6 = j == DISTRIBUTE_V6_IN || j == DISTRIBUTE_V6_OUT;
+			vty_out(vty, " %sdistribute-list %s %s %s\n",
+				v6 ? "ipv6 " : "", dist->list[j],
+				output ? "out" : "in",
+				dist->ifname ? dist->ifname : "");
+			write_arg->write++;
 		}
-	return write;
+
+	for (j = 0; j < DISTRIBUTE_MAX; j++)
+		if (dist->prefix[j]) {
+			output = j == DISTRIBUTE_V4_OUT
+				 || j == DISTRIBUTE_V6_OUT;
+			v6 = j == DISTRIBUTE_V6_IN || j == DISTRIBUTE_V6_OUT;
+			vty_out(vty, " %sdistribute-list prefix %s %s %s\n",
+				v6 ? "ipv6 " : "", dist->prefix[j],
+				output ? "out" : "in",
+				dist->ifname ? dist->ifname : "");
+			write_arg->write++;
+		}
+}
+
+/* Configuration write function. */
+int config_write_distribute(struct vty *vty,
+			    struct distribute_ctx *dist_ctxt)
+{
+	struct distribute_write_arg write_arg = {.vty = vty};
+
+	hash_iterate(dist_ctxt->disthash, distribute_write_iface, &write_arg);
+	return write_arg.write;
 }
 
 void distribute_list_delete(struct distribute_ctx **ctx)
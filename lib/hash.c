@@ -19,7 +19,6 @@
  */
 
 #include <zebra.h>
-#include <math.h>
 
 #include "hash.h"
 #include "memory.h"
@@ -31,12 +30,20 @@
 #include "frr_pthread.h"
 
 DEFINE_MTYPE_STATIC(LIB, HASH, "Hash")
-DEFINE_MTYPE_STATIC(LIB, HASH_BACKET, "Hash Bucket")
 DEFINE_MTYPE_STATIC(LIB, HASH_INDEX, "Hash Index")
 
 static pthread_mutex_t _hashes_mtx = PTHREAD_MUTEX_INITIALIZER;
 static struct list *_hashes;
 
+/*
+ * Released entries leave this marker behind in their slot, so that probe
+ * sequences running across the slot are not cut short.
+ */
+static char hash_deleted;
+#define HASH_DELETED ((void *)&hash_deleted)
+
+#define HASH_SLOT_LIVE(hb) ((hb)->data && (hb)->data != HASH_DELETED)
+
 struct hash *hash_create_size(unsigned int size,
 			      unsigned int (*hash_key)(const void *),
 			      bool (*hash_cmp)(const void *, const void *),
@@ -47,13 +54,12 @@ struct hash *hash_create_size(unsigned int size,
 	assert((size & (size - 1)) == 0);
 	hash = XCALLOC(MTYPE_HASH, sizeof(struct hash));
 	hash->index =
-		XCALLOC(MTYPE_HASH_INDEX, sizeof(struct hash_bucket *) * size);
+		XCALLOC(MTYPE_HASH_INDEX, sizeof(struct hash_bucket) * size);
 	hash->size = size;
 	hash->hash_key = hash_key;
 	hash->hash_cmp = hash_cmp;
 	hash->count = 0;
 	hash->name = name ? XSTRDUP(MTYPE_HASH, name) : NULL;
-	hash->stats.empty = hash->size;
 
 	frr_with_mutex(&_hashes_mtx) {
 		if (!_hashes)
@@ -78,113 +84,206 @@ void *hash_alloc_intern(void *arg)
 }
 
 /*
- * ssq = ssq + (new^2 - old^2)
- *     = ssq + ((new + old) * (new - old))
+ * Home slot of a key.  Linear probing needs the keys spread evenly over the
+ * index, but plenty of hash_key functions simply return some ID, so the key
+ * is mixed first (murmur3 finalizer).
  */
-#define hash_update_ssq(hz, old, new)                                          \
-	do {                                                                   \
-		int _adjust = (new + old) * (new - old);                       \
-		if (_adjust < 0)                                               \
-			atomic_fetch_sub_explicit(&hz->stats.ssq, -_adjust,    \
-						  memory_order_relaxed);       \
-		else                                                           \
-			atomic_fetch_add_explicit(&hz->stats.ssq, _adjust,     \
-						  memory_order_relaxed);       \
-	} while (0)
-
-/* Expand hash if the chain length exceeds the threshold. */
-static void hash_expand(struct hash *hash)
+static inline unsigned int hash_home(unsigned int key, unsigned int size)
 {
-	unsigned int i, new_size;
-	struct hash_bucket *hb, *hbnext, **new_index;
+	key ^= key >> 16;
+	key *= 0x85ebca6b;
+	key ^= key >> 13;
+	key *= 0xc2b2ae35;
+	key ^= key >> 16;
 
-	new_size = hash->size * 2;
+	return key & (size - 1);
+}
 
-	if (hash->max_size && new_size > hash->max_size)
-		return;
+/* Number of slots looked at to find the entry with key stored at pos */
+static inline unsigned int hash_probe_len(unsigned int key, unsigned int pos,
+					  unsigned int size)
+{
+	return ((pos - hash_home(key, size)) & (size - 1)) + 1;
+}
 
-	new_index = XCALLOC(MTYPE_HASH_INDEX,
-			    sizeof(struct hash_bucket *) * new_size);
+static void hash_stats_add(struct hash *hash, unsigned int len)
+{
+	atomic_fetch_add_explicit(&hash->stats.probes, len,
+				  memory_order_relaxed);
 
-	hash->stats.empty = new_size;
+	if (len > atomic_load_explicit(&hash->stats.probe_max,
+				       memory_order_relaxed))
+		atomic_store_explicit(&hash->stats.probe_max, len,
+				      memory_order_relaxed);
+}
 
-	for (i = 0; i < hash->size; i++)
-		for (hb = hash->index[i]; hb; hb = hbnext) {
-			unsigned int h = hb->key & (new_size - 1);
+static void hash_stats_sub(struct hash *hash, unsigned int len)
+{
+	atomic_fetch_sub_explicit(&hash->stats.probes, len,
+				  memory_order_relaxed);
+}
 
-			hbnext = hb->next;
-			hb->next = new_index[h];
+static struct hash_bucket *hash_find_slot(struct hash *hash,
+					  struct hash_bucket *index,
+					  unsigned int size, unsigned int key,
+					  const void *data)
+{
+	struct hash_bucket *hb;
+	unsigned int i, n;
 
-			int oldlen = hb->next ? hb->next->len : 0;
-			int newlen = oldlen + 1;
+	for (i = hash_home(key, size), n = 0; n < size;
+	     i = (i + 1) & (size - 1), n++) {
+		hb = &index[i];
 
-			if (newlen == 1)
-				hash->stats.empty--;
-			else
-				hb->next->len = 0;
+		if (!hb->data)
+			return NULL;
+		if (hb->data != HASH_DELETED && hb->key == key
+		    && (*hash->hash_cmp)(hb->data, data))
+			return hb;
+	}
+
+	return NULL;
+}
+
+/* Caller makes sure the entry is not in the table yet and there is room */
+static void hash_insert_slot(struct hash *hash, unsigned int key, void *data)
+{
+	struct hash_bucket *hb;
+	unsigned int i;
 
-			hb->len = newlen;
+	for (i = hash_home(key, hash->size); HASH_SLOT_LIVE(&hash->index[i]);
+	     i = (i + 1) & (hash->size - 1))
+		;
 
-			hash_update_ssq(hash, oldlen, newlen);
+	hb = &hash->index[i];
+	if (hb->data == HASH_DELETED)
+		atomic_fetch_sub_explicit(&hash->stats.tombstones, 1,
+					  memory_order_relaxed);
+	else
+		hash->used++;
+
+	hb->key = key;
+	hb->data = data;
+
+	hash_stats_add(hash, hash_probe_len(key, i, hash->size));
+}
 
-			new_index[h] = hb;
+/*
+ * Move at least steps slots of the previous index over to the current one.
+ *
+ * Slots are emptied as their entries move, which would cut short the probe
+ * sequences of entries further down the same run of occupied slots.  Runs are
+ * therefore always moved as a whole: the move starts out at an empty slot and
+ * only stops in front of another one.
+ */
+static void hash_rehash_step(struct hash *hash, unsigned int steps)
+{
+	struct hash_bucket *hb;
+	unsigned int pos, mask;
+
+	while (hash->old_index) {
+		mask = hash->old_size - 1;
+		pos = (hash->rehash_start + hash->rehash_done) & mask;
+		hb = &hash->old_index[pos];
+
+		if (HASH_SLOT_LIVE(hb)) {
+			hash_stats_sub(hash, hash_probe_len(hb->key, pos,
+							    hash->old_size));
+			hash_insert_slot(hash, hb->key, hb->data);
+		}
+		hb->data = NULL;
+
+		if (++hash->rehash_done == hash->old_size) {
+			XFREE(MTYPE_HASH_INDEX, hash->old_index);
+			hash->old_size = 0;
+			hash->rehash_start = 0;
+			hash->rehash_done = 0;
+			break;
 		}
 
-	/* Switch to new table */
-	XFREE(MTYPE_HASH_INDEX, hash->index);
+		if (steps)
+			steps--;
+		if (!steps && !hash->old_index[(pos + 1) & mask].data)
+			break;
+	}
+}
+
+/*
+ * Start moving the entries over to a new index.  The index is doubled when
+ * more than half of it would be live entries after the next insertion,
+ * otherwise the same size is kept and the resize only gets rid of deleted
+ * slots.
+ */
+static void hash_resize(struct hash *hash)
+{
+	unsigned int new_size = hash->size;
+	unsigned int start;
+
+	/* only one resize at a time */
+	hash_rehash_step(hash, UINT_MAX);
+
+	if ((hash->count + 1) * 2 > hash->size)
+		new_size *= 2;
+
+	/* there always is an empty slot, the index is never full */
+	for (start = 0; hash->index[start].data; start++)
+		;
+
+	hash->old_index = hash->index;
+	hash->old_size = hash->size;
+	hash->rehash_start = start;
+	hash->rehash_done = 0;
+
+	hash->index = XCALLOC(MTYPE_HASH_INDEX,
+			      sizeof(struct hash_bucket) * new_size);
 	hash->size = new_size;
-	hash->index = new_index;
+	hash->used = 0;
+
+	atomic_store_explicit(&hash->stats.tombstones, 0, memory_order_relaxed);
+	atomic_store_explicit(&hash->stats.probe_max, 0, memory_order_relaxed);
 }
 
 void *hash_get(struct hash *hash, void *data, void *(*alloc_func)(void *))
 {
 	unsigned int key;
-	unsigned int index;
 	void *newdata;
-	struct hash_bucket *bucket;
+	struct hash_bucket *hb;
 
 	if (!alloc_func && !hash->count)
 		return NULL;
 
 	key = (*hash->hash_key)(data);
-	index = key & (hash->size - 1);
 
-	for (bucket = hash->index[index]; bucket != NULL;
-	     bucket = bucket->next) {
-		if (bucket->key == key && (*hash->hash_cmp)(bucket->data, data))
-			return bucket->data;
-	}
+	hb = hash_find_slot(hash, hash->index, hash->size, key, data);
+	if (!hb && hash->old_index)
+		hb = hash_find_slot(hash, hash->old_index, hash->old_size, key,
+				    data);
+	if (hb)
+		return hb->data;
 
 	if (alloc_func) {
 		newdata = (*alloc_func)(data);
 		if (newdata == NULL)
 			return NULL;
 
-		if (HASH_THRESHOLD(hash->count + 1, hash->size)) {
-			hash_expand(hash);
-			index = key & (hash->size - 1);
+		if (!hash->iterating) {
+			/* spread the cost of a resize over many insertions */
+			hash_rehash_step(hash, HASH_REHASH_STEP);
+
+			if (HASH_THRESHOLD(hash->used + 1, hash->size))
+				hash_resize(hash);
+		} else if (hash->used + 1 >= hash->size) {
+			/* entries must not move under an iteration, unless
+			 * there is no other way to make room
+			 */
+			hash_resize(hash);
+			hash_rehash_step(hash, UINT_MAX);
 		}
 
-		bucket = XCALLOC(MTYPE_HASH_BACKET, sizeof(struct hash_bucket));
-		bucket->data = newdata;
-		bucket->key = key;
-		bucket->next = hash->index[index];
-		hash->index[index] = bucket;
+		hash_insert_slot(hash, key, newdata);
 		hash->count++;
 
-		int oldlen = bucket->next ? bucket->next->len : 0;
-		int newlen = oldlen + 1;
-
-		if (newlen == 1)
-			hash->stats.empty--;
-		else
-			bucket->next->len = 0;
-
-		bucket->len = newlen;
-
-		hash_update_ssq(hash, oldlen, newlen);
-
-		return bucket->data;
+		return newdata;
 	}
 	return NULL;
 }
@@ -208,56 +307,90 @@ void *hash_release(struct hash *hash, void *data)
 {
 	void *ret;
 	unsigned int key;
-	unsigned int index;
-	struct hash_bucket *bucket;
-	struct hash_bucket *pp;
+	unsigned int pos;
+	struct hash_bucket *hb;
 
 	key = (*hash->hash_key)(data);
-	index = key & (hash->size - 1);
-
-	for (bucket = pp = hash->index[index]; bucket; bucket = bucket->next) {
-		if (bucket->key == key
-		    && (*hash->hash_cmp)(bucket->data, data)) {
-			int oldlen = hash->index[index]->len;
-			int newlen = oldlen - 1;
-
-			if (bucket == pp)
-				hash->index[index] = bucket->next;
-			else
-				pp->next = bucket->next;
-
-			if (hash->index[index])
-				hash->index[index]->len = newlen;
-			else
-				hash->stats.empty++;
-
-			hash_update_ssq(hash, oldlen, newlen);
-
-			ret = bucket->data;
-			XFREE(MTYPE_HASH_BACKET, bucket);
-			hash->count--;
-			return ret;
+
+	hb = hash_find_slot(hash, hash->index, hash->size, key, data);
+	if (hb) {
+		pos = hb - hash->index;
+		hash_stats_sub(hash, hash_probe_len(key, pos, hash->size));
+		ret = hb->data;
+		hb->data = HASH_DELETED;
+
+		/* Deleted slots right in front of an empty one are not part
+		 * of any probe sequence anymore and can be emptied as well.
+		 */
+		if (hash->index[(pos + 1) & (hash->size - 1)].data) {
+			atomic_fetch_add_explicit(&hash->stats.tombstones, 1,
+						  memory_order_relaxed);
+		} else {
+			while (hash->index[pos].data == HASH_DELETED) {
+				if (&hash->index[pos] != hb)
+					atomic_fetch_sub_explicit(
+						&hash->stats.tombstones, 1,
+						memory_order_relaxed);
+				hash->index[pos].data = NULL;
+				hash->used--;
+				pos = (pos - 1) & (hash->size - 1);
+			}
 		}
-		pp = bucket;
+	} else if (hash->old_index) {
+		hb = hash_find_slot(hash, hash->old_index, hash->old_size, key,
+				    data);
+		if (!hb)
+			return NULL;
+
+		pos = hb - hash->old_index;
+		hash_stats_sub(hash, hash_probe_len(key, pos, hash->old_size));
+		ret = hb->data;
+		hb->data = HASH_DELETED;
+	} else
+		return NULL;
+
+	hash->count--;
+
+	if (!hash->iterating) {
+		hash_rehash_step(hash, HASH_REHASH_STEP);
+
+		/* too many deleted slots make for long probe sequences */
+		if (atomic_load_explicit(&hash->stats.tombstones,
+					 memory_order_relaxed)
+		    > hash->size / 4)
+			hash_resize(hash);
 	}
-	return NULL;
+
+	return ret;
 }
 
+/*
+ * Iteration runs over the previous index (if a resize is in progress) and then
+ * the current one.  Entries are not moved between the two while an iteration
+ * is running, and released entries merely leave a deleted slot behind, so
+ * both releasing the current entry and any other one are safe.
+ */
 void hash_iterate(struct hash *hash, void (*func)(struct hash_bucket *, void *),
 		  void *arg)
 {
 	unsigned int i;
 	struct hash_bucket *hb;
-	struct hash_bucket *hbnext;
 
-	for (i = 0; i < hash->size; i++)
-		for (hb = hash->index[i]; hb; hb = hbnext) {
-			/* get pointer to next hash bucket here, in case (*func)
-			 * decides to delete hb by calling hash_release
-			 */
-			hbnext = hb->next;
+	hash->iterating++;
+
+	for (i = 0; i < hash->old_size; i++) {
+		hb = &hash->old_index[i];
+		if (HASH_SLOT_LIVE(hb))
 			(*func)(hb, arg);
-		}
+	}
+
+	for (i = 0; i < hash->size; i++) {
+		hb = &hash->index[i];
+		if (HASH_SLOT_LIVE(hb))
+			(*func)(hb, arg);
+	}
+
+	hash->iterating--;
 }
 
 void hash_walk(struct hash *hash, int (*func)(struct hash_bucket *, void *),
@@ -265,43 +398,59 @@ void hash_walk(struct hash *hash, int (*func)(struct hash_bucket *, void *),
 {
 	unsigned int i;
 	struct hash_bucket *hb;
-	struct hash_bucket *hbnext;
 	int ret = HASHWALK_CONTINUE;
 
-	for (i = 0; i < hash->size; i++) {
-		for (hb = hash->index[i]; hb; hb = hbnext) {
-			/* get pointer to next hash bucket here, in case (*func)
-			 * decides to delete hb by calling hash_release
-			 */
-			hbnext = hb->next;
+	hash->iterating++;
+
+	for (i = 0; i < hash->old_size && ret != HASHWALK_ABORT; i++) {
+		hb = &hash->old_index[i];
+		if (HASH_SLOT_LIVE(hb))
+			ret = (*func)(hb, arg);
+	}
+
+	for (i = 0; i < hash->size && ret != HASHWALK_ABORT; i++) {
+		hb = &hash->index[i];
+		if (HASH_SLOT_LIVE(hb))
 			ret = (*func)(hb, arg);
-			if (ret == HASHWALK_ABORT)
-				return;
-		}
 	}
+
+	hash->iterating--;
 }
 
 void hash_clean(struct hash *hash, void (*free_func)(void *))
 {
 	unsigned int i;
 	struct hash_bucket *hb;
-	struct hash_bucket *next;
 
-	for (i = 0; i < hash->size; i++) {
-		for (hb = hash->index[i]; hb; hb = next) {
-			next = hb->next;
+	if (free_func) {
+		hash->iterating++;
 
-			if (free_func)
+		for (i = 0; i < hash->old_size; i++) {
+			hb = &hash->old_index[i];
+			if (HASH_SLOT_LIVE(hb))
+				(*free_func)(hb->data);
+		}
+		for (i = 0; i < hash->size; i++) {
+			hb = &hash->index[i];
+			if (HASH_SLOT_LIVE(hb))
 				(*free_func)(hb->data);
-
-			XFREE(MTYPE_HASH_BACKET, hb);
-			hash->count--;
 		}
-		hash->index[i] = NULL;
+
+		hash->iterating--;
 	}
 
-	hash->stats.ssq = 0;
-	hash->stats.empty = hash->size;
+	XFREE(MTYPE_HASH_INDEX, hash->old_index);
+	hash->old_size = 0;
+	hash->rehash_start = 0;
+	hash->rehash_done = 0;
+
+	memset(hash->index, 0, sizeof(struct hash_bucket) * hash->size);
+	hash->used = 0;
+	hash->count = 0;
+
+	atomic_store_explicit(&hash->stats.probes, 0, memory_order_relaxed);
+	atomic_store_explicit(&hash->stats.probe_max, 0, memory_order_relaxed);
+	atomic_store_explicit(&hash->stats.tombstones, 0, memory_order_relaxed);
 }
 
 static void hash_to_list_iter(struct hash_bucket *hb, void *arg)
@@ -332,6 +481,7 @@ void hash_free(struct hash *hash)
 
 	XFREE(MTYPE_HASH, hash->name);
 
+	XFREE(MTYPE_HASH_INDEX, hash->old_index);
 	XFREE(MTYPE_HASH_INDEX, hash->index);
 	XFREE(MTYPE_HASH, hash);
 }
@@ -351,7 +501,8 @@ DEFUN_NOSH(show_hash_stats,
 	struct listnode *ln;
 	struct ttable *tt = ttable_new(&ttable_styles[TTSTYLE_BLANK]);
 
-	ttable_add_row(tt, "Hash table|Buckets|Entries|Empty|LF|SD|FLF|SD");
+	ttable_add_row(tt,
+		       "Hash table|Slots|Entries|Deleted|LF|Avg probe|Max probe|Resizing");
 	tt->style.cell.lpad = 2;
 	tt->style.cell.rpad = 1;
 	tt->style.corner = '+';
@@ -361,38 +512,26 @@ DEFUN_NOSH(show_hash_stats,
 	/* Summary statistics calculated are:
 	 *
 	 * - Load factor: This is the number of elements in the table divided
-	 *   by the number of buckets. Since this hash table implementation
-	 *   uses chaining, this value can be greater than 1.
-	 *   This number provides information on how 'full' the table is, but
-	 *   does not provide information on how evenly distributed the
-	 *   elements are.
-	 *   Notably, a load factor >= 1 does not imply that every bucket has
-	 *   an element; with a pathological hash function, all elements could
-	 *   be in a single bucket.
+	 *   by the number of slots.  The table is open addressed, so this is
+	 *   always below 1; deleted slots are not included.
+	 *
+	 * - Deleted: slots of released entries that still take part in probe
+	 *   sequences.  They are reclaimed by the next resize.
 	 *
-	 * - Full load factor: this is the number of elements in the table
-	 *   divided by the number of buckets that have some elements in them.
+	 * - Average probe length: the number of slots looked at on average to
+	 *   find an entry of the table.  1 means every entry sits in its home
+	 *   slot; values well above 2 point to a poor hash function.
 	 *
-	 * - Std. Dev.: This is the standard deviation calculated from the
-	 *   relevant load factor. If the load factor is the mean of number of
-	 *   elements per bucket, the standard deviation measures how much any
-	 *   particular bucket is likely to deviate from the mean.
-	 *   As a rule of thumb this number should be less than 2, and ideally
-	 *   <= 1 for optimal performance. A number larger than 3 generally
-	 *   indicates a poor hash function.
+	 * - Maximum probe length: the longest probe sequence of an entry
+	 *   inserted since the table was last resized.
+	 *
+	 * - Resizing: progress of an incremental resize in progress, i.e. the
+	 *   share of the previous index moved over to the current one.
 	 */
 
 	double lf;    // load factor
-	double flf;   // full load factor
-	double var;   // overall variance
-	double fvar;  // full variance
-	double stdv;  // overall stddev
-	double fstdv; // full stddev
-
-	long double x2;   // h->count ^ 2
-	long double ldc;  // (long double) h->count
-	long double full; // h->size - h->stats.empty
-	long double ssq;  // ssq casted to long double
+	double probe; // average probe length
+	char resizing[16];
 
 	pthread_mutex_lock(&_hashes_mtx);
 	if (!_hashes) {
@@ -406,23 +545,27 @@ DEFUN_NOSH(show_hash_stats,
 		if (!h->name)
 			continue;
 
-		ssq = (long double)h->stats.ssq;
-		x2 = h->count * h->count;
-		ldc = (long double)h->count;
-		full = h->size - h->stats.empty;
 		lf = h->count / (double)h->size;
-		flf = full ? h->count / (double)(full) : 0;
-		var = ldc ? (1.0 / ldc) * (ssq - x2 / ldc) : 0;
-		fvar = full ? (1.0 / full) * (ssq - x2 / full) : 0;
-		var = (var < .0001) ? 0 : var;
-		fvar = (fvar < .0001) ? 0 : fvar;
-		stdv = sqrt(var);
-		fstdv = sqrt(fvar);
-
-		ttable_add_row(tt, "%s|%d|%ld|%.0f%%|%.2lf|%.2lf|%.2lf|%.2lf",
-			       h->name, h->size, h->count,
-			       (h->stats.empty / (double)h->size) * 100, lf,
-			       stdv, flf, fstdv);
+		probe = h->count ? atomic_load_explicit(&h->stats.probes,
+							memory_order_relaxed)
+					   / (double)h->count
+				 : 0;
+
+		if (h->old_size)
+			snprintf(resizing, sizeof(resizing), "%.0f%%",
+				 h->rehash_done / (double)h->old_size * 100);
+		else
+			strlcpy(resizing, "-", sizeof(resizing));
+
+		ttable_add_row(
+			tt, "%s|%u|%lu|%u|%.2lf|%.2lf|%u|%s", h->name, h->size,
+			h->count,
+			(unsigned int)atomic_load_explicit(
+				&h->stats.tombstones, memory_order_relaxed),
+			lf, probe,
+			(unsigned int)atomic_load_explicit(
+				&h->stats.probe_max, memory_order_relaxed),
+			resizing);
 	}
 	pthread_mutex_unlock(&_hashes_mtx);
 
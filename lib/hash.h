@@ -30,22 +30,21 @@ extern "C" {
 
 /* Default hash table size.  */
 #define HASH_INITIAL_SIZE 256
-/* Expansion threshold */
-#define HASH_THRESHOLD(used, size) ((used) > (size))
+/* Expansion threshold, slots in use (including deleted ones) vs. size */
+#define HASH_THRESHOLD(used, size) ((used) * 4 > (size) * 3)
+/* Minimum number of old slots moved per insert/release while resizing */
+#define HASH_REHASH_STEP 8
 
 #define HASHWALK_CONTINUE 0
 #define HASHWALK_ABORT -1
 
+/*
+ * A slot of the table.  Slots live inline in the table's index; the table is
+ * open addressed with linear probing, and the full hash key is kept next to
+ * the data so that mismatches are nearly always resolved without calling
+ * hash_cmp.
+ */
 struct hash_bucket {
-	/*
-	 * if this bucket is the head of the linked listed, len denotes the
-	 * number of elements in the list
-	 */
-	int len;
-
-	/* Linked list.  */
-	struct hash_bucket *next;
-
 	/* Hash key. */
 	unsigned int key;
 
@@ -54,21 +53,35 @@ struct hash_bucket {
 };
 
 struct hashstats {
-	/* number of empty hash buckets */
-	atomic_uint_fast32_t empty;
-	/* sum of squares of bucket length */
-	atomic_uint_fast32_t ssq;
+	/* sum of the probe lengths of all entries */
+	atomic_uint_fast32_t probes;
+	/* longest probe length seen since the last resize */
+	atomic_uint_fast32_t probe_max;
+	/* number of deleted slots in the current index */
+	atomic_uint_fast32_t tombstones;
 };
 
 struct hash {
-	/* Hash bucket. */
-	struct hash_bucket **index;
+	/* Hash slots. */
+	struct hash_bucket *index;
 
 	/* Hash table size. Must be power of 2 */
 	unsigned int size;
 
-	/* If max_size is 0 there is no limit */
-	unsigned int max_size;
+	/* Slots in index that are not empty, including deleted ones */
+	unsigned int used;
+
+	/* Previous index while a resize is in progress.  Its entries are
+	 * moved over to index a few at a time by insertions and releases,
+	 * rehash_done slots from rehash_start on so far; lookups check both.
+	 */
+	struct hash_bucket *old_index;
+	unsigned int old_size;
+	unsigned int rehash_start;
+	unsigned int rehash_done;
+
+	/* hash_iterate/hash_walk in progress, no entries may be moved */
+	unsigned int iterating;
 
 	/* Key make function. */
 	unsigned int (*hash_key)(const void *);
@@ -90,8 +103,9 @@ struct hash {
 /*
  * Create a hash table.
  *
- * The created hash table uses chaining and a user-provided comparator function
- * to resolve collisions. For best performance use a perfect hash function.
+ * The created hash table uses open addressing and a user-provided comparator
+ * function to resolve collisions. For best performance use a perfect hash
+ * function.
  * Worst case lookup time is O(N) when using a constant hash function. Best
  * case lookup time is O(1) when using a perfect hash function.
  *
@@ -122,13 +136,14 @@ extern struct hash *hash_create(unsigned int (*hash_key)(const void *),
 /*
  * Create a hash table.
  *
- * The created hash table uses chaining and a user-provided comparator function
- * to resolve collisions. For best performance use a perfect hash function.
+ * The created hash table uses open addressing and a user-provided comparator
+ * function to resolve collisions. For best performance use a perfect hash
+ * function.
  * Worst case lookup time is O(N) when using a constant hash function. Best
  * case lookup time is O(1) when using a perfect hash function.
  *
  * size
- *    initial number of hash buckets to allocate; must be a power of 2 or the
+ *    initial number of hash slots to allocate; must be a power of 2 or the
  *    program will assert
  *
  * hash_key
@@ -235,9 +250,8 @@ extern void *hash_release(struct hash *hash, void *data);
 /*
  * Iterate over the elements in a hash table.
  *
- * It is safe to delete items passed to the iteration function from the hash
- * table during iteration. More than one item cannot be deleted during each
- * iteration. Please note that adding entries to the hash
+ * It is safe to delete items from the hash table during iteration.  Please
+ * note that adding entries to the hash
  * during the walk will cause undefined behavior in that some new entries
  * will be walked and some will not.  So do not do this.
  *
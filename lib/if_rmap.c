@@ -255,36 +255,37 @@ DEFUN (no_if_rmap,
 }
 
 
+struct if_rmap_write_arg {
+	struct vty *vty;
+	int write;
+};
+
+static void if_rmap_write_iface(struct hash_bucket *hb, void *arg)
+{
+	struct if_rmap_write_arg *write_arg = arg;
+	struct if_rmap *if_rmap = hb->data;
+
+	if (if_rmap->routemap[IF_RMAP_IN]) {
+		vty_out(write_arg->vty, " route-map %s in %s\n",
+			if_rmap->routemap[IF_RMAP_IN], if_rmap->ifname);
+		write_arg->write++;
+	}
+
+	if (if_rmap->routemap[IF_RMAP_OUT]) {
+		vty_out(write_arg->vty, " route-map %s out %s\n",
+			if_rmap->routemap[IF_RMAP_OUT], if_rmap->ifname);
+		write_arg->write++;
+	}
+}
+
 /* Configuration write function. */
 int config_write_if_rmap(struct vty *vty,
 			 struct if_rmap_ctx *ctx)
 {
-	unsigned int i;
-	struct hash_bucket *mp;
-	int write = 0;
-	struct hash *ifrmaphash = ctx->ifrmaphash;
-
-	for (i = 0; i < ifrmaphash->size; i++)
-		for (mp = ifrmaphash->index[i]; mp; mp = mp->next) {
-			struct if_rmap *if_rmap;
-
-			if_rmap = mp->data;
-
-			if (if_rmap->routemap[IF_RMAP_IN]) {
-				vty_out(vty, " route-map %s in %s\n",
-					if_rmap->routemap[IF_RMAP_IN],
-					if_rmap->ifname);
-				write++;
-			}
-
-			if (if_rmap->routemap[IF_RMAP_OUT]) {
-				vty_out(vty, " route-map %s out %s\n",
-					if_rmap->routemap[IF_RMAP_OUT],
-					if_rmap->ifname);
-				write++;
-			}
-		}
-	return write;
+	struct if_rmap_write_arg write_arg = {.vty = vty};
+
+	hash_iterate(ctx->ifrmaphash, if_rmap_write_iface, &write_arg);
+	return write_arg.write;
 }
 
 void if_rmap_ctx_delete(struct if_rmap_ctx *ctx)
@@ -99,6 +99,7 @@ static void opt_extend(const struct optspec *os)
 #define OPTION_TCLI      1005
 #define OPTION_DB_FILE   1006
 #define OPTION_LOGGING   1007
+#define OPTION_IOBACKEND 1008
 
 static const struct option lo_always[] = {
 	{"help", no_argument, NULL, 'h'},
@@ -113,6 +114,7 @@ static const struct option lo_always[] = {
 	{"log-level", required_argument, NULL, OPTION_LOGLEVEL},
 	{"tcli", no_argument, NULL, OPTION_TCLI},
 	{"command-log-always", no_argument, NULL, OPTION_LOGGING},
+	{"io-backend", required_argument, NULL, OPTION_IOBACKEND},
 	{NULL}};
 static const struct optspec os_always = {
 	"hvdM:F:N:",
@@ -126,7 +128,8 @@ static const struct optspec os_always = {
 	"      --moduledir    Override modules directory\n"
 	"      --log          Set Logging to stdout, syslog, or file:<name>\n"
 	"      --log-level    Set Logging Level to use, debug, info, warn, etc\n"
-	"      --tcli         Use transaction-based CLI\n",
+	"      --tcli         Use transaction-based CLI\n"
+	"      --io-backend   Wait for I/O with poll or epoll\n",
 	lo_always};
 
 
@@ -552,6 +555,13 @@ static int frr_opt(int opt)
 	case OPTION_LOGGING:
 		di->log_always = true;
 		break;
+	case OPTION_IOBACKEND:
+		if (!thread_io_backend_set(optarg)) {
+			fprintf(stderr, "unsupported I/O backend \"%s\"\n",
+				optarg);
+			errors++;
+		}
+		break;
 	default:
 		return 1;
 	}
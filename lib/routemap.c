@@ -41,6 +41,7 @@ DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_RULE_STR, "Route map rule str")
 DEFINE_MTYPE(LIB, ROUTE_MAP_COMPILED, "Route map compiled")
 DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_DEP, "Route map dependency")
 DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_DEP_DATA, "Route map dependency data")
+DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_MEMO, "Route map result cache")
 
 DEFINE_QOBJ_TYPE(route_map_index)
 DEFINE_QOBJ_TYPE(route_map)
@@ -563,8 +564,20 @@ static unsigned int route_map_dep_hash_make_key(const void *p);
 static void route_map_clear_all_references(char *rmap_name);
 static void route_map_rule_delete(struct route_map_rule_list *,
 				  struct route_map_rule *);
+static void route_map_memo_flush(struct route_map_index *index);
 static bool rmap_debug;
 
+static const struct route_map_memo_ops *route_map_memo_ops;
+
+/* Per route_map_apply() call, so the object is only hashed once for all
+ * the indexes it goes through until a set clause changes it.
+ */
+struct route_map_memo_ctx {
+	bool hashed;
+	bool usable;
+	uint32_t hash;
+};
+
 /* New route map allocation. Please note route map's name must be
    specified. */
 static struct route_map *route_map_new(const char *name)
@@ -849,6 +862,12 @@ static void vty_show_route_map_entry(struct vty *vty, struct route_map *map)
 			route_map_type_str(index->type), index->pref,
 			index->applied - index->applied_clear);
 
+		if (index->memo_hits || index->memo_misses)
+			vty_out(vty,
+				"  Match result cache: %" PRIu64
+				" hits, %" PRIu64 " misses\n",
+				index->memo_hits, index->memo_misses);
+
 		/* Description */
 		if (index->description)
 			vty_out(vty, "  Description:\n    %s\n",
@@ -1002,6 +1021,8 @@ void route_map_index_delete(struct route_map_index *index, int notify)
 	while ((rule = index->set_list.head) != NULL)
 		route_map_rule_delete(&index->set_list, rule);
 
+	route_map_memo_flush(index);
+
 	/* Remove index from route map list. */
 	if (index->next)
 		index->next->prev = index->prev;
@@ -1366,6 +1387,7 @@ enum rmap_compile_rets route_map_add_match(struct route_map_index *index,
 
 	/* Add new route match rule to linked list. */
 	route_map_rule_add(&index->match_list, rule);
+	route_map_memo_flush(index);
 
 	/* If IPv4 or IPv6 prefix-list match criteria
 	 * has been added to the route-map index, update
@@ -1426,6 +1448,7 @@ enum rmap_compile_rets route_map_delete_match(struct route_map_index *index,
 						index->map->name);
 
 			route_map_rule_delete(&index->match_list, rule);
+			route_map_memo_flush(index);
 
 			/* If IPv4 or IPv6 prefix-list match criteria
 			 * has been delete from the route-map index, update
@@ -1528,81 +1551,192 @@ enum rmap_compile_rets route_map_delete_set(struct route_map_index *index,
 	return RMAP_RULE_MISSING;
 }
 
+/* Runs either the memo or the other match rules of a list; no rules at all
+ * count as RMAP_NOOP here.
+ */
 static enum route_map_cmd_result_t
-route_map_apply_match(struct route_map_rule_list *match_list,
+route_map_match_rules(struct route_map_rule_list *match_list, bool memo,
 		      const struct prefix *prefix, route_map_object_t type,
 		      void *object)
 {
-	enum route_map_cmd_result_t ret = RMAP_NOMATCH;
+	enum route_map_cmd_result_t ret = RMAP_NOOP;
 	struct route_map_rule *match;
 	bool is_matched = false;
 
+	for (match = match_list->head; match; match = match->next) {
+		if (match->cmd->memo != memo)
+			continue;
 
-	/* Check all match rule and if there is no match rule, go to the
-	   set statement. */
-	if (!match_list->head)
-		ret = RMAP_MATCH;
-	else {
-		for (match = match_list->head; match; match = match->next) {
-			/*
-			 * Try each match statement. If any match does not
-			 * return RMAP_MATCH or RMAP_NOOP, return.
-			 * Otherwise continue on to next match statement.
-			 * All match statements must MATCH for
-			 * end-result to be a match.
-			 * (Exception:If match stmts result in a mix of
-			 * MATCH/NOOP, then also end-result is a match)
-			 * If all result in NOOP, end-result is NOOP.
-			 */
-			ret = (*match->cmd->func_apply)(match->value, prefix,
-							type, object);
-
-			/*
-			 * If the consolidated result of func_apply is:
-			 *   -----------------------------------------------
-			 *   |  MATCH  | NOMATCH  |  NOOP   |  Final Result |
-			 *   ------------------------------------------------
-			 *   |   yes   |   yes    |  yes    |     NOMATCH   |
-			 *   |   no    |   no     |  yes    |     NOOP      |
-			 *   |   yes   |   no     |  yes    |     MATCH     |
-			 *   |   no    |   yes    |  yes    |     NOMATCH   |
-			 *   |-----------------------------------------------
-			 *
-			 *  Traditionally, all rules within route-map
-			 *  should match for it to MATCH.
-			 *  If there are noops within the route-map rules,
-			 *  it follows the above matrix.
-			 *
-			 *   Eg: route-map rm1 permit 10
-			 *         match rule1
-			 *         match rule2
-			 *         match rule3
-			 *         ....
-			 *       route-map rm1 permit 20
-			 *         match ruleX
-			 *         match ruleY
-			 *         ...
-			 */
+		/*
+		 * Try each match statement. If any match does not
+		 * return RMAP_MATCH or RMAP_NOOP, return.
+		 * Otherwise continue on to next match statement.
+		 * All match statements must MATCH for
+		 * end-result to be a match.
+		 * (Exception:If match stmts result in a mix of
+		 * MATCH/NOOP, then also end-result is a match)
+		 * If all result in NOOP, end-result is NOOP.
+		 */
+		ret = (*match->cmd->func_apply)(match->value, prefix,
+						type, object);
 
-			switch (ret) {
-			case RMAP_MATCH:
-				is_matched = true;
-				break;
+		/*
+		 * If the consolidated result of func_apply is:
+		 *   -----------------------------------------------
+		 *   |  MATCH  | NOMATCH  |  NOOP   |  Final Result |
+		 *   ------------------------------------------------
+		 *   |   yes   |   yes    |  yes    |     NOMATCH   |
+		 *   |   no    |   no     |  yes    |     NOOP      |
+		 *   |   yes   |   no     |  yes    |     MATCH     |
+		 *   |   no    |   yes    |  yes    |     NOMATCH   |
+		 *   |-----------------------------------------------
+		 *
+		 *  Traditionally, all rules within route-map
+		 *  should match for it to MATCH.
+		 *  If there are noops within the route-map rules,
+		 *  it follows the above matrix.
+		 *
+		 *   Eg: route-map rm1 permit 10
+		 *         match rule1
+		 *         match rule2
+		 *         match rule3
+		 *         ....
+		 *       route-map rm1 permit 20
+		 *         match ruleX
+		 *         match ruleY
+		 *         ...
+		 */
 
-			case RMAP_NOMATCH:
-				return ret;
+		switch (ret) {
+		case RMAP_MATCH:
+			is_matched = true;
+			break;
 
-			case RMAP_NOOP:
-				if (is_matched)
-					ret = RMAP_MATCH;
-				break;
+		case RMAP_NOMATCH:
+			return ret;
 
-			default:
-				break;
-			}
+		case RMAP_NOOP:
+			if (is_matched)
+				ret = RMAP_MATCH;
+			break;
 
+		default:
+			break;
 		}
+
+	}
+	return ret;
+}
+
+/* Drops the cached results of an index, e.g. because its match rules or a
+ * list they refer to changed.
+ */
+static void route_map_memo_flush(struct route_map_index *index)
+{
+	struct route_map_rule *match;
+	unsigned int i;
+
+	if (index->memo) {
+		for (i = 0; i < ROUTE_MAP_MEMO_SLOTS; i++)
+			if (index->memo[i].key)
+				route_map_memo_ops->put(index->memo[i].key);
+		XFREE(MTYPE_ROUTE_MAP_MEMO, index->memo);
+	}
+
+	index->memo_rules = 0;
+	for (match = index->match_list.head; match; match = match->next)
+		if (match->cmd->memo)
+			index->memo_rules++;
+}
+
+static void route_map_memo_flush_map(const char *name)
+{
+	struct route_map *map = route_map_lookup_by_name(name);
+	struct route_map_index *index;
+
+	if (!map)
+		return;
+
+	for (index = map->head; index; index = index->next)
+		route_map_memo_flush(index);
+}
+
+void route_map_memo_register(const struct route_map_memo_ops *ops)
+{
+	route_map_memo_ops = ops;
+}
+
+static enum route_map_cmd_result_t
+route_map_memo_match(struct route_map_index *index,
+		     const struct prefix *prefix, route_map_object_t type,
+		     void *object, struct route_map_memo_ctx *ctx)
+{
+	struct route_map_memo_slot *slot;
+
+	if (!ctx->hashed) {
+		ctx->hashed = true;
+		ctx->usable =
+			route_map_memo_ops->hash(type, object, &ctx->hash);
+	}
+	if (!ctx->usable)
+		return route_map_match_rules(&index->match_list, true, prefix,
+					     type, object);
+
+	if (!index->memo)
+		index->memo = XCALLOC(MTYPE_ROUTE_MAP_MEMO,
+				      ROUTE_MAP_MEMO_SLOTS
+					      * sizeof(*index->memo));
+
+	slot = &index->memo[ctx->hash % ROUTE_MAP_MEMO_SLOTS];
+	if (slot->key && slot->hash == ctx->hash
+	    && route_map_memo_ops->cmp(slot->key, type, object)) {
+		index->memo_hits++;
+		return slot->ret;
 	}
+
+	index->memo_misses++;
+	if (slot->key)
+		route_map_memo_ops->put(slot->key);
+	slot->ret = route_map_match_rules(&index->match_list, true, prefix,
+					  type, object);
+	slot->key = route_map_memo_ops->get(type, object);
+	slot->hash = ctx->hash;
+	return slot->ret;
+}
+
+/*
+ * Rules flagged as memo are evaluated first, through the result cache if
+ * the daemon provides one; the remaining rules run for every prefix.  The
+ * combined result follows the matrix in route_map_match_rules.
+ */
+static enum route_map_cmd_result_t
+route_map_apply_match(struct route_map_index *index,
+		      const struct prefix *prefix, route_map_object_t type,
+		      void *object, struct route_map_memo_ctx *ctx)
+{
+	enum route_map_cmd_result_t memo_ret = RMAP_NOOP, ret;
+
+	/* Check all match rule and if there is no match rule, go to the
+	   set statement. */
+	if (!index->match_list.head)
+		return RMAP_MATCH;
+
+	if (index->memo_rules) {
+		if (route_map_memo_ops)
+			memo_ret = route_map_memo_match(index, prefix, type,
+							object, ctx);
+		else
+			memo_ret = route_map_match_rules(&index->match_list,
+							 true, prefix, type,
+							 object);
+		if (memo_ret == RMAP_NOMATCH)
+			return memo_ret;
+	}
+
+	ret = route_map_match_rules(&index->match_list, false, prefix, type,
+				    object);
+	if (ret == RMAP_NOOP && memo_ret == RMAP_MATCH)
+		ret = RMAP_MATCH;
 	return ret;
 }
 
@@ -1649,7 +1783,8 @@ static struct list *route_map_get_index_list(struct route_node **rn,
  */
 static struct route_map_index *
 route_map_get_index(struct route_map *map, const struct prefix *prefix,
-		    route_map_object_t type, void *object, uint8_t *match_ret)
+		    route_map_object_t type, void *object, uint8_t *match_ret,
+		    struct route_map_memo_ctx *ctx)
 {
 	int ret = 0;
 	struct list *candidate_rmap_list = NULL;
@@ -1694,8 +1829,8 @@ route_map_get_index(struct route_map *map, const struct prefix *prefix,
 			if (best_index && (best_index->pref < index->pref))
 				break;
 
-			ret = route_map_apply_match(&index->match_list, prefix,
-						    type, object);
+			ret = route_map_apply_match(index, prefix, type,
+						    object, ctx);
 
 			if (ret == RMAP_MATCH) {
 				*match_ret = ret;
@@ -2379,6 +2514,7 @@ route_map_result_t route_map_apply(struct route_map *map,
 	struct route_map_rule *set = NULL;
 	char buf[PREFIX_STRLEN];
 	bool skip_match_clause = false;
+	struct route_map_memo_ctx memo_ctx = {};
 
 	if (recursion > RMAP_RECURSION_LIMIT) {
 		flog_warn(
@@ -2399,7 +2535,7 @@ route_map_result_t route_map_apply(struct route_map *map,
 	if ((!map->optimization_disabled)
 	    && (map->ipv4_prefix_table || map->ipv6_prefix_table)) {
 		index = route_map_get_index(map, prefix, type, object,
-					    (uint8_t *)&match_ret);
+					    (uint8_t *)&match_ret, &memo_ctx);
 		if (index) {
 			if (rmap_debug)
 				zlog_debug(
@@ -2433,8 +2569,8 @@ route_map_result_t route_map_apply(struct route_map *map,
 		if (!skip_match_clause) {
 			index->applied++;
 			/* Apply this index. */
-			match_ret = route_map_apply_match(&index->match_list,
-							  prefix, type, object);
+			match_ret = route_map_apply_match(index, prefix, type,
+							  object, &memo_ctx);
 			if (rmap_debug) {
 				zlog_debug(
 					"Route-map: %s, sequence: %d, prefix: %s, result: %s",
@@ -2497,6 +2633,9 @@ route_map_result_t route_map_apply(struct route_map *map,
 						set->value, prefix, type,
 						object);
 
+				/* sets and called maps may change the object */
+				memo_ctx.hashed = false;
+
 				/* Call another route-map if available */
 				if (index->nextrm) {
 					struct route_map *nextrm =
@@ -2882,6 +3021,7 @@ static void route_map_process_dependency(struct hash_bucket *bucket, void *data)
 
 	if (rmap_debug)
 		zlog_debug("Notifying %s of dependency", rmap_name);
+	route_map_memo_flush_map(rmap_name);
 	if (route_map_master.event_hook)
 		(*route_map_master.event_hook)(rmap_name);
 }
@@ -2966,8 +3106,10 @@ static void clear_route_map_helper(struct route_map *map)
 	struct route_map_index *index;
 
 	map->applied_clear = map->applied;
-	for (index = map->head; index; index = index->next)
+	for (index = map->head; index; index = index->next) {
 		index->applied_clear = index->applied;
+		index->memo_hits = index->memo_misses = 0;
+	}
 }
 
 DEFUN (rmap_clear_counters,
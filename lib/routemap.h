@@ -128,6 +128,33 @@ struct route_map_rule_cmd {
 
 	/** To get the rule key after Compilation **/
 	void *(*func_get_rmap_rule_key)(void *val);
+
+	/* The result only depends on what the daemon's memo key covers
+	 * (see route_map_memo_register), never on the prefix.
+	 */
+	bool memo;
+};
+
+/* Result cache for the memo match rules of an index. */
+struct route_map_memo_slot {
+	void *key;
+	uint32_t hash;
+	enum route_map_cmd_result_t ret;
+};
+
+#define ROUTE_MAP_MEMO_SLOTS 1024
+
+/*
+ * Supplied by a daemon to let route_map_apply() remember the outcome of
+ * memo match rules per distinct object.  hash() returns false for objects
+ * that can't be cached; get() returns a key owned by the cache which must
+ * stay comparable with cmp() until it is given back through put().
+ */
+struct route_map_memo_ops {
+	bool (*hash)(route_map_object_t type, void *object, uint32_t *hash);
+	bool (*cmp)(const void *key, route_map_object_t type, void *object);
+	void *(*get)(route_map_object_t type, void *object);
+	void (*put)(void *key);
 };
 
 /* Route map apply error. */
@@ -199,6 +226,13 @@ struct route_map_index {
 	uint64_t applied;
 	uint64_t applied_clear;
 
+	/* Cached results of the memo match rules, and how many of those
+	 * rules there are.
+	 */
+	struct route_map_memo_slot *memo;
+	unsigned int memo_rules;
+	uint64_t memo_hits, memo_misses;
+
 	/* List of match/sets contexts. */
 	TAILQ_HEAD(, routemap_hook_context) rhclist;
 
@@ -313,6 +347,7 @@ extern void route_map_delete_hook(void (*func)(const char *));
  * name - Is the name of the changed route-map
  */
 extern void route_map_event_hook(void (*func)(const char *name));
+extern void route_map_memo_register(const struct route_map_memo_ops *ops);
 extern int route_map_mark_updated(const char *name);
 extern void route_map_walk_update_list(void (*update_fn)(char *name));
 extern void route_map_upd8_dependency(route_map_event_t type, const char *arg,
@@ -30,7 +30,6 @@
 #include "table.h"
 #include "printfrr.h"
 
-DEFINE_MTYPE_STATIC(LIB, ROUTE_SRC_NODE, "Route source node")
 
 /* ----- functions to manage rnodes _with_ srcdest table ----- */
 struct srcdest_rnode {
@@ -55,7 +54,7 @@ static struct route_node *srcdest_rnode_create(route_table_delegate_t *delegate,
 					       struct route_table *table)
 {
 	struct srcdest_rnode *srn;
-	srn = XCALLOC(MTYPE_ROUTE_NODE, sizeof(struct srcdest_rnode));
+	srn = route_table_node_alloc(table, sizeof(struct srcdest_rnode));
 	return srcdest_rnode_to_rnode(srn);
 }
 
@@ -75,7 +74,7 @@ static void srcdest_rnode_destroy(route_table_delegate_t *delegate,
 	src_table = srn->src_table;
 	srn->src_table = NULL;
 	route_table_finish(src_table);
-	XFREE(MTYPE_ROUTE_NODE, rn);
+	route_table_node_free(table, rn);
 }
 
 route_table_delegate_t _srcdest_dstnode_delegate = {
@@ -93,7 +92,7 @@ static struct route_node *
 srcdest_srcnode_create(route_table_delegate_t *delegate,
 		       struct route_table *table)
 {
-	return XCALLOC(MTYPE_ROUTE_SRC_NODE, sizeof(struct route_node));
+	return route_table_node_alloc(table, sizeof(struct route_node));
 }
 
 static void srcdest_srcnode_destroy(route_table_delegate_t *delegate,
@@ -102,7 +101,7 @@ static void srcdest_srcnode_destroy(route_table_delegate_t *delegate,
 {
 	struct srcdest_rnode *srn;
 
-	XFREE(MTYPE_ROUTE_SRC_NODE, rn);
+	route_table_node_free(table, rn);
 
 	srn = route_table_get_info(table);
 	if (srn->src_table && route_table_count(srn->src_table) == 0) {
@@ -1372,3 +1372,100 @@ void stream_fifo_free(struct stream_fifo *fifo)
 	stream_fifo_deinit(fifo);
 	XFREE(MTYPE_STREAM_FIFO, fifo);
 }
+
+void stream_mpsc_init(struct stream_mpsc *q)
+{
+	memset(q, 0, sizeof(*q));
+}
+
+void stream_mpsc_fini(struct stream_mpsc *q)
+{
+	struct stream *s;
+
+	while ((s = stream_mpsc_pop(q)))
+		stream_free(s);
+}
+
+/* newest .. oldest are n streams linked through ->next, newest first */
+static void stream_mpsc_push_chain(struct stream_mpsc *q, struct stream *newest,
+				   struct stream *oldest, size_t n)
+{
+	uintptr_t prev;
+	size_t count, max;
+
+	/* counted before they become visible, so the consumer can't take
+	 * the count below zero
+	 */
+	count = atomic_fetch_add_explicit(&q->count, n, memory_order_relaxed)
+		+ n;
+	max = atomic_load_explicit(&q->max_count, memory_order_relaxed);
+	while (count > max
+	       && !atomic_compare_exchange_weak_explicit(
+		       &q->max_count, &max, count, memory_order_relaxed,
+		       memory_order_relaxed))
+		;
+
+	prev = atomic_load_explicit(&q->pushed, memory_order_relaxed);
+	for (;;) {
+		oldest->next = (struct stream *)prev;
+		if (atomic_compare_exchange_strong_explicit(
+			    &q->pushed, &prev, (uintptr_t)newest,
+			    memory_order_release, memory_order_relaxed))
+			break;
+		atomic_fetch_add_explicit(&q->push_retries, 1,
+					  memory_order_relaxed);
+	}
+}
+
+void stream_mpsc_push(struct stream_mpsc *q, struct stream *s)
+{
+	stream_mpsc_push_chain(q, s, s, 1);
+}
+
+void stream_mpsc_push_fifo(struct stream_mpsc *q, struct stream_fifo *fifo)
+{
+	struct stream *s, *next, *newest = NULL, *oldest = fifo->head;
+	size_t n = 0;
+
+	if (!oldest)
+		return;
+
+	/* reverse into the stack's newest-first order */
+	for (s = fifo->head; s; s = next) {
+		next = s->next;
+		s->next = newest;
+		newest = s;
+		n++;
+	}
+	fifo->head = fifo->tail = NULL;
+	atomic_store_explicit(&fifo->count, 0, memory_order_release);
+
+	stream_mpsc_push_chain(q, newest, oldest, n);
+}
+
+struct stream *stream_mpsc_pop(struct stream_mpsc *q)
+{
+	struct stream *s, *next, *oldest = NULL;
+
+	if (!q->head) {
+		s = (struct stream *)atomic_exchange_explicit(
+			&q->pushed, (uintptr_t)NULL, memory_order_acquire);
+
+		/* back into FIFO order */
+		for (; s; s = next) {
+			next = s->next;
+			s->next = oldest;
+			oldest = s;
+		}
+		q->head = oldest;
+	}
+
+	s = q->head;
+	if (!s)
+		return NULL;
+
+	q->head = s->next;
+	s->next = NULL;
+	atomic_fetch_sub_explicit(&q->count, 1, memory_order_relaxed);
+	return s;
+}
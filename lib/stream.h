@@ -128,6 +128,29 @@ struct stream_fifo {
 	struct stream *tail;
 };
 
+/*
+ * Lock-free queue of streams, for any number of producer pthreads and a
+ * single consumer pthread.
+ *
+ * Producers push onto an atomic stack, with one compare-and-swap per batch.
+ * The consumer takes the whole stack with one atomic exchange and restores
+ * the FIFO order in its private list, so neither side waits for the other.
+ */
+struct stream_mpsc {
+	/* pushed but not yet taken by the consumer, newest first */
+	atomic_uintptr_t pushed;
+
+	/* consumer private, oldest first */
+	struct stream *head;
+
+	/* number of streams in the queue, and the most it ever held */
+	atomic_size_t count;
+	atomic_size_t max_count;
+
+	/* pushes that had to retry because another producer got in first */
+	atomic_size_t push_retries;
+};
+
 /* Utility macros. */
 #define STREAM_SIZE(S)  ((S)->size)
 /* number of bytes which can still be written */
@@ -367,6 +390,34 @@ extern size_t stream_fifo_count_safe(struct stream_fifo *fifo);
  */
 extern void stream_fifo_free(struct stream_fifo *fifo);
 
+/*
+ * Operations on struct stream_mpsc.
+ *
+ * stream_mpsc_push and stream_mpsc_push_fifo may be called from any pthread,
+ * everything else only from the consumer pthread (or once no producer is
+ * left, for stream_mpsc_init/fini).
+ */
+extern void stream_mpsc_init(struct stream_mpsc *q);
+
+/* Frees all streams still on the queue. */
+extern void stream_mpsc_fini(struct stream_mpsc *q);
+
+extern void stream_mpsc_push(struct stream_mpsc *q, struct stream *s);
+
+/* Moves all streams of a stream_fifo onto the queue in one go. */
+extern void stream_mpsc_push_fifo(struct stream_mpsc *q,
+				  struct stream_fifo *fifo);
+
+extern struct stream *stream_mpsc_pop(struct stream_mpsc *q);
+
+/* Number of streams on the queue; may be ahead of what stream_mpsc_pop
+ * can return while a push is in progress.
+ */
+static inline size_t stream_mpsc_count(struct stream_mpsc *q)
+{
+	return atomic_load_explicit(&q->count, memory_order_relaxed);
+}
+
 /* This is here because "<< 24" is particularly problematic in C.
  * This is because the left operand of << is integer-promoted, which means
  * an uint8_t gets converted into a *signed* int.  Shifting into the sign
@@ -29,7 +29,36 @@
 #include "sockunion.h"
 
 DEFINE_MTYPE_STATIC(LIB, ROUTE_TABLE, "Route table")
-DEFINE_MTYPE(LIB, ROUTE_NODE, "Route node")
+DEFINE_MTYPE_STATIC(LIB, ROUTE_NODE_SLAB, "Route node slab")
+
+/* Number of nodes per slab; slabs start small and grow with the table */
+#define ROUTE_NODE_SLAB_MIN 8
+#define ROUTE_NODE_SLAB_MAX 512
+
+/*
+ * Every node in a slab is preceded by a pointer back to the slab.  Free nodes
+ * are chained through their first word, nodes past 'fresh' were never handed
+ * out yet.
+ */
+struct route_node_slab {
+	/* on table->slabs while there are free nodes */
+	struct route_node_slab *prev;
+	struct route_node_slab *next;
+
+	void *free;
+	unsigned int fresh;
+	unsigned int used;
+	unsigned int total;
+
+	uint64_t nodes[];
+};
+
+struct route_node_hdr {
+	union {
+		struct route_node_slab *slab;
+		uint64_t align;
+	};
+};
 
 static void route_table_free(struct route_table *);
 
@@ -135,6 +164,15 @@ static void route_table_free(struct route_table *rt)
 
 	assert(rt->count == 0);
 
+	/* only empty slabs can be left at this point */
+	while (rt->slabs) {
+		struct route_node_slab *slab = rt->slabs;
+
+		assert(slab->used == 0);
+		rt->slabs = slab->next;
+		XFREE(MTYPE_ROUTE_NODE_SLAB, slab);
+	}
+
 	rn_hash_node_fini(&rt->hash);
 	XFREE(MTYPE_ROUTE_TABLE, rt);
 	return;
@@ -476,6 +514,95 @@ unsigned long route_table_count(struct route_table *table)
 	return table->count;
 }
 
+static inline size_t route_node_stride(size_t size)
+{
+	return sizeof(struct route_node_hdr)
+	       + ((size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1));
+}
+
+static void route_node_slab_link(struct route_table *table,
+				 struct route_node_slab *slab)
+{
+	slab->prev = NULL;
+	slab->next = table->slabs;
+	if (table->slabs)
+		table->slabs->prev = slab;
+	table->slabs = slab;
+}
+
+static void route_node_slab_unlink(struct route_table *table,
+				   struct route_node_slab *slab)
+{
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		table->slabs = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+}
+
+void *route_table_node_alloc(struct route_table *table, size_t size)
+{
+	struct route_node_slab *slab = table->slabs;
+	struct route_node_hdr *hdr;
+	size_t stride = route_node_stride(size);
+	void *node;
+
+	if (!table->node_size)
+		table->node_size = size;
+	assert(table->node_size == size);
+
+	if (!slab) {
+		if (table->slab_nodes < ROUTE_NODE_SLAB_MIN)
+			table->slab_nodes = ROUTE_NODE_SLAB_MIN;
+
+		slab = XMALLOC(MTYPE_ROUTE_NODE_SLAB,
+			       sizeof(*slab) + stride * table->slab_nodes);
+		slab->free = NULL;
+		slab->fresh = 0;
+		slab->used = 0;
+		slab->total = table->slab_nodes;
+		route_node_slab_link(table, slab);
+
+		table->slab_nodes = MIN(table->slab_nodes * 2,
+					ROUTE_NODE_SLAB_MAX);
+	}
+
+	if (slab->free) {
+		node = slab->free;
+		slab->free = *(void **)node;
+	} else {
+		hdr = (struct route_node_hdr *)((char *)slab->nodes
+						+ stride * slab->fresh++);
+		hdr->slab = slab;
+		node = hdr + 1;
+	}
+
+	if (++slab->used == slab->total)
+		route_node_slab_unlink(table, slab);
+
+	memset(node, 0, size);
+	return node;
+}
+
+void route_table_node_free(struct route_table *table, void *node)
+{
+	struct route_node_hdr *hdr = (struct route_node_hdr *)node - 1;
+	struct route_node_slab *slab = hdr->slab;
+
+	*(void **)node = slab->free;
+	slab->free = node;
+
+	if (slab->used-- == slab->total)
+		route_node_slab_link(table, slab);
+
+	/* keep one slab around to avoid churn at a slab boundary */
+	if (slab->used == 0 && (slab->prev || slab->next)) {
+		route_node_slab_unlink(table, slab);
+		XFREE(MTYPE_ROUTE_NODE_SLAB, slab);
+	}
+}
+
 /**
  * route_node_create
  *
@@ -484,9 +611,7 @@ unsigned long route_table_count(struct route_table *table)
 struct route_node *route_node_create(route_table_delegate_t *delegate,
 				     struct route_table *table)
 {
-	struct route_node *node;
-	node = XCALLOC(MTYPE_ROUTE_NODE, sizeof(struct route_node));
-	return node;
+	return route_table_node_alloc(table, sizeof(struct route_node));
 }
 
 /**
@@ -497,7 +622,7 @@ struct route_node *route_node_create(route_table_delegate_t *delegate,
 void route_node_destroy(route_table_delegate_t *delegate,
 			struct route_table *table, struct route_node *node)
 {
-	XFREE(MTYPE_ROUTE_NODE, node);
+	route_table_node_free(table, node);
 }
 
 /*
@@ -31,13 +31,12 @@
 extern "C" {
 #endif
 
-DECLARE_MTYPE(ROUTE_NODE)
-
 /*
  * Forward declarations.
  */
 struct route_node;
 struct route_table;
+struct route_node_slab;
 
 /*
  * route_table_delegate_t
@@ -74,6 +73,13 @@ struct route_table {
 
 	unsigned long count;
 
+	/*
+	 * Slabs with free nodes, see route_table_node_alloc().
+	 */
+	struct route_node_slab *slabs;
+	size_t node_size;
+	unsigned int slab_nodes;
+
 	/*
 	 * User data.
 	 */
@@ -221,6 +227,17 @@ ext_pure struct route_node *route_node_match_ipv6(struct route_table *table,
 
 ext_pure unsigned long route_table_count(struct route_table *table);
 
+/*
+ * Node allocator for delegates.
+ *
+ * Nodes are carved out of slabs owned by the table, which keeps the nodes of
+ * a table close together in memory and avoids a malloc() per node.  All nodes
+ * of a table must have the same size; the memory is zeroed.  Slabs are
+ * released as soon as they are empty, and with the table at the latest.
+ */
+extern void *route_table_node_alloc(struct route_table *table, size_t size);
+extern void route_table_node_free(struct route_table *table, void *node);
+
 extern struct route_node *route_node_create(route_table_delegate_t *delegate,
 					    struct route_table *table);
 extern void route_node_delete(struct route_node *node);
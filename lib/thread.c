@@ -22,6 +22,9 @@
 
 #include <zebra.h>
 #include <sys/resource.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 #include "thread.h"
 #include "memory.h"
@@ -42,6 +45,7 @@ DEFINE_MTYPE_STATIC(LIB, THREAD_POLL, "Thread Poll Info")
 DEFINE_MTYPE_STATIC(LIB, THREAD_STATS, "Thread stats")
 
 DECLARE_LIST(thread_list, struct thread, threaditem)
+DECLARE_DLIST(thread_wheel_list, struct thread, wheelitem)
 
 static int thread_timer_cmp(const struct thread *a, const struct thread *b)
 {
@@ -77,6 +81,23 @@ pthread_key_t thread_current;
 static pthread_mutex_t masters_mtx = PTHREAD_MUTEX_INITIALIZER;
 static struct list *masters;
 
+/* backend for new thread masters */
+#ifdef HAVE_SYS_EPOLL_H
+static enum thread_io_backend io_backend = THREAD_IO_EPOLL;
+#else
+static enum thread_io_backend io_backend = THREAD_IO_POLL;
+#endif
+
+/* max. number of ready fds picked up per epoll_wait() call */
+#define THREAD_EPOLL_EVENTS 1024
+
+/* timers this far out or more go into the timer wheel, which fires them up
+ * to one tick late
+ */
+static const struct timeval thread_wheel_min = {1, 0};
+#define THREAD_WHEEL_TICK_USEC 10000
+#define THREAD_WHEEL_MASK      (THREAD_WHEEL_SLOTS - 1)
+
 static void thread_free(struct thread_master *master, struct thread *thread);
 
 /* CLI start ---------------------------------------------------------------- */
@@ -316,11 +337,46 @@ DEFUN (show_thread_cpu,
 }
 #endif
 
+static void show_thread_rw_funcname(struct vty *vty, struct thread *thread,
+				    const char *sep)
+{
+	if (!thread)
+		vty_out(vty, "ERROR%s", sep);
+	else
+		vty_out(vty, "%s%s", thread->funcname, sep);
+}
+
+static void show_thread_epoll_helper(struct vty *vty, struct thread_master *m)
+{
+	uint8_t mask;
+	uint32_t i = 0;
+	int fd;
+
+	vty_out(vty, "Count: %u/%d\n", (uint32_t)m->handler.epoll_count,
+		m->fd_limit);
+	for (fd = 0; fd < m->fd_limit && i < m->handler.epoll_count; fd++) {
+		mask = m->handler.epoll_mask[fd];
+		if (!mask)
+			continue;
+
+		vty_out(vty, "\t%6d fd:%6d events:%2d\t\t", i++, fd, mask);
+
+		if (mask & POLLIN)
+			show_thread_rw_funcname(vty, m->read[fd], " ");
+		else
+			vty_out(vty, " ");
+
+		if (mask & POLLOUT)
+			show_thread_rw_funcname(vty, m->write[fd], "\n");
+		else
+			vty_out(vty, "\n");
+	}
+}
+
 static void show_thread_poll_helper(struct vty *vty, struct thread_master *m)
 {
 	const char *name = m->name ? m->name : "main";
 	char underline[strlen(name) + 1];
-	struct thread *thread;
 	uint32_t i;
 
 	memset(underline, '-', sizeof(underline));
@@ -328,6 +384,13 @@ static void show_thread_poll_helper(struct vty *vty, struct thread_master *m)
 
 	vty_out(vty, "\nShowing poll FD's for %s\n", name);
 	vty_out(vty, "----------------------%s\n", underline);
+	vty_out(vty, "Backend: %s\n", thread_io_backend_name(m->io_backend));
+
+	if (m->io_backend == THREAD_IO_EPOLL) {
+		show_thread_epoll_helper(vty, m);
+		return;
+	}
+
 	vty_out(vty, "Count: %u/%d\n", (uint32_t)m->handler.pfdcount,
 		m->fd_limit);
 	for (i = 0; i < m->handler.pfdcount; i++) {
@@ -335,24 +398,16 @@ static void show_thread_poll_helper(struct vty *vty, struct thread_master *m)
 			m->handler.pfds[i].fd, m->handler.pfds[i].events,
 			m->handler.pfds[i].revents);
 
-		if (m->handler.pfds[i].events & POLLIN) {
-			thread = m->read[m->handler.pfds[i].fd];
-
-			if (!thread)
-				vty_out(vty, "ERROR ");
-			else
-				vty_out(vty, "%s ", thread->funcname);
-		} else
+		if (m->handler.pfds[i].events & POLLIN)
+			show_thread_rw_funcname(
+				vty, m->read[m->handler.pfds[i].fd], " ");
+		else
 			vty_out(vty, " ");
 
-		if (m->handler.pfds[i].events & POLLOUT) {
-			thread = m->write[m->handler.pfds[i].fd];
-
-			if (!thread)
-				vty_out(vty, "ERROR\n");
-			else
-				vty_out(vty, "%s\n", thread->funcname);
-		} else
+		if (m->handler.pfds[i].events & POLLOUT)
+			show_thread_rw_funcname(
+				vty, m->write[m->handler.pfds[i].fd], "\n");
+		else
 			vty_out(vty, "\n");
 	}
 }
@@ -463,6 +518,11 @@ struct thread_master *thread_master_create(const char *name)
 	thread_list_init(&rv->unuse);
 	thread_timer_list_init(&rv->timer);
 
+	monotime(&rv->wheel.base);
+	for (int level = 0; level < THREAD_WHEEL_LEVELS; level++)
+		for (int slot = 0; slot < THREAD_WHEEL_SLOTS; slot++)
+			thread_wheel_list_init(&rv->wheel.slots[level][slot]);
+
 	/* Initialize thread_fetch() settings */
 	rv->spin = true;
 	rv->handle_signals = true;
@@ -478,13 +538,45 @@ struct thread_master *thread_master_create(const char *name)
 	set_nonblocking(rv->io_pipe[0]);
 	set_nonblocking(rv->io_pipe[1]);
 
+	rv->handler.epoll_fd = -1;
+	rv->io_backend = io_backend;
+#ifdef HAVE_SYS_EPOLL_H
+	if (rv->io_backend == THREAD_IO_EPOLL) {
+		rv->handler.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (rv->handler.epoll_fd < 0) {
+			flog_err_sys(EC_LIB_SYSTEM_CALL,
+				     "epoll_create1() failed, using poll(): %s",
+				     safe_strerror(errno));
+			rv->io_backend = THREAD_IO_POLL;
+		}
+	}
+
+	if (rv->io_backend == THREAD_IO_EPOLL) {
+		struct epoll_event ev = {.events = EPOLLIN};
+
+		ev.data.fd = rv->io_pipe[0];
+		epoll_ctl(rv->handler.epoll_fd, EPOLL_CTL_ADD, rv->io_pipe[0],
+			  &ev);
+
+		rv->handler.epoll_mask =
+			XCALLOC(MTYPE_THREAD_POLL, rv->fd_limit);
+		rv->handler.epoll_events =
+			XCALLOC(MTYPE_THREAD_POLL, sizeof(struct epoll_event)
+							   * THREAD_EPOLL_EVENTS);
+	}
+#endif
+
 	/* Initialize data structures for poll() */
-	rv->handler.pfdsize = rv->fd_limit;
-	rv->handler.pfdcount = 0;
-	rv->handler.pfds = XCALLOC(MTYPE_THREAD_MASTER,
-				   sizeof(struct pollfd) * rv->handler.pfdsize);
-	rv->handler.copy = XCALLOC(MTYPE_THREAD_MASTER,
-				   sizeof(struct pollfd) * rv->handler.pfdsize);
+	if (rv->io_backend == THREAD_IO_POLL) {
+		rv->handler.pfdsize = rv->fd_limit;
+		rv->handler.pfdcount = 0;
+		rv->handler.pfds =
+			XCALLOC(MTYPE_THREAD_MASTER,
+				sizeof(struct pollfd) * rv->handler.pfdsize);
+		rv->handler.copy =
+			XCALLOC(MTYPE_THREAD_MASTER,
+				sizeof(struct pollfd) * rv->handler.pfdsize);
+	}
 
 	/* add to list of threadmasters */
 	frr_with_mutex(&masters_mtx) {
@@ -505,6 +597,32 @@ void thread_master_set_name(struct thread_master *master, const char *name)
 	}
 }
 
+const char *thread_io_backend_name(enum thread_io_backend backend)
+{
+	switch (backend) {
+	case THREAD_IO_POLL:
+		return "poll";
+	case THREAD_IO_EPOLL:
+		return "epoll";
+	}
+	return "unknown";
+}
+
+bool thread_io_backend_set(const char *name)
+{
+	if (!strcmp(name, "poll")) {
+		io_backend = THREAD_IO_POLL;
+		return true;
+	}
+#ifdef HAVE_SYS_EPOLL_H
+	if (!strcmp(name, "epoll")) {
+		io_backend = THREAD_IO_EPOLL;
+		return true;
+	}
+#endif
+	return false;
+}
+
 #define THREAD_UNUSED_DEPTH 10
 
 /* Move thread to unuse list. */
@@ -588,6 +706,11 @@ void thread_master_free(struct thread_master *m)
 	thread_array_free(m, m->write);
 	while ((t = thread_timer_list_pop(&m->timer)))
 		thread_free(m, t);
+	for (int level = 0; level < THREAD_WHEEL_LEVELS; level++)
+		for (int slot = 0; slot < THREAD_WHEEL_SLOTS; slot++)
+			while ((t = thread_wheel_list_pop(
+					&m->wheel.slots[level][slot])))
+				thread_free(m, t);
 	thread_list_free(m, &m->event);
 	thread_list_free(m, &m->ready);
 	thread_list_free(m, &m->unuse);
@@ -605,6 +728,10 @@ void thread_master_free(struct thread_master *m)
 	XFREE(MTYPE_THREAD_MASTER, m->name);
 	XFREE(MTYPE_THREAD_MASTER, m->handler.pfds);
 	XFREE(MTYPE_THREAD_MASTER, m->handler.copy);
+	if (m->handler.epoll_fd >= 0)
+		close(m->handler.epoll_fd);
+	XFREE(MTYPE_THREAD_POLL, m->handler.epoll_mask);
+	XFREE(MTYPE_THREAD_POLL, m->handler.epoll_events);
 	XFREE(MTYPE_THREAD_MASTER, m);
 }
 
@@ -727,8 +854,8 @@ static void thread_free(struct thread_master *master, struct thread *thread)
 	XFREE(MTYPE_THREAD, thread);
 }
 
-static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
-		   nfds_t count, const struct timeval *timer_wait)
+static int fd_poll_timeout(struct thread_master *m,
+			   const struct timeval *timer_wait)
 {
 	/*
 	 * If timer_wait is null here, that means poll() should block
@@ -742,9 +869,6 @@ static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
 	 */
 	int timeout = -1;
 
-	/* number of file descriptors with events */
-	int num;
-
 	if (timer_wait != NULL
 	    && m->selectpoll_timeout == 0) // use the default value
 		timeout = (timer_wait->tv_sec * 1000)
@@ -755,6 +879,17 @@ static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
 		 < 0) // effect a poll (return immediately)
 		timeout = 0;
 
+	return timeout;
+}
+
+static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
+		   nfds_t count, const struct timeval *timer_wait)
+{
+	int timeout = fd_poll_timeout(m, timer_wait);
+
+	/* number of file descriptors with events */
+	int num;
+
 	zlog_tls_buffer_flush();
 	rcu_read_unlock();
 	rcu_assert_read_unlocked();
@@ -777,6 +912,115 @@ static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
 	return num;
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+static int fd_epoll(struct thread_master *m, const struct timeval *timer_wait)
+{
+	int timeout = fd_poll_timeout(m, timer_wait);
+	int num;
+
+	zlog_tls_buffer_flush();
+	rcu_read_unlock();
+	rcu_assert_read_unlocked();
+
+	num = epoll_wait(m->handler.epoll_fd, m->handler.epoll_events,
+			 THREAD_EPOLL_EVENTS, timeout);
+
+	rcu_read_lock();
+
+	return num;
+}
+
+/*
+ * Brings the kernel's epoll registration for fd in line with
+ * m->handler.epoll_mask[fd], which was 'old' before the caller changed it.
+ *
+ * Returns 0 or an errno value if the fd could not be registered.
+ *
+ * @REQUIRE m->mtx
+ */
+static int fd_epoll_update(struct thread_master *m, int fd, uint8_t old)
+{
+	struct epoll_event ev = {};
+	uint8_t mask = m->handler.epoll_mask[fd];
+	int op, ret;
+
+	if (mask == old)
+		return 0;
+
+	if (mask & POLLIN)
+		ev.events |= EPOLLIN;
+	if (mask & POLLOUT)
+		ev.events |= EPOLLOUT;
+	ev.data.fd = fd;
+
+	if (!mask)
+		op = EPOLL_CTL_DEL;
+	else if (!old)
+		op = EPOLL_CTL_ADD;
+	else
+		op = EPOLL_CTL_MOD;
+
+	ret = epoll_ctl(m->handler.epoll_fd, op, fd, &ev);
+
+	/*
+	 * The kernel drops the registration by itself when an fd is closed,
+	 * so it may be gone already, or a reused fd number may have been
+	 * registered again before we noticed.
+	 */
+	if (ret < 0 && errno == ENOENT && op == EPOLL_CTL_MOD)
+		ret = epoll_ctl(m->handler.epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+	else if (ret < 0 && errno == EEXIST && op == EPOLL_CTL_ADD)
+		ret = epoll_ctl(m->handler.epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+
+	if (ret < 0 && op != EPOLL_CTL_DEL) {
+		ret = errno;
+		m->handler.epoll_mask[fd] = old;
+		return ret;
+	}
+
+	if (!old)
+		m->handler.epoll_count++;
+	else if (!mask)
+		m->handler.epoll_count--;
+
+	return 0;
+}
+#endif
+
+/* Add an fd to the pollfd array, or add to its events if it is there. */
+static void fd_poll_add(struct thread_master *m, int fd, short events,
+			struct thread **thread_array)
+{
+	/* default to a new pollfd */
+	nfds_t queuepos = m->handler.pfdcount;
+
+	/* if we already have a pollfd for our file descriptor, find and
+	 * use it */
+	for (nfds_t i = 0; i < m->handler.pfdcount; i++)
+		if (m->handler.pfds[i].fd == fd) {
+			queuepos = i;
+
+#ifdef DEV_BUILD
+			/*
+			 * What happens if we have a thread already
+			 * created for this event?
+			 */
+			if (thread_array[fd])
+				assert(!"Thread already scheduled for file descriptor");
+#endif
+			break;
+		}
+
+	/* make sure we have room for this fd + pipe poker fd */
+	assert(queuepos + 1 < m->handler.pfdsize);
+
+	m->handler.pfds[queuepos].fd = fd;
+	m->handler.pfds[queuepos].events |= events;
+
+	if (queuepos == m->handler.pfdcount)
+		m->handler.pfdcount++;
+}
+
 /* Add new read thread. */
 struct thread *funcname_thread_add_read_write(int dir, struct thread_master *m,
 					      int (*func)(struct thread *),
@@ -786,6 +1030,8 @@ struct thread *funcname_thread_add_read_write(int dir, struct thread_master *m,
 {
 	struct thread *thread = NULL;
 	struct thread **thread_array;
+	short events = (dir == THREAD_READ ? POLLIN : POLLOUT);
+	bool always_ready = false;
 
 	assert(fd >= 0 && fd < m->fd_limit);
 	frr_with_mutex(&m->mtx) {
@@ -793,47 +1039,48 @@ struct thread *funcname_thread_add_read_write(int dir, struct thread_master *m,
 			// thread is already scheduled; don't reschedule
 			break;
 
-		/* default to a new pollfd */
-		nfds_t queuepos = m->handler.pfdcount;
-
 		if (dir == THREAD_READ)
 			thread_array = m->read;
 		else
 			thread_array = m->write;
 
-		/* if we already have a pollfd for our file descriptor, find and
-		 * use it */
-		for (nfds_t i = 0; i < m->handler.pfdcount; i++)
-			if (m->handler.pfds[i].fd == fd) {
-				queuepos = i;
+#ifdef HAVE_SYS_EPOLL_H
+		if (m->io_backend == THREAD_IO_EPOLL) {
+			uint8_t old = m->handler.epoll_mask[fd];
+			int ret;
 
 #ifdef DEV_BUILD
-				/*
-				 * What happens if we have a thread already
-				 * created for this event?
-				 */
-				if (thread_array[fd])
-					assert(!"Thread already scheduled for file descriptor");
+			if (thread_array[fd])
+				assert(!"Thread already scheduled for file descriptor");
 #endif
-				break;
-			}
-
-		/* make sure we have room for this fd + pipe poker fd */
-		assert(queuepos + 1 < m->handler.pfdsize);
+			m->handler.epoll_mask[fd] |= events;
+
+			/*
+			 * epoll refuses regular files, which poll() always
+			 * reports as ready; do the same by running the thread
+			 * right away.
+			 */
+			ret = fd_epoll_update(m, fd, old);
+			if (ret == EPERM)
+				always_ready = true;
+			else if (ret)
+				flog_err_sys(EC_LIB_SYSTEM_CALL,
+					     "epoll_ctl() failed for fd %d: %s",
+					     fd, safe_strerror(ret));
+		} else
+#endif
+			fd_poll_add(m, fd, events, thread_array);
 
 		thread = thread_get(m, dir, func, arg, debugargpass);
 
-		m->handler.pfds[queuepos].fd = fd;
-		m->handler.pfds[queuepos].events |=
-			(dir == THREAD_READ ? POLLIN : POLLOUT);
-
-		if (queuepos == m->handler.pfdcount)
-			m->handler.pfdcount++;
-
 		if (thread) {
 			frr_with_mutex(&thread->mtx) {
 				thread->u.fd = fd;
-				thread_array[thread->u.fd] = thread;
+				if (always_ready) {
+					thread->type = THREAD_READY;
+					thread_list_add_tail(&m->ready, thread);
+				} else
+					thread_array[thread->u.fd] = thread;
 			}
 
 			if (t_ptr) {
@@ -848,6 +1095,167 @@ struct thread *funcname_thread_add_read_write(int dir, struct thread_master *m,
 	return thread;
 }
 
+/* Timer wheel ------------------------------------------------------------- */
+
+static uint64_t thread_wheel_ticks(const struct thread_wheel *wheel,
+				   const struct timeval *tv, bool round_up)
+{
+	int64_t usec = (tv->tv_sec - wheel->base.tv_sec) * TIMER_SECOND_MICRO
+		       + (tv->tv_usec - wheel->base.tv_usec);
+
+	if (usec <= 0)
+		return 0;
+	if (round_up)
+		usec += THREAD_WHEEL_TICK_USEC - 1;
+	return usec / THREAD_WHEEL_TICK_USEC;
+}
+
+static void thread_wheel_add(struct thread_wheel *wheel, struct thread *thread)
+{
+	uint64_t expires, delta;
+	unsigned int level = 0, slot;
+
+	expires = thread_wheel_ticks(wheel, &thread->u.sands, true);
+	expires = MAX(expires, wheel->tick);
+	delta = expires - wheel->tick;
+
+	while (level < THREAD_WHEEL_LEVELS - 1
+	       && delta >> (THREAD_WHEEL_BITS * (level + 1)))
+		level++;
+
+	/* beyond the range of the wheel (decades), park the timer in the
+	 * last slot reached; it is put back in when that slot cascades
+	 */
+	if (delta >> (THREAD_WHEEL_BITS * THREAD_WHEEL_LEVELS))
+		expires = wheel->tick
+			  + (1ULL << (THREAD_WHEEL_BITS * THREAD_WHEEL_LEVELS))
+			  - 1;
+
+	slot = (expires >> (THREAD_WHEEL_BITS * level)) & THREAD_WHEEL_MASK;
+	thread->wheelslot = &wheel->slots[level][slot];
+	thread_wheel_list_add_tail(thread->wheelslot, thread);
+	wheel->occupied[level] |= 1ULL << slot;
+	wheel->count++;
+}
+
+static void thread_wheel_del(struct thread_wheel *wheel, struct thread *thread)
+{
+	struct thread_wheel_list_head *head = thread->wheelslot;
+	ptrdiff_t idx;
+
+	thread_wheel_list_del(head, thread);
+	thread->wheelslot = NULL;
+	wheel->count--;
+
+	if (!thread_wheel_list_count(head)) {
+		idx = head - &wheel->slots[0][0];
+		wheel->occupied[idx / THREAD_WHEEL_SLOTS] &=
+			~(1ULL << (idx % THREAD_WHEEL_SLOTS));
+	}
+}
+
+/* Re-files the timers of a slot one level up, at the start of its period */
+static void thread_wheel_cascade(struct thread_wheel *wheel,
+				 unsigned int level, unsigned int slot)
+{
+	struct thread_wheel_list_head *head = &wheel->slots[level][slot];
+	struct thread_wheel_list_head cascade;
+	struct thread *thread;
+
+	thread_wheel_list_init(&cascade);
+	while ((thread = thread_wheel_list_pop(head)))
+		thread_wheel_list_add_tail(&cascade, thread);
+
+	wheel->occupied[level] &= ~(1ULL << slot);
+	wheel->count -= thread_wheel_list_count(&cascade);
+
+	while ((thread = thread_wheel_list_pop(&cascade)))
+		thread_wheel_add(wheel, thread);
+	thread_wheel_list_fini(&cascade);
+}
+
+/*
+ * Moves the timers of all ticks up to now from the wheel into the timer
+ * heap, which hands them out in order.
+ */
+static void thread_wheel_expire(struct thread_master *m,
+				const struct timeval *now)
+{
+	struct thread_wheel *wheel = &m->wheel;
+	struct thread_wheel_list_head *head;
+	uint64_t now_tick = thread_wheel_ticks(wheel, now, false);
+	unsigned int level, slot;
+	struct thread *thread;
+
+	while (wheel->count && wheel->tick <= now_tick) {
+		/* at the start of a period on the levels above, file their
+		 * timers one level down
+		 */
+		for (level = 1; level < THREAD_WHEEL_LEVELS; level++) {
+			if (wheel->tick
+			    & ((1ULL << (THREAD_WHEEL_BITS * level)) - 1))
+				break;
+			thread_wheel_cascade(
+				wheel, level,
+				(wheel->tick >> (THREAD_WHEEL_BITS * level))
+					& THREAD_WHEEL_MASK);
+		}
+
+		slot = wheel->tick & THREAD_WHEEL_MASK;
+		head = &wheel->slots[0][slot];
+		while ((thread = thread_wheel_list_pop(head))) {
+			thread->wheelslot = NULL;
+			wheel->count--;
+			thread_timer_list_add(&m->timer, thread);
+		}
+		wheel->occupied[0] &= ~(1ULL << slot);
+
+		/* nothing left on level 0, skip ahead to the next cascade */
+		if (wheel->occupied[0])
+			wheel->tick++;
+		else
+			wheel->tick = MIN(now_tick + 1,
+					  (wheel->tick | THREAD_WHEEL_MASK) + 1);
+	}
+
+	if (!wheel->count)
+		wheel->tick = MAX(wheel->tick, now_tick + 1);
+}
+
+/* Earliest time at which the wheel has timers to expire or cascade */
+static bool thread_wheel_next(const struct thread_wheel *wheel,
+			      struct timeval *next)
+{
+	uint64_t tick = UINT64_MAX, start, occupied, usec;
+	unsigned int level, shift, rot;
+
+	if (!wheel->count)
+		return false;
+
+	for (level = 0; level < THREAD_WHEEL_LEVELS; level++) {
+		occupied = wheel->occupied[level];
+		if (!occupied)
+			continue;
+
+		/* first period of this level that has not been cascaded yet,
+		 * then the first occupied slot from there on
+		 */
+		shift = THREAD_WHEEL_BITS * level;
+		start = (wheel->tick + (1ULL << shift) - 1) >> shift;
+		rot = start & THREAD_WHEEL_MASK;
+		if (rot)
+			occupied = (occupied >> rot)
+				   | (occupied << (THREAD_WHEEL_SLOTS - rot));
+
+		tick = MIN(tick, (start + __builtin_ctzll(occupied)) << shift);
+	}
+
+	usec = tick * THREAD_WHEEL_TICK_USEC + wheel->base.tv_usec;
+	next->tv_sec = wheel->base.tv_sec + usec / TIMER_SECOND_MICRO;
+	next->tv_usec = usec % TIMER_SECOND_MICRO;
+	return true;
+}
+
 static struct thread *
 funcname_thread_add_timer_timeval(struct thread_master *m,
 				  int (*func)(struct thread *), int type,
@@ -872,7 +1280,10 @@ funcname_thread_add_timer_timeval(struct thread_master *m,
 			monotime(&thread->u.sands);
 			timeradd(&thread->u.sands, time_relative,
 				 &thread->u.sands);
-			thread_timer_list_add(&m->timer, thread);
+			if (timercmp(time_relative, &thread_wheel_min, <))
+				thread_timer_list_add(&m->timer, thread);
+			else
+				thread_wheel_add(&m->wheel, thread);
 			if (t_ptr) {
 				*t_ptr = thread;
 				thread->ref = t_ptr;
@@ -970,7 +1381,8 @@ struct thread *funcname_thread_add_event(struct thread_master *m,
  * descriptor. The event to be NOT'd is passed in the 'state' parameter.
  *
  * This needs to happen for both copies of pollfd's. See 'thread_fetch'
- * implementation for details.
+ * implementation for details.  With the epoll backend the fd's epoll
+ * registration is updated instead.
  *
  * @param master
  * @param fd
@@ -983,6 +1395,24 @@ static void thread_cancel_rw(struct thread_master *master, int fd, short state)
 {
 	bool found = false;
 
+#ifdef HAVE_SYS_EPOLL_H
+	if (master->io_backend == THREAD_IO_EPOLL) {
+		uint8_t old = master->handler.epoll_mask[fd];
+
+		if (!(old & state)) {
+			zlog_debug(
+				"[!] Received cancellation request for nonexistent rw job");
+			zlog_debug("[!] threadmaster: %s | fd: %d",
+				   master->name ? master->name : "", fd);
+			return;
+		}
+
+		master->handler.epoll_mask[fd] &= ~state;
+		fd_epoll_update(master, fd, old);
+		return;
+	}
+#endif
+
 	/* Cancel POLLHUP too just in case some bozo set it */
 	state |= POLLHUP;
 
@@ -1101,7 +1531,10 @@ static void do_thread_cancel(struct thread_master *master)
 			thread_array = master->write;
 			break;
 		case THREAD_TIMER:
-			thread_timer_list_del(&master->timer, thread);
+			if (thread->wheelslot)
+				thread_wheel_del(&master->wheel, thread);
+			else
+				thread_timer_list_del(&master->timer, thread);
 			break;
 		case THREAD_EVENT:
 			list = &master->event;
@@ -1230,14 +1663,20 @@ void thread_cancel_async(struct thread_master *master, struct thread **thread,
 }
 /* ------------------------------------------------------------------------- */
 
-static struct timeval *thread_timer_wait(struct thread_timer_list_head *timers,
+static struct timeval *thread_timer_wait(struct thread_master *m,
 					 struct timeval *timer_val)
 {
-	if (!thread_timer_list_count(timers))
+	struct thread *next_timer = thread_timer_list_first(&m->timer);
+	struct timeval next;
+	bool wheel = thread_wheel_next(&m->wheel, &next);
+
+	if (!next_timer && !wheel)
 		return NULL;
 
-	struct thread *next_timer = thread_timer_list_first(timers);
-	monotime_until(&next_timer->u.sands, timer_val);
+	if (next_timer && (!wheel || timercmp(&next_timer->u.sands, &next, <)))
+		next = next_timer->u.sands;
+
+	monotime_until(&next, timer_val);
 	return timer_val;
 }
 
@@ -1250,29 +1689,16 @@ static struct thread *thread_run(struct thread_master *m, struct thread *thread,
 }
 
 static int thread_process_io_helper(struct thread_master *m,
-				    struct thread *thread, short state,
-				    short actual_state, int pos)
+				    struct thread *thread, int fd,
+				    short actual_state)
 {
 	struct thread **thread_array;
 
-	/*
-	 * poll() clears the .events field, but the pollfd array we
-	 * pass to poll() is a copy of the one used to schedule threads.
-	 * We need to synchronize state between the two here by applying
-	 * the same changes poll() made on the copy of the "real" pollfd
-	 * array.
-	 *
-	 * This cleans up a possible infinite loop where we refuse
-	 * to respond to a poll event but poll is insistent that
-	 * we should.
-	 */
-	m->handler.pfds[pos].events &= ~(state);
-
 	if (!thread) {
 		if ((actual_state & (POLLHUP|POLLIN)) != POLLHUP)
 			flog_err(EC_LIB_NO_THREAD,
 				 "Attempting to process an I/O event but for fd: %d(%d) no thread to handle this!\n",
-				 m->handler.pfds[pos].fd, actual_state);
+				 fd, actual_state);
 		return 0;
 	}
 
@@ -1288,6 +1714,22 @@ static int thread_process_io_helper(struct thread_master *m,
 	return 1;
 }
 
+static void fd_poll_clear(struct thread_master *m, int pos, short state)
+{
+	/*
+	 * poll() clears the .events field, but the pollfd array we
+	 * pass to poll() is a copy of the one used to schedule threads.
+	 * We need to synchronize state between the two here by applying
+	 * the same changes poll() made on the copy of the "real" pollfd
+	 * array.
+	 *
+	 * This cleans up a possible infinite loop where we refuse
+	 * to respond to a poll event but poll is insistent that
+	 * we should.
+	 */
+	m->handler.pfds[pos].events &= ~(state);
+}
+
 /**
  * Process I/O events.
  *
@@ -1324,12 +1766,15 @@ static void thread_process_io(struct thread_master *m, unsigned int num)
 		 * read function should handle it appropriately
 		 */
 		if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
-			thread_process_io_helper(m, m->read[pfds[i].fd], POLLIN,
-						 pfds[i].revents, i);
+			fd_poll_clear(m, i, POLLIN);
+			thread_process_io_helper(m, m->read[pfds[i].fd],
+						 pfds[i].fd, pfds[i].revents);
 		}
-		if (pfds[i].revents & POLLOUT)
+		if (pfds[i].revents & POLLOUT) {
+			fd_poll_clear(m, i, POLLOUT);
 			thread_process_io_helper(m, m->write[pfds[i].fd],
-						 POLLOUT, pfds[i].revents, i);
+						 pfds[i].fd, pfds[i].revents);
+		}
 
 		/* if one of our file descriptors is garbage, remove the same
 		 * from
@@ -1354,6 +1799,71 @@ static void thread_process_io(struct thread_master *m, unsigned int num)
 	}
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+/**
+ * Process I/O events reported by epoll_wait().
+ *
+ * Like poll(), an fd only reports events for threads that are scheduled, so
+ * the interest in an event is dropped as soon as its thread is made ready.
+ *
+ * @param m the thread master
+ * @param num the number of events (return value of epoll_wait())
+ */
+static void thread_process_epoll(struct thread_master *m, int num)
+{
+	struct epoll_event *ev;
+	unsigned char trash[64];
+	short revents;
+	uint8_t old;
+	int fd;
+
+	for (ev = m->handler.epoll_events; ev < m->handler.epoll_events + num;
+	     ev++) {
+		fd = ev->data.fd;
+
+		if (fd == m->io_pipe[0]) {
+			while (read(fd, &trash, sizeof(trash)) > 0)
+				;
+			continue;
+		}
+
+		revents = 0;
+		if (ev->events & EPOLLIN)
+			revents |= POLLIN;
+		if (ev->events & EPOLLOUT)
+			revents |= POLLOUT;
+		if (ev->events & EPOLLHUP)
+			revents |= POLLHUP;
+		if (ev->events & EPOLLERR)
+			revents |= POLLERR;
+
+		old = m->handler.epoll_mask[fd];
+
+		/*
+		 * Another pthread may have cancelled the read or write while
+		 * we were waiting without the lock, so only hand out what is
+		 * still asked for.  An error on an fd we only write to goes
+		 * to the writer, or epoll keeps reporting it.
+		 */
+		if (!(old & POLLIN) && (old & POLLOUT)
+		    && (revents & (POLLHUP | POLLERR)))
+			revents |= POLLOUT;
+
+		/* see thread_process_io() about POLLERR */
+		if ((old & POLLIN) && (revents & (POLLIN | POLLHUP | POLLERR))) {
+			m->handler.epoll_mask[fd] &= ~POLLIN;
+			thread_process_io_helper(m, m->read[fd], fd, revents);
+		}
+		if ((old & POLLOUT) && (revents & POLLOUT)) {
+			m->handler.epoll_mask[fd] &= ~POLLOUT;
+			thread_process_io_helper(m, m->write[fd], fd, revents);
+		}
+
+		fd_epoll_update(m, fd, old);
+	}
+}
+#endif
+
 /* Add all timers that have popped to the ready list. */
 static unsigned int thread_process_timers(struct thread_timer_list_head *timers,
 					  struct timeval *timenow)
@@ -1445,32 +1955,44 @@ struct thread *thread_fetch(struct thread_master *m, struct thread *fetch)
 		 * once per loop to avoid starvation by events
 		 */
 		if (!thread_list_count(&m->ready))
-			tw = thread_timer_wait(&m->timer, &tv);
+			tw = thread_timer_wait(m, &tv);
 
 		if (thread_list_count(&m->ready) ||
 				(tw && !timercmp(tw, &zerotime, >)))
 			tw = &zerotime;
 
-		if (!tw && m->handler.pfdcount == 0) { /* die */
+		if (!tw && m->handler.pfdcount == 0
+		    && m->handler.epoll_count == 0) { /* die */
 			pthread_mutex_unlock(&m->mtx);
 			fetch = NULL;
 			break;
 		}
 
+#ifdef HAVE_SYS_EPOLL_H
 		/*
-		 * Copy pollfd array + # active pollfds in it. Not necessary to
-		 * copy the array size as this is fixed.
+		 * The epoll set is kept up to date by the kernel, threads
+		 * added from other pthreads meanwhile show up right away.
 		 */
-		m->handler.copycount = m->handler.pfdcount;
-		memcpy(m->handler.copy, m->handler.pfds,
-		       m->handler.copycount * sizeof(struct pollfd));
-
-		pthread_mutex_unlock(&m->mtx);
+		if (m->io_backend == THREAD_IO_EPOLL) {
+			pthread_mutex_unlock(&m->mtx);
+			num = fd_epoll(m, tw);
+			pthread_mutex_lock(&m->mtx);
+		} else
+#endif
 		{
+			/*
+			 * Copy pollfd array + # active pollfds in it. Not
+			 * necessary to copy the array size as this is fixed.
+			 */
+			m->handler.copycount = m->handler.pfdcount;
+			memcpy(m->handler.copy, m->handler.pfds,
+			       m->handler.copycount * sizeof(struct pollfd));
+
+			pthread_mutex_unlock(&m->mtx);
 			num = fd_poll(m, m->handler.copy, m->handler.pfdsize,
 				      m->handler.copycount, tw);
+			pthread_mutex_lock(&m->mtx);
 		}
-		pthread_mutex_lock(&m->mtx);
 
 		/* Handle any errors received in poll() */
 		if (num < 0) {
@@ -1490,11 +2012,18 @@ struct thread *thread_fetch(struct thread_master *m, struct thread *fetch)
 
 		/* Post timers to ready queue. */
 		monotime(&now);
+		thread_wheel_expire(m, &now);
 		thread_process_timers(&m->timer, &now);
 
 		/* Post I/O to ready queue. */
-		if (num > 0)
-			thread_process_io(m, num);
+		if (num > 0) {
+#ifdef HAVE_SYS_EPOLL_H
+			if (m->io_backend == THREAD_IO_EPOLL)
+				thread_process_epoll(m, num);
+			else
+#endif
+				thread_process_io(m, num);
+		}
 
 		pthread_mutex_unlock(&m->mtx);
 
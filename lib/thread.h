@@ -42,6 +42,15 @@ struct rusage_t {
 
 PREDECL_LIST(thread_list)
 PREDECL_HEAP(thread_timer_list)
+PREDECL_DLIST(thread_wheel_list)
+
+struct epoll_event;
+
+/* I/O readiness backends */
+enum thread_io_backend {
+	THREAD_IO_POLL = 0,
+	THREAD_IO_EPOLL,
+};
 
 struct fd_handler {
 	/* number of pfd that fit in the allocated space of pfds. This is a
@@ -58,6 +67,37 @@ struct fd_handler {
 	struct pollfd *copy;
 	/* number of pollfds stored in copy */
 	nfds_t copycount;
+
+	/* epoll backend: the epoll instance, the POLLIN/POLLOUT interest
+	 * registered for each fd and the buffer epoll_wait() fills in
+	 */
+	int epoll_fd;
+	uint8_t *epoll_mask;
+	/* number of fds with a non-zero epoll_mask */
+	nfds_t epoll_count;
+	struct epoll_event *epoll_events;
+};
+
+/*
+ * Hierarchical timing wheel for coarse timers.  Slots on level n each span
+ * THREAD_WHEEL_SLOTS^n ticks; timers move down a level whenever the level
+ * below wraps around, and into the timer heap once their tick has come.
+ */
+#define THREAD_WHEEL_BITS   6
+#define THREAD_WHEEL_SLOTS  (1U << THREAD_WHEEL_BITS)
+#define THREAD_WHEEL_LEVELS 6
+
+struct thread_wheel {
+	/* time of tick 0 */
+	struct timeval base;
+	/* next tick to process */
+	uint64_t tick;
+	/* number of timers in all slots */
+	size_t count;
+	/* bitmap of non-empty slots, per level */
+	uint64_t occupied[THREAD_WHEEL_LEVELS];
+	struct thread_wheel_list_head slots[THREAD_WHEEL_LEVELS]
+					   [THREAD_WHEEL_SLOTS];
 };
 
 struct cancel_req {
@@ -73,6 +113,7 @@ struct thread_master {
 	struct thread **read;
 	struct thread **write;
 	struct thread_timer_list_head timer;
+	struct thread_wheel wheel;
 	struct thread_list_head event, ready, unuse;
 	struct list *cancel_req;
 	bool canceled;
@@ -80,6 +121,7 @@ struct thread_master {
 	struct hash *cpu_record;
 	int io_pipe[2];
 	int fd_limit;
+	enum thread_io_backend io_backend;
 	struct fd_handler handler;
 	unsigned long alloc;
 	long selectpoll_timeout;
@@ -95,6 +137,8 @@ struct thread {
 	uint8_t add_type;	  /* thread type */
 	struct thread_list_item threaditem;
 	struct thread_timer_list_item timeritem;
+	struct thread_wheel_list_item wheelitem;
+	struct thread_wheel_list_head *wheelslot; /* set while in the wheel */
 	struct thread **ref;	  /* external reference (if given) */
 	struct thread_master *master; /* pointer to the struct thread_master */
 	int (*func)(struct thread *); /* event function */
@@ -220,6 +264,14 @@ extern int thread_should_yield(struct thread *);
 /* set yield time for thread */
 extern void thread_set_yield_time(struct thread *, unsigned long);
 
+/*
+ * Selects the I/O backend for thread masters created from now on, by name
+ * ("poll" or "epoll").  Returns false if the backend is unknown or not
+ * available on this platform.  epoll is the default where available.
+ */
+extern bool thread_io_backend_set(const char *name);
+extern const char *thread_io_backend_name(enum thread_io_backend backend);
+
 /* Internal libfrr exports */
 extern void thread_getrusage(RUSAGE_T *);
 extern void thread_cmd_init(void);
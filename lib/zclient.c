@@ -712,15 +712,14 @@ static int zclient_connect(struct thread *t)
 	return zclient_start(zclient);
 }
 
-int zclient_send_rnh(struct zclient *zclient, int command,
-		     const struct prefix *p, bool exact_match,
-		     vrf_id_t vrf_id)
-{
-	struct stream *s;
+/* Largest nexthop registration entry: flags, family, length and an IPv6
+ * address.
+ */
+#define ZAPI_RNH_MAX_LEN (1 + 2 + 1 + IPV6_MAX_BYTELEN)
 
-	s = zclient->obuf;
-	stream_reset(s);
-	zclient_create_header(s, command, vrf_id);
+static void zapi_rnh_encode(struct stream *s, const struct prefix *p,
+			    bool exact_match)
+{
 	stream_putc(s, (exact_match) ? 1 : 0);
 
 	stream_putw(s, PREFIX_FAMILY(p));
@@ -735,11 +734,58 @@ int zclient_send_rnh(struct zclient *zclient, int command,
 	default:
 		break;
 	}
+}
+
+int zclient_send_rnh(struct zclient *zclient, int command,
+		     const struct prefix *p, bool exact_match,
+		     vrf_id_t vrf_id)
+{
+	struct stream *s;
+
+	s = zclient->obuf;
+	stream_reset(s);
+	zclient_create_header(s, command, vrf_id);
+	zapi_rnh_encode(s, p, exact_match);
 	stream_putw_at(s, 0, stream_get_endp(s));
 
 	return zclient_send_message(zclient);
 }
 
+/*
+ * Send a list of nexthop (un)registrations.  Zebra accepts any number of
+ * entries in a single register or unregister message, so runs of entries
+ * sharing the command and VRF are packed into as few messages as fit.
+ */
+int zclient_send_rnh_list(struct zclient *zclient, const struct zapi_rnh *rnhs,
+			  unsigned int count)
+{
+	struct stream *s = zclient->obuf;
+	unsigned int i, start;
+	int ret = 0;
+
+	for (start = 0; start < count; start = i) {
+		stream_reset(s);
+		zclient_create_header(s, rnhs[start].command,
+				      rnhs[start].vrf_id);
+
+		for (i = start; i < count; i++) {
+			if (rnhs[i].command != rnhs[start].command
+			    || rnhs[i].vrf_id != rnhs[start].vrf_id
+			    || STREAM_WRITEABLE(s) < ZAPI_RNH_MAX_LEN)
+				break;
+
+			zapi_rnh_encode(s, &rnhs[i].prefix,
+					rnhs[i].exact_match);
+		}
+		stream_putw_at(s, 0, stream_get_endp(s));
+
+		if (zclient_send_message(zclient) < 0)
+			ret = -1;
+	}
+
+	return ret;
+}
+
 /*
  * "xdr_encode"-like interface that allows daemon (client) to send
  * a message to zebra server for a route that needs to be
@@ -3537,6 +3583,48 @@ stream_failure:
 	return -1;
 }
 
+/*
+ * A batch carries the bodies of several nexthop or import check updates for
+ * one VRF, each preceded by its length.  Every entry is handed to the regular
+ * update callback with the input stream positioned at its start, so daemons
+ * decode it exactly like a single update.
+ */
+static void zclient_nexthop_update_batch(struct zclient *zclient,
+					 vrf_id_t vrf_id)
+{
+	struct stream *s = zclient->ibuf;
+	int (*handler)(ZAPI_CALLBACK_ARGS) = NULL;
+	uint16_t command, length;
+	size_t next;
+
+	STREAM_GETW(s, command);
+	if (command == ZEBRA_NEXTHOP_UPDATE)
+		handler = zclient->nexthop_update;
+	else if (command == ZEBRA_IMPORT_CHECK_UPDATE)
+		handler = zclient->import_check_update;
+
+	if (zclient_debug)
+		zlog_debug("zclient rcvd %s batch of %zu bytes",
+			   zserv_command_string(command),
+			   STREAM_READABLE(s));
+
+	while (STREAM_READABLE(s)) {
+		STREAM_GETW(s, length);
+		next = stream_get_getp(s) + length;
+		if (next > stream_get_endp(s))
+			goto stream_failure;
+
+		if (handler)
+			(*handler)(command, zclient, length, vrf_id);
+		stream_set_getp(s, next);
+	}
+	return;
+
+stream_failure:
+	flog_err(EC_LIB_ZAPI_MISSMATCH, "%s: malformed nexthop update batch",
+		 __func__);
+}
+
 /* Zebra client message read function. */
 static int zclient_read(struct thread *thread)
 {
@@ -3708,6 +3796,9 @@ static int zclient_read(struct thread *thread)
 			(*zclient->import_check_update)(command, zclient,
 							length, vrf_id);
 		break;
+	case ZEBRA_NEXTHOP_UPDATE_BATCH:
+		zclient_nexthop_update_batch(zclient, vrf_id);
+		break;
 	case ZEBRA_BFD_DEST_REPLAY:
 		if (zclient->bfd_dest_replay)
 			(*zclient->bfd_dest_replay)(command, zclient, length,
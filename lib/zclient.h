@@ -218,6 +218,7 @@ typedef enum {
 	ZEBRA_OPAQUE_REGISTER,
 	ZEBRA_OPAQUE_UNREGISTER,
 	ZEBRA_NEIGH_DISCOVER,
+	ZEBRA_NEXTHOP_UPDATE_BATCH,
 } zebra_message_types_t;
 
 enum zebra_error_types {
@@ -551,6 +552,18 @@ struct zapi_route {
 	uint32_t srte_color;
 };
 
+/*
+ * A nexthop or import route (un)registration, see zclient_send_rnh_list().
+ * Consecutive entries for the same command and VRF are packed into a single
+ * message.
+ */
+struct zapi_rnh {
+	int command;
+	vrf_id_t vrf_id;
+	struct prefix prefix;
+	bool exact_match;
+};
+
 struct zapi_labels {
 	uint8_t message;
 #define ZAPI_LABELS_FTN           0x01
@@ -894,6 +907,9 @@ extern int zclient_route_send(uint8_t, struct zclient *, struct zapi_route *);
 extern int zclient_send_rnh(struct zclient *zclient, int command,
 			    const struct prefix *p, bool exact_match,
 			    vrf_id_t vrf_id);
+extern int zclient_send_rnh_list(struct zclient *zclient,
+				 const struct zapi_rnh *rnhs,
+				 unsigned int count);
 int zapi_nexthop_encode(struct stream *s, const struct zapi_nexthop *api_nh,
 			uint32_t api_flags, uint32_t api_message);
 extern int zapi_route_encode(uint8_t, struct stream *, struct zapi_route *);
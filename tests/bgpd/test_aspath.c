@@ -31,6 +31,7 @@
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_attr.h"
 #include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_regex.h"
 
 #define VT100_RESET "\x1b[0m"
 #define VT100_RED "\x1b[31m"
@@ -1189,6 +1190,77 @@ static void cmp_test(void)
 	}
 }
 
+/* the compiled as-path regex must agree with regexec() on the string */
+static const char *const regex_tests[] = {
+	"^$",
+	"_8466_",
+	"^8466_",
+	"_2_$",
+	"^8466 3 52737 4096$",
+	"_(8722|8466)_",
+	"^[0-9]+ [0-9]+$",
+	"_6435[0-9]_",
+	"^(8466_)+",
+	"\\{.*\\}",
+	"\\(.*\\)",
+	"_1{1,2}_",
+	"^([0-9]+ ){2}",
+	".*",
+	"^8466 .* 4096$",
+	"^[^ ]+$",
+	"_(64[5-9][0-9][0-9]|65[0-5][0-9][0-9])_",
+	"^8466_?",
+	"_3?_",
+	"[^0-9]52737",
+	NULL,
+};
+
+static void regex_test(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; regex_tests[i]; i++) {
+		struct bgp_asregex *asre = bgp_asregcomp(regex_tests[i]);
+		regex_t *re = bgp_regcomp(regex_tests[i]);
+		bool ok = asre && re;
+
+		printf("regex test %s\n", regex_tests[i]);
+
+		for (j = 0; ok && test_segments[j].name; j++) {
+			struct test_segment *t = &test_segments[j];
+			struct aspath *asp;
+
+			if (t->sp.shouldbe == NULL)
+				continue;
+
+			asp = make_aspath(t->asdata, t->len, 0);
+			if (!asp)
+				continue;
+
+			if (bgp_asregexec(asre, asp)
+			    != (bgp_regexec(re, asp) != REG_NOMATCH)) {
+				printf("mismatch on %s: %s\n", t->name,
+				       aspath_print(asp));
+				ok = false;
+			}
+			aspath_unintern(&asp);
+		}
+
+		if (ok)
+			printf(OK "\n");
+		else {
+			failed++;
+			printf(FAILED "\n");
+		}
+		printf("\n");
+
+		if (asre)
+			bgp_asregex_free(asre);
+		if (re)
+			bgp_regex_free(re);
+	}
+}
+
 static int handle_attr_test(struct aspath_tests *t)
 {
 	struct bgp bgp = {0};
@@ -1303,6 +1375,8 @@ int main(void)
 
 	empty_get_test();
 
+	regex_test();
+
 	i = 0;
 
 	frr_pthread_init();
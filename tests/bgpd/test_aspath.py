@@ -68,6 +68,9 @@ for _ in range(22):
 
 TestAspath.okfail("empty_get_test")
 
+for _ in range(20):
+    TestAspath.okfail("regex test ")
+
 TestAspath.attrtest("basic test")
 TestAspath.attrtest("length too short")
 TestAspath.attrtest("length too long")
@@ -0,0 +1,248 @@
+/*
+ * BGP UPDATE encoding worker tests
+ * Copyright (C) 2020 FRRouting
+ *
+ * This file is part of FRR
+ *
+ * FRR is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * FRR is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "frr_pthread.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_update_workers.h"
+#include "bgpd/bgp_network.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t bgpd_privs = {0};
+struct thread_master *master = NULL;
+
+static struct bgp *bgp;
+static as_t asn = 100;
+
+#define NSUBGRPS 3
+#define NPREFIXES 64
+
+/* eBGP, iBGP and iBGP with next-hop-self end up in separate update groups */
+static const struct {
+	const char *addr;
+	as_t remote_as;
+	bool nexthop_self;
+} peer_conf[NSUBGRPS] = {
+	{"192.0.2.1", 200, false},
+	{"192.0.2.2", 100, false},
+	{"192.0.2.3", 100, true},
+};
+
+static struct peer *peers[NSUBGRPS];
+static struct update_subgroup *subgrps[NSUBGRPS];
+
+/* the UPDATE each subgroup encodes on the main pthread */
+static uint8_t serial[NSUBGRPS][BGP_MAX_PACKET_SIZE];
+static size_t serial_len[NSUBGRPS];
+
+static int failed;
+
+static void setup_peers(void)
+{
+	union sockunion su;
+	struct peer *peer;
+	int i;
+
+	for (i = 0; i < NSUBGRPS; i++) {
+		str2sockunion(peer_conf[i].addr, &su);
+		peer = peer_create(&su, NULL, bgp, asn, peer_conf[i].remote_as,
+				   AS_SPECIFIED, AFI_IP, SAFI_UNICAST, NULL);
+
+		/* no MRAI, so announcing does not arm t_routeadv */
+		peer->v_routeadv = 0;
+		peer->status = Established;
+		peer->afc_nego[AFI_IP][SAFI_UNICAST] = 1;
+		if (peer_conf[i].nexthop_self)
+			SET_FLAG(peer->af_flags[AFI_IP][SAFI_UNICAST],
+				 PEER_FLAG_NEXTHOP_SELF);
+
+		update_group_adjust_peer(peer_af_find(peer, AFI_IP,
+						      SAFI_UNICAST));
+		peers[i] = peer;
+		subgrps[i] = PAF_SUBGRP(peer_af_find(peer, AFI_IP,
+						     SAFI_UNICAST));
+	}
+}
+
+static void announce_prefixes(void)
+{
+	struct bgp_path_info *path;
+	struct bgp_dest *dest;
+	struct prefix p;
+	struct attr attr;
+	int i, j;
+
+	bgp_attr_default_set(&attr, BGP_ORIGIN_IGP);
+	inet_pton(AF_INET, "198.51.100.1", &attr.nexthop);
+
+	for (j = 0; j < NPREFIXES; j++) {
+		memset(&p, 0, sizeof(p));
+		p.family = AF_INET;
+		p.prefixlen = 24;
+		p.u.prefix4.s_addr = htonl(0x0a000000 | (j << 8));
+
+		dest = bgp_node_get(bgp->rib[AFI_IP][SAFI_UNICAST], &p);
+		path = info_make(ZEBRA_ROUTE_BGP, BGP_ROUTE_STATIC, 0,
+				 bgp->peer_self, bgp_attr_intern(&attr), dest);
+		bgp_path_info_add(dest, path);
+
+		for (i = 0; i < NSUBGRPS; i++)
+			bgp_adj_out_set_subgroup(dest, subgrps[i], &attr, path);
+	}
+}
+
+static void encode_serial(void)
+{
+	struct bpacket_encode enc;
+	int i;
+
+	/* encoding does not consume the advertisements, only commit does */
+	for (i = 0; i < NSUBGRPS; i++) {
+		subgroup_update_packet_encode(subgrps[i], &enc);
+		assert(enc.packet);
+
+		serial_len[i] = stream_get_endp(enc.packet);
+		memcpy(serial[i], STREAM_DATA(enc.packet), serial_len[i]);
+		stream_free(enc.packet);
+	}
+}
+
+static bool packet_matches_serial(int i)
+{
+	struct bpacket *pkt = bpacket_queue_first(SUBGRP_PKTQ(subgrps[i]));
+
+	if (!pkt || !pkt->buffer)
+		return false;
+	if (stream_get_endp(pkt->buffer) != serial_len[i])
+		return false;
+
+	return !memcmp(STREAM_DATA(pkt->buffer), serial[i], serial_len[i]);
+}
+
+static void test_result(const char *name, bool ok)
+{
+	printf("%s: %s\n", name, ok ? "OK" : "failed");
+	if (!ok)
+		failed++;
+}
+
+static void test_distinct_subgroups(void)
+{
+	bool ok = true;
+	int i, j;
+
+	for (i = 0; i < NSUBGRPS; i++) {
+		if (!subgrps[i])
+			ok = false;
+		for (j = 0; j < i; j++)
+			if (subgrps[i] == subgrps[j])
+				ok = false;
+	}
+
+	test_result("distinct subgroups", ok);
+}
+
+/* a subgroup whose peers are waiting on MRAI must not be encoded early */
+static void test_mrai_held(void)
+{
+	struct thread routeadv = {};
+	bool ok = true;
+	int i;
+
+	peers[0]->t_routeadv = &routeadv;
+	bgp_update_workers_run(bgp);
+	peers[0]->t_routeadv = NULL;
+
+	if (bgp_adv_fifo_count(&subgrps[0]->sync->update) != NPREFIXES)
+		ok = false;
+	if (bpacket_queue_first(SUBGRP_PKTQ(subgrps[0]))->buffer)
+		ok = false;
+
+	for (i = 1; i < NSUBGRPS; i++) {
+		if (bgp_adv_fifo_count(&subgrps[i]->sync->update))
+			ok = false;
+		if (!packet_matches_serial(i))
+			ok = false;
+	}
+
+	if (bgp->update_group_stats.updates_offloaded != NSUBGRPS - 1)
+		ok = false;
+
+	test_result("parallel encode skips subgroups held by MRAI", ok);
+}
+
+/* the held subgroup then goes out inline, identical to the serial path */
+static void test_serial_after_hold(void)
+{
+	bool ok = true;
+
+	subgroup_update_packet(subgrps[0]);
+
+	if (bgp_adv_fifo_count(&subgrps[0]->sync->update))
+		ok = false;
+	if (!packet_matches_serial(0))
+		ok = false;
+
+	test_result("inline encode after MRAI", ok);
+}
+
+int main(void)
+{
+	qobj_init();
+	bgp_attr_init();
+	master = thread_master_create(NULL);
+	frr_pthread_init();
+	bgp_master_init(master, BGP_SOCKET_SNDBUF_SIZE);
+	vrf_init(NULL, NULL, NULL, NULL, NULL);
+	bgp_option_set(BGP_OPT_NO_LISTEN);
+
+	if (bgp_get(&bgp, &asn, NULL, BGP_INSTANCE_TYPE_DEFAULT) < 0)
+		return -1;
+
+	setup_peers();
+	test_distinct_subgroups();
+	if (failed)
+		goto done;
+
+	announce_prefixes();
+	encode_serial();
+
+	bgp_update_workers_set(2);
+	test_mrai_held();
+	bgp_update_workers_set(0);
+
+	test_serial_after_hold();
+
+done:
+	printf("failures: %d\n", failed);
+	return failed;
+}
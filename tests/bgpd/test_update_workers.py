@@ -0,0 +1,10 @@
+import frrtest
+
+
+class TestUpdateWorkers(frrtest.TestMultiOut):
+    program = "./test_update_workers"
+
+
+TestUpdateWorkers.okfail("distinct subgroups")
+TestUpdateWorkers.okfail("parallel encode skips subgroups held by MRAI")
+TestUpdateWorkers.okfail("inline encode after MRAI")
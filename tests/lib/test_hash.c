@@ -0,0 +1,191 @@
+/*
+ * Hash table tests.
+ * Copyright (C) 2020 FRRouting
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+
+#include "hash.h"
+
+#define NITEMS 100000
+
+struct item {
+	unsigned int val;
+	bool seen;
+};
+
+static struct item items[NITEMS];
+
+static unsigned int item_key(const void *arg)
+{
+	const struct item *item = arg;
+
+	return item->val;
+}
+
+/* deliberately poor: lots of collisions and long probe sequences */
+static unsigned int item_key_bad(const void *arg)
+{
+	const struct item *item = arg;
+
+	return item->val & 0xf;
+}
+
+static bool item_cmp(const void *a, const void *b)
+{
+	return ((const struct item *)a)->val == ((const struct item *)b)->val;
+}
+
+static void item_mark(struct hash_bucket *hb, void *arg)
+{
+	struct item *item = hb->data;
+	unsigned int *count = arg;
+
+	assert(!item->seen);
+	item->seen = true;
+	(*count)++;
+}
+
+/* releases every other entry while iterating */
+static void item_release_odd(struct hash_bucket *hb, void *arg)
+{
+	struct hash *hash = arg;
+	struct item *item = hb->data;
+
+	if (item->val % 2)
+		assert(hash_release(hash, item) == item);
+}
+
+static int item_find(struct hash_bucket *hb, void *arg)
+{
+	struct item **found = arg;
+
+	*found = hb->data;
+	return HASHWALK_ABORT;
+}
+
+/* items[0..nitems) are expected in the hash if their index is a multiple of
+ * step
+ */
+static void check_all(struct hash *hash, unsigned int nitems,
+		      unsigned int step)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i < nitems; i++)
+		items[i].seen = false;
+
+	hash_iterate(hash, item_mark, &count);
+	assert(count == hash->count);
+
+	for (i = 0; i < nitems; i++) {
+		struct item lookup = {.val = items[i].val};
+		bool present = (i % step) == 0;
+
+		assert(items[i].seen == present);
+		assert(hash_lookup(hash, &lookup)
+		       == (present ? &items[i] : NULL));
+	}
+}
+
+static void run(unsigned int (*key)(const void *), unsigned int nitems)
+{
+	struct hash *hash;
+	struct item *found = NULL;
+	unsigned int i;
+
+	hash = hash_create_size(8, key, item_cmp, "test");
+
+	for (i = 0; i < nitems; i++) {
+		items[i].val = i * 7919;
+		assert(hash_get(hash, &items[i], hash_alloc_intern)
+		       == &items[i]);
+		/* inserting again finds the existing entry */
+		assert(hash_get(hash, &items[i], hash_alloc_intern)
+		       == &items[i]);
+	}
+	assert(hash->count == nitems);
+	check_all(hash, nitems, 1);
+
+	/* release half of the entries from within an iteration */
+	hash_iterate(hash, item_release_odd, hash);
+	assert(hash->count == nitems / 2);
+	for (i = 0; i < nitems; i++)
+		if (items[i].val % 2)
+			assert(hash_release(hash, &items[i]) == NULL);
+
+	/* the freed up slots are reused */
+	for (i = 1; i < nitems; i += 2)
+		hash_get(hash, &items[i], hash_alloc_intern);
+	assert(hash->count == nitems);
+
+	hash_walk(hash, item_find, &found);
+	assert(found);
+
+	for (i = 0; i < nitems; i++)
+		assert(hash_release(hash, &items[i]) == &items[i]);
+	assert(hash->count == 0);
+	assert(atomic_load_explicit(&hash->stats.probes, memory_order_relaxed)
+	       == 0);
+
+	hash_clean(hash, NULL);
+	hash_free(hash);
+}
+
+int main(int argc, char **argv)
+{
+	struct hash *hash;
+	unsigned int i, size;
+
+	printf("Validating insert, lookup and release...\n");
+	run(item_key, NITEMS);
+
+	printf("Validating with a poor hash function...\n");
+	run(item_key_bad, 2000);
+
+	printf("Validating incremental resize...\n");
+	hash = hash_create_size(8, item_key, item_cmp, "test");
+	for (i = 0; i < NITEMS; i++) {
+		items[i].val = i;
+		size = hash->size;
+		hash_get(hash, &items[i], hash_alloc_intern);
+
+		/* a resize only switches over to the new index, the entries
+		 * are moved by the following insertions
+		 */
+		if (hash->size != size)
+			assert(hash->old_size == size
+			       && hash->rehash_done == 0);
+		assert(!HASH_THRESHOLD(hash->used, hash->size));
+
+		if (i < 1000)
+			check_all(hash, i + 1, 1);
+	}
+	check_all(hash, NITEMS, 1);
+
+	/* keep every third entry, the rest becomes deleted slots */
+	for (i = 0; i < NITEMS; i++)
+		if (i % 3)
+			assert(hash_release(hash, &items[i]) == &items[i]);
+	check_all(hash, NITEMS, 3);
+
+	hash_clean(hash, NULL);
+	assert(hash->count == 0 && hash->old_index == NULL);
+	hash_free(hash);
+
+	printf("Hash table test successful.\n");
+	return 0;
+}
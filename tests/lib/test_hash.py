@@ -0,0 +1,8 @@
+import frrtest
+
+
+class TestHash(frrtest.TestMultiOut):
+    program = "./test_hash"
+
+
+TestHash.onesimple("Hash table test successful.")
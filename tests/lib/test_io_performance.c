@@ -0,0 +1,147 @@
+/*
+ * Test program which measures the time it takes to dispatch read events
+ * on a large number of file descriptors, for each I/O backend.
+ *
+ * Copyright (C) 2020 FRRouting
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include <sys/resource.h>
+
+#include "thread.h"
+#include "network.h"
+#include "prng.h"
+
+#define SOCKETS 5000
+#define ROUNDS  5000
+#define ACTIVE  8
+
+struct conn {
+	int fd[2];
+	bool pending;
+	struct thread *t_read;
+};
+
+static struct conn *conns;
+static unsigned int nconns;
+static unsigned int handled;
+
+static int conn_read(struct thread *thread)
+{
+	struct conn *conn = THREAD_ARG(thread);
+	char buf[16];
+
+	while (read(conn->fd[0], buf, sizeof(buf)) > 0)
+		;
+	conn->pending = false;
+	handled++;
+
+	thread_add_read(thread->master, conn_read, conn, conn->fd[0],
+			&conn->t_read);
+	return 0;
+}
+
+static void run(const char *backend, struct prng *prng)
+{
+	struct thread_master *master;
+	struct thread thread;
+	struct timeval tv_start, tv_stop;
+	unsigned long t_run;
+	unsigned int i, n, round, scheduled;
+
+	if (!thread_io_backend_set(backend)) {
+		printf("%s: not available\n", backend);
+		return;
+	}
+
+	master = thread_master_create(NULL);
+	for (i = 0; i < nconns; i++)
+		thread_add_read(master, conn_read, &conns[i], conns[i].fd[0],
+				&conns[i].t_read);
+
+	monotime(&tv_start);
+
+	for (round = 0; round < ROUNDS; round++) {
+		handled = 0;
+		scheduled = 0;
+		for (n = 0; n < ACTIVE; n++) {
+			i = prng_rand(prng) % nconns;
+			if (conns[i].pending)
+				continue;
+			if (write(conns[i].fd[1], "x", 1) != 1) {
+				perror("write");
+				exit(1);
+			}
+			conns[i].pending = true;
+			scheduled++;
+		}
+
+		while (handled < scheduled && thread_fetch(master, &thread))
+			thread_call(&thread);
+	}
+
+	monotime(&tv_stop);
+
+	for (i = 0; i < nconns; i++)
+		thread_cancel(conns[i].t_read);
+	thread_master_free(master);
+
+	t_run = 1000 * (tv_stop.tv_sec - tv_start.tv_sec);
+	t_run += (tv_stop.tv_usec - tv_start.tv_usec) / 1000;
+
+	printf("%s: %d rounds of %d ready out of %u sockets took %lu.%03lu seconds.\n",
+	       backend, ROUNDS, ACTIVE, nconns, t_run / 1000, t_run % 1000);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	struct prng *prng;
+	struct rlimit limit;
+	unsigned int i;
+
+	/* two fds per socket pair plus some slack */
+	getrlimit(RLIMIT_NOFILE, &limit);
+	if (limit.rlim_cur < 2 * SOCKETS + 64) {
+		limit.rlim_cur = MIN(limit.rlim_max, (rlim_t)2 * SOCKETS + 64);
+		setrlimit(RLIMIT_NOFILE, &limit);
+		getrlimit(RLIMIT_NOFILE, &limit);
+	}
+	nconns = MIN(SOCKETS, (limit.rlim_cur - 64) / 2);
+
+	conns = calloc(nconns, sizeof(*conns));
+	for (i = 0; i < nconns; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, conns[i].fd) < 0) {
+			perror("socketpair");
+			return 1;
+		}
+		set_nonblocking(conns[i].fd[0]);
+	}
+
+	prng = prng_new(0);
+	run("poll", prng);
+	run("epoll", prng);
+
+	for (i = 0; i < nconns; i++) {
+		close(conns[i].fd[0]);
+		close(conns[i].fd[1]);
+	}
+	free(conns);
+	prng_free(prng);
+	return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Multi-producer single-consumer stream queue tests.
+ * Copyright (C) 2020 FRRouting
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+#include <pthread.h>
+
+#include "stream.h"
+
+#define PRODUCERS 8
+#define PER_PRODUCER 100000
+#define BATCH 16
+
+static struct stream_mpsc queue;
+
+static struct stream *item_new(uint32_t producer, uint32_t seq)
+{
+	struct stream *s = stream_new(8);
+
+	stream_putl(s, producer);
+	stream_putl(s, seq);
+	return s;
+}
+
+/* even producers push one stream at a time, odd ones in batches */
+static void *producer(void *arg)
+{
+	uint32_t id = (uintptr_t)arg;
+	struct stream_fifo fifo;
+	uint32_t seq;
+
+	stream_fifo_init(&fifo);
+	for (seq = 0; seq < PER_PRODUCER; seq++) {
+		if (id % 2 == 0) {
+			stream_mpsc_push(&queue, item_new(id, seq));
+			continue;
+		}
+
+		stream_fifo_push(&fifo, item_new(id, seq));
+		if (fifo.count == BATCH)
+			stream_mpsc_push_fifo(&queue, &fifo);
+	}
+	stream_mpsc_push_fifo(&queue, &fifo);
+	assert(fifo.head == NULL && fifo.count == 0);
+	stream_fifo_deinit(&fifo);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[PRODUCERS];
+	uint32_t next[PRODUCERS] = {};
+	uint32_t id, seq, received = 0;
+	struct stream *s;
+	uintptr_t i;
+
+	printf("Validating single pthread ordering...\n");
+	stream_mpsc_init(&queue);
+	assert(stream_mpsc_pop(&queue) == NULL);
+	for (seq = 0; seq < 100; seq++) {
+		stream_mpsc_push(&queue, item_new(0, seq));
+		/* interleave pops with pushes */
+		if (seq % 3 == 0) {
+			s = stream_mpsc_pop(&queue);
+			assert(stream_getl_from(s, 4) == received++);
+			stream_free(s);
+		}
+	}
+	while ((s = stream_mpsc_pop(&queue))) {
+		assert(stream_getl_from(s, 4) == received++);
+		stream_free(s);
+	}
+	assert(received == 100 && stream_mpsc_count(&queue) == 0);
+
+	/* streams still queued are freed */
+	stream_mpsc_push(&queue, item_new(0, 0));
+	stream_mpsc_fini(&queue);
+
+	printf("Validating concurrent producers...\n");
+	stream_mpsc_init(&queue);
+	received = 0;
+	for (i = 0; i < PRODUCERS; i++)
+		pthread_create(&threads[i], NULL, producer, (void *)i);
+
+	while (received < PRODUCERS * PER_PRODUCER) {
+		s = stream_mpsc_pop(&queue);
+		if (!s) {
+			sched_yield();
+			continue;
+		}
+
+		id = stream_getl_from(s, 0);
+		seq = stream_getl_from(s, 4);
+		assert(id < PRODUCERS);
+		assert(seq == next[id]);
+		next[id]++;
+		received++;
+		stream_free(s);
+	}
+
+	for (i = 0; i < PRODUCERS; i++)
+		pthread_join(threads[i], NULL);
+
+	assert(stream_mpsc_pop(&queue) == NULL);
+	assert(stream_mpsc_count(&queue) == 0);
+	assert(atomic_load_explicit(&queue.max_count, memory_order_relaxed)
+	       <= PRODUCERS * PER_PRODUCER);
+	stream_mpsc_fini(&queue);
+
+	printf("Stream MPSC test successful.\n");
+	return 0;
+}
@@ -0,0 +1,8 @@
+import frrtest
+
+
+class TestStreamMpsc(frrtest.TestMultiOut):
+    program = "./test_stream_mpsc"
+
+
+TestStreamMpsc.onesimple("Stream MPSC test successful.")
@@ -0,0 +1,146 @@
+/*
+ * Test program which measures the time it takes to add, look up and
+ * remove routes in a route table.
+ *
+ * Copyright (C) 2020 FRRouting
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "memory.h"
+#include "prefix.h"
+#include "table.h"
+#include "prng.h"
+
+#define ROUTES  500000
+#define LOOKUPS 2000000
+
+DEFINE_MGROUP(TEST_TABLE, "table performance test")
+DEFINE_MTYPE_STATIC(TEST_TABLE, TEST_NODE, "test route node")
+
+/* the allocation scheme route tables used before nodes came from per-table
+ * slabs, for comparison
+ */
+static struct route_node *test_node_create(route_table_delegate_t *delegate,
+					   struct route_table *table)
+{
+	return XCALLOC(MTYPE_TEST_NODE, sizeof(struct route_node));
+}
+
+static void test_node_destroy(route_table_delegate_t *delegate,
+			      struct route_table *table, struct route_node *node)
+{
+	XFREE(MTYPE_TEST_NODE, node);
+}
+
+static route_table_delegate_t test_delegate = {
+	.create_node = test_node_create,
+	.destroy_node = test_node_destroy,
+};
+
+static unsigned long elapsed_msec(struct timeval *start, struct timeval *stop)
+{
+	return 1000 * (stop->tv_sec - start->tv_sec)
+	       + (stop->tv_usec - start->tv_usec) / 1000;
+}
+
+static void run(const char *name, route_table_delegate_t *delegate,
+		struct prefix_ipv4 *routes, struct in_addr *lookups)
+{
+	struct route_table *table;
+	struct route_node *rn;
+	struct prefix_ipv4 p = {.family = AF_INET, .prefixlen = IPV4_MAX_BITLEN};
+	struct timeval tv_start, tv_add, tv_lookup, tv_stop;
+	unsigned long matched = 0;
+	int i;
+
+	table = route_table_init_with_delegate(delegate);
+
+	monotime(&tv_start);
+
+	for (i = 0; i < ROUTES; i++) {
+		rn = route_node_get(table, (struct prefix *)&routes[i]);
+		if (rn->info)
+			route_unlock_node(rn);
+		rn->info = &routes[i];
+	}
+
+	monotime(&tv_add);
+
+	for (i = 0; i < LOOKUPS; i++) {
+		p.prefix = lookups[i];
+		rn = route_node_match(table, (struct prefix *)&p);
+		if (rn) {
+			matched++;
+			route_unlock_node(rn);
+		}
+	}
+
+	monotime(&tv_lookup);
+
+	for (i = 0; i < ROUTES; i++) {
+		rn = route_node_lookup(table, (struct prefix *)&routes[i]);
+		if (!rn)
+			continue;
+		rn->info = NULL;
+		route_unlock_node(rn);
+		route_unlock_node(rn);
+	}
+
+	monotime(&tv_stop);
+
+	assert(route_table_count(table) == 0);
+	route_table_finish(table);
+
+	printf("%s: adding %d routes took %lu msec\n", name, ROUTES,
+	       elapsed_msec(&tv_start, &tv_add));
+	printf("%s: %d longest prefix matches (%lu hits) took %lu msec\n",
+	       name, LOOKUPS, matched, elapsed_msec(&tv_add, &tv_lookup));
+	printf("%s: removing %d routes took %lu msec\n", name, ROUTES,
+	       elapsed_msec(&tv_lookup, &tv_stop));
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	struct prng *prng;
+	struct prefix_ipv4 *routes;
+	struct in_addr *lookups;
+	int i;
+
+	prng = prng_new(0);
+	routes = calloc(ROUTES, sizeof(*routes));
+	lookups = calloc(LOOKUPS, sizeof(*lookups));
+
+	/* mostly /16 to /24 like a full table, duplicates are harmless */
+	for (i = 0; i < ROUTES; i++) {
+		routes[i].family = AF_INET;
+		routes[i].prefixlen = 16 + prng_rand(prng) % 9;
+		routes[i].prefix.s_addr = htonl(prng_rand(prng));
+		apply_mask_ipv4(&routes[i]);
+	}
+	for (i = 0; i < LOOKUPS; i++)
+		lookups[i].s_addr = htonl(prng_rand(prng));
+
+	run("malloc'd nodes", &test_delegate, routes, lookups);
+	run("slab nodes", route_table_get_default_delegate(), routes, lookups);
+
+	free(lookups);
+	free(routes);
+	prng_free(prng);
+	return 0;
+}
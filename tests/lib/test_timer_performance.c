@@ -30,8 +30,9 @@
 #include "thread.h"
 #include "prng.h"
 
-#define SCHEDULE_TIMERS 1000000
-#define REMOVE_TIMERS    500000
+#define SCHEDULE_TIMERS   1000000
+#define REMOVE_TIMERS      500000
+#define RESCHEDULE_TIMERS 1000000
 
 struct thread_master *master;
 
@@ -45,8 +46,8 @@ int main(int argc, char **argv)
 	struct prng *prng;
 	int i;
 	struct thread **timers;
-	struct timeval tv_start, tv_lap, tv_stop;
-	unsigned long t_schedule, t_remove;
+	struct timeval tv_start, tv_lap, tv_lap2, tv_stop;
+	unsigned long t_schedule, t_reschedule, t_remove;
 
 	master = thread_master_create(NULL);
 	prng = prng_new(0);
@@ -74,6 +75,21 @@ int main(int argc, char **argv)
 
 	monotime(&tv_lap);
 
+	/* keepalive style: cancel a running timer and start it again */
+	for (i = 0; i < RESCHEDULE_TIMERS; i++) {
+		long interval_msec;
+		int index;
+
+		index = prng_rand(prng) % SCHEDULE_TIMERS;
+		interval_msec = prng_rand(prng) % (100 * SCHEDULE_TIMERS);
+		thread_cancel(timers[index]);
+		timers[index] = NULL;
+		thread_add_timer_msec(master, dummy_func, NULL, interval_msec,
+				      &timers[index]);
+	}
+
+	monotime(&tv_lap2);
+
 	for (i = 0; i < REMOVE_TIMERS; i++) {
 		int index;
 
@@ -88,11 +104,16 @@ int main(int argc, char **argv)
 	t_schedule = 1000 * (tv_lap.tv_sec - tv_start.tv_sec);
 	t_schedule += (tv_lap.tv_usec - tv_start.tv_usec) / 1000;
 
-	t_remove = 1000 * (tv_stop.tv_sec - tv_lap.tv_sec);
-	t_remove += (tv_stop.tv_usec - tv_lap.tv_usec) / 1000;
+	t_reschedule = 1000 * (tv_lap2.tv_sec - tv_lap.tv_sec);
+	t_reschedule += (tv_lap2.tv_usec - tv_lap.tv_usec) / 1000;
+
+	t_remove = 1000 * (tv_stop.tv_sec - tv_lap2.tv_sec);
+	t_remove += (tv_stop.tv_usec - tv_lap2.tv_usec) / 1000;
 
 	printf("Scheduling %d random timers took %lu.%03lu seconds.\n",
 	       SCHEDULE_TIMERS, t_schedule / 1000, t_schedule % 1000);
+	printf("Rescheduling %d random timers took %lu.%03lu seconds.\n",
+	       RESCHEDULE_TIMERS, t_reschedule / 1000, t_reschedule % 1000);
 	printf("Removing %d random timers took %lu.%03lu seconds.\n",
 	       REMOVE_TIMERS, t_remove / 1000, t_remove % 1000);
 	fflush(stdout);
@@ -0,0 +1,230 @@
+#!/usr/bin/env python
+
+#
+# fpm_server.py
+#
+# Permission to use, copy, modify, and/or distribute this software
+# for any purpose with or without fee is hereby granted, provided
+# that the above copyright notice and this permission notice appear
+# in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND NETDEF DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL NETDEF BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+# DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+# WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+# ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+# OF THIS SOFTWARE.
+#
+
+"""
+fpm_server.py: minimal FPM server taking several connections and speaking
+the flow control messages.
+
+Records, for every connection, how many messages came in and which tables
+and router MACs they were about, and dumps it as JSON after every read.
+
+Every message is acknowledged right away with a large window. SIGUSR1
+acknowledges what came in so far with a window of --window messages and
+stops acknowledging, SIGUSR2 acknowledges everything again.
+"""
+
+import argparse
+import json
+import os
+import select
+import signal
+import socket
+import struct
+
+FPM_HEADER = struct.Struct("!BBH")
+FPM_MSG_TYPE_NETLINK = 1
+FPM_MSG_TYPE_WINDOW = 4
+
+WINDOW_MSG = struct.Struct("!I4xQ")
+WINDOW_OPEN = 1000000
+
+NLMSGHDR = struct.Struct("=IHHII")
+RTMSG = struct.Struct("=BBBBBBBBI")
+RTATTR = struct.Struct("=HH")
+RTM_NEWROUTE = 24
+RTM_DELROUTE = 25
+RTM_NEWNEIGH = 28
+RTM_DELNEIGH = 29
+RTA_TABLE = 15
+
+
+def nl_align(length):
+    return (length + 3) & ~3
+
+
+class FpmConnection(object):
+    def __init__(self, sock, idx):
+        self.sock = sock
+        self.idx = idx
+        self.ibuf = b""
+        self.messages = 0
+        self.held = None
+        self.tables = {}
+        self.macs = 0
+
+    def send_window(self, window):
+        msg = WINDOW_MSG.pack(window, self.messages)
+        hdr = FPM_HEADER.pack(1, FPM_MSG_TYPE_WINDOW, FPM_HEADER.size + len(msg))
+        self.sock.sendall(hdr + msg)
+
+    def netlink(self, data):
+        while len(data) >= NLMSGHDR.size:
+            nl_len, nl_type, _, _, _ = NLMSGHDR.unpack_from(data)
+            msg, data = data[:nl_len], data[nl_align(nl_len) :]
+            if nl_type in (RTM_NEWNEIGH, RTM_DELNEIGH):
+                self.macs += 1
+                continue
+            if nl_type not in (RTM_NEWROUTE, RTM_DELROUTE):
+                continue
+
+            table = RTMSG.unpack_from(msg, NLMSGHDR.size)[4]
+            offset = NLMSGHDR.size + RTMSG.size
+            while offset + RTATTR.size <= len(msg):
+                rta_len, rta_type = RTATTR.unpack_from(msg, offset)
+                if rta_len < RTATTR.size:
+                    break
+                if rta_type == RTA_TABLE:
+                    table = struct.unpack_from("=I", msg, offset + RTATTR.size)[0]
+                offset += nl_align(rta_len)
+
+            key = str(table)
+            self.tables[key] = self.tables.get(key, 0) + 1
+
+    def read(self):
+        data = self.sock.recv(65536)
+        if not data:
+            return False
+
+        self.ibuf += data
+        while len(self.ibuf) >= FPM_HEADER.size:
+            _, msg_type, msg_len = FPM_HEADER.unpack_from(self.ibuf)
+            if len(self.ibuf) < msg_len:
+                break
+            payload = self.ibuf[FPM_HEADER.size : msg_len]
+            self.ibuf = self.ibuf[msg_len:]
+            self.messages += 1
+            if msg_type == FPM_MSG_TYPE_NETLINK:
+                self.netlink(payload)
+        return True
+
+    def state(self):
+        return {
+            "messages": self.messages,
+            "held": None if self.held is None else self.messages - self.held,
+            "tables": self.tables,
+            "macs": self.macs,
+        }
+
+
+class FpmServer(object):
+    def __init__(self, port, window, state_file):
+        self.port = port
+        self.window = window
+        self.state_file = state_file
+        self.listener = None
+        self.conns = []
+        self.closed = 0
+        self.hold = False
+        self.hold_changed = False
+
+    def dump(self):
+        state = {
+            "hold": self.hold,
+            "closed": self.closed,
+            "connections": [c.state() for c in self.conns],
+        }
+        with open(self.state_file + ".tmp", "w") as f:
+            json.dump(state, f)
+        os.rename(self.state_file + ".tmp", self.state_file)
+
+    def apply_hold(self):
+        for conn in self.conns:
+            if self.hold:
+                conn.held = conn.messages
+                conn.send_window(self.window)
+            else:
+                conn.held = None
+                conn.send_window(WINDOW_OPEN)
+
+    def run(self):
+        self.listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.bind(("127.0.0.1", self.port))
+        self.listener.listen(16)
+        self.dump()
+
+        while True:
+            if self.hold_changed:
+                self.hold_changed = False
+                self.apply_hold()
+                self.dump()
+
+            socks = [c.sock for c in self.conns] + [self.listener]
+            try:
+                ready, _, _ = select.select(socks, [], [], 0.5)
+            except (select.error, OSError):
+                # Interrupted by a signal.
+                continue
+
+            if self.listener in ready:
+                sock, _ = self.listener.accept()
+                conn = FpmConnection(sock, len(self.conns))
+                self.conns.append(conn)
+                if self.hold:
+                    conn.held = 0
+                    conn.send_window(self.window)
+                else:
+                    conn.send_window(WINDOW_OPEN)
+
+            for conn in list(self.conns):
+                if conn.sock not in ready:
+                    continue
+                if not conn.read():
+                    # zebra reconnects all connections together.
+                    for c in self.conns:
+                        c.sock.close()
+                    self.conns = []
+                    self.closed += 1
+                    break
+                if not self.hold:
+                    conn.send_window(WINDOW_OPEN)
+
+            self.dump()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--port", type=int, default=2620)
+    parser.add_argument("--window", type=int, default=8)
+    parser.add_argument("--state", required=True)
+    parser.add_argument("--pid", required=True)
+    args = parser.parse_args()
+
+    server = FpmServer(args.port, args.window, args.state)
+
+    def hold(signum, frame):
+        server.hold = True
+        server.hold_changed = True
+
+    def release(signum, frame):
+        server.hold = False
+        server.hold_changed = True
+
+    signal.signal(signal.SIGUSR1, hold)
+    signal.signal(signal.SIGUSR2, release)
+
+    with open(args.pid, "w") as f:
+        f.write(str(os.getpid()))
+
+    server.run()
+
+
+if __name__ == "__main__":
+    main()
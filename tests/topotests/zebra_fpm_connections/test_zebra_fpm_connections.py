@@ -0,0 +1,279 @@
+#!/usr/bin/env python
+
+#
+# test_zebra_fpm_connections.py
+#
+# Permission to use, copy, modify, and/or distribute this software
+# for any purpose with or without fee is hereby granted, provided
+# that the above copyright notice and this permission notice appear
+# in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND NETDEF DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL NETDEF BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+# DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+# WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+# ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+# OF THIS SOFTWARE.
+#
+
+"""
+test_zebra_fpm_connections.py: Test that zebra spreads the routes over
+several FPM connections by table, and stops sending on a connection once
+the server window is full.
+"""
+
+import os
+import sys
+import pytest
+import json
+from functools import partial
+
+# Save the Current Working Directory to find configuration files.
+CWD = os.path.dirname(os.path.realpath(__file__))
+sys.path.append(os.path.join(CWD, "../"))
+
+# pylint: disable=C0413
+# Import topogen and topotest helpers
+from lib import topotest
+from lib.topogen import Topogen, TopoRouter, get_topogen
+from lib.topolog import logger
+
+# Required to instantiate the topology builder class.
+from mininet.topo import Topo
+
+# Must match `fpm connections` in r1/zebra.conf.
+CONNECTIONS = 4
+
+# Messages the FPM server takes on a connection while holding.
+WINDOW = 8
+
+# VRFs and their tables, on top of the default table.
+VRF_TABLES = {"vrf{}".format(i): 1000 + i for i in range(1, 8)}
+
+# Routes sharpd installs in every table.
+ROUTES = 50
+
+
+def fpm_server_file(name):
+    "Returns the path of a FPM server file in the router log directory."
+    router = get_topogen().gears["r1"]
+    return os.path.join(router.logdir, router.name, name)
+
+
+#####################################################
+##
+##   Network Topology Definition
+##
+#####################################################
+
+
+class ZebraTopo(Topo):
+    "Test topology builder"
+
+    def build(self, *_args, **_opts):
+        "Build function"
+        tgen = get_topogen(self)
+
+        tgen.add_router("r1")
+
+        # Create a empty network for router 1
+        switch = tgen.add_switch("s1")
+        switch.add_link(tgen.gears["r1"])
+
+
+#####################################################
+##
+##   Tests starting
+##
+#####################################################
+
+
+def setup_module(mod):
+    "Sets up the pytest environment"
+    tgen = Topogen(ZebraTopo, mod.__name__)
+    tgen.start_topology()
+
+    r1 = tgen.gears["r1"]
+
+    # One table per VRF, each with a connected network to route through.
+    for vrf, table in VRF_TABLES.items():
+        idx = table - 1000
+        r1.run("ip link add {} type vrf table {}".format(vrf, table))
+        r1.run("ip link set dev {} up".format(vrf))
+        r1.run("ip link add dum{} type dummy".format(idx))
+        r1.run("ip link set dev dum{} master {}".format(idx, vrf))
+        r1.run("ip address add 172.16.{}.1/24 dev dum{}".format(idx, idx))
+        r1.run("ip link set dev dum{} up".format(idx))
+
+    router_list = tgen.routers()
+    for rname, router in router_list.items():
+        router.load_config(
+            TopoRouter.RD_ZEBRA,
+            os.path.join(CWD, "{}/zebra.conf".format(rname)),
+            "-M dplane_fpm_nl",
+        )
+
+        router.load_config(
+            TopoRouter.RD_SHARP, os.path.join(CWD, "{}/sharpd.conf".format(rname))
+        )
+
+    # Don't pick up the state of a previous run.
+    for name in ["fpm_server.json", "fpm_server.pid"]:
+        if os.path.exists(fpm_server_file(name)):
+            os.remove(fpm_server_file(name))
+
+    # The FPM server lives in the router namespace.
+    r1.run(
+        "{} {}/fpm_server.py --window {} --state {} --pid {} > /dev/null 2>&1 &".format(
+            sys.executable,
+            CWD,
+            WINDOW,
+            fpm_server_file("fpm_server.json"),
+            fpm_server_file("fpm_server.pid"),
+        )
+    )
+
+    # Initialize all routers.
+    tgen.start_router()
+
+
+def teardown_module(_mod):
+    "Teardown the pytest environment"
+    tgen = get_topogen()
+
+    tgen.gears["r1"].run("kill $(cat {})".format(fpm_server_file("fpm_server.pid")))
+
+    # This function tears down the whole topology.
+    tgen.stop_topology()
+
+
+def fpm_server_state():
+    try:
+        with open(fpm_server_file("fpm_server.json")) as f:
+            return json.load(f)
+    except (IOError, ValueError):
+        return None
+
+
+def fpm_server_signal(signal):
+    get_topogen().gears["r1"].run(
+        "kill -{} $(cat {})".format(signal, fpm_server_file("fpm_server.pid"))
+    )
+
+
+def fpm_table_routes(state, table):
+    "Returns the route messages of a table on each connection."
+    return [conn["tables"].get(str(table), 0) for conn in state["connections"]]
+
+
+def fpm_tables_check(routes):
+    "Checks that each table went over one connection only."
+    state = fpm_server_state()
+    if state is None:
+        return "no FPM server state yet"
+    if state["closed"]:
+        return "FPM connections were closed"
+    if len(state["connections"]) != CONNECTIONS:
+        return "{} FPM connections".format(len(state["connections"]))
+
+    for table in [254] + list(VRF_TABLES.values()):
+        per_conn = fpm_table_routes(state, table)
+        if sum(per_conn) < routes:
+            return "table {}: {} routes".format(table, sum(per_conn))
+        if len([n for n in per_conn if n]) != 1:
+            return "table {} over several connections: {}".format(table, per_conn)
+
+    # Router MACs only go over the first connection.
+    if any(conn["macs"] for conn in state["connections"][1:]):
+        return "router MACs over several connections"
+    return None
+
+
+def fpm_held_check():
+    "Checks that the connections stopped at the window while held."
+    state = fpm_server_state()
+    if state is None or not state["hold"]:
+        return "FPM server not holding"
+
+    held = [conn["held"] for conn in state["connections"]]
+    if any(n is None or n > WINDOW for n in held):
+        return "messages beyond the window: {}".format(held)
+    if WINDOW not in held:
+        return "no window filled up yet: {}".format(held)
+    return None
+
+
+def sharp_install(r1, start, count):
+    "Installs the same routes in the default table and every VRF."
+    r1.vtysh_cmd(
+        "sharp install routes {} nexthop 192.168.1.2 {}".format(start, count)
+    )
+    for vrf, table in VRF_TABLES.items():
+        r1.vtysh_cmd(
+            "sharp install routes vrf {} {} nexthop 172.16.{}.2 {}".format(
+                vrf, start, table - 1000, count
+            )
+        )
+
+
+def test_zebra_fpm_connections():
+    "Test that the routes of each table go over a single connection."
+    logger.info("Test that the routes of each table go over a single connection.")
+    tgen = get_topogen()
+    if tgen.routers_have_failure():
+        pytest.skip("skipped because of previous test failure")
+    r1 = tgen.gears["r1"]
+
+    sharp_install(r1, "10.0.0.0", ROUTES)
+
+    test_func = partial(fpm_tables_check, ROUTES)
+    _, result = topotest.run_and_expect(test_func, None, count=30, wait=1)
+    assert result is None, result
+
+    # The routes are spread, not all on the first connection.
+    state = fpm_server_state()
+    used = [conn for conn in state["connections"] if conn["tables"]]
+    assert len(used) > 1, "all tables on one connection"
+
+
+def test_zebra_fpm_window():
+    "Test that zebra stops sending when the server window is full."
+    logger.info("Test that zebra stops sending when the server window is full.")
+    tgen = get_topogen()
+    if tgen.routers_have_failure():
+        pytest.skip("skipped because of previous test failure")
+    r1 = tgen.gears["r1"]
+
+    fpm_server_signal("USR1")
+    _, result = topotest.run_and_expect(
+        lambda: (fpm_server_state() or {}).get("hold"), True, count=10, wait=1
+    )
+    assert result, "FPM server did not hold"
+
+    sharp_install(r1, "10.1.0.0", ROUTES)
+
+    _, result = topotest.run_and_expect(fpm_held_check, None, count=30, wait=1)
+    assert result is None, result
+
+    # Nothing more comes while the window stays full.
+    held = [conn["held"] for conn in fpm_server_state()["connections"]]
+    topotest.sleep(3, "Wait to see if more messages come in")
+    assert fpm_held_check() is None, fpm_held_check()
+    assert [conn["held"] for conn in fpm_server_state()["connections"]] == held
+
+    output = json.loads(r1.vtysh_cmd("show fpm counters json"))
+    hits = sum(conn["window-full-hits"] for conn in output["connections"])
+    assert hits > 0, "zebra did not hit the window"
+
+    # The rest comes once the server takes it.
+    fpm_server_signal("USR2")
+    test_func = partial(fpm_tables_check, 2 * ROUTES)
+    _, result = topotest.run_and_expect(test_func, None, count=30, wait=1)
+    assert result is None, result
+
+
+if __name__ == "__main__":
+    args = ["-s"] + sys.argv[1:]
+    sys.exit(pytest.main(args))
@@ -0,0 +1,233 @@
+#!/usr/bin/env python
+
+#
+# fpm_server.py
+#
+# Permission to use, copy, modify, and/or distribute this software
+# for any purpose with or without fee is hereby granted, provided
+# that the above copyright notice and this permission notice appear
+# in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND NETDEF DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL NETDEF BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+# DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+# WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+# ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+# OF THIS SOFTWARE.
+#
+
+"""
+fpm_server.py: minimal FPM server speaking the session resume messages.
+
+Keeps the route prefixes zebra sends, acknowledges the generation markers,
+asks zebra to resume from the last acknowledged generation when it connects
+again and dumps its state as JSON after every marker.
+
+SIGUSR1 drops the connection and stops listening, SIGUSR2 listens again.
+"""
+
+import argparse
+import json
+import os
+import select
+import signal
+import socket
+import struct
+
+FPM_HEADER = struct.Struct("!BBH")
+FPM_MSG_TYPE_NETLINK = 1
+FPM_MSG_TYPE_GENERATION = 3
+
+GENERATION_MSG = struct.Struct("!B3xQ")
+FPM_GENERATION_RESUME = 1
+FPM_GENERATION_REPLAY = 2
+FPM_GENERATION_MARKER = 3
+FPM_GENERATION_ACK = 4
+
+NLMSGHDR = struct.Struct("=IHHII")
+RTMSG = struct.Struct("=BBBBBBBBI")
+RTATTR = struct.Struct("=HH")
+RTM_NEWROUTE = 24
+RTM_DELROUTE = 25
+RTA_DST = 1
+RTA_TABLE = 15
+
+
+def nl_align(length):
+    return (length + 3) & ~3
+
+
+class FpmServer(object):
+    def __init__(self, port, state_file):
+        self.port = port
+        self.state_file = state_file
+        self.listener = None
+        self.conn = None
+        self.ibuf = b""
+        self.routes = set()
+        self.applied = 0
+        self.sessions = []
+        self.seen = set()
+        self.drop = False
+        self.listen_again = False
+
+    def listen(self):
+        self.listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.bind(("127.0.0.1", self.port))
+        self.listener.listen(1)
+
+    def close(self):
+        if self.conn:
+            self.conn.close()
+            self.conn = None
+        if self.listener:
+            self.listener.close()
+            self.listener = None
+
+    def send_generation(self, op, gen):
+        msg = GENERATION_MSG.pack(op, gen)
+        hdr = FPM_HEADER.pack(
+            1, FPM_MSG_TYPE_GENERATION, FPM_HEADER.size + len(msg)
+        )
+        self.conn.sendall(hdr + msg)
+
+    def accept(self):
+        self.conn, _ = self.listener.accept()
+        self.ibuf = b""
+        self.seen = set()
+        self.sessions.append({"replay": None, "routes": 0, "deletes": 0})
+        self.send_generation(FPM_GENERATION_RESUME, self.applied)
+
+    def dump(self):
+        state = {
+            "applied": self.applied,
+            "routes": sorted(self.routes),
+            "sessions": self.sessions,
+        }
+        with open(self.state_file + ".tmp", "w") as f:
+            json.dump(state, f)
+        os.rename(self.state_file + ".tmp", self.state_file)
+
+    def route(self, data):
+        while len(data) >= NLMSGHDR.size:
+            nl_len, nl_type, _, _, _ = NLMSGHDR.unpack_from(data)
+            msg, data = data[:nl_len], data[nl_align(nl_len) :]
+            if nl_type not in (RTM_NEWROUTE, RTM_DELROUTE):
+                continue
+
+            family, dst_len, _, _, table, _, _, _, _ = RTMSG.unpack_from(
+                msg, NLMSGHDR.size
+            )
+            dst = b"\0" * (4 if family == socket.AF_INET else 16)
+            offset = NLMSGHDR.size + RTMSG.size
+            while offset + RTATTR.size <= len(msg):
+                rta_len, rta_type = RTATTR.unpack_from(msg, offset)
+                if rta_len < RTATTR.size:
+                    break
+                value = msg[offset + RTATTR.size : offset + rta_len]
+                if rta_type == RTA_DST:
+                    dst = value
+                elif rta_type == RTA_TABLE:
+                    table = struct.unpack("=I", value)[0]
+                offset += nl_align(rta_len)
+
+            key = "{}/{} table {}".format(
+                socket.inet_ntop(family, dst), dst_len, table
+            )
+            session = self.sessions[-1]
+            if nl_type == RTM_NEWROUTE:
+                self.routes.add(key)
+                self.seen.add(key)
+                session["routes"] += 1
+            else:
+                self.routes.discard(key)
+                self.seen.discard(key)
+                session["deletes"] += 1
+
+    def generation(self, data):
+        op, gen = GENERATION_MSG.unpack_from(data)
+        session = self.sessions[-1]
+        if op == FPM_GENERATION_REPLAY:
+            session["replay"] = gen
+        elif op == FPM_GENERATION_MARKER:
+            # Everything was sent again: forget what was not.
+            if session["replay"] == 0 and not session.get("complete"):
+                self.routes &= self.seen
+            session["complete"] = True
+            self.applied = gen
+            self.send_generation(FPM_GENERATION_ACK, gen)
+            self.dump()
+
+    def read(self):
+        data = self.conn.recv(65536)
+        if not data:
+            self.conn.close()
+            self.conn = None
+            return
+
+        self.ibuf += data
+        while len(self.ibuf) >= FPM_HEADER.size:
+            _, msg_type, msg_len = FPM_HEADER.unpack_from(self.ibuf)
+            if len(self.ibuf) < msg_len:
+                break
+            payload = self.ibuf[FPM_HEADER.size : msg_len]
+            self.ibuf = self.ibuf[msg_len:]
+            if msg_type == FPM_MSG_TYPE_NETLINK:
+                self.route(payload)
+            elif msg_type == FPM_MSG_TYPE_GENERATION:
+                self.generation(payload)
+
+    def run(self):
+        self.listen()
+        while True:
+            if self.drop:
+                self.drop = False
+                self.close()
+            if self.listen_again:
+                self.listen_again = False
+                if not self.listener:
+                    self.listen()
+
+            # One session at a time.
+            fds = [s for s in (self.conn or self.listener,) if s]
+            try:
+                ready, _, _ = select.select(fds, [], [], 0.5)
+            except (select.error, OSError):
+                # Interrupted by a signal.
+                continue
+
+            if self.conn in ready:
+                self.read()
+            elif self.listener in ready:
+                self.accept()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--port", type=int, default=2620)
+    parser.add_argument("--state", required=True)
+    parser.add_argument("--pid", required=True)
+    args = parser.parse_args()
+
+    server = FpmServer(args.port, args.state)
+
+    def drop(signum, frame):
+        server.drop = True
+
+    def listen_again(signum, frame):
+        server.listen_again = True
+
+    signal.signal(signal.SIGUSR1, drop)
+    signal.signal(signal.SIGUSR2, listen_again)
+
+    with open(args.pid, "w") as f:
+        f.write(str(os.getpid()))
+
+    server.run()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,225 @@
+#!/usr/bin/env python
+
+#
+# test_zebra_fpm_resume.py
+#
+# Permission to use, copy, modify, and/or distribute this software
+# for any purpose with or without fee is hereby granted, provided
+# that the above copyright notice and this permission notice appear
+# in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND NETDEF DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL NETDEF BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+# DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+# WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+# ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+# OF THIS SOFTWARE.
+#
+
+"""
+test_zebra_fpm_resume.py: Test that a reconnecting FPM server only gets the
+routes changed while it was away.
+
+"""
+
+import os
+import sys
+import pytest
+import json
+from functools import partial
+
+# Save the Current Working Directory to find configuration files.
+CWD = os.path.dirname(os.path.realpath(__file__))
+sys.path.append(os.path.join(CWD, "../"))
+
+# pylint: disable=C0413
+# Import topogen and topotest helpers
+from lib import topotest
+from lib.topogen import Topogen, TopoRouter, get_topogen
+from lib.topolog import logger
+
+# Required to instantiate the topology builder class.
+from mininet.topo import Topo
+
+
+def fpm_server_file(name):
+    "Returns the path of a FPM server file in the router log directory."
+    router = get_topogen().gears["r1"]
+    return os.path.join(router.logdir, router.name, name)
+
+
+#####################################################
+##
+##   Network Topology Definition
+##
+#####################################################
+
+
+class ZebraTopo(Topo):
+    "Test topology builder"
+
+    def build(self, *_args, **_opts):
+        "Build function"
+        tgen = get_topogen(self)
+
+        tgen.add_router("r1")
+
+        # Create a empty network for router 1
+        switch = tgen.add_switch("s1")
+        switch.add_link(tgen.gears["r1"])
+
+
+#####################################################
+##
+##   Tests starting
+##
+#####################################################
+
+
+def setup_module(mod):
+    "Sets up the pytest environment"
+    tgen = Topogen(ZebraTopo, mod.__name__)
+    tgen.start_topology()
+
+    router_list = tgen.routers()
+    for rname, router in router_list.items():
+        router.load_config(
+            TopoRouter.RD_ZEBRA,
+            os.path.join(CWD, "{}/zebra.conf".format(rname)),
+            "-M dplane_fpm_nl",
+        )
+
+        router.load_config(
+            TopoRouter.RD_SHARP, os.path.join(CWD, "{}/sharpd.conf".format(rname))
+        )
+
+    # Don't pick up the state of a previous run.
+    for name in ["fpm_server.json", "fpm_server.pid"]:
+        if os.path.exists(fpm_server_file(name)):
+            os.remove(fpm_server_file(name))
+
+    # The FPM server lives in the router namespace.
+    tgen.gears["r1"].run(
+        "{} {}/fpm_server.py --state {} --pid {} > /dev/null 2>&1 &".format(
+            sys.executable,
+            CWD,
+            fpm_server_file("fpm_server.json"),
+            fpm_server_file("fpm_server.pid"),
+        )
+    )
+
+    # Initialize all routers.
+    tgen.start_router()
+
+
+def teardown_module(_mod):
+    "Teardown the pytest environment"
+    tgen = get_topogen()
+
+    tgen.gears["r1"].run(
+        "kill $(cat {})".format(fpm_server_file("fpm_server.pid"))
+    )
+
+    # This function tears down the whole topology.
+    tgen.stop_topology()
+
+
+def fpm_server_state():
+    try:
+        with open(fpm_server_file("fpm_server.json")) as f:
+            return json.load(f)
+    except (IOError, ValueError):
+        return None
+
+
+def fpm_server_check(sessions, replay_full, routes):
+    "Compares the FPM server state with the expected session and routes."
+    state = fpm_server_state()
+    if state is None:
+        return "no FPM server state yet"
+    if len(state["sessions"]) != sessions:
+        return "{} FPM sessions".format(len(state["sessions"]))
+
+    session = state["sessions"][-1]
+    if not session.get("complete"):
+        return "FPM session still replaying"
+    if (session["replay"] == 0) != replay_full:
+        return "unexpected replay from {}".format(session["replay"])
+
+    test_routes = [
+        r for r in state["routes"] if r.startswith(("10.", "172.16."))
+    ]
+    if sorted(test_routes) != sorted(routes):
+        return "FPM routes mismatch: {}".format(test_routes)
+    return None
+
+
+def route_keys(prefixes):
+    return ["{} table 254".format(p) for p in prefixes]
+
+
+def test_zebra_fpm_full_replay():
+    "Test that the first session gets all routes."
+    logger.info("Test that the first session gets all routes.")
+    tgen = get_topogen()
+    if tgen.routers_have_failure():
+        pytest.skip("skipped because of previous test failure")
+    r1 = tgen.gears["r1"]
+
+    r1.vtysh_cmd("sharp install routes 10.0.0.0 nexthop 192.168.1.2 100")
+
+    expected = route_keys(["10.0.0.{}/32".format(i) for i in range(100)])
+    test_func = partial(fpm_server_check, 1, True, expected)
+    _, result = topotest.run_and_expect(test_func, None, count=30, wait=1)
+    assert result is None, result
+
+
+def test_zebra_fpm_resume():
+    "Test that the server only gets what changed while it was away."
+    logger.info("Test that the server only gets what changed while it was away.")
+    tgen = get_topogen()
+    if tgen.routers_have_failure():
+        pytest.skip("skipped because of previous test failure")
+    r1 = tgen.gears["r1"]
+
+    # Drop the session, and change some routes meanwhile.
+    r1.run("kill -USR1 $(cat {})".format(fpm_server_file("fpm_server.pid")))
+    test_func = partial(
+        topotest.router_json_cmp,
+        r1,
+        "show fpm counters json",
+        {"connection-closes": 1},
+    )
+    _, result = topotest.run_and_expect(test_func, None, count=10, wait=1)
+    assert result is None, "zebra did not notice the FPM session drop"
+
+    r1.vtysh_cmd("sharp remove routes 10.0.0.0 10")
+    r1.vtysh_cmd(
+        """
+        configure terminal
+         ip route 172.16.0.0/24 192.168.1.2
+         ip route 172.16.1.0/24 192.168.1.2
+        """
+    )
+
+    r1.run("kill -USR2 $(cat {})".format(fpm_server_file("fpm_server.pid")))
+
+    expected = route_keys(
+        ["10.0.0.{}/32".format(i) for i in range(10, 100)]
+        + ["172.16.0.0/24", "172.16.1.0/24"]
+    )
+    test_func = partial(fpm_server_check, 2, False, expected)
+    _, result = topotest.run_and_expect(test_func, None, count=30, wait=1)
+    assert result is None, result
+
+    # Only the changes were replayed.
+    session = fpm_server_state()["sessions"][-1]
+    assert session["deletes"] >= 10, "deleted routes were not replayed"
+    assert session["routes"] < 90, "unchanged routes were replayed"
+
+
+if __name__ == "__main__":
+    args = ["-s"] + sys.argv[1:]
+    sys.exit(pytest.main(args))
@@ -0,0 +1,232 @@
+#!/usr/bin/env python
+
+#
+# test_zebra_restart_reconcile.py
+#
+# Permission to use, copy, modify, and/or distribute this software
+# for any purpose with or without fee is hereby granted, provided
+# that the above copyright notice and this permission notice appear
+# in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND NETDEF DISCLAIMS ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL NETDEF BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+# DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS,
+# WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS
+# ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+# OF THIS SOFTWARE.
+#
+
+"""
+test_zebra_restart_reconcile.py: Test that zebra restarted with -K only
+rewrites the kernel routes that changed.
+
+Before the restart sharpd installs:
+  10.0.0.0/32 - 10.0.0.9/32 via 192.168.1.2
+  10.0.1.0/32 - 10.0.1.3/32 via 192.168.1.2
+  10.0.2.0/32 - 10.0.2.3/32 via 192.168.1.2
+
+After the restart:
+  10.0.0.0/32 - 10.0.0.7/32 come back unchanged and are skipped,
+  10.0.0.8/32 and 10.0.0.9/32 do not come back and are swept,
+  10.0.1.0/32 - 10.0.1.3/32 come back via 192.168.1.3 and are updated,
+  10.0.2.0/32 - 10.0.2.3/32 come back with a route-map source address
+  the kernel does not have yet, and are updated.
+"""
+
+import os
+import re
+import sys
+import pytest
+from functools import partial
+
+# Save the Current Working Directory to find configuration files.
+CWD = os.path.dirname(os.path.realpath(__file__))
+sys.path.append(os.path.join(CWD, "../"))
+
+# pylint: disable=C0413
+# Import topogen and topotest helpers
+from lib import topotest
+from lib.topogen import Topogen, TopoRouter, get_topogen
+from lib.topolog import logger
+
+# Required to instantiate the topology builder class.
+from mininet.topo import Topo
+
+# Seconds after the restart until zebra sweeps the stale kernel routes.
+SWEEP_TIME = 20
+
+
+#####################################################
+##
+##   Network Topology Definition
+##
+#####################################################
+
+
+class ZebraTopo(Topo):
+    "Test topology builder"
+
+    def build(self, *_args, **_opts):
+        "Build function"
+        tgen = get_topogen(self)
+
+        tgen.add_router("r1")
+
+        # Create a empty network for router 1
+        switch = tgen.add_switch("s1")
+        switch.add_link(tgen.gears["r1"])
+
+
+#####################################################
+##
+##   Tests starting
+##
+#####################################################
+
+
+def setup_module(mod):
+    "Sets up the pytest environment"
+    tgen = Topogen(ZebraTopo, mod.__name__)
+    tgen.start_topology()
+
+    router_list = tgen.routers()
+    for rname, router in router_list.items():
+        router.load_config(
+            TopoRouter.RD_ZEBRA, os.path.join(CWD, "{}/zebra.conf".format(rname))
+        )
+        router.load_config(
+            TopoRouter.RD_SHARP, os.path.join(CWD, "{}/sharpd.conf".format(rname))
+        )
+
+    # Initialize all routers.
+    tgen.start_router()
+
+
+def teardown_module(_mod):
+    "Teardown the pytest environment"
+    tgen = get_topogen()
+
+    # This function tears down the whole topology.
+    tgen.stop_topology()
+
+
+def kernel_routes(router, prefix):
+    "Returns the sharpd routes the kernel has under a prefix."
+    # Not every iproute2 knows the name of the sharp protocol (194).
+    output = router.run("ip -4 route show proto 194 root {}".format(prefix))
+    return sorted(line.strip() for line in output.splitlines() if line.strip())
+
+
+def sharp_install(router, start, nexthop, count):
+    "Installs routes through sharpd, waiting until zebra installed them."
+    router.vtysh_cmd(
+        "sharp install routes {} nexthop {} {}".format(start, nexthop, count)
+    )
+
+    def check():
+        output = router.vtysh_cmd("show ip route sharp json", isjson=True)
+        installed = [
+            p
+            for p, routes in output.items()
+            if p.startswith(start.rsplit(".", 1)[0] + ".")
+            and any(r.get("installed") for r in routes)
+            and any(
+                nh.get("ip") == nexthop
+                for r in routes
+                for nh in r.get("nexthops", [])
+            )
+        ]
+        return len(installed) == count
+
+    _, result = topotest.run_and_expect(check, True, count=30, wait=1)
+    assert result, "sharp routes from {} were not installed".format(start)
+
+
+def restart_counters(router):
+    "Returns the skipped, updated and deleted counters of the default VRF."
+    output = router.vtysh_cmd("show zebra")
+    # The restart table comes last in the output.
+    counters = re.findall(r"^default\s+(\d+)\s+(\d+)\s+(\d+)\s*$", output, re.M)
+    if not counters:
+        return None
+    return tuple(int(c) for c in counters[-1])
+
+
+def test_zebra_routes_before_restart():
+    "Install the routes zebra finds in the kernel after restarting."
+    logger.info("Install the routes zebra finds in the kernel after restarting.")
+    tgen = get_topogen()
+    if tgen.routers_have_failure():
+        pytest.skip("skipped because of previous test failure")
+    r1 = tgen.gears["r1"]
+
+    sharp_install(r1, "10.0.0.0", "192.168.1.2", 10)
+    sharp_install(r1, "10.0.1.0", "192.168.1.2", 4)
+    sharp_install(r1, "10.0.2.0", "192.168.1.2", 4)
+
+    assert len(kernel_routes(r1, "10.0.0.0/24")) == 10
+    for route in kernel_routes(r1, "10.0.2.0/24"):
+        assert " src " not in route, "unexpected source address: " + route
+
+
+def test_zebra_restart_reconcile():
+    "Restart zebra and sharpd, and check what was written to the kernel."
+    logger.info("Restart zebra and sharpd, and check what was written to the kernel.")
+    tgen = get_topogen()
+    if tgen.routers_have_failure():
+        pytest.skip("skipped because of previous test failure")
+    r1 = tgen.gears["r1"]
+
+    # SIGKILL leaves the routes in the kernel, zebra reads them back and
+    # keeps them until the sweep.
+    r1.killDaemons(["zebra", "sharpd"])
+    tgen.net["r1"].daemons_options["zebra"] = "-K {}".format(SWEEP_TIME)
+    r1.startDaemons(["zebra", "sharpd"])
+
+    r1.vtysh_cmd(
+        """
+        configure terminal
+         ip protocol sharp route-map SRC
+        """
+    )
+
+    sharp_install(r1, "10.0.0.0", "192.168.1.2", 8)
+    sharp_install(r1, "10.0.1.0", "192.168.1.3", 4)
+    sharp_install(r1, "10.0.2.0", "192.168.1.2", 4)
+
+    test_func = partial(restart_counters, r1)
+    _, result = topotest.run_and_expect(test_func, (8, 8, 0), count=10, wait=1)
+    assert result == (8, 8, 0), "unexpected restart counters {}".format(result)
+
+    # What was skipped or updated matches the RIB.
+    for route in kernel_routes(r1, "10.0.1.0/24"):
+        assert "via 192.168.1.3 " in route, "route not updated: " + route
+    routes = kernel_routes(r1, "10.0.2.0/24")
+    assert len(routes) == 4
+    for route in routes:
+        assert " src 192.168.1.1" in route, "source not updated: " + route
+
+
+def test_zebra_restart_sweep():
+    "Check that the routes not installed again are swept."
+    logger.info("Check that the routes not installed again are swept.")
+    tgen = get_topogen()
+    if tgen.routers_have_failure():
+        pytest.skip("skipped because of previous test failure")
+    r1 = tgen.gears["r1"]
+
+    test_func = partial(restart_counters, r1)
+    _, result = topotest.run_and_expect(
+        test_func, (8, 8, 2), count=SWEEP_TIME + 30, wait=1
+    )
+    assert result == (8, 8, 2), "unexpected restart counters {}".format(result)
+
+    routes = kernel_routes(r1, "10.0.0.0/24")
+    assert len(routes) == 8, "stale routes were not swept: {}".format(routes)
+
+
+if __name__ == "__main__":
+    args = ["-s"] + sys.argv[1:]
+    sys.exit(pytest.main(args))
@@ -40,6 +40,7 @@
 #include "lib/network.h"
 #include "lib/ns.h"
 #include "lib/frr_pthread.h"
+#include "lib/jhash.h"
 #include "zebra/debug.h"
 #include "zebra/interface.h"
 #include "zebra/zebra_dplane.h"
@@ -50,6 +51,7 @@
 #include "zebra/kernel_netlink.h"
 #include "zebra/rt_netlink.h"
 #include "zebra/debug.h"
+#include "fpm/fpm.h"
 
 #define SOUTHBOUND_DEFAULT_ADDR INADDR_LOOPBACK
 #define SOUTHBOUND_DEFAULT_PORT 2620
@@ -58,7 +60,8 @@
  * FPM header:
  * {
  *   version: 1 byte (always 1),
- *   type: 1 byte (1 for netlink, 2 protobuf),
+ *   type: 1 byte (1 for netlink, 2 protobuf, 3 session resume, 4 flow
+ *         control),
  *   len: 2 bytes (network order),
  * }
  *
@@ -67,23 +70,154 @@
  */
 #define FPM_HEADER_SIZE 4
 
+/* Session resume message size, see `fpm_generation_msg_t`. */
+#define FPM_GENERATION_MSG_SIZE                                                \
+	(FPM_HEADER_SIZE + sizeof(fpm_generation_msg_t))
+
+/* How long to wait for the server resume request before replaying all. */
+#define FPM_RESUME_WAIT_MSEC 1000
+
+/* Generation marker interval in seconds. */
+#define FPM_MARKER_INTERVAL 1
+
+/* How long to wait for room on the connections before trying again. */
+#define FPM_QUEUE_RETRY_MSEC 10
+
+/* Maximum amount of connections to the FPM server. */
+#define FPM_MAX_CONNECTIONS 16
+
+/* Messages in flight timed per connection for the latency histograms. */
+#define FPM_LATENCY_SAMPLES 256
+
+/* Latency histogram buckets: < 100us, < 1ms, < 10ms, < 100ms, < 1s, more. */
+#define FPM_LATENCY_BUCKETS 6
+
+/* Flow control message size, see `fpm_window_msg_t`. */
+#define FPM_WINDOW_MSG_SIZE (FPM_HEADER_SIZE + sizeof(fpm_window_msg_t))
+
 static const char *prov_name = "dplane_fpm_nl";
 
-struct fpm_nl_ctx {
+struct fpm_latency {
+	/* Amount of samples per bucket. */
+	_Atomic uint32_t buckets[FPM_LATENCY_BUCKETS];
+	/* Sum of all samples in microseconds. */
+	_Atomic uint64_t total_usec;
+	/* Largest sample in microseconds. */
+	_Atomic uint32_t max_usec;
+};
+
+/*
+ * Start time of (some of) the messages in flight, keyed by the byte or
+ * message count the message ends at.
+ */
+struct fpm_latency_ring {
+	struct {
+		uint64_t key;
+		struct timeval start;
+	} samples[FPM_LATENCY_SAMPLES];
+	unsigned int head;
+	unsigned int count;
+};
+
+/*
+ * One of the connections to the FPM server. Routes are sharded by table
+ * among the connections, router MACs all go over the first one and next
+ * hop groups over all of them.
+ */
+struct fpm_nl_conn {
+	struct fpm_nl_ctx *fnc;
+	unsigned int idx;
+
 	/* data plane connection. */
 	int socket;
-	bool disabled;
 	bool connecting;
+
+	/* data plane buffers. */
+	struct stream *ibuf;
+	struct stream *obuf;
+	pthread_mutex_t obuf_mutex;
+
+	/*
+	 * Contexts waiting for room in this connection output buffer, only
+	 * used by the FPM thread.
+	 */
+	struct dplane_ctx_q ctxqueue;
+
+	/* Session resume: what the server asked for and acknowledged. */
+	bool resume_req;
+	uint64_t resume_req_gen;
+	uint64_t acked_gen;
+
+	/*
+	 * Flow control, protected by `obuf_mutex`: messages and bytes queued
+	 * on this connection, how many messages the server is done with and
+	 * how many more it takes.
+	 */
+	bool window_on;
+	uint32_t window;
+	uint64_t msgs_sent;
+	uint64_t msgs_acked;
+	uint64_t bytes_queued;
+	uint64_t bytes_written;
+	struct fpm_latency_ring write_ring;
+	struct fpm_latency_ring ack_ring;
+
+	/* data plane events. */
+	struct thread *t_read;
+	struct thread *t_write;
+
+	/* Statistic counters. */
+	struct {
+		/* Amount of bytes written from obuf. */
+		_Atomic uint32_t bytes_sent;
+		/* Output buffer current usage. */
+		_Atomic uint32_t obuf_bytes;
+		/* Output buffer peak usage. */
+		_Atomic uint32_t obuf_peak;
+		/* Amount of data plane contexts enqueued. */
+		_Atomic uint32_t ctxqueue_len;
+		/* Amount of buffer full events. */
+		_Atomic uint32_t buffer_full;
+		/* Amount of times the server window was full. */
+		_Atomic uint32_t window_full;
+		/* Amount of flow control messages received. */
+		_Atomic uint32_t window_updates;
+
+		/* Time from output buffer to socket. */
+		struct fpm_latency write_latency;
+		/* Time from output buffer to server acknowledgement. */
+		struct fpm_latency ack_latency;
+	} counters;
+};
+
+struct fpm_nl_ctx {
+	bool disabled;
 	bool nhg_complete;
 	bool rib_complete;
 	bool rmac_complete;
 	bool use_nhg;
+	bool resume;
+	bool resume_wait;
+	/* Session resume as configured, applied by FNE_SET_RESUME. */
+	_Atomic bool resume_config;
+	bool flow_control;
+	/* Flow control as configured, applied by FNE_SET_FLOW_CONTROL. */
+	_Atomic bool flow_control_config;
 	struct sockaddr_storage addr;
 
-	/* data plane buffers. */
-	struct stream *ibuf;
-	struct stream *obuf;
-	pthread_mutex_t obuf_mutex;
+	/* Connections in use and the configured amount. */
+	struct fpm_nl_conn conns[FPM_MAX_CONNECTIONS];
+	unsigned int nconns;
+	_Atomic uint32_t nconns_config;
+
+	/*
+	 * Session resume generations: the one the current RIB walk replays
+	 * changes from (0 replays everything), the last one all the servers
+	 * acknowledged and the last marker sent.
+	 */
+	uint64_t resume_gen;
+	uint64_t acked_gen;
+	uint64_t marker_gen;
 
 	/*
 	 * data plane context queue:
@@ -93,14 +227,20 @@ struct fpm_nl_ctx {
 	struct dplane_ctx_q ctxqueue;
 	pthread_mutex_t ctxqueue_mutex;
 
+	/*
+	 * Next hop group or router MAC context waiting for the connection
+	 * queues to drain, only used by the FPM thread.
+	 */
+	struct zebra_dplane_ctx *ctx_pending;
+
 	/* data plane events. */
 	struct zebra_dplane_provider *prov;
 	struct frr_pthread *fthread;
 	struct thread *t_connect;
-	struct thread *t_read;
-	struct thread *t_write;
 	struct thread *t_event;
 	struct thread *t_dequeue;
+	struct thread *t_resume;
+	struct thread *t_marker;
 
 	/* zebra events. */
 	struct thread *t_nhgreset;
@@ -140,6 +280,15 @@ struct fpm_nl_ctx {
 
 		/* Amount of buffer full events. */
 		_Atomic uint32_t buffer_full;
+
+		/* Amount of sessions that only got the changed routes. */
+		_Atomic uint32_t resumes;
+		/* Amount of sessions that got all routes. */
+		_Atomic uint32_t full_replays;
+		/* Amount of generation markers sent. */
+		_Atomic uint32_t markers_sent;
+		/* Amount of generation acknowledgements received. */
+		_Atomic uint32_t acks_received;
 	} counters;
 } *gfnc;
 
@@ -152,6 +301,12 @@ enum fpm_nl_events {
 	FNE_RESET_COUNTERS,
 	/* Toggle next hop group feature. */
 	FNE_TOGGLE_NHG,
+	/* Apply the configured session resume setting. */
+	FNE_SET_RESUME,
+	/* Apply the configured flow control setting. */
+	FNE_SET_FLOW_CONTROL,
+	/* Apply the configured amount of connections. */
+	FNE_SET_CONNECTIONS,
 	/* Reconnect request by our own code to avoid races. */
 	FNE_INTERNAL_RECONNECT,
 
@@ -182,6 +337,12 @@ static int fpm_rib_send(struct thread *t);
 static int fpm_rib_reset(struct thread *t);
 static int fpm_rmac_send(struct thread *t);
 static int fpm_rmac_reset(struct thread *t);
+static int fpm_resume_timeout(struct thread *t);
+static int fpm_resume_replay(struct thread *t);
+static int fpm_marker(struct thread *t);
+static void fpm_resume_wait(struct fpm_nl_ctx *fnc);
+static int fpm_read_messages(struct fpm_nl_conn *conn);
+static int fpm_process_queue(struct thread *t);
 
 /*
  * Helper functions.
@@ -208,6 +369,91 @@ static void stream_pulldown(struct stream *s)
 	s->endp = rlen;
 }
 
+/**
+ * Accounts a latency sample in its histogram bucket.
+ *
+ * @param fl the latency histogram.
+ * @param usec the sample in microseconds.
+ */
+static void fpm_latency_add(struct fpm_latency *fl, int64_t usec)
+{
+	unsigned int bucket;
+	int64_t limit;
+
+	for (bucket = 0, limit = 100; bucket < FPM_LATENCY_BUCKETS - 1;
+	     bucket++, limit *= 10)
+		if (usec < limit)
+			break;
+
+	atomic_fetch_add_explicit(&fl->buckets[bucket], 1,
+				  memory_order_relaxed);
+	atomic_fetch_add_explicit(&fl->total_usec, usec, memory_order_relaxed);
+	if (usec > atomic_load_explicit(&fl->max_usec, memory_order_relaxed))
+		atomic_store_explicit(&fl->max_usec, MIN(usec, UINT32_MAX),
+				      memory_order_relaxed);
+}
+
+/**
+ * Remembers when the message ending at `key` was queued, unless too many
+ * messages are already being timed.
+ */
+static void fpm_latency_start(struct fpm_latency_ring *ring, uint64_t key)
+{
+	unsigned int slot;
+
+	if (ring->count == FPM_LATENCY_SAMPLES)
+		return;
+
+	slot = (ring->head + ring->count) % FPM_LATENCY_SAMPLES;
+	ring->samples[slot].key = key;
+	monotime(&ring->samples[slot].start);
+	ring->count++;
+}
+
+/**
+ * Accounts the time the messages up to `key` took.
+ */
+static void fpm_latency_done(struct fpm_latency_ring *ring, uint64_t key,
+			     struct fpm_latency *fl)
+{
+	while (ring->count && ring->samples[ring->head].key <= key) {
+		fpm_latency_add(
+			fl, monotime_since(&ring->samples[ring->head].start,
+					   NULL));
+		ring->head = (ring->head + 1) % FPM_LATENCY_SAMPLES;
+		ring->count--;
+	}
+}
+
+/**
+ * Picks the connection a route goes over: all routes of a table share one,
+ * so they keep their order.
+ */
+static struct fpm_nl_conn *fpm_conn_shard(struct fpm_nl_ctx *fnc,
+					  const struct zebra_dplane_ctx *ctx)
+{
+	if (fnc->nconns == 1)
+		return &fnc->conns[0];
+
+	return &fnc->conns[jhash_2words(dplane_ctx_get_vrf(ctx),
+					dplane_ctx_get_table(ctx), 0)
+			   % fnc->nconns];
+}
+
+/**
+ * Whether all connections are up.
+ */
+static bool fpm_connected(const struct fpm_nl_ctx *fnc)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < fnc->nconns; idx++)
+		if (fnc->conns[idx].socket == -1 || fnc->conns[idx].connecting)
+			return false;
+
+	return true;
+}
+
 /*
  * CLI.
  */
@@ -313,6 +559,107 @@ DEFUN(no_fpm_use_nhg, no_fpm_use_nhg_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(fpm_resume, fpm_resume_cmd,
+      "fpm session-resume",
+      FPM_STR
+      "Only replay the routes changed since the server last acknowledged.\n")
+{
+	/* Already enabled. */
+	if (atomic_load_explicit(&gfnc->resume_config, memory_order_relaxed))
+		return CMD_SUCCESS;
+
+	atomic_store_explicit(&gfnc->resume_config, true,
+			      memory_order_relaxed);
+	thread_add_event(gfnc->fthread->master, fpm_process_event, gfnc,
+			 FNE_SET_RESUME, NULL);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_fpm_resume, no_fpm_resume_cmd,
+      "no fpm session-resume",
+      NO_STR
+      FPM_STR
+      "Only replay the routes changed since the server last acknowledged.\n")
+{
+	/* Already disabled. */
+	if (!atomic_load_explicit(&gfnc->resume_config, memory_order_relaxed))
+		return CMD_SUCCESS;
+
+	atomic_store_explicit(&gfnc->resume_config, false,
+			      memory_order_relaxed);
+	thread_add_event(gfnc->fthread->master, fpm_process_event, gfnc,
+			 FNE_SET_RESUME, NULL);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(fpm_flow_control, fpm_flow_control_cmd,
+      "fpm flow-control",
+      FPM_STR
+      "Let the server pace the messages sent on each connection.\n")
+{
+	/* Already enabled. */
+	if (atomic_load_explicit(&gfnc->flow_control_config,
+				 memory_order_relaxed))
+		return CMD_SUCCESS;
+
+	atomic_store_explicit(&gfnc->flow_control_config, true,
+			      memory_order_relaxed);
+	thread_add_event(gfnc->fthread->master, fpm_process_event, gfnc,
+			 FNE_SET_FLOW_CONTROL, NULL);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_fpm_flow_control, no_fpm_flow_control_cmd,
+      "no fpm flow-control",
+      NO_STR
+      FPM_STR
+      "Let the server pace the messages sent on each connection.\n")
+{
+	/* Already disabled. */
+	if (!atomic_load_explicit(&gfnc->flow_control_config,
+				  memory_order_relaxed))
+		return CMD_SUCCESS;
+
+	atomic_store_explicit(&gfnc->flow_control_config, false,
+			      memory_order_relaxed);
+	thread_add_event(gfnc->fthread->master, fpm_process_event, gfnc,
+			 FNE_SET_FLOW_CONTROL, NULL);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(fpm_connections, fpm_connections_cmd,
+      "fpm connections (1-16)",
+      FPM_STR
+      "Spread the routes over several connections, by table\n"
+      "Amount of connections\n")
+{
+	atomic_store_explicit(&gfnc->nconns_config,
+			      strtoul(argv[2]->arg, NULL, 10),
+			      memory_order_relaxed);
+	thread_add_event(gfnc->fthread->master, fpm_process_event, gfnc,
+			 FNE_SET_CONNECTIONS, NULL);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(no_fpm_connections, no_fpm_connections_cmd,
+      "no fpm connections [(1-16)]",
+      NO_STR
+      FPM_STR
+      "Spread the routes over several connections, by table\n"
+      "Amount of connections\n")
+{
+	atomic_store_explicit(&gfnc->nconns_config, 1, memory_order_relaxed);
+	thread_add_event(gfnc->fthread->master, fpm_process_event, gfnc,
+			 FNE_SET_CONNECTIONS, NULL);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(fpm_reset_counters, fpm_reset_counters_cmd,
       "clear fpm counters",
       CLEAR_STR
@@ -324,12 +671,65 @@ DEFUN(fpm_reset_counters, fpm_reset_counters_cmd,
 	return CMD_SUCCESS;
 }
 
+static void fpm_show_latency(struct vty *vty, const char *label,
+			     struct fpm_latency *fl)
+{
+	uint32_t bucket, samples = 0;
+	unsigned int idx;
+
+	vty_out(vty, "%28s:", label);
+	for (idx = 0; idx < FPM_LATENCY_BUCKETS; idx++) {
+		bucket = atomic_load_explicit(&fl->buckets[idx],
+					      memory_order_relaxed);
+		samples += bucket;
+		vty_out(vty, " %8u", bucket);
+	}
+	vty_out(vty, " %8" PRIu64 " %8u\n",
+		samples ? atomic_load_explicit(&fl->total_usec,
+					       memory_order_relaxed)
+				  / samples
+			: 0,
+		atomic_load_explicit(&fl->max_usec, memory_order_relaxed));
+}
+
+static struct json_object *fpm_json_latency(struct fpm_latency *fl)
+{
+	static const char *const names[FPM_LATENCY_BUCKETS] = {
+		"lt-100us", "lt-1ms", "lt-10ms", "lt-100ms", "lt-1s", "ge-1s",
+	};
+	struct json_object *jo;
+	uint32_t bucket, samples = 0;
+	unsigned int idx;
+
+	jo = json_object_new_object();
+	for (idx = 0; idx < FPM_LATENCY_BUCKETS; idx++) {
+		bucket = atomic_load_explicit(&fl->buckets[idx],
+					      memory_order_relaxed);
+		samples += bucket;
+		json_object_int_add(jo, names[idx], bucket);
+	}
+	json_object_int_add(
+		jo, "average-usec",
+		samples ? atomic_load_explicit(&fl->total_usec,
+					       memory_order_relaxed)
+				  / samples
+			: 0);
+	json_object_int_add(jo, "max-usec",
+			    atomic_load_explicit(&fl->max_usec,
+						 memory_order_relaxed));
+
+	return jo;
+}
+
 DEFUN(fpm_show_counters, fpm_show_counters_cmd,
       "show fpm counters",
       SHOW_STR
       FPM_STR
       "FPM statistic counters\n")
 {
+	struct fpm_nl_conn *conn;
+	unsigned int idx;
+
 	vty_out(vty, "%30s\n%30s\n", "FPM counters", "============");
 
 #define SHOW_COUNTER(label, counter) \
@@ -350,6 +750,34 @@ DEFUN(fpm_show_counters, fpm_show_counters_cmd,
 	SHOW_COUNTER("Buffer full hits", gfnc->counters.buffer_full);
 	SHOW_COUNTER("User FPM configurations", gfnc->counters.user_configures);
 	SHOW_COUNTER("User FPM disable requests", gfnc->counters.user_disables);
+	SHOW_COUNTER("Session resumes", gfnc->counters.resumes);
+	SHOW_COUNTER("Session full replays", gfnc->counters.full_replays);
+	SHOW_COUNTER("Generation markers sent", gfnc->counters.markers_sent);
+	SHOW_COUNTER("Generation acks received", gfnc->counters.acks_received);
+
+	for (idx = 0; idx < gfnc->nconns; idx++) {
+		conn = &gfnc->conns[idx];
+
+		vty_out(vty, "\n%28s %u\n%30s\n", "FPM connection", idx,
+			"================");
+		SHOW_COUNTER("Output bytes", conn->counters.bytes_sent);
+		SHOW_COUNTER("Output buffer current size",
+			     conn->counters.obuf_bytes);
+		SHOW_COUNTER("Output buffer peak size",
+			     conn->counters.obuf_peak);
+		SHOW_COUNTER("Data plane items enqueued",
+			     conn->counters.ctxqueue_len);
+		SHOW_COUNTER("Buffer full hits", conn->counters.buffer_full);
+		SHOW_COUNTER("Window full hits", conn->counters.window_full);
+		SHOW_COUNTER("Window updates", conn->counters.window_updates);
+		vty_out(vty, "%29s %8s %8s %8s %8s %8s %8s %8s %8s\n", "",
+			"<100us", "<1ms", "<10ms", "<100ms", "<1s", "more",
+			"avg(us)", "max(us)");
+		fpm_show_latency(vty, "Write latency",
+				 &conn->counters.write_latency);
+		fpm_show_latency(vty, "Ack latency",
+				 &conn->counters.ack_latency);
+	}
 
 #undef SHOW_COUNTER
 
@@ -363,7 +791,9 @@ DEFUN(fpm_show_counters_json, fpm_show_counters_json_cmd,
       "FPM statistic counters\n"
       JSON_STR)
 {
-	struct json_object *jo;
+	struct json_object *jo, *jconns, *jconn;
+	struct fpm_nl_conn *conn;
+	unsigned int idx;
 
 	jo = json_object_new_object();
 	json_object_int_add(jo, "bytes-read", gfnc->counters.bytes_read);
@@ -384,6 +814,43 @@ DEFUN(fpm_show_counters_json, fpm_show_counters_json_cmd,
 	json_object_int_add(jo, "user-configures",
 			    gfnc->counters.user_configures);
 	json_object_int_add(jo, "user-disables", gfnc->counters.user_disables);
+	json_object_int_add(jo, "session-resumes", gfnc->counters.resumes);
+	json_object_int_add(jo, "session-full-replays",
+			    gfnc->counters.full_replays);
+	json_object_int_add(jo, "generation-markers-sent",
+			    gfnc->counters.markers_sent);
+	json_object_int_add(jo, "generation-acks-received",
+			    gfnc->counters.acks_received);
+
+	jconns = json_object_new_array();
+	for (idx = 0; idx < gfnc->nconns; idx++) {
+		conn = &gfnc->conns[idx];
+
+		jconn = json_object_new_object();
+		json_object_int_add(jconn, "connection", idx);
+		json_object_int_add(jconn, "bytes-sent",
+				    conn->counters.bytes_sent);
+		json_object_int_add(jconn, "obuf-bytes",
+				    conn->counters.obuf_bytes);
+		json_object_int_add(jconn, "obuf-bytes-peak",
+				    conn->counters.obuf_peak);
+		json_object_int_add(jconn, "data-plane-contexts-queue",
+				    conn->counters.ctxqueue_len);
+		json_object_int_add(jconn, "buffer-full-hits",
+				    conn->counters.buffer_full);
+		json_object_int_add(jconn, "window-full-hits",
+				    conn->counters.window_full);
+		json_object_int_add(jconn, "window-updates",
+				    conn->counters.window_updates);
+		json_object_object_add(
+			jconn, "write-latency",
+			fpm_json_latency(&conn->counters.write_latency));
+		json_object_object_add(
+			jconn, "ack-latency",
+			fpm_json_latency(&conn->counters.ack_latency));
+		json_object_array_add(jconns, jconn);
+	}
+	json_object_object_add(jo, "connections", jconns);
 	vty_out(vty, "%s\n", json_object_to_json_string_ext(jo, 0));
 	json_object_free(jo);
 
@@ -431,6 +898,22 @@ static int fpm_write_config(struct vty *vty)
 		written = 1;
 	}
 
+	if (atomic_load_explicit(&gfnc->resume_config, memory_order_relaxed)) {
+		vty_out(vty, "fpm session-resume\n");
+		written = 1;
+	}
+
+	if (atomic_load_explicit(&gfnc->flow_control_config,
+				 memory_order_relaxed)) {
+		vty_out(vty, "fpm flow-control\n");
+		written = 1;
+	}
+
+	if (gfnc->nconns_config != 1) {
+		vty_out(vty, "fpm connections %u\n", gfnc->nconns_config);
+		written = 1;
+	}
+
 	return written;
 }
 
@@ -445,9 +928,79 @@ static struct cmd_node fpm_node = {
  * FPM functions.
  */
 static int fpm_connect(struct thread *t);
+static int fpm_write(struct thread *t);
+
+/**
+ * Allocates the buffers of a connection the first time it is used.
+ *
+ * @param fnc the netlink FPM context.
+ * @param idx the connection index.
+ */
+static void fpm_conn_init(struct fpm_nl_ctx *fnc, unsigned int idx)
+{
+	struct fpm_nl_conn *conn = &fnc->conns[idx];
+
+	if (conn->obuf)
+		return;
+
+	conn->fnc = fnc;
+	conn->idx = idx;
+	conn->socket = -1;
+	conn->ibuf = stream_new(NL_PKT_BUF_SIZE);
+	conn->obuf = stream_new(NL_PKT_BUF_SIZE * 128);
+	pthread_mutex_init(&conn->obuf_mutex, NULL);
+	TAILQ_INIT(&conn->ctxqueue);
+}
+
+/**
+ * Hands a context back to the data plane.
+ */
+static void fpm_ctx_done(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
+{
+	/* Account the processed entries. */
+	atomic_fetch_add_explicit(&fnc->counters.dplane_contexts, 1,
+				  memory_order_relaxed);
+	atomic_fetch_sub_explicit(&fnc->counters.ctxqueue_len, 1,
+				  memory_order_relaxed);
+
+	dplane_ctx_set_status(ctx, ZEBRA_DPLANE_REQUEST_SUCCESS);
+	dplane_provider_enqueue_out_ctx(fnc->prov, ctx);
+}
+
+/**
+ * Drops the contexts waiting to be sent: the walks after reconnecting send
+ * the routes they carried.
+ */
+static void fpm_queue_flush(struct fpm_nl_ctx *fnc)
+{
+	struct fpm_nl_conn *conn;
+	struct zebra_dplane_ctx *ctx;
+	unsigned int idx;
+
+	if (fnc->ctx_pending) {
+		fpm_ctx_done(fnc, fnc->ctx_pending);
+		fnc->ctx_pending = NULL;
+	}
+
+	for (idx = 0; idx < FPM_MAX_CONNECTIONS; idx++) {
+		conn = &fnc->conns[idx];
+		while ((ctx = dplane_ctx_dequeue(&conn->ctxqueue))) {
+			atomic_fetch_sub_explicit(&conn->counters.ctxqueue_len,
+						  1, memory_order_relaxed);
+			fpm_ctx_done(fnc, ctx);
+		}
+	}
+
+	frr_mutex_lock_autounlock(&fnc->ctxqueue_mutex);
+	while ((ctx = dplane_ctx_dequeue(&fnc->ctxqueue)))
+		fpm_ctx_done(fnc, ctx);
+}
 
 static void fpm_reconnect(struct fpm_nl_ctx *fnc)
 {
+	struct fpm_nl_conn *conn;
+	unsigned int idx;
+
 	/* Cancel all zebra threads first. */
 	thread_cancel_async(zrouter.master, &fnc->t_nhgreset, NULL);
 	thread_cancel_async(zrouter.master, &fnc->t_nhgwalk, NULL);
@@ -456,22 +1009,55 @@ static void fpm_reconnect(struct fpm_nl_ctx *fnc)
 	thread_cancel_async(zrouter.master, &fnc->t_rmacreset, NULL);
 	thread_cancel_async(zrouter.master, &fnc->t_rmacwalk, NULL);
 
-	/*
-	 * Grab the lock to empty the streams (data plane might try to
-	 * enqueue updates while we are closing).
-	 */
-	frr_mutex_lock_autounlock(&fnc->obuf_mutex);
+	THREAD_OFF(fnc->t_dequeue);
+	fpm_queue_flush(fnc);
+
+	for (idx = 0; idx < FPM_MAX_CONNECTIONS; idx++) {
+		conn = &fnc->conns[idx];
+		if (conn->obuf == NULL)
+			continue;
+
+		/*
+		 * Grab the lock to empty the streams (data plane might try to
+		 * enqueue updates while we are closing).
+		 */
+		frr_with_mutex(&conn->obuf_mutex) {
+			/* Avoid calling close on `-1`. */
+			if (conn->socket != -1) {
+				close(conn->socket);
+				conn->socket = -1;
+			}
 
-	/* Avoid calling close on `-1`. */
-	if (fnc->socket != -1) {
-		close(fnc->socket);
-		fnc->socket = -1;
+			stream_reset(conn->ibuf);
+			stream_reset(conn->obuf);
+			atomic_fetch_sub_explicit(
+				&fnc->counters.obuf_bytes,
+				atomic_load_explicit(&conn->counters.obuf_bytes,
+						     memory_order_relaxed),
+				memory_order_relaxed);
+			atomic_store_explicit(&conn->counters.obuf_bytes, 0,
+					      memory_order_relaxed);
+			THREAD_OFF(conn->t_read);
+			THREAD_OFF(conn->t_write);
+
+			/* The next server starts over. */
+			conn->resume_req = false;
+			conn->window_on = false;
+			conn->msgs_sent = 0;
+			conn->msgs_acked = 0;
+			conn->bytes_queued = 0;
+			conn->bytes_written = 0;
+			conn->write_ring.count = 0;
+			conn->ack_ring.count = 0;
+		}
 	}
 
-	stream_reset(fnc->ibuf);
-	stream_reset(fnc->obuf);
-	THREAD_OFF(fnc->t_read);
-	THREAD_OFF(fnc->t_write);
+	THREAD_OFF(fnc->t_resume);
+	THREAD_OFF(fnc->t_marker);
+
+	/* No markers until the next session replayed its routes. */
+	fnc->resume_wait = false;
+	fnc->rib_complete = false;
 
 	/* FPM is disabled, don't attempt to connect. */
 	if (fnc->disabled)
@@ -481,19 +1067,34 @@ static void fpm_reconnect(struct fpm_nl_ctx *fnc)
 			 &fnc->t_connect);
 }
 
+/**
+ * Tells the FPM thread there might be room for the queued contexts now.
+ */
+static void fpm_queue_kick(struct fpm_nl_ctx *fnc)
+{
+	if (atomic_load_explicit(&fnc->counters.ctxqueue_len,
+				 memory_order_relaxed)
+	    == 0)
+		return;
+
+	THREAD_OFF(fnc->t_dequeue);
+	thread_add_event(fnc->fthread->master, fpm_process_queue, fnc, 0,
+			 &fnc->t_dequeue);
+}
+
 static int fpm_read(struct thread *t)
 {
-	struct fpm_nl_ctx *fnc = THREAD_ARG(t);
+	struct fpm_nl_conn *conn = THREAD_ARG(t);
+	struct fpm_nl_ctx *fnc = conn->fnc;
 	ssize_t rv;
 
-	/* Let's ignore the input at the moment. */
-	rv = stream_read_try(fnc->ibuf, fnc->socket,
-			     STREAM_WRITEABLE(fnc->ibuf));
+	rv = stream_read_try(conn->ibuf, conn->socket,
+			     STREAM_WRITEABLE(conn->ibuf));
 	/* We've got an interruption. */
 	if (rv == -2) {
 		/* Schedule next read. */
-		thread_add_read(fnc->fthread->master, fpm_read, fnc,
-				fnc->socket, &fnc->t_read);
+		thread_add_read(fnc->fthread->master, fpm_read, conn,
+				conn->socket, &conn->t_read);
 		return 0;
 	}
 	if (rv == 0) {
@@ -501,7 +1102,8 @@ static int fpm_read(struct thread *t)
 					  memory_order_relaxed);
 
 		if (IS_ZEBRA_DEBUG_FPM)
-			zlog_debug("%s: connection closed", __func__);
+			zlog_debug("%s: connection %u closed", __func__,
+				   conn->idx);
 
 		FPM_RECONNECT(fnc);
 		return 0;
@@ -509,40 +1111,52 @@ static int fpm_read(struct thread *t)
 	if (rv == -1) {
 		atomic_fetch_add_explicit(&fnc->counters.connection_errors, 1,
 					  memory_order_relaxed);
-		zlog_warn("%s: connection failure: %s", __func__,
+		zlog_warn("%s: connection %u failure: %s", __func__, conn->idx,
 			  strerror(errno));
 		FPM_RECONNECT(fnc);
 		return 0;
 	}
-	stream_reset(fnc->ibuf);
 
 	/* Account all bytes read. */
 	atomic_fetch_add_explicit(&fnc->counters.bytes_read, rv,
 				  memory_order_relaxed);
 
-	thread_add_read(fnc->fthread->master, fpm_read, fnc, fnc->socket,
-			&fnc->t_read);
+	/* Only session resume and flow control talk back, ignore otherwise. */
+	if (!fnc->resume && !fnc->flow_control)
+		stream_reset(conn->ibuf);
+	else if (fpm_read_messages(conn) == -1) {
+		atomic_fetch_add_explicit(&fnc->counters.connection_errors, 1,
+					  memory_order_relaxed);
+		FPM_RECONNECT(fnc);
+		return 0;
+	}
+
+	thread_add_read(fnc->fthread->master, fpm_read, conn, conn->socket,
+			&conn->t_read);
 
 	return 0;
 }
 
 static int fpm_write(struct thread *t)
 {
-	struct fpm_nl_ctx *fnc = THREAD_ARG(t);
+	struct fpm_nl_conn *conn = THREAD_ARG(t);
+	struct fpm_nl_ctx *fnc = conn->fnc;
 	socklen_t statuslen;
 	ssize_t bwritten;
 	int rv, status;
 	size_t btotal;
+	bool written = false;
 
-	if (fnc->connecting == true) {
+	if (conn->connecting == true) {
 		status = 0;
 		statuslen = sizeof(status);
 
-		rv = getsockopt(fnc->socket, SOL_SOCKET, SO_ERROR, &status,
+		rv = getsockopt(conn->socket, SOL_SOCKET, SO_ERROR, &status,
 				&statuslen);
 		if (rv == -1 || status != 0) {
 			if (rv != -1)
-				zlog_warn("%s: connection failed: %s", __func__,
+				zlog_warn("%s: connection %u failed: %s",
+					  __func__, conn->idx,
 					  strerror(status));
 			else
 				zlog_warn("%s: SO_ERROR failed: %s", __func__,
@@ -556,95 +1170,124 @@ static int fpm_write(struct thread *t)
 			return 0;
 		}
 
-		fnc->connecting = false;
+		conn->connecting = false;
 
 		/* Permit receiving messages now. */
-		thread_add_read(fnc->fthread->master, fpm_read, fnc,
-				fnc->socket, &fnc->t_read);
-	}
-
-	frr_mutex_lock_autounlock(&fnc->obuf_mutex);
+		thread_add_read(fnc->fthread->master, fpm_read, conn,
+				conn->socket, &conn->t_read);
 
-	while (true) {
-		/* Stream is empty: reset pointers and return. */
-		if (STREAM_READABLE(fnc->obuf) == 0) {
-			stream_reset(fnc->obuf);
-			break;
-		}
-
-		/* Try to write all at once. */
-		btotal = stream_get_endp(fnc->obuf) -
-			stream_get_getp(fnc->obuf);
-		bwritten = write(fnc->socket, stream_pnt(fnc->obuf), btotal);
-		if (bwritten == 0) {
-			atomic_fetch_add_explicit(
-				&fnc->counters.connection_closes, 1,
-				memory_order_relaxed);
+		/* The servers tell us where to resume from. */
+		if (fnc->resume && fpm_connected(fnc))
+			fpm_resume_wait(fnc);
+	}
 
-			if (IS_ZEBRA_DEBUG_FPM)
-				zlog_debug("%s: connection closed", __func__);
-			break;
-		}
-		if (bwritten == -1) {
-			/* Attempt to continue if blocked by a signal. */
-			if (errno == EINTR)
-				continue;
-			/* Receiver is probably slow, lets give it some time. */
-			if (errno == EAGAIN || errno == EWOULDBLOCK)
+	frr_with_mutex(&conn->obuf_mutex) {
+		while (true) {
+			/* Stream is empty: reset pointers and return. */
+			if (STREAM_READABLE(conn->obuf) == 0) {
+				stream_reset(conn->obuf);
 				break;
+			}
 
-			atomic_fetch_add_explicit(
-				&fnc->counters.connection_errors, 1,
-				memory_order_relaxed);
-			zlog_warn("%s: connection failure: %s", __func__,
-				  strerror(errno));
+			/* Try to write all at once. */
+			btotal = stream_get_endp(conn->obuf)
+				 - stream_get_getp(conn->obuf);
+			bwritten = write(conn->socket, stream_pnt(conn->obuf),
+					 btotal);
+			if (bwritten == 0) {
+				atomic_fetch_add_explicit(
+					&fnc->counters.connection_closes, 1,
+					memory_order_relaxed);
+
+				if (IS_ZEBRA_DEBUG_FPM)
+					zlog_debug("%s: connection %u closed",
+						   __func__, conn->idx);
+				break;
+			}
+			if (bwritten == -1) {
+				/* Attempt to continue if blocked by a signal. */
+				if (errno == EINTR)
+					continue;
+				/* Receiver is probably slow, lets give it some time. */
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					break;
+
+				atomic_fetch_add_explicit(
+					&fnc->counters.connection_errors, 1,
+					memory_order_relaxed);
+				zlog_warn("%s: connection %u failure: %s",
+					  __func__, conn->idx, strerror(errno));
+
+				FPM_RECONNECT(fnc);
+				return 0;
+			}
 
-			FPM_RECONNECT(fnc);
-			return 0;
+			/* Account all bytes sent. */
+			atomic_fetch_add_explicit(&fnc->counters.bytes_sent,
+						  bwritten,
+						  memory_order_relaxed);
+			atomic_fetch_add_explicit(&conn->counters.bytes_sent,
+						  bwritten,
+						  memory_order_relaxed);
+
+			/* Account number of bytes free. */
+			atomic_fetch_sub_explicit(&fnc->counters.obuf_bytes,
+						  bwritten,
+						  memory_order_relaxed);
+			atomic_fetch_sub_explicit(&conn->counters.obuf_bytes,
+						  bwritten,
+						  memory_order_relaxed);
+
+			stream_forward_getp(conn->obuf, (size_t)bwritten);
+
+			/* Time the messages that made it to the socket. */
+			conn->bytes_written += bwritten;
+			fpm_latency_done(&conn->write_ring, conn->bytes_written,
+					 &conn->counters.write_latency);
+			written = true;
 		}
 
-		/* Account all bytes sent. */
-		atomic_fetch_add_explicit(&fnc->counters.bytes_sent, bwritten,
-					  memory_order_relaxed);
-
-		/* Account number of bytes free. */
-		atomic_fetch_sub_explicit(&fnc->counters.obuf_bytes, bwritten,
-					  memory_order_relaxed);
-
-		stream_forward_getp(fnc->obuf, (size_t)bwritten);
+		/* Stream is not empty yet, we must schedule more writes. */
+		if (STREAM_READABLE(conn->obuf)) {
+			stream_pulldown(conn->obuf);
+			thread_add_write(fnc->fthread->master, fpm_write, conn,
+					 conn->socket, &conn->t_write);
+		}
 	}
 
-	/* Stream is not empty yet, we must schedule more writes. */
-	if (STREAM_READABLE(fnc->obuf)) {
-		stream_pulldown(fnc->obuf);
-		thread_add_write(fnc->fthread->master, fpm_write, fnc,
-				 fnc->socket, &fnc->t_write);
-		return 0;
-	}
+	/* Make room for the contexts waiting on this connection. */
+	if (written)
+		fpm_queue_kick(fnc);
 
 	return 0;
 }
 
+/**
+ * Schedules the walks sending everything (or only the changed routes when
+ * resuming) to the server.
+ */
+static void fpm_walk_start(struct fpm_nl_ctx *fnc)
+{
+	/* Mark all routes as unsent. */
+	if (fnc->use_nhg)
+		thread_add_timer(zrouter.master, fpm_nhg_reset, fnc, 0,
+				 &fnc->t_nhgreset);
+	else
+		thread_add_timer(zrouter.master, fpm_rib_reset, fnc, 0,
+				 &fnc->t_ribreset);
+}
+
 static int fpm_connect(struct thread *t)
 {
 	struct fpm_nl_ctx *fnc = THREAD_ARG(t);
+	struct fpm_nl_conn *conn;
 	struct sockaddr_in *sin = (struct sockaddr_in *)&fnc->addr;
 	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&fnc->addr;
 	socklen_t slen;
 	int rv, sock;
+	unsigned int idx;
 	char addrstr[INET6_ADDRSTRLEN];
 
-	sock = socket(fnc->addr.ss_family, SOCK_STREAM, 0);
-	if (sock == -1) {
-		zlog_err("%s: fpm socket failed: %s", __func__,
-			 strerror(errno));
-		thread_add_timer(fnc->fthread->master, fpm_connect, fnc, 3,
-				 &fnc->t_connect);
-		return 0;
-	}
-
-	set_nonblocking(sock);
-
 	if (fnc->addr.ss_family == AF_INET) {
 		inet_ntop(AF_INET, &sin->sin_addr, addrstr, sizeof(addrstr));
 		slen = sizeof(*sin);
@@ -654,43 +1297,221 @@ static int fpm_connect(struct thread *t)
 	}
 
 	if (IS_ZEBRA_DEBUG_FPM)
-		zlog_debug("%s: attempting to connect to %s:%d", __func__,
-			   addrstr, ntohs(sin->sin_port));
+		zlog_debug("%s: attempting to connect to %s:%d (%u connections)",
+			   __func__, addrstr, ntohs(sin->sin_port),
+			   fnc->nconns);
+
+	/* The connections come up and go down together. */
+	for (idx = 0; idx < fnc->nconns; idx++) {
+		conn = &fnc->conns[idx];
+
+		sock = socket(fnc->addr.ss_family, SOCK_STREAM, 0);
+		if (sock == -1) {
+			zlog_err("%s: fpm socket failed: %s", __func__,
+				 strerror(errno));
+			fpm_reconnect(fnc);
+			return 0;
+		}
 
-	rv = connect(sock, (struct sockaddr *)&fnc->addr, slen);
-	if (rv == -1 && errno != EINPROGRESS) {
-		atomic_fetch_add_explicit(&fnc->counters.connection_errors, 1,
-					  memory_order_relaxed);
-		close(sock);
-		zlog_warn("%s: fpm connection failed: %s", __func__,
-			  strerror(errno));
-		thread_add_timer(fnc->fthread->master, fpm_connect, fnc, 3,
-				 &fnc->t_connect);
+		set_nonblocking(sock);
+
+		rv = connect(sock, (struct sockaddr *)&fnc->addr, slen);
+		if (rv == -1 && errno != EINPROGRESS) {
+			atomic_fetch_add_explicit(
+				&fnc->counters.connection_errors, 1,
+				memory_order_relaxed);
+			close(sock);
+			zlog_warn("%s: fpm connection %u failed: %s", __func__,
+				  idx, strerror(errno));
+			fpm_reconnect(fnc);
+			return 0;
+		}
+
+		conn->connecting = (rv == -1);
+		conn->socket = sock;
+		if (!conn->connecting)
+			thread_add_read(fnc->fthread->master, fpm_read, conn,
+					sock, &conn->t_read);
+		thread_add_write(fnc->fthread->master, fpm_write, conn, sock,
+				 &conn->t_write);
+	}
+
+	/*
+	 * When resuming the walks wait for the server request, which can
+	 * only come once connected.
+	 */
+	if (fnc->resume) {
+		if (fpm_connected(fnc))
+			fpm_resume_wait(fnc);
 		return 0;
 	}
 
-	fnc->connecting = (errno == EINPROGRESS);
-	fnc->socket = sock;
-	if (!fnc->connecting)
-		thread_add_read(fnc->fthread->master, fpm_read, fnc, sock,
-				&fnc->t_read);
-	thread_add_write(fnc->fthread->master, fpm_write, fnc, sock,
-			 &fnc->t_write);
+	fpm_walk_start(fnc);
 
-	/* Mark all routes as unsent. */
-	if (fnc->use_nhg)
-		thread_add_timer(zrouter.master, fpm_nhg_reset, fnc, 0,
-				 &fnc->t_nhgreset);
-	else
-		thread_add_timer(zrouter.master, fpm_rib_reset, fnc, 0,
-				 &fnc->t_ribreset);
+	return 0;
+}
+
+/**
+ * Accounts the bytes just written to the output buffer and tells the
+ * thread to start writing. Must be called with the output buffer lock held.
+ *
+ * @param conn the FPM connection.
+ * @param len amount of bytes written.
+ */
+static void fpm_obuf_written(struct fpm_nl_conn *conn, size_t len)
+{
+	struct fpm_nl_ctx *fnc = conn->fnc;
+	uint64_t obytes, obytes_peak;
+
+	/* Account number of bytes waiting to be written. */
+	atomic_fetch_add_explicit(&fnc->counters.obuf_bytes, len,
+				  memory_order_relaxed);
+	obytes = atomic_load_explicit(&fnc->counters.obuf_bytes,
+				      memory_order_relaxed);
+	obytes_peak = atomic_load_explicit(&fnc->counters.obuf_peak,
+					   memory_order_relaxed);
+	if (obytes_peak < obytes)
+		atomic_store_explicit(&fnc->counters.obuf_peak, obytes,
+				      memory_order_relaxed);
+
+	atomic_fetch_add_explicit(&conn->counters.obuf_bytes, len,
+				  memory_order_relaxed);
+	obytes = atomic_load_explicit(&conn->counters.obuf_bytes,
+				      memory_order_relaxed);
+	obytes_peak = atomic_load_explicit(&conn->counters.obuf_peak,
+					   memory_order_relaxed);
+	if (obytes_peak < obytes)
+		atomic_store_explicit(&conn->counters.obuf_peak, obytes,
+				      memory_order_relaxed);
+
+	/* Time the message until it is written and acknowledged. */
+	conn->msgs_sent++;
+	conn->bytes_queued += len;
+	fpm_latency_start(&conn->write_ring, conn->bytes_queued);
+	if (conn->window_on)
+		fpm_latency_start(&conn->ack_ring, conn->msgs_sent);
+
+	/* Tell the thread to start writing, once there is someone to. */
+	if (conn->socket != -1)
+		thread_add_write(fnc->fthread->master, fpm_write, conn,
+				 conn->socket, &conn->t_write);
+}
+
+/**
+ * Checks whether a connection takes one more message. Must be called with
+ * the output buffer lock held.
+ *
+ * @param conn the FPM connection.
+ * @param len the message size.
+ * @return true if there is room in the buffer and the server window.
+ */
+static bool fpm_conn_has_room(struct fpm_nl_conn *conn, size_t len)
+{
+	struct fpm_nl_ctx *fnc = conn->fnc;
+
+	if (STREAM_WRITEABLE(conn->obuf) < len) {
+		atomic_fetch_add_explicit(&fnc->counters.buffer_full, 1,
+					  memory_order_relaxed);
+		atomic_fetch_add_explicit(&conn->counters.buffer_full, 1,
+					  memory_order_relaxed);
+
+		if (IS_ZEBRA_DEBUG_FPM)
+			zlog_debug(
+				"%s: connection %u buffer full: wants to write %zu but has %zu",
+				__func__, conn->idx, len,
+				STREAM_WRITEABLE(conn->obuf));
+
+		return false;
+	}
+
+	if (conn->window_on
+	    && conn->msgs_sent - conn->msgs_acked >= conn->window) {
+		atomic_fetch_add_explicit(&conn->counters.window_full, 1,
+					  memory_order_relaxed);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Writes a FPM message to the connection output buffer. Must be called
+ * with the output buffer lock held and after checking for room.
+ */
+static void fpm_conn_put(struct fpm_nl_conn *conn, uint8_t msg_type,
+			 const uint8_t *data, size_t data_len)
+{
+	/*
+	 * Fill in the FPM header information.
+	 *
+	 * See FPM_HEADER_SIZE definition for more information.
+	 */
+	stream_putc(conn->obuf, FPM_PROTO_VERSION);
+	stream_putc(conn->obuf, msg_type);
+	stream_putw(conn->obuf, data_len + FPM_HEADER_SIZE);
+
+	/* Write current data. */
+	stream_write(conn->obuf, data, data_len);
+
+	fpm_obuf_written(conn, data_len + FPM_HEADER_SIZE);
+}
+
+/**
+ * Enqueues a FPM message on one connection, or on all of them if `conn` is
+ * `NULL`. Messages for all connections are only enqueued if all of them
+ * have room, so they never get out of order with the routes.
+ *
+ * @param fnc the netlink FPM context.
+ * @param conn the FPM connection or `NULL` for all connections.
+ * @param msg_type the FPM message type.
+ * @param data the message payload.
+ * @param data_len the message payload size.
+ * @return 0 on success or -1 on not enough space.
+ */
+static int fpm_msg_enqueue(struct fpm_nl_ctx *fnc, struct fpm_nl_conn *conn,
+			   uint8_t msg_type, const uint8_t *data,
+			   size_t data_len)
+{
+	unsigned int idx, locked;
+	int rv = 0;
+
+	/* We must know if someday a message goes beyond 65KiB. */
+	assert((data_len + FPM_HEADER_SIZE) <= UINT16_MAX);
+
+	if (conn) {
+		frr_mutex_lock_autounlock(&conn->obuf_mutex);
+		if (!fpm_conn_has_room(conn, data_len + FPM_HEADER_SIZE))
+			return -1;
+
+		fpm_conn_put(conn, msg_type, data, data_len);
+		return 0;
+	}
+
+	/* Always lock in the same order. */
+	for (locked = 0; locked < fnc->nconns; locked++) {
+		pthread_mutex_lock(&fnc->conns[locked].obuf_mutex);
+		if (!fpm_conn_has_room(&fnc->conns[locked],
+				       data_len + FPM_HEADER_SIZE)) {
+			locked++;
+			rv = -1;
+			break;
+		}
+	}
 
-	return 0;
+	for (idx = 0; idx < locked; idx++) {
+		if (rv == 0)
+			fpm_conn_put(&fnc->conns[idx], msg_type, data,
+				     data_len);
+		pthread_mutex_unlock(&fnc->conns[idx].obuf_mutex);
+	}
+
+	return rv;
 }
 
 /**
  * Encode data plane operation context into netlink and enqueue it in the FPM
- * output buffer.
+ * output buffer: routes go over the connection of their table, router MACs
+ * over the first connection and next hop groups over all connections.
  *
  * @param fnc the netlink FPM context.
  * @param ctx the data plane operation context data.
@@ -701,7 +1522,7 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 	uint8_t nl_buf[NL_PKT_BUF_SIZE];
 	size_t nl_buf_len;
 	ssize_t rv;
-	uint64_t obytes, obytes_peak;
+	struct fpm_nl_conn *conn = NULL;
 	enum dplane_op_e op = dplane_ctx_get_op(ctx);
 
 	/*
@@ -715,8 +1536,6 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 
 	nl_buf_len = 0;
 
-	frr_mutex_lock_autounlock(&fnc->obuf_mutex);
-
 	switch (op) {
 	case DPLANE_OP_ROUTE_UPDATE:
 	case DPLANE_OP_ROUTE_DELETE:
@@ -731,6 +1550,7 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 		}
 
 		nl_buf_len = (size_t)rv;
+		conn = fpm_conn_shard(fnc, ctx);
 
 		/* UPDATE operations need a INSTALL, otherwise just quit. */
 		if (op == DPLANE_OP_ROUTE_DELETE)
@@ -749,6 +1569,7 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 		}
 
 		nl_buf_len += (size_t)rv;
+		conn = fpm_conn_shard(fnc, ctx);
 		break;
 
 	case DPLANE_OP_MAC_INSTALL:
@@ -761,6 +1582,8 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 		}
 
 		nl_buf_len = (size_t)rv;
+		/* The server gets each router MAC once. */
+		conn = &fnc->conns[0];
 		break;
 
 	case DPLANE_OP_NH_DELETE:
@@ -818,50 +1641,331 @@ static int fpm_nl_enqueue(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
 	if (nl_buf_len == 0)
 		return 0;
 
-	/* We must know if someday a message goes beyond 65KiB. */
-	assert((nl_buf_len + FPM_HEADER_SIZE) <= UINT16_MAX);
+	return fpm_msg_enqueue(fnc, conn, FPM_MSG_TYPE_NETLINK, nl_buf,
+			       nl_buf_len);
+}
 
-	/* Check if we have enough buffer space. */
-	if (STREAM_WRITEABLE(fnc->obuf) < (nl_buf_len + FPM_HEADER_SIZE)) {
-		atomic_fetch_add_explicit(&fnc->counters.buffer_full, 1,
+/*
+ * Session resume functions.
+ */
+
+/**
+ * Enqueues a session resume message on all connections.
+ *
+ * @param fnc the netlink FPM context.
+ * @param op the message operation (`fpm_generation_op_e`).
+ * @param gen the generation.
+ * @return 0 on success or -1 on not enough space.
+ */
+static int fpm_generation_enqueue(struct fpm_nl_ctx *fnc, uint8_t op,
+				  uint64_t gen)
+{
+	uint8_t msg[sizeof(fpm_generation_msg_t)] = {op};
+	unsigned int i;
+
+	/* Generation in network byte order. */
+	for (i = 0; i < sizeof(gen); i++)
+		msg[4 + i] = gen >> (8 * (sizeof(gen) - 1 - i));
+
+	return fpm_msg_enqueue(fnc, NULL, FPM_MSG_TYPE_GENERATION, msg,
+			       sizeof(msg));
+}
+
+/**
+ * Tells the servers whether they get a delta or everything, then starts the
+ * walks. Retried until the output buffers have room for the message.
+ */
+static int fpm_resume_replay(struct thread *t)
+{
+	struct fpm_nl_ctx *fnc = THREAD_ARG(t);
+
+	if (fpm_generation_enqueue(fnc, FPM_GENERATION_REPLAY, fnc->resume_gen)
+	    == -1) {
+		thread_add_timer_msec(fnc->fthread->master, fpm_resume_replay,
+				      fnc, 10, &fnc->t_resume);
+		return 0;
+	}
+
+	fpm_walk_start(fnc);
+	thread_add_timer(fnc->fthread->master, fpm_marker, fnc,
+			 FPM_MARKER_INTERVAL, &fnc->t_marker);
+
+	return 0;
+}
+
+/**
+ * Answers the servers resume request: only the routes changed since `gen`
+ * are replayed if it is a generation the servers could have acknowledged
+ * and the deleted prefixes since then are still known.
+ *
+ * @param fnc the netlink FPM context.
+ * @param gen the generation the servers ask to resume from, 0 for none.
+ */
+static void fpm_resume_start(struct fpm_nl_ctx *fnc, uint64_t gen)
+{
+	unsigned int idx;
+
+	THREAD_OFF(fnc->t_resume);
+	fnc->resume_wait = false;
+
+	if (gen != 0 && gen >= fnc->acked_gen && gen <= fnc->marker_gen
+	    && gen >= dplane_route_gen_floor()) {
+		fnc->resume_gen = gen;
+		fnc->acked_gen = gen;
+		for (idx = 0; idx < fnc->nconns; idx++)
+			fnc->conns[idx].acked_gen = gen;
+		dplane_route_gen_retain(gen);
+		atomic_fetch_add_explicit(&fnc->counters.resumes, 1,
+					  memory_order_relaxed);
+	} else {
+		fnc->resume_gen = 0;
+		atomic_fetch_add_explicit(&fnc->counters.full_replays, 1,
 					  memory_order_relaxed);
+	}
 
-		if (IS_ZEBRA_DEBUG_FPM)
-			zlog_debug(
-				"%s: buffer full: wants to write %zu but has %zu",
-				__func__, nl_buf_len + FPM_HEADER_SIZE,
-				STREAM_WRITEABLE(fnc->obuf));
+	if (IS_ZEBRA_DEBUG_FPM)
+		zlog_debug("%s: servers resume from %" PRIu64
+			   ", replaying changes since %" PRIu64,
+			   __func__, gen, fnc->resume_gen);
+
+	thread_add_event(fnc->fthread->master, fpm_resume_replay, fnc, 0,
+			 &fnc->t_resume);
+}
+
+/**
+ * Starts the session once every server asked where to resume from: the
+ * session resumes from the oldest generation among them.
+ */
+static void fpm_resume_check(struct fpm_nl_ctx *fnc)
+{
+	uint64_t gen = UINT64_MAX;
+	unsigned int idx;
+
+	if (!fnc->resume_wait)
+		return;
+
+	for (idx = 0; idx < fnc->nconns; idx++) {
+		if (!fnc->conns[idx].resume_req)
+			return;
 
-		return -1;
+		gen = MIN(gen, fnc->conns[idx].resume_req_gen);
 	}
 
-	/*
-	 * Fill in the FPM header information.
-	 *
-	 * See FPM_HEADER_SIZE definition for more information.
-	 */
-	stream_putc(fnc->obuf, 1);
-	stream_putc(fnc->obuf, 1);
-	stream_putw(fnc->obuf, nl_buf_len + FPM_HEADER_SIZE);
+	fpm_resume_start(fnc, gen);
+}
 
-	/* Write current data. */
-	stream_write(fnc->obuf, nl_buf, (size_t)nl_buf_len);
+static int fpm_resume_timeout(struct thread *t)
+{
+	struct fpm_nl_ctx *fnc = THREAD_ARG(t);
 
-	/* Account number of bytes waiting to be written. */
-	atomic_fetch_add_explicit(&fnc->counters.obuf_bytes,
-				  nl_buf_len + FPM_HEADER_SIZE,
+	if (IS_ZEBRA_DEBUG_FPM)
+		zlog_debug("%s: no resume request from the servers", __func__);
+
+	fpm_resume_start(fnc, 0);
+
+	return 0;
+}
+
+/**
+ * Gives the servers some time to send their resume request, once all
+ * connections are up.
+ */
+static void fpm_resume_wait(struct fpm_nl_ctx *fnc)
+{
+	fnc->resume_wait = true;
+	thread_add_timer_msec(fnc->fthread->master, fpm_resume_timeout, fnc,
+			      FPM_RESUME_WAIT_MSEC, &fnc->t_resume);
+
+	/* The requests may have come in already. */
+	fpm_resume_check(fnc);
+}
+
+/**
+ * Periodically tells the servers up to which generation they have got all
+ * changes, once the RIB walk is done and no route update is in flight.
+ */
+static int fpm_marker(struct thread *t)
+{
+	struct fpm_nl_ctx *fnc = THREAD_ARG(t);
+	uint64_t gen;
+
+	thread_add_timer(fnc->fthread->master, fpm_marker, fnc,
+			 FPM_MARKER_INTERVAL, &fnc->t_marker);
+
+	if (!fnc->rib_complete)
+		return 0;
+
+	gen = dplane_route_gen_settled();
+	if (gen <= fnc->marker_gen)
+		return 0;
+
+	if (fpm_generation_enqueue(fnc, FPM_GENERATION_MARKER, gen) == -1)
+		return 0;
+
+	fnc->marker_gen = gen;
+	atomic_fetch_add_explicit(&fnc->counters.markers_sent, 1,
 				  memory_order_relaxed);
-	obytes = atomic_load_explicit(&fnc->counters.obuf_bytes,
-				      memory_order_relaxed);
-	obytes_peak = atomic_load_explicit(&fnc->counters.obuf_peak,
-					   memory_order_relaxed);
-	if (obytes_peak < obytes)
-		atomic_store_explicit(&fnc->counters.obuf_peak, obytes,
-				      memory_order_relaxed);
 
-	/* Tell the thread to start writing. */
-	thread_add_write(fnc->fthread->master, fpm_write, fnc, fnc->socket,
-			 &fnc->t_write);
+	return 0;
+}
+
+/**
+ * Starts over tracking the servers acknowledgements, nothing before this
+ * point can be resumed from.
+ */
+static void fpm_resume_reset(struct fpm_nl_ctx *fnc)
+{
+	unsigned int idx;
+
+	fnc->resume_gen = 0;
+	fnc->marker_gen = 0;
+
+	if (!fnc->resume)
+		fnc->acked_gen = 0;
+	else
+		fnc->acked_gen = dplane_route_gen_current();
+
+	for (idx = 0; idx < FPM_MAX_CONNECTIONS; idx++)
+		fnc->conns[idx].acked_gen = fnc->acked_gen;
+	dplane_route_gen_retain(fnc->acked_gen);
+}
+
+static void fpm_generation_handle(struct fpm_nl_conn *conn, uint8_t op,
+				  uint64_t gen)
+{
+	struct fpm_nl_ctx *fnc = conn->fnc;
+	uint64_t acked = UINT64_MAX;
+	unsigned int idx;
+
+	switch (op) {
+	case FPM_GENERATION_RESUME:
+		if (conn->resume_req) {
+			if (IS_ZEBRA_DEBUG_FPM)
+				zlog_debug(
+					"%s: unexpected resume request on connection %u",
+					__func__, conn->idx);
+			break;
+		}
+
+		conn->resume_req = true;
+		conn->resume_req_gen = gen;
+		fpm_resume_check(fnc);
+		break;
+
+	case FPM_GENERATION_ACK:
+		atomic_fetch_add_explicit(&fnc->counters.acks_received, 1,
+					  memory_order_relaxed);
+
+		/* Only announced generations can be acknowledged. */
+		if (gen <= conn->acked_gen || gen > fnc->marker_gen)
+			break;
+
+		conn->acked_gen = gen;
+
+		/* The deleted prefixes all servers have applied can go now. */
+		for (idx = 0; idx < fnc->nconns; idx++)
+			acked = MIN(acked, fnc->conns[idx].acked_gen);
+		if (acked <= fnc->acked_gen)
+			break;
+
+		fnc->acked_gen = acked;
+		dplane_route_gen_retain(acked);
+		break;
+
+	default:
+		if (IS_ZEBRA_DEBUG_FPM)
+			zlog_debug("%s: unhandled generation message %u",
+				   __func__, op);
+		break;
+	}
+}
+
+/*
+ * Flow control functions.
+ */
+static void fpm_window_handle(struct fpm_nl_conn *conn, uint32_t window,
+			      uint64_t acked)
+{
+	struct fpm_nl_ctx *fnc = conn->fnc;
+
+	atomic_fetch_add_explicit(&conn->counters.window_updates, 1,
+				  memory_order_relaxed);
+
+	frr_with_mutex(&conn->obuf_mutex) {
+		/* Only sent messages can be acknowledged. */
+		if (acked < conn->msgs_acked || acked > conn->msgs_sent) {
+			if (IS_ZEBRA_DEBUG_FPM)
+				zlog_debug(
+					"%s: connection %u acknowledges %" PRIu64
+					" of %" PRIu64 " messages",
+					__func__, conn->idx, acked,
+					conn->msgs_sent);
+			return;
+		}
+
+		conn->window_on = true;
+		conn->window = window;
+		conn->msgs_acked = acked;
+		fpm_latency_done(&conn->ack_ring, acked,
+				 &conn->counters.ack_latency);
+	}
+
+	/* The window might have opened. */
+	fpm_queue_kick(fnc);
+}
+
+/**
+ * Handles the complete messages in the input buffer, only session resume
+ * and flow control messages are of interest.
+ *
+ * @param conn the FPM connection.
+ * @return 0 on success or -1 if the server sent garbage.
+ */
+static int fpm_read_messages(struct fpm_nl_conn *conn)
+{
+	struct fpm_nl_ctx *fnc = conn->fnc;
+	size_t getp, len;
+	uint8_t type, op;
+	uint32_t window;
+	uint64_t gen, acked;
+
+	while (STREAM_READABLE(conn->ibuf) >= FPM_HEADER_SIZE) {
+		/* Peek at the header and wait for the whole message. */
+		getp = stream_get_getp(conn->ibuf);
+		type = stream_getc_from(conn->ibuf, getp + 1);
+		len = stream_getw_from(conn->ibuf, getp + 2);
+		if (len < FPM_HEADER_SIZE || len > STREAM_SIZE(conn->ibuf)) {
+			zlog_warn("%s: invalid message length %zu", __func__,
+				  len);
+			return -1;
+		}
+		if (STREAM_READABLE(conn->ibuf) < len)
+			break;
+
+		if (fnc->resume && type == FPM_MSG_TYPE_GENERATION
+		    && len == FPM_GENERATION_MSG_SIZE) {
+			stream_forward_getp(conn->ibuf, FPM_HEADER_SIZE);
+			op = stream_getc(conn->ibuf);
+			stream_forward_getp(conn->ibuf, 3);
+			gen = stream_getq(conn->ibuf);
+			fpm_generation_handle(conn, op, gen);
+			continue;
+		}
+
+		if (fnc->flow_control && type == FPM_MSG_TYPE_WINDOW
+		    && len == FPM_WINDOW_MSG_SIZE) {
+			stream_forward_getp(conn->ibuf, FPM_HEADER_SIZE);
+			window = stream_getl(conn->ibuf);
+			stream_forward_getp(conn->ibuf, 4);
+			acked = stream_getq(conn->ibuf);
+			fpm_window_handle(conn, window, acked);
+			continue;
+		}
+
+		stream_forward_getp(conn->ibuf, len);
+	}
+
+	stream_pulldown(conn->ibuf);
 
 	return 0;
 }
@@ -920,14 +2024,37 @@ static int fpm_nhg_send(struct thread *t)
 		thread_add_timer(zrouter.master, fpm_rib_reset, fnc, 0,
 				 &fnc->t_ribreset);
 	} else /* Otherwise reschedule next hop group again. */
-		thread_add_timer(zrouter.master, fpm_nhg_send, fnc, 0,
+		thread_add_timer(zrouter.master, fpm_nhg_send, fnc, 1,
 				 &fnc->t_nhgwalk);
 
 	return 0;
 }
 
 /**
- * Send all RIB installed routes to the connected data plane.
+ * Fills in a route removal, for prefixes deleted since the generation the
+ * server resumes from.
+ */
+static void fpm_rib_delete_init(struct zebra_dplane_ctx *ctx,
+				struct route_node *rn)
+{
+	const struct route_table *table = srcdest_rnode_table(rn);
+	const struct rib_table_info *info = table->info;
+	const struct prefix *p, *src_p;
+
+	srcdest_rnode_prefixes(rn, &p, &src_p);
+
+	dplane_ctx_set_op(ctx, DPLANE_OP_ROUTE_DELETE);
+	dplane_ctx_set_dest(ctx, p);
+	dplane_ctx_set_src(ctx, src_p);
+	dplane_ctx_set_afi(ctx, info->afi);
+	dplane_ctx_set_safi(ctx, info->safi);
+	dplane_ctx_set_table(ctx, info->table_id);
+	dplane_ctx_set_vrf(ctx, zvrf_id(info->zvrf));
+}
+
+/**
+ * Send all RIB installed routes to the connected data plane, or only the
+ * ones changed since the generation the server resumes from.
  */
 static int fpm_rib_send(struct thread *t)
 {
@@ -946,17 +2073,28 @@ static int fpm_rib_send(struct thread *t)
 		for (rn = route_top(rt); rn; rn = srcdest_route_next(rn)) {
 			dest = rib_dest_from_rnode(rn);
 			/* Skip bad route entries. */
-			if (dest == NULL || dest->selected_fib == NULL)
+			if (dest == NULL)
 				continue;
 
 			/* Check for already sent routes. */
 			if (CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_FPM))
 				continue;
 
-			/* Enqueue route install. */
+			/* The server already has it. */
+			if (fnc->resume_gen && dest->dplane_gen <= fnc->resume_gen)
+				continue;
+
+			/* Enqueue route install, or removal when resuming. */
 			dplane_ctx_reset(ctx);
-			dplane_ctx_route_init(ctx, DPLANE_OP_ROUTE_INSTALL, rn,
-					      dest->selected_fib);
+			if (dest->selected_fib)
+				dplane_ctx_route_init(ctx,
+						      DPLANE_OP_ROUTE_INSTALL,
+						      rn, dest->selected_fib);
+			else if (fnc->resume_gen)
+				fpm_rib_delete_init(ctx, rn);
+			else
+				continue;
+
 			if (fpm_nl_enqueue(fnc, ctx) == -1) {
 				/* Free the temporary allocated context. */
 				dplane_ctx_fini(&ctx);
@@ -1098,6 +2236,13 @@ static int fpm_rib_reset(struct thread *t)
 				continue;
 
 			UNSET_FLAG(dest->flags, RIB_DEST_UPDATE_FPM);
+
+			/*
+			 * Release the deleted prefixes kept for the server
+			 * which it has acknowledged meanwhile.
+			 */
+			if (fnc->resume && re_list_first(&dest->routes) == NULL)
+				rib_gc_dest(rn);
 		}
 	}
 
@@ -1138,41 +2283,121 @@ static int fpm_rmac_reset(struct thread *t)
 	return 0;
 }
 
+/**
+ * Moves the contexts waiting on a connection to its output buffer.
+ *
+ * @return true if the connection queue is empty.
+ */
+static bool fpm_conn_drain(struct fpm_nl_conn *conn)
+{
+	struct fpm_nl_ctx *fnc = conn->fnc;
+	struct zebra_dplane_ctx *ctx;
+
+	while ((ctx = TAILQ_FIRST(&conn->ctxqueue))) {
+		/* No space available yet. */
+		if (fpm_nl_enqueue(fnc, ctx) == -1)
+			return false;
+
+		dplane_ctx_dequeue(&conn->ctxqueue);
+		atomic_fetch_sub_explicit(&conn->counters.ctxqueue_len, 1,
+					  memory_order_relaxed);
+		fpm_ctx_done(fnc, ctx);
+	}
+
+	return true;
+}
+
+/**
+ * Queues a route context on the connection of its table, hands back the
+ * contexts with nothing to send.
+ *
+ * @return false if the context waits for all connection queues instead.
+ */
+static bool fpm_ctx_sort(struct fpm_nl_ctx *fnc, struct zebra_dplane_ctx *ctx)
+{
+	struct fpm_nl_conn *conn;
+
+	switch (dplane_ctx_get_op(ctx)) {
+	case DPLANE_OP_ROUTE_INSTALL:
+	case DPLANE_OP_ROUTE_UPDATE:
+	case DPLANE_OP_ROUTE_DELETE:
+		conn = fpm_conn_shard(fnc, ctx);
+		dplane_ctx_enqueue_tail(&conn->ctxqueue, ctx);
+		atomic_fetch_add_explicit(&conn->counters.ctxqueue_len, 1,
+					  memory_order_relaxed);
+		return true;
+
+	case DPLANE_OP_NH_INSTALL:
+	case DPLANE_OP_NH_UPDATE:
+	case DPLANE_OP_NH_DELETE:
+		if (!fnc->use_nhg)
+			break;
+
+		/* FALL THROUGH */
+	case DPLANE_OP_MAC_INSTALL:
+	case DPLANE_OP_MAC_DELETE:
+		return false;
+
+	default:
+		break;
+	}
+
+	/* Nothing to send. */
+	fpm_ctx_done(fnc, ctx);
+	return true;
+}
+
+/**
+ * Sorts the data plane contexts into the connection queues, so a slow
+ * connection only holds back the routes of its own tables.
+ */
 static int fpm_process_queue(struct thread *t)
 {
 	struct fpm_nl_ctx *fnc = THREAD_ARG(t);
 	struct zebra_dplane_ctx *ctx;
-
-	frr_mutex_lock_autounlock(&fnc->ctxqueue_mutex);
+	unsigned int idx;
+	bool drained;
 
 	while (true) {
-		/* No space available yet. */
-		if (STREAM_WRITEABLE(fnc->obuf) < NL_PKT_BUF_SIZE)
-			break;
+		/* Sort until a next hop group or MAC context shows up. */
+		while (fnc->ctx_pending == NULL) {
+			frr_with_mutex(&fnc->ctxqueue_mutex) {
+				ctx = dplane_ctx_dequeue(&fnc->ctxqueue);
+			}
+			if (ctx == NULL)
+				break;
 
-		/* Dequeue next item or quit processing. */
-		ctx = dplane_ctx_dequeue(&fnc->ctxqueue);
-		if (ctx == NULL)
-			break;
+			if (!fpm_ctx_sort(fnc, ctx))
+				fnc->ctx_pending = ctx;
+		}
 
-		fpm_nl_enqueue(fnc, ctx);
+		drained = true;
+		for (idx = 0; idx < fnc->nconns; idx++)
+			if (!fpm_conn_drain(&fnc->conns[idx]))
+				drained = false;
 
-		/* Account the processed entries. */
-		atomic_fetch_add_explicit(&fnc->counters.dplane_contexts, 1,
-					  memory_order_relaxed);
-		atomic_fetch_sub_explicit(&fnc->counters.ctxqueue_len, 1,
-					  memory_order_relaxed);
+		if (fnc->ctx_pending == NULL)
+			break;
 
-		dplane_ctx_set_status(ctx, ZEBRA_DPLANE_REQUEST_SUCCESS);
-		dplane_provider_enqueue_out_ctx(fnc->prov, ctx);
+		/*
+		 * Next hop groups and MACs go out after the routes queued
+		 * before them, which might still use a next hop group being
+		 * removed.
+		 */
+		if (!drained || fpm_nl_enqueue(fnc, fnc->ctx_pending) == -1)
+			break;
+
+		fpm_ctx_done(fnc, fnc->ctx_pending);
+		fnc->ctx_pending = NULL;
 	}
 
 	/* Check for more items in the queue. */
 	if (atomic_load_explicit(&fnc->counters.ctxqueue_len,
 				 memory_order_relaxed)
 	    > 0)
-		thread_add_timer(fnc->fthread->master, fpm_process_queue,
-				 fnc, 0, &fnc->t_dequeue);
+		thread_add_timer_msec(fnc->fthread->master, fpm_process_queue,
+				      fnc, FPM_QUEUE_RETRY_MSEC,
+				      &fnc->t_dequeue);
 
 	return 0;
 }
@@ -1184,6 +2409,8 @@ static int fpm_process_event(struct thread *t)
 {
 	struct fpm_nl_ctx *fnc = THREAD_ARG(t);
 	int event = THREAD_VAL(t);
+	unsigned int idx, nconns;
+	bool resume, flow_control;
 
 	switch (event) {
 	case FNE_DISABLE:
@@ -1207,6 +2434,9 @@ static int fpm_process_event(struct thread *t)
 	case FNE_RESET_COUNTERS:
 		zlog_info("%s: manual FPM counters reset event", __func__);
 		memset(&fnc->counters, 0, sizeof(fnc->counters));
+		for (idx = 0; idx < FPM_MAX_CONNECTIONS; idx++)
+			memset(&fnc->conns[idx].counters, 0,
+			       sizeof(fnc->conns[idx].counters));
 		break;
 
 	case FNE_TOGGLE_NHG:
@@ -1215,6 +2445,49 @@ static int fpm_process_event(struct thread *t)
 		fpm_reconnect(fnc);
 		break;
 
+	case FNE_SET_RESUME:
+		resume = atomic_load_explicit(&fnc->resume_config,
+					      memory_order_relaxed);
+		if (resume == fnc->resume)
+			break;
+
+		zlog_info("%s: session resume support %s", __func__,
+			  resume ? "enabled" : "disabled");
+		fnc->resume = resume;
+		fpm_resume_reset(fnc);
+		fpm_reconnect(fnc);
+		break;
+
+	case FNE_SET_FLOW_CONTROL:
+		flow_control = atomic_load_explicit(&fnc->flow_control_config,
+						    memory_order_relaxed);
+		if (flow_control == fnc->flow_control)
+			break;
+
+		zlog_info("%s: flow control support %s", __func__,
+			  flow_control ? "enabled" : "disabled");
+		fnc->flow_control = flow_control;
+		fpm_reconnect(fnc);
+		break;
+
+	case FNE_SET_CONNECTIONS:
+		nconns = atomic_load_explicit(&fnc->nconns_config,
+					      memory_order_relaxed);
+		if (nconns == fnc->nconns)
+			break;
+
+		zlog_info("%s: using %u connections", __func__, nconns);
+
+		/* Stop the walks before the routes move around. */
+		fpm_reconnect(fnc);
+		for (idx = 0; idx < nconns; idx++)
+			fpm_conn_init(fnc, idx);
+		fnc->nconns = nconns;
+
+		/* The servers have not seen the moved tables. */
+		fpm_resume_reset(fnc);
+		break;
+
 	case FNE_INTERNAL_RECONNECT:
 		fpm_reconnect(fnc);
 		break;
@@ -1258,10 +2531,9 @@ static int fpm_nl_start(struct zebra_dplane_provider *prov)
 	fnc = dplane_provider_get_data(prov);
 	fnc->fthread = frr_pthread_new(NULL, prov_name, prov_name);
 	assert(frr_pthread_run(fnc->fthread, NULL) == 0);
-	fnc->ibuf = stream_new(NL_PKT_BUF_SIZE);
-	fnc->obuf = stream_new(NL_PKT_BUF_SIZE * 128);
-	pthread_mutex_init(&fnc->obuf_mutex, NULL);
-	fnc->socket = -1;
+	fpm_conn_init(fnc, 0);
+	fnc->nconns = 1;
+	fnc->nconns_config = 1;
 	fnc->disabled = true;
 	fnc->prov = prov;
 	TAILQ_INIT(&fnc->ctxqueue);
@@ -1275,6 +2547,9 @@ static int fpm_nl_start(struct zebra_dplane_provider *prov)
 
 static int fpm_nl_finish_early(struct fpm_nl_ctx *fnc)
 {
+	struct fpm_nl_conn *conn;
+	unsigned int idx;
+
 	/* Disable all events and close socket. */
 	THREAD_OFF(fnc->t_nhgreset);
 	THREAD_OFF(fnc->t_nhgwalk);
@@ -1282,13 +2557,22 @@ static int fpm_nl_finish_early(struct fpm_nl_ctx *fnc)
 	THREAD_OFF(fnc->t_ribwalk);
 	THREAD_OFF(fnc->t_rmacreset);
 	THREAD_OFF(fnc->t_rmacwalk);
-	thread_cancel_async(fnc->fthread->master, &fnc->t_read, NULL);
-	thread_cancel_async(fnc->fthread->master, &fnc->t_write, NULL);
 	thread_cancel_async(fnc->fthread->master, &fnc->t_connect, NULL);
+	thread_cancel_async(fnc->fthread->master, &fnc->t_resume, NULL);
+	thread_cancel_async(fnc->fthread->master, &fnc->t_marker, NULL);
 
-	if (fnc->socket != -1) {
-		close(fnc->socket);
-		fnc->socket = -1;
+	for (idx = 0; idx < FPM_MAX_CONNECTIONS; idx++) {
+		conn = &fnc->conns[idx];
+		if (conn->obuf == NULL)
+			continue;
+
+		thread_cancel_async(fnc->fthread->master, &conn->t_read, NULL);
+		thread_cancel_async(fnc->fthread->master, &conn->t_write, NULL);
+
+		if (conn->socket != -1) {
+			close(conn->socket);
+			conn->socket = -1;
+		}
 	}
 
 	return 0;
@@ -1296,14 +2580,23 @@ static int fpm_nl_finish_early(struct fpm_nl_ctx *fnc)
 
 static int fpm_nl_finish_late(struct fpm_nl_ctx *fnc)
 {
+	struct fpm_nl_conn *conn;
+	unsigned int idx;
+
 	/* Stop the running thread. */
 	frr_pthread_stop(fnc->fthread, NULL);
 
 	/* Free all allocated resources. */
-	pthread_mutex_destroy(&fnc->obuf_mutex);
+	for (idx = 0; idx < FPM_MAX_CONNECTIONS; idx++) {
+		conn = &fnc->conns[idx];
+		if (conn->obuf == NULL)
+			continue;
+
+		pthread_mutex_destroy(&conn->obuf_mutex);
+		stream_free(conn->ibuf);
+		stream_free(conn->obuf);
+	}
 	pthread_mutex_destroy(&fnc->ctxqueue_mutex);
-	stream_free(fnc->ibuf);
-	stream_free(fnc->obuf);
 	free(gfnc);
 	gfnc = NULL;
 
@@ -1339,7 +2632,7 @@ static int fpm_nl_process(struct zebra_dplane_provider *prov)
 		 * Skip all notifications if not connected, we'll walk the RIB
 		 * anyway.
 		 */
-		if (fnc->socket != -1 && fnc->connecting == false) {
+		if (fpm_connected(fnc)) {
 			frr_mutex_lock_autounlock(&fnc->ctxqueue_mutex);
 			dplane_ctx_enqueue_tail(&fnc->ctxqueue, ctx);
 
@@ -1394,6 +2687,12 @@ static int fpm_nl_new(struct thread_master *tm)
 	install_element(CONFIG_NODE, &no_fpm_set_address_cmd);
 	install_element(CONFIG_NODE, &fpm_use_nhg_cmd);
 	install_element(CONFIG_NODE, &no_fpm_use_nhg_cmd);
+	install_element(CONFIG_NODE, &fpm_resume_cmd);
+	install_element(CONFIG_NODE, &no_fpm_resume_cmd);
+	install_element(CONFIG_NODE, &fpm_flow_control_cmd);
+	install_element(CONFIG_NODE, &no_fpm_flow_control_cmd);
+	install_element(CONFIG_NODE, &fpm_connections_cmd);
+	install_element(CONFIG_NODE, &no_fpm_connections_cmd);
 
 	return 0;
 }
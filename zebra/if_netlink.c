@@ -858,8 +858,8 @@ static int netlink_interface(struct nlmsghdr *h, ns_id_t ns_id, int startup)
 }
 
 /* Request for specific interface or address information from the kernel */
-static int netlink_request_intf_addr(struct nlsock *netlink_cmd, int family,
-				     int type, uint32_t filter_mask)
+int netlink_request_intf_addr(struct nlsock *netlink_cmd, int family, int type,
+			      uint32_t filter_mask)
 {
 	struct {
 		struct nlmsghdr n;
@@ -885,38 +885,19 @@ static int netlink_request_intf_addr(struct nlsock *netlink_cmd, int family,
 int interface_lookup_netlink(struct zebra_ns *zns)
 {
 	int ret;
-	struct zebra_dplane_info dp_info;
-	struct nlsock *netlink_cmd = &zns->netlink_cmd;
-
-	/* Capture key info from ns struct */
-	zebra_dplane_info_from_zns(&dp_info, zns, true /*is_cmd*/);
 
 	/* Get interface information. */
-	ret = netlink_request_intf_addr(netlink_cmd, AF_PACKET, RTM_GETLINK, 0);
-	if (ret < 0)
-		return ret;
-	ret = netlink_parse_info(netlink_interface, netlink_cmd, &dp_info, 0,
-				 1);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_LINK, netlink_interface, 1);
 	if (ret < 0)
 		return ret;
 
 	/* Get interface information - for bridge interfaces. */
-	ret = netlink_request_intf_addr(netlink_cmd, AF_BRIDGE, RTM_GETLINK,
-					RTEXT_FILTER_BRVLAN);
-	if (ret < 0)
-		return ret;
-	ret = netlink_parse_info(netlink_interface, netlink_cmd, &dp_info, 0,
-				 0);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_BRIDGE, netlink_interface, 0);
 	if (ret < 0)
 		return ret;
 
 	/* Get interface information - for bridge interfaces. */
-	ret = netlink_request_intf_addr(netlink_cmd, AF_BRIDGE, RTM_GETLINK,
-					RTEXT_FILTER_BRVLAN);
-	if (ret < 0)
-		return ret;
-	ret = netlink_parse_info(netlink_interface, netlink_cmd, &dp_info, 0,
-				 0);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_BRIDGE, netlink_interface, 0);
 	if (ret < 0)
 		return ret;
 
@@ -934,27 +915,16 @@ int interface_lookup_netlink(struct zebra_ns *zns)
 static int interface_addr_lookup_netlink(struct zebra_ns *zns)
 {
 	int ret;
-	struct zebra_dplane_info dp_info;
-	struct nlsock *netlink_cmd = &zns->netlink_cmd;
-
-	/* Capture key info from ns struct */
-	zebra_dplane_info_from_zns(&dp_info, zns, true /*is_cmd*/);
 
 	/* Get IPv4 address of the interfaces. */
-	ret = netlink_request_intf_addr(netlink_cmd, AF_INET, RTM_GETADDR, 0);
-	if (ret < 0)
-		return ret;
-	ret = netlink_parse_info(netlink_interface_addr, netlink_cmd, &dp_info,
-				 0, 1);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_ADDR4, netlink_interface_addr,
+				1);
 	if (ret < 0)
 		return ret;
 
 	/* Get IPv6 address of the interfaces. */
-	ret = netlink_request_intf_addr(netlink_cmd, AF_INET6, RTM_GETADDR, 0);
-	if (ret < 0)
-		return ret;
-	ret = netlink_parse_info(netlink_interface_addr, netlink_cmd, &dp_info,
-				 0, 1);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_ADDR6, netlink_interface_addr,
+				1);
 	if (ret < 0)
 		return ret;
 
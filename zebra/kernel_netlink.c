@@ -37,6 +37,8 @@
 #include "vrf.h"
 #include "mpls.h"
 #include "lib_errors.h"
+#include "frr_pthread.h"
+#include "monotime.h"
 
 //#include "zebra/zserv.h"
 #include "zebra/zebra_router.h"
@@ -49,6 +51,7 @@
 #include "zebra/if_netlink.h"
 #include "zebra/rule_netlink.h"
 #include "zebra/zebra_errors.h"
+#include "zebra/zebra_dplane.h"
 
 #ifndef SO_RCVBUFFORCE
 #define SO_RCVBUFFORCE  (33)
@@ -160,11 +163,18 @@ extern uint32_t nl_rcvbufsize;
 extern struct zebra_privs_t zserv_privs;
 
 DEFINE_MTYPE_STATIC(ZEBRA, NL_BUF, "Zebra Netlink buffers")
+DEFINE_MTYPE_STATIC(ZEBRA, NL_DUMP, "Zebra Netlink startup dumps")
 
-size_t nl_batch_tx_bufsize;
-char *nl_batch_tx_buf;
+#ifndef thread_local
+#define thread_local __thread
+#endif
 
-char nl_batch_rx_buf[NL_BATCH_RX_BUFSIZE];
+/* Each pthread writing to the kernel (the dataplane pthread and the kernel
+ * dataplane shards) batches in its own buffers.
+ */
+static thread_local size_t nl_batch_tx_bufsize;
+static thread_local char *nl_batch_tx_buf;
+static thread_local char *nl_batch_rx_buf;
 
 _Atomic uint32_t nl_batch_bufsize = NL_DEFAULT_BATCH_BUFSIZE;
 _Atomic uint32_t nl_batch_send_threshold = NL_DEFAULT_BATCH_SEND_THRESHOLD;
@@ -421,7 +431,8 @@ static int kernel_read(struct thread *thread)
  * so that we only had to write one way to handle incoming
  * address add/delete changes.
  */
-static void netlink_install_filter(int sock, __u32 pid, __u32 dplane_pid)
+static void netlink_install_filter(int sock, const __u32 *pids,
+				   unsigned int npids)
 {
 	/*
 	 * BPF_JUMP instructions and where you jump to are based upon
@@ -429,59 +440,67 @@ static void netlink_install_filter(int sock, __u32 pid, __u32 dplane_pid)
 	 * this down because every time I look at this I have to
 	 * re-remember it.
 	 */
-	struct sock_filter filter[] = {
-		/*
-		 * Logic:
-		 *   if (nlmsg_pid == pid ||
-		 *       nlmsg_pid == dplane_pid) {
-		 *       if (the incoming nlmsg_type ==
-		 *           RTM_NEWADDR | RTM_DELADDR)
-		 *           keep this message
-		 *       else
-		 *           skip this message
-		 *   } else
-		 *       keep this netlink message
-		 */
-		/*
-		 * 0: Load the nlmsg_pid into the BPF register
-		 */
-		BPF_STMT(BPF_LD | BPF_ABS | BPF_W,
-			 offsetof(struct nlmsghdr, nlmsg_pid)),
-		/*
-		 * 1: Compare to pid
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(pid), 1, 0),
-		/*
-		 * 2: Compare to dplane pid
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(dplane_pid), 0, 4),
-		/*
-		 * 3: Load the nlmsg_type into BPF register
-		 */
-		BPF_STMT(BPF_LD | BPF_ABS | BPF_H,
-			 offsetof(struct nlmsghdr, nlmsg_type)),
-		/*
-		 * 4: Compare to RTM_NEWADDR
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_NEWADDR), 2, 0),
-		/*
-		 * 5: Compare to RTM_DELADDR
-		 */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELADDR), 1, 0),
-		/*
-		 * 6: This is the end state of we want to skip the
-		 *    message
-		 */
-		BPF_STMT(BPF_RET | BPF_K, 0),
-		/* 7: This is the end state of we want to keep
-		 *     the message
-		 */
-		BPF_STMT(BPF_RET | BPF_K, 0xffff),
-	};
+	struct sock_filter filter[npids + 7];
+	struct sock_fprog prog;
+	unsigned int i, n = 0;
 
-	struct sock_fprog prog = {
-		.len = array_size(filter), .filter = filter,
-	};
+	/*
+	 * Logic:
+	 *   if (nlmsg_pid is one of pids) {
+	 *       if (the incoming nlmsg_type ==
+	 *           RTM_NEWADDR | RTM_DELADDR)
+	 *           keep this message
+	 *       else
+	 *           skip this message
+	 *   } else
+	 *       keep this netlink message
+	 */
+
+	/*
+	 * 0: Load the nlmsg_pid into the BPF register
+	 */
+	filter[n++] = (struct sock_filter)BPF_STMT(
+		BPF_LD | BPF_ABS | BPF_W, offsetof(struct nlmsghdr, nlmsg_pid));
+	/*
+	 * 1 .. npids: Compare to each pid, on a match go on with the
+	 *             nlmsg_type checks after the next statement
+	 */
+	for (i = 0; i < npids; i++, n++)
+		filter[n] = (struct sock_filter)BPF_JUMP(
+			BPF_JMP | BPF_JEQ | BPF_K, htonl(pids[i]),
+			npids - i, 0);
+	/*
+	 * npids + 1: None of ours, keep the message
+	 */
+	filter[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffff);
+	/*
+	 * npids + 2: Load the nlmsg_type into BPF register
+	 */
+	filter[n++] = (struct sock_filter)BPF_STMT(
+		BPF_LD | BPF_ABS | BPF_H, offsetof(struct nlmsghdr, nlmsg_type));
+	/*
+	 * npids + 3: Compare to RTM_NEWADDR
+	 */
+	filter[n++] = (struct sock_filter)BPF_JUMP(
+		BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_NEWADDR), 2, 0);
+	/*
+	 * npids + 4: Compare to RTM_DELADDR
+	 */
+	filter[n++] = (struct sock_filter)BPF_JUMP(
+		BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELADDR), 1, 0);
+	/*
+	 * npids + 5: This is the end state of we want to skip the
+	 *            message
+	 */
+	filter[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+	/*
+	 * npids + 6: This is the end state of we want to keep
+	 *            the message
+	 */
+	filter[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffff);
+
+	prog.len = n;
+	prog.filter = filter;
 
 	if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog))
 	    < 0)
@@ -859,6 +878,87 @@ static int netlink_parse_error(const struct nlsock *nl, struct nlmsghdr *h,
 	return -1;
 }
 
+/*
+ * netlink_parse_reply
+ *
+ * Pass the messages of one netlink reply to the given function.
+ *
+ * Returns true if the reply ends the exchange, in which case the result
+ * is in 'ret'.
+ */
+static bool netlink_parse_reply(int (*filter)(struct nlmsghdr *, ns_id_t, int),
+				const struct nlsock *nl,
+				const struct zebra_dplane_info *zns, char *buf,
+				int status, uint32_t pid, int msg_flags,
+				int startup, int *ret)
+{
+	struct nlmsghdr *h;
+	int error;
+
+	for (h = (struct nlmsghdr *)buf;
+	     (status >= 0 && NLMSG_OK(h, (unsigned int)status));
+	     h = NLMSG_NEXT(h, status)) {
+		/* Finish of reading. */
+		if (h->nlmsg_type == NLMSG_DONE)
+			return true;
+
+		/* Error handling. */
+		if (h->nlmsg_type == NLMSG_ERROR) {
+			int err = netlink_parse_error(nl, h, zns, startup);
+
+			if (err == 1) {
+				if (!(h->nlmsg_flags & NLM_F_MULTI)) {
+					*ret = 0;
+					return true;
+				}
+				continue;
+			}
+
+			*ret = err;
+			return true;
+		}
+
+		/* OK we got netlink message. */
+		if (IS_ZEBRA_DEBUG_KERNEL)
+			zlog_debug(
+				"netlink_parse_info: %s type %s(%u), len=%d, seq=%u, pid=%u",
+				nl->name, nl_msg_type_to_str(h->nlmsg_type),
+				h->nlmsg_type, h->nlmsg_len, h->nlmsg_seq,
+				h->nlmsg_pid);
+
+
+		/*
+		 * Ignore messages that maybe sent from
+		 * other actors besides the kernel
+		 */
+		if (pid != 0) {
+			zlog_debug("Ignoring message from pid %u", pid);
+			continue;
+		}
+
+		error = (*filter)(h, zns->ns_id, startup);
+		if (error < 0) {
+			zlog_debug("%s filter function error", nl->name);
+			*ret = error;
+		}
+	}
+
+	/* After error care. */
+	if (msg_flags & MSG_TRUNC) {
+		flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
+			 "%s error: message truncated", nl->name);
+		return false;
+	}
+	if (status) {
+		flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
+			 "%s error: data remnant size %d", nl->name, status);
+		*ret = -1;
+		return true;
+	}
+
+	return false;
+}
+
 /*
  * netlink_parse_info
  *
@@ -879,7 +979,6 @@ int netlink_parse_info(int (*filter)(struct nlmsghdr *, ns_id_t, int),
 {
 	int status;
 	int ret = 0;
-	int error;
 	int read_in = 0;
 
 	while (1) {
@@ -887,7 +986,6 @@ int netlink_parse_info(int (*filter)(struct nlmsghdr *, ns_id_t, int),
 		struct sockaddr_nl snl;
 		struct msghdr msg = {.msg_name = (void *)&snl,
 				     .msg_namelen = sizeof(snl)};
-		struct nlmsghdr *h;
 
 		if (count && read_in >= count)
 			return 0;
@@ -899,65 +997,10 @@ int netlink_parse_info(int (*filter)(struct nlmsghdr *, ns_id_t, int),
 			break;
 
 		read_in++;
-		for (h = (struct nlmsghdr *)buf;
-		     (status >= 0 && NLMSG_OK(h, (unsigned int)status));
-		     h = NLMSG_NEXT(h, status)) {
-			/* Finish of reading. */
-			if (h->nlmsg_type == NLMSG_DONE)
-				return ret;
-
-			/* Error handling. */
-			if (h->nlmsg_type == NLMSG_ERROR) {
-				int err = netlink_parse_error(nl, h, zns,
-							      startup);
-				if (err == 1) {
-					if (!(h->nlmsg_flags & NLM_F_MULTI))
-						return 0;
-					continue;
-				} else
-					return err;
-			}
-
-			/* OK we got netlink message. */
-			if (IS_ZEBRA_DEBUG_KERNEL)
-				zlog_debug(
-					"netlink_parse_info: %s type %s(%u), len=%d, seq=%u, pid=%u",
-					nl->name,
-					nl_msg_type_to_str(h->nlmsg_type),
-					h->nlmsg_type, h->nlmsg_len,
-					h->nlmsg_seq, h->nlmsg_pid);
-
-
-			/*
-			 * Ignore messages that maybe sent from
-			 * other actors besides the kernel
-			 */
-			if (snl.nl_pid != 0) {
-				zlog_debug("Ignoring message from pid %u",
-					   snl.nl_pid);
-				continue;
-			}
-
-			error = (*filter)(h, zns->ns_id, startup);
-			if (error < 0) {
-				zlog_debug("%s filter function error",
-					   nl->name);
-				ret = error;
-			}
-		}
-
-		/* After error care. */
-		if (msg.msg_flags & MSG_TRUNC) {
-			flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
-				 "%s error: message truncated", nl->name);
-			continue;
-		}
-		if (status) {
-			flog_err(EC_ZEBRA_NETLINK_LENGTH_ERROR,
-				 "%s error: data remnant size %d", nl->name,
-				 status);
-			return -1;
-		}
+		if (netlink_parse_reply(filter, nl, zns, buf, status,
+					snl.nl_pid, msg.msg_flags, startup,
+					&ret))
+			return ret;
 	}
 	return ret;
 }
@@ -1068,7 +1111,7 @@ static int nl_batch_read_resp(struct nl_batch *bth)
 	 */
 	while (true) {
 		status = netlink_recv_msg(nl, msg, nl_batch_rx_buf,
-					  sizeof(nl_batch_rx_buf));
+					  NL_BATCH_RX_BUFSIZE);
 		if (status == -1 || status == 0)
 			return status;
 
@@ -1171,6 +1214,8 @@ static void nl_batch_init(struct nl_batch *bth, struct dplane_ctx_q *ctx_out_q)
 		nl_batch_tx_buf = XCALLOC(MTYPE_NL_BUF, bufsize);
 		nl_batch_tx_bufsize = bufsize;
 	}
+	if (!nl_batch_rx_buf)
+		nl_batch_rx_buf = XMALLOC(MTYPE_NL_BUF, NL_BATCH_RX_BUFSIZE);
 
 	bth->buf = nl_batch_tx_buf;
 	bth->bufsiz = bufsize;
@@ -1372,11 +1417,436 @@ void kernel_update_multi(struct dplane_ctx_q *ctx_list)
 	dplane_ctx_list_append(ctx_list, &handled_list);
 }
 
+/* Opens one of the sockets the dataplane writes to the kernel with */
+static void netlink_dplane_socket(struct nlsock *nl, ns_id_t ns_id)
+{
+#if defined SOL_NETLINK
+	int one, ret;
+#endif
+
+	nl->sock = -1;
+	if (netlink_socket(nl, 0, ns_id) < 0) {
+		zlog_err("Failure to create %s socket", nl->name);
+		exit(-1);
+	}
+
+#if defined SOL_NETLINK
+	one = 1;
+	ret = setsockopt(nl->sock, SOL_NETLINK, NETLINK_EXT_ACK, &one,
+			 sizeof(one));
+
+	if (ret < 0)
+		zlog_notice("Registration for extended dp ACK failed : %d %s",
+			    errno, safe_strerror(errno));
+
+	/*
+	 * Trim off the payload of the original netlink message in the
+	 * acknowledgment. This option is available since Linux 4.2, so if
+	 * setsockopt fails, ignore the error.
+	 */
+	one = 1;
+	ret = setsockopt(nl->sock, SOL_NETLINK, NETLINK_CAP_ACK, &one,
+			 sizeof(one));
+	if (ret < 0)
+		zlog_notice(
+			"Registration for reduced ACK packet size failed, probably running an early kernel");
+#endif
+
+	if (fcntl(nl->sock, F_SETFL, O_NONBLOCK) < 0)
+		zlog_err("Can't set %s socket error: %s(%d)", nl->name,
+			 safe_strerror(errno), errno);
+
+	/* Set receive buffer size if it's set from command line */
+	if (nl_rcvbufsize)
+		netlink_recvbuf(nl, nl_rcvbufsize);
+}
+
+/*
+ * Kernel state read when a namespace is enabled or EVPN is turned on. The
+ * dumps are requested all at once, each on its own socket and pthread, and
+ * the main pthread parses the replies as they come in, in the order the
+ * state depends on each other: links, then addresses, then routes.
+ */
+struct netlink_dump_reply {
+	struct netlink_dump_reply *next;
+
+	uint32_t pid;
+	int flags;
+	int len;
+	char buf[];
+};
+
+struct netlink_dump {
+	enum netlink_dump_type type;
+	struct nlsock nls;
+	struct frr_pthread *fpt;
+
+	/* Replies not parsed yet, and whether there are more to come */
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	struct netlink_dump_reply *head;
+	struct netlink_dump_reply **tail;
+	bool done;
+
+	/* Bytes queued, the dump pthread waits on space while there are
+	 * NL_DUMP_QUEUE_MAX of them, or until it is told to stop.
+	 */
+	pthread_cond_t space;
+	size_t queued;
+	bool stop;
+
+	/* Set once the main pthread read the dump */
+	bool parsed;
+
+	/* Statistics */
+	uint32_t replies;
+	size_t bytes;
+	struct timeval start;
+	int64_t dump_usec;
+	int64_t wait_usec;
+	int64_t parse_usec;
+};
+
+/* Most a dump queues before the main pthread parsed some of it */
+#define NL_DUMP_QUEUE_MAX (128 * NL_RCV_PKT_BUF_SIZE)
+
+struct netlink_dumps {
+	struct netlink_dump *dump[NETLINK_DUMP_MAX];
+	struct timeval start;
+};
+
+static const struct {
+	const char *name;
+	uint32_t what;
+} netlink_dump_info[NETLINK_DUMP_MAX] = {
+	[NETLINK_DUMP_LINK] = {"links", KERNEL_READ_INTERFACES},
+	[NETLINK_DUMP_BRIDGE] = {"bridge links", KERNEL_READ_INTERFACES},
+	[NETLINK_DUMP_NEXTHOP] = {"nexthops", KERNEL_READ_INTERFACES},
+	[NETLINK_DUMP_ADDR4] = {"IPv4 addresses", KERNEL_READ_INTERFACES},
+	[NETLINK_DUMP_ADDR6] = {"IPv6 addresses", KERNEL_READ_INTERFACES},
+	[NETLINK_DUMP_ROUTE4] = {"IPv4 routes", KERNEL_READ_ROUTES},
+	[NETLINK_DUMP_ROUTE6] = {"IPv6 routes", KERNEL_READ_ROUTES},
+	[NETLINK_DUMP_RULE4] = {"IPv4 rules", KERNEL_READ_ROUTES},
+	[NETLINK_DUMP_RULE6] = {"IPv6 rules", KERNEL_READ_ROUTES},
+	[NETLINK_DUMP_MACFDB] = {"MAC FDB", KERNEL_READ_NEIGHBORS},
+	[NETLINK_DUMP_NEIGH] = {"neighbors", KERNEL_READ_NEIGHBORS},
+};
+
+static int netlink_dump_request(struct nlsock *nl, enum netlink_dump_type type)
+{
+	switch (type) {
+	case NETLINK_DUMP_LINK:
+		return netlink_request_intf_addr(nl, AF_PACKET, RTM_GETLINK, 0);
+	case NETLINK_DUMP_BRIDGE:
+		return netlink_request_intf_addr(nl, AF_BRIDGE, RTM_GETLINK,
+						 RTEXT_FILTER_BRVLAN);
+	case NETLINK_DUMP_NEXTHOP:
+		return netlink_request_nexthop(nl, AF_UNSPEC, RTM_GETNEXTHOP);
+	case NETLINK_DUMP_ADDR4:
+		return netlink_request_intf_addr(nl, AF_INET, RTM_GETADDR, 0);
+	case NETLINK_DUMP_ADDR6:
+		return netlink_request_intf_addr(nl, AF_INET6, RTM_GETADDR, 0);
+	case NETLINK_DUMP_ROUTE4:
+		return netlink_request_route(nl, AF_INET, RTM_GETROUTE);
+	case NETLINK_DUMP_ROUTE6:
+		return netlink_request_route(nl, AF_INET6, RTM_GETROUTE);
+	case NETLINK_DUMP_RULE4:
+		return netlink_request_rules(nl, AF_INET, RTM_GETRULE);
+	case NETLINK_DUMP_RULE6:
+		return netlink_request_rules(nl, AF_INET6, RTM_GETRULE);
+	case NETLINK_DUMP_MACFDB:
+		return netlink_request_macs(nl, AF_BRIDGE, RTM_GETNEIGH, 0);
+	case NETLINK_DUMP_NEIGH:
+		return netlink_request_neigh(nl, AF_UNSPEC, RTM_GETNEIGH, 0);
+	case NETLINK_DUMP_MAX:
+		break;
+	}
+
+	return -1;
+}
+
+/* Whether a reply is the last one of the dump */
+static bool netlink_dump_last(char *buf, int status)
+{
+	struct nlmsghdr *h;
+
+	for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, (unsigned int)status);
+	     h = NLMSG_NEXT(h, status)) {
+		if (h->nlmsg_type == NLMSG_DONE || h->nlmsg_type == NLMSG_ERROR
+		    || !(h->nlmsg_flags & NLM_F_MULTI))
+			return true;
+	}
+
+	return false;
+}
+
+static void *netlink_dump_thread(void *arg)
+{
+	struct frr_pthread *fpt = arg;
+	struct netlink_dump *dump = fpt->data;
+	struct netlink_dump_reply *reply;
+	struct sockaddr_nl snl;
+	bool last = false, stop;
+	int status;
+
+	if (netlink_dump_request(&dump->nls, dump->type) < 0)
+		last = true;
+
+	while (!last) {
+		struct msghdr msg = {.msg_name = (void *)&snl,
+				     .msg_namelen = sizeof(snl)};
+
+		/* Leave the rest in the socket until the parser caught up */
+		frr_with_mutex(&dump->mtx) {
+			while (dump->queued >= NL_DUMP_QUEUE_MAX && !dump->stop)
+				pthread_cond_wait(&dump->space, &dump->mtx);
+			stop = dump->stop;
+		}
+		if (stop)
+			break;
+
+		reply = XMALLOC(MTYPE_NL_DUMP,
+				sizeof(*reply) + NL_RCV_PKT_BUF_SIZE);
+
+		/* The socket blocks, there is always something to read */
+		status = netlink_recv_msg(&dump->nls, msg, reply->buf,
+					  NL_RCV_PKT_BUF_SIZE);
+		if (status <= 0) {
+			XFREE(MTYPE_NL_DUMP, reply);
+			break;
+		}
+
+		reply = XREALLOC(MTYPE_NL_DUMP, reply, sizeof(*reply) + status);
+		reply->next = NULL;
+		reply->pid = snl.nl_pid;
+		reply->flags = msg.msg_flags;
+		reply->len = status;
+		last = netlink_dump_last(reply->buf, status);
+
+		frr_with_mutex(&dump->mtx) {
+			*dump->tail = reply;
+			dump->tail = &reply->next;
+			dump->replies++;
+			dump->bytes += status;
+			dump->queued += status;
+			pthread_cond_signal(&dump->cond);
+		}
+	}
+
+	frr_with_mutex(&dump->mtx) {
+		dump->done = true;
+		dump->dump_usec = monotime_since(&dump->start, NULL);
+		pthread_cond_signal(&dump->cond);
+	}
+
+	return NULL;
+}
+
+static int netlink_dump_stop(struct frr_pthread *fpt, void **result)
+{
+	pthread_join(fpt->thread, result);
+	return 0;
+}
+
+/* Parse the replies of a dump as they come in */
+static int netlink_dump_parse(struct netlink_dump *dump,
+			      int (*filter)(struct nlmsghdr *, ns_id_t, int),
+			      const struct zebra_dplane_info *dp_info,
+			      int startup)
+{
+	struct netlink_dump_reply *reply;
+	struct timeval start, wait;
+	bool finished = false;
+	int ret = 0;
+
+	monotime(&start);
+	dump->parsed = true;
+
+	while (!finished) {
+		monotime(&wait);
+		frr_with_mutex(&dump->mtx) {
+			while (!dump->head && !dump->done)
+				pthread_cond_wait(&dump->cond, &dump->mtx);
+
+			reply = dump->head;
+			if (reply) {
+				dump->head = reply->next;
+				if (!dump->head)
+					dump->tail = &dump->head;
+				dump->queued -= reply->len;
+				pthread_cond_signal(&dump->space);
+			}
+		}
+		dump->wait_usec += monotime_since(&wait, NULL);
+
+		/* The dump failed before it was complete */
+		if (!reply)
+			break;
+
+		finished = netlink_parse_reply(filter, &dump->nls, dp_info,
+					       reply->buf, reply->len,
+					       reply->pid, reply->flags,
+					       startup, &ret);
+		XFREE(MTYPE_NL_DUMP, reply);
+	}
+
+	dump->parse_usec = monotime_since(&start, NULL) - dump->wait_usec;
+
+	return finished ? ret : -1;
+}
+
+int netlink_dump_read(struct zebra_ns *zns, enum netlink_dump_type type,
+		      int (*filter)(struct nlmsghdr *, ns_id_t, int),
+		      int startup)
+{
+	struct netlink_dump *dump = NULL;
+	struct zebra_dplane_info dp_info;
+	int ret;
+
+	/* Capture key info from ns struct */
+	zebra_dplane_info_from_zns(&dp_info, zns, true /*is_cmd*/);
+
+	if (zns->netlink_dumps)
+		dump = zns->netlink_dumps->dump[type];
+
+	/* Each dump is read once, ask the kernel again otherwise */
+	if (dump && !dump->parsed)
+		return netlink_dump_parse(dump, filter, &dp_info, startup);
+
+	ret = netlink_dump_request(&zns->netlink_cmd, type);
+	if (ret < 0)
+		return ret;
+
+	return netlink_parse_info(filter, &zns->netlink_cmd, &dp_info, 0,
+				  startup);
+}
+
+void netlink_dump_start(struct zebra_ns *zns, uint32_t what)
+{
+	struct frr_pthread_attr attr = {
+		.start = netlink_dump_thread,
+		.stop = netlink_dump_stop,
+	};
+	struct netlink_dump *dump;
+	int type;
+
+	if (!zns->netlink_dumps) {
+		zns->netlink_dumps =
+			XCALLOC(MTYPE_NL_DUMP, sizeof(struct netlink_dumps));
+		monotime(&zns->netlink_dumps->start);
+	}
+
+	for (type = 0; type < NETLINK_DUMP_MAX; type++) {
+		if (!(netlink_dump_info[type].what & what)
+		    || zns->netlink_dumps->dump[type])
+			continue;
+
+		dump = XCALLOC(MTYPE_NL_DUMP, sizeof(*dump));
+		dump->type = type;
+		snprintf(dump->nls.name, sizeof(dump->nls.name),
+			 "netlink-dump %s (NS %u)", netlink_dump_info[type].name,
+			 zns->ns_id);
+
+		/* Without a socket, the dump is done when it is read */
+		dump->nls.sock = -1;
+		if (netlink_socket(&dump->nls, 0, zns->ns_id) < 0) {
+			XFREE(MTYPE_NL_DUMP, dump);
+			continue;
+		}
+		if (nl_rcvbufsize)
+			netlink_recvbuf(&dump->nls, nl_rcvbufsize);
+
+		pthread_mutex_init(&dump->mtx, NULL);
+		pthread_cond_init(&dump->cond, NULL);
+		pthread_cond_init(&dump->space, NULL);
+		dump->tail = &dump->head;
+		monotime(&dump->start);
+
+		dump->fpt = frr_pthread_new(&attr, dump->nls.name,
+					    "zebra_nl_dump");
+		dump->fpt->data = dump;
+		frr_pthread_run(dump->fpt, NULL);
+
+		zns->netlink_dumps->dump[type] = dump;
+	}
+}
+
+void netlink_dump_finish(struct zebra_ns *zns)
+{
+	struct netlink_dumps *dumps = zns->netlink_dumps;
+	struct netlink_dump *dump;
+	struct netlink_dump_reply *reply;
+	int64_t read_usec[3] = {0}, dump_usec[3] = {0};
+	static const char *const phases[3] = {"interfaces", "routes",
+					      "neighbors"};
+	int type, phase;
+
+	if (!dumps)
+		return;
+
+	for (type = 0; type < NETLINK_DUMP_MAX; type++) {
+		dump = dumps->dump[type];
+		if (!dump)
+			continue;
+
+		/* A dump never parsed may be waiting for space */
+		frr_with_mutex(&dump->mtx) {
+			dump->stop = true;
+			pthread_cond_signal(&dump->space);
+		}
+		frr_pthread_stop(dump->fpt, NULL);
+		frr_pthread_destroy(dump->fpt);
+
+		if (IS_ZEBRA_DEBUG_KERNEL)
+			zlog_debug(
+				"%s: %u replies, %zu bytes in %" PRId64
+				" ms, parsed in %" PRId64 " ms, waited %" PRId64
+				" ms",
+				dump->nls.name, dump->replies, dump->bytes,
+				dump->dump_usec / 1000, dump->parse_usec / 1000,
+				dump->wait_usec / 1000);
+
+		/* The main pthread reads one dump after the other, while they
+		 * are all dumped at once.
+		 */
+		phase = ffs(netlink_dump_info[type].what) - 1;
+		read_usec[phase] += dump->parse_usec + dump->wait_usec;
+		dump_usec[phase] = MAX(dump_usec[phase], dump->dump_usec);
+
+		while ((reply = dump->head)) {
+			dump->head = reply->next;
+			XFREE(MTYPE_NL_DUMP, reply);
+		}
+
+		close(dump->nls.sock);
+		pthread_mutex_destroy(&dump->mtx);
+		pthread_cond_destroy(&dump->cond);
+		pthread_cond_destroy(&dump->space);
+		XFREE(MTYPE_NL_DUMP, dump);
+	}
+
+	for (phase = 0; phase < 3; phase++) {
+		if (!read_usec[phase] && !dump_usec[phase])
+			continue;
+
+		zlog_info("NS %u: read kernel %s in %" PRId64
+			  " ms, the longest dump took %" PRId64 " ms",
+			  zns->ns_id, phases[phase], read_usec[phase] / 1000,
+			  dump_usec[phase] / 1000);
+	}
+	zlog_info("NS %u: read kernel state in %" PRId64 " ms", zns->ns_id,
+		  monotime_since(&dumps->start, NULL) / 1000);
+
+	XFREE(MTYPE_NL_DUMP, zns->netlink_dumps);
+}
+
 /* Exported interface function.  This function simply calls
    netlink_socket (). */
 void kernel_init(struct zebra_ns *zns)
 {
 	uint32_t groups;
+	__u32 pids[DPLANE_KERNEL_SHARDS_MAX + 1];
+	unsigned int i, shards = dplane_kernel_shard_count();
 #if defined SOL_NETLINK
 	int one, ret;
 #endif
@@ -1421,11 +1891,14 @@ void kernel_init(struct zebra_ns *zns)
 
 	snprintf(zns->netlink_dplane.name, sizeof(zns->netlink_dplane.name),
 		 "netlink-dp (NS %u)", zns->ns_id);
-	zns->netlink_dplane.sock = -1;
-	if (netlink_socket(&zns->netlink_dplane, 0, zns->ns_id) < 0) {
-		zlog_err("Failure to create %s socket",
-			 zns->netlink_dplane.name);
-		exit(-1);
+	netlink_dplane_socket(&zns->netlink_dplane, zns->ns_id);
+
+	for (i = 1; i < shards; i++) {
+		struct nlsock *nl = &zns->netlink_dplane_shard[i - 1];
+
+		snprintf(nl->name, sizeof(nl->name), "netlink-dp%u (NS %u)", i,
+			 zns->ns_id);
+		netlink_dplane_socket(nl, zns->ns_id);
 	}
 
 	/*
@@ -1445,26 +1918,6 @@ void kernel_init(struct zebra_ns *zns)
 	if (ret < 0)
 		zlog_notice("Registration for extended cmd ACK failed : %d %s",
 			    errno, safe_strerror(errno));
-
-	one = 1;
-	ret = setsockopt(zns->netlink_dplane.sock, SOL_NETLINK, NETLINK_EXT_ACK,
-			 &one, sizeof(one));
-
-	if (ret < 0)
-		zlog_notice("Registration for extended dp ACK failed : %d %s",
-			    errno, safe_strerror(errno));
-
-	/*
-	 * Trim off the payload of the original netlink message in the
-	 * acknowledgment. This option is available since Linux 4.2, so if
-	 * setsockopt fails, ignore the error.
-	 */
-	one = 1;
-	ret = setsockopt(zns->netlink_dplane.sock, SOL_NETLINK, NETLINK_CAP_ACK,
-			 &one, sizeof(one));
-	if (ret < 0)
-		zlog_notice(
-			"Registration for reduced ACK packet size failed, probably running an early kernel");
 #endif
 
 	/* Register kernel socket. */
@@ -1476,20 +1929,17 @@ void kernel_init(struct zebra_ns *zns)
 		zlog_err("Can't set %s socket error: %s(%d)",
 			 zns->netlink_cmd.name, safe_strerror(errno), errno);
 
-	if (fcntl(zns->netlink_dplane.sock, F_SETFL, O_NONBLOCK) < 0)
-		zlog_err("Can't set %s socket error: %s(%d)",
-			 zns->netlink_dplane.name, safe_strerror(errno), errno);
-
 	/* Set receive buffer size if it's set from command line */
 	if (nl_rcvbufsize) {
 		netlink_recvbuf(&zns->netlink, nl_rcvbufsize);
 		netlink_recvbuf(&zns->netlink_cmd, nl_rcvbufsize);
-		netlink_recvbuf(&zns->netlink_dplane, nl_rcvbufsize);
 	}
 
-	netlink_install_filter(zns->netlink.sock,
-			       zns->netlink_cmd.snl.nl_pid,
-			       zns->netlink_dplane.snl.nl_pid);
+	pids[0] = zns->netlink_cmd.snl.nl_pid;
+	pids[1] = zns->netlink_dplane.snl.nl_pid;
+	for (i = 1; i < shards; i++)
+		pids[i + 1] = zns->netlink_dplane_shard[i - 1].snl.nl_pid;
+	netlink_install_filter(zns->netlink.sock, pids, shards + 1);
 
 	zns->t_netlink = NULL;
 
@@ -1501,6 +1951,8 @@ void kernel_init(struct zebra_ns *zns)
 
 void kernel_terminate(struct zebra_ns *zns, bool complete)
 {
+	unsigned int i;
+
 	THREAD_READ_OFF(zns->t_netlink);
 
 	if (zns->netlink.sock >= 0) {
@@ -1521,6 +1973,15 @@ void kernel_terminate(struct zebra_ns *zns, bool complete)
 			close(zns->netlink_dplane.sock);
 			zns->netlink_dplane.sock = -1;
 		}
+
+		for (i = 1; i < dplane_kernel_shard_count(); i++) {
+			struct nlsock *nl = &zns->netlink_dplane_shard[i - 1];
+
+			if (nl->sock >= 0) {
+				close(nl->sock);
+				nl->sock = -1;
+			}
+		}
 	}
 }
 #endif /* HAVE_NETLINK */
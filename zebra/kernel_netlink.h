@@ -96,6 +96,38 @@ extern int netlink_talk(int (*filter)(struct nlmsghdr *, ns_id_t, int startup),
 			struct zebra_ns *zns, int startup);
 extern int netlink_request(struct nlsock *nl, void *req);
 
+/* Kernel state dumped by netlink_dump_start() */
+enum netlink_dump_type {
+	NETLINK_DUMP_LINK,
+	NETLINK_DUMP_BRIDGE,
+	NETLINK_DUMP_NEXTHOP,
+	NETLINK_DUMP_ADDR4,
+	NETLINK_DUMP_ADDR6,
+	NETLINK_DUMP_ROUTE4,
+	NETLINK_DUMP_ROUTE6,
+	NETLINK_DUMP_RULE4,
+	NETLINK_DUMP_RULE6,
+	NETLINK_DUMP_MACFDB,
+	NETLINK_DUMP_NEIGH,
+	NETLINK_DUMP_MAX,
+};
+
+/*
+ * netlink_dump_start - start dumping the given KERNEL_READ_* state of a
+ * namespace, every dump at once on its own pthread.
+ *
+ * netlink_dump_read - pass a dump to the given function, waiting for the
+ * replies as needed. Dumps not started, or already read, are requested on
+ * the command socket.
+ *
+ * netlink_dump_finish - release the dumps and log how long they took.
+ */
+extern void netlink_dump_start(struct zebra_ns *zns, uint32_t what);
+extern int netlink_dump_read(struct zebra_ns *zns, enum netlink_dump_type type,
+			     int (*filter)(struct nlmsghdr *, ns_id_t, int),
+			     int startup);
+extern void netlink_dump_finish(struct zebra_ns *zns);
+
 enum netlink_msg_status {
 	FRR_NETLINK_SUCCESS,
 	FRR_NETLINK_ERROR,
@@ -58,6 +58,7 @@
 #include "zebra/zebra_nb.h"
 #include "zebra/zebra_opaque.h"
 #include "zebra/zebra_srte.h"
+#include "zebra/zebra_dplane.h"
 
 #define ZEBRA_PTM_SUPPORT
 
@@ -83,6 +84,7 @@ uint32_t nl_rcvbufsize = 4194304;
 #endif /* HAVE_NETLINK */
 
 #define OPTION_V6_RR_SEMANTICS 2000
+#define OPTION_DPLANE_SHARDS 2001
 /* Command line options. */
 const struct option longopts[] = {
 	{"batch", no_argument, NULL, 'b'},
@@ -97,6 +99,7 @@ const struct option longopts[] = {
 	{"vrfwnetns", no_argument, NULL, 'n'},
 	{"nl-bufsize", required_argument, NULL, 's'},
 	{"v6-rr-semantics", no_argument, NULL, OPTION_V6_RR_SEMANTICS},
+	{"dplane-shards", required_argument, NULL, OPTION_DPLANE_SHARDS},
 #endif /* HAVE_NETLINK */
 	{0}};
 
@@ -304,6 +307,7 @@ int main(int argc, char **argv)
 		"  -n, --vrfwnetns          Use NetNS as VRF backend\n"
 		"  -s, --nl-bufsize         Set netlink receive buffer size\n"
 		"      --v6-rr-semantics    Use v6 RR semantics\n"
+		"      --dplane-shards      Number of pthreads writing routes to the kernel\n"
 #endif /* HAVE_NETLINK */
 	);
 
@@ -365,6 +369,18 @@ int main(int argc, char **argv)
 		case OPTION_V6_RR_SEMANTICS:
 			v6_rr_semantics = true;
 			break;
+		case OPTION_DPLANE_SHARDS: {
+			unsigned long int shards = strtoul(optarg, NULL, 10);
+
+			if (shards == 0 || shards > DPLANE_KERNEL_SHARDS_MAX) {
+				fprintf(stderr,
+					"Number of dataplane shards must be between 1 and %u\n",
+					DPLANE_KERNEL_SHARDS_MAX);
+				return 1;
+			}
+			dplane_kernel_shard_count_set(shards);
+			break;
+		}
 #endif /* HAVE_NETLINK */
 		default:
 			frr_help_exit(1);
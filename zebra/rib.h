@@ -44,6 +44,7 @@ extern "C" {
 enum rnh_type { RNH_NEXTHOP_TYPE, RNH_IMPORT_CHECK_TYPE };
 
 PREDECL_LIST(rnh_list)
+PREDECL_LIST(rnh_pending)
 
 /* Nexthop structure. */
 struct rnh {
@@ -52,6 +53,7 @@ struct rnh {
 #define ZEBRA_NHT_CONNECTED     0x1
 #define ZEBRA_NHT_DELETED       0x2
 #define ZEBRA_NHT_EXACT_MATCH   0x4
+#define ZEBRA_NHT_PENDING       0x8
 
 	/* VRF identifier. */
 	vrf_id_t vrf_id;
@@ -77,12 +79,16 @@ struct rnh {
 	int filtered[ZEBRA_ROUTE_MAX];
 
 	struct rnh_list_item rnh_list_item;
+
+	/* queued for a coalesced re-evaluation */
+	struct rnh_pending_item pending_item;
 };
 
 #define DISTANCE_INFINITY  255
 #define ZEBRA_KERNEL_TABLE_MAX 252 /* support for no more than this rt tables */
 
 PREDECL_LIST(re_list)
+PREDECL_HEAP(rib_retained)
 
 struct route_entry {
 	/* Link list. */
@@ -148,6 +154,10 @@ struct route_entry {
  * differs from the rib/normal set of nexthops.
  */
 #define ROUTE_ENTRY_USE_FIB_NHG      0x40
+/* The kernel already holds this route exactly as it would be installed,
+ * so the dataplane does not need to write it again.
+ */
+#define ROUTE_ENTRY_KERNEL_SAME      0x80
 
 	/* Sequence value incremented for each dataplane operation */
 	uint32_t dplane_sequence;
@@ -174,11 +184,27 @@ struct route_entry {
  *              don't generate routes
  */
 #define MQ_SIZE 7
+
+/* The route sub-queues hold the zebra_vrfs that have route nodes waiting in
+ * them, and are served round-robin one route node at a time, so a burst of
+ * changes in one VRF does not hold up the others.  The route nodes themselves
+ * wait on the VRF's struct meta_queue_vrf.
+ */
 struct meta_queue {
 	struct list *subq[MQ_SIZE];
 	uint32_t size; /* sum of lengths of all subqueues */
 };
 
+struct meta_queue_vrf {
+	struct list *subq[MQ_SIZE];
+	uint32_t size;
+
+	/* statistics */
+	uint32_t max_size;
+	uint64_t processed;
+	uint64_t process_usec;
+};
+
 /*
  * Structure that represents a single destination (prefix).
  */
@@ -216,6 +242,20 @@ typedef struct rib_dest_t_ {
 	 */
 	TAILQ_ENTRY(rib_dest_t_) fpm_q_entries;
 
+	/*
+	 * Generation of the last update handed to the dataplane for this
+	 * prefix, see dplane_route_gen_current().
+	 */
+	uint64_t dplane_gen;
+
+	/*
+	 * Linkage to keep an empty dest, retained for a dataplane provider
+	 * to replay its deletion, until the generation it was retained at is
+	 * not anymore, see rib_gc_dest().
+	 */
+	struct rib_retained_item retained_item;
+	uint64_t retained_gen;
+
 } rib_dest_t;
 
 DECLARE_LIST(rnh_list, struct rnh, rnh_list_item);
@@ -244,6 +284,11 @@ DECLARE_LIST(re_list, struct route_entry, next);
 
 #define RIB_DEST_UPDATE_LSPS   (1 << (ZEBRA_MAX_QINDEX + 3))
 
+/*
+ * This flag is set while an empty dest waits on the retained heap.
+ */
+#define RIB_DEST_RETAINED      (1 << (ZEBRA_MAX_QINDEX + 4))
+
 /*
  * Macro to iterate over each route for a destination (prefix).
  */
@@ -417,16 +462,23 @@ struct nhg_ctx; /* Forward declaration */
 extern int rib_queue_nhg_add(struct nhg_ctx *ctx);
 
 extern void meta_queue_free(struct meta_queue *mq);
+extern void meta_queue_vrf_init(struct meta_queue_vrf *mqv);
+extern void meta_queue_vrf_free(struct meta_queue_vrf *mqv);
+/* Drops all route nodes the VRF has waiting on the meta-queue */
+extern void rib_meta_queue_vrf_clean(struct zebra_vrf *zvrf);
 extern int zebra_rib_labeled_unicast(struct route_entry *re);
 extern struct route_table *rib_table_ipv6;
 
 extern void rib_unlink(struct route_node *rn, struct route_entry *re);
 extern int rib_gc_dest(struct route_node *rn);
+extern void rib_retained_untrack(rib_dest_t *dest);
+extern void rib_retained_gc_schedule(void);
 extern struct route_table *rib_tables_iter_next(rib_tables_iter_t *iter);
 
 extern uint8_t route_distance(int type);
 
-extern void zebra_rib_evaluate_rn_nexthops(struct route_node *rn, uint32_t seq);
+extern void zebra_rib_evaluate_rn_nexthops(struct route_node *rn,
+					   uint32_t seq, bool coalesce);
 
 /*
  * Inline functions.
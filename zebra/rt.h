@@ -96,6 +96,18 @@ extern void neigh_read_for_vlan(struct zebra_ns *zns, struct interface *ifp);
 extern void neigh_read_specific_ip(struct ipaddr *ip,
 				   struct interface *vlan_if);
 extern void route_read(struct zebra_ns *zns);
+
+/*
+ * Start reading the given kernel state of a namespace ahead of the
+ * functions that use it, so it is read concurrently, and release what
+ * was read once they are done.
+ */
+#define KERNEL_READ_INTERFACES 0x01 /* interface_list() */
+#define KERNEL_READ_ROUTES 0x02     /* route_read(), kernel_read_pbr_rules() */
+#define KERNEL_READ_NEIGHBORS 0x04  /* macfdb_read(), neigh_read() */
+extern void kernel_read_begin(struct zebra_ns *zns, uint32_t what);
+extern void kernel_read_end(struct zebra_ns *zns);
+
 extern int kernel_upd_mac_nh(uint32_t nh_id, struct in_addr vtep_ip);
 extern int kernel_del_mac_nh(uint32_t nh_id);
 extern int kernel_upd_mac_nhg(uint32_t nhg_id, uint32_t nh_cnt,
@@ -1039,7 +1039,7 @@ int netlink_route_change(struct nlmsghdr *h, ns_id_t ns_id, int startup)
 }
 
 /* Request for specific route information from the kernel */
-static int netlink_request_route(struct zebra_ns *zns, int family, int type)
+int netlink_request_route(struct nlsock *netlink_cmd, int family, int type)
 {
 	struct {
 		struct nlmsghdr n;
@@ -1053,7 +1053,7 @@ static int netlink_request_route(struct zebra_ns *zns, int family, int type)
 	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
 	req.rtm.rtm_family = family;
 
-	return netlink_request(&zns->netlink_cmd, &req);
+	return netlink_request(netlink_cmd, &req);
 }
 
 /* Routing table read function using netlink interface.  Only called
@@ -1061,25 +1061,16 @@ static int netlink_request_route(struct zebra_ns *zns, int family, int type)
 int netlink_route_read(struct zebra_ns *zns)
 {
 	int ret;
-	struct zebra_dplane_info dp_info;
-
-	zebra_dplane_info_from_zns(&dp_info, zns, true /*is_cmd*/);
 
 	/* Get IPv4 routing table. */
-	ret = netlink_request_route(zns, AF_INET, RTM_GETROUTE);
-	if (ret < 0)
-		return ret;
-	ret = netlink_parse_info(netlink_route_change_read_unicast,
-				 &zns->netlink_cmd, &dp_info, 0, 1);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_ROUTE4,
+				netlink_route_change_read_unicast, 1);
 	if (ret < 0)
 		return ret;
 
 	/* Get IPv6 routing table. */
-	ret = netlink_request_route(zns, AF_INET6, RTM_GETROUTE);
-	if (ret < 0)
-		return ret;
-	ret = netlink_parse_info(netlink_route_change_read_unicast,
-				 &zns->netlink_cmd, &dp_info, 0, 1);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_ROUTE6,
+				netlink_route_change_read_unicast, 1);
 	if (ret < 0)
 		return ret;
 
@@ -2638,13 +2629,13 @@ int netlink_nexthop_change(struct nlmsghdr *h, ns_id_t ns_id, int startup)
 
 /**
  * netlink_request_nexthop() - Request nextop information from the kernel
- * @zns:	Zebra namespace
+ * @netlink_cmd:	Netlink socket
  * @family:	AF_* netlink family
  * @type:	RTM_* route type
  *
  * Return:	Result status
  */
-static int netlink_request_nexthop(struct zebra_ns *zns, int family, int type)
+int netlink_request_nexthop(struct nlsock *netlink_cmd, int family, int type)
 {
 	struct {
 		struct nlmsghdr n;
@@ -2658,7 +2649,7 @@ static int netlink_request_nexthop(struct zebra_ns *zns, int family, int type)
 	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct nhmsg));
 	req.nhm.nh_family = family;
 
-	return netlink_request(&zns->netlink_cmd, &req);
+	return netlink_request(netlink_cmd, &req);
 }
 
 
@@ -2673,16 +2664,10 @@ static int netlink_request_nexthop(struct zebra_ns *zns, int family, int type)
 int netlink_nexthop_read(struct zebra_ns *zns)
 {
 	int ret;
-	struct zebra_dplane_info dp_info;
-
-	zebra_dplane_info_from_zns(&dp_info, zns, true /*is_cmd*/);
 
 	/* Get nexthop objects */
-	ret = netlink_request_nexthop(zns, AF_UNSPEC, RTM_GETNEXTHOP);
-	if (ret < 0)
-		return ret;
-	ret = netlink_parse_info(netlink_nexthop_change, &zns->netlink_cmd,
-				 &dp_info, 0, 1);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_NEXTHOP,
+				netlink_nexthop_change, 1);
 
 	if (!ret)
 		/* If we succesfully read in nexthop objects,
@@ -3022,8 +3007,8 @@ static int netlink_macfdb_table(struct nlmsghdr *h, ns_id_t ns_id, int startup)
 }
 
 /* Request for MAC FDB information from the kernel */
-static int netlink_request_macs(struct nlsock *netlink_cmd, int family,
-				int type, ifindex_t master_ifindex)
+int netlink_request_macs(struct nlsock *netlink_cmd, int family, int type,
+			 ifindex_t master_ifindex)
 {
 	struct {
 		struct nlmsghdr n;
@@ -3049,22 +3034,10 @@ static int netlink_request_macs(struct nlsock *netlink_cmd, int family,
  */
 int netlink_macfdb_read(struct zebra_ns *zns)
 {
-	int ret;
-	struct zebra_dplane_info dp_info;
-
-	zebra_dplane_info_from_zns(&dp_info, zns, true /*is_cmd*/);
-
-	/* Get bridge FDB table. */
-	ret = netlink_request_macs(&zns->netlink_cmd, AF_BRIDGE, RTM_GETNEIGH,
-				   0);
-	if (ret < 0)
-		return ret;
-	/* We are reading entire table. */
+	/* Get bridge FDB table, we are reading entire table. */
 	filter_vlan = 0;
-	ret = netlink_parse_info(netlink_macfdb_table, &zns->netlink_cmd,
-				 &dp_info, 0, 1);
-
-	return ret;
+	return netlink_dump_read(zns, NETLINK_DUMP_MACFDB, netlink_macfdb_table,
+				 1);
 }
 
 /*
@@ -3464,8 +3437,8 @@ static int netlink_neigh_table(struct nlmsghdr *h, ns_id_t ns_id, int startup)
 }
 
 /* Request for IP neighbor information from the kernel */
-static int netlink_request_neigh(struct nlsock *netlink_cmd, int family,
-				 int type, ifindex_t ifindex)
+int netlink_request_neigh(struct nlsock *netlink_cmd, int family, int type,
+			  ifindex_t ifindex)
 {
 	struct {
 		struct nlmsghdr n;
@@ -3491,20 +3464,9 @@ static int netlink_request_neigh(struct nlsock *netlink_cmd, int family,
  */
 int netlink_neigh_read(struct zebra_ns *zns)
 {
-	int ret;
-	struct zebra_dplane_info dp_info;
-
-	zebra_dplane_info_from_zns(&dp_info, zns, true /*is_cmd*/);
-
 	/* Get IP neighbor table. */
-	ret = netlink_request_neigh(&zns->netlink_cmd, AF_UNSPEC, RTM_GETNEIGH,
-				    0);
-	if (ret < 0)
-		return ret;
-	ret = netlink_parse_info(netlink_neigh_table, &zns->netlink_cmd,
-				 &dp_info, 0, 1);
-
-	return ret;
+	return netlink_dump_read(zns, NETLINK_DUMP_NEIGH, netlink_neigh_table,
+				 1);
 }
 
 /*
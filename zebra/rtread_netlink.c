@@ -27,6 +27,7 @@
 #include "zebra/rt.h"
 #include "zebra/zebra_pbr.h"
 #include "zebra/rt_netlink.h"
+#include "zebra/kernel_netlink.h"
 #include "zebra/rule_netlink.h"
 
 void route_read(struct zebra_ns *zns)
@@ -71,4 +72,14 @@ void kernel_read_pbr_rules(struct zebra_ns *zns)
 	netlink_rules_read(zns);
 }
 
+void kernel_read_begin(struct zebra_ns *zns, uint32_t what)
+{
+	netlink_dump_start(zns, what);
+}
+
+void kernel_read_end(struct zebra_ns *zns)
+{
+	netlink_dump_finish(zns);
+}
+
 #endif /* GNU_LINUX */
@@ -109,4 +109,12 @@ void kernel_read_pbr_rules(struct zebra_ns *zns)
 {
 }
 
+void kernel_read_begin(struct zebra_ns *zns, uint32_t what)
+{
+}
+
+void kernel_read_end(struct zebra_ns *zns)
+{
+}
+
 #endif /* !defined(GNU_LINUX) */
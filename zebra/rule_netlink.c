@@ -366,7 +366,7 @@ int netlink_rule_change(struct nlmsghdr *h, ns_id_t ns_id, int startup)
 /*
  * Request rules from the kernel
  */
-static int netlink_request_rules(struct zebra_ns *zns, int family, int type)
+int netlink_request_rules(struct nlsock *netlink_cmd, int family, int type)
 {
 	struct {
 		struct nlmsghdr n;
@@ -380,7 +380,7 @@ static int netlink_request_rules(struct zebra_ns *zns, int family, int type)
 	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct fib_rule_hdr));
 	req.frh.family = family;
 
-	return netlink_request(&zns->netlink_cmd, &req);
+	return netlink_request(netlink_cmd, &req);
 }
 
 /*
@@ -389,25 +389,12 @@ static int netlink_request_rules(struct zebra_ns *zns, int family, int type)
 int netlink_rules_read(struct zebra_ns *zns)
 {
 	int ret;
-	struct zebra_dplane_info dp_info;
 
-	zebra_dplane_info_from_zns(&dp_info, zns, true);
-
-	ret = netlink_request_rules(zns, AF_INET, RTM_GETRULE);
-	if (ret < 0)
-		return ret;
-
-	ret = netlink_parse_info(netlink_rule_change, &zns->netlink_cmd,
-				 &dp_info, 0, 1);
-	if (ret < 0)
-		return ret;
-
-	ret = netlink_request_rules(zns, AF_INET6, RTM_GETRULE);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_RULE4, netlink_rule_change, 1);
 	if (ret < 0)
 		return ret;
 
-	ret = netlink_parse_info(netlink_rule_change, &zns->netlink_cmd,
-				 &dp_info, 0, 1);
+	ret = netlink_dump_read(zns, NETLINK_DUMP_RULE6, netlink_rule_change, 1);
 	return ret;
 }
 
@@ -39,6 +39,8 @@ extern int netlink_rule_change(struct nlmsghdr *h, ns_id_t ns_id, int startup);
  * Get to know existing PBR rules in the kernel - typically called at startup.
  */
 extern int netlink_rules_read(struct zebra_ns *zns);
+extern int netlink_request_rules(struct nlsock *netlink_cmd, int family,
+				 int type);
 
 extern enum netlink_msg_status
 netlink_put_rule_update_msg(struct nl_batch *bth, struct zebra_dplane_ctx *ctx);
@@ -35,6 +35,7 @@
 #include "lib/vrf.h"
 #include "lib/libfrr.h"
 #include "lib/lib_errors.h"
+#include "lib/jhash.h"
 
 #include "zebra/zebra_router.h"
 #include "zebra/rib.h"
@@ -62,6 +63,8 @@
 #include "zebra/zebra_opaque.h"
 #include "zebra/zebra_srte.h"
 
+DEFINE_MTYPE_STATIC(ZEBRA, ZAPI_NHG_CACHE, "Zebra zapi nexthop group cache")
+
 /* Encoding helpers -------------------------------------------------------- */
 
 static void zserv_encode_interface(struct stream *s, struct interface *ifp)
@@ -1109,6 +1112,9 @@ static void zread_rnh_register(ZAPI_HANDLER_ARGS)
 	if (!client->nh_reg_time)
 		client->nh_reg_time = monotime(NULL);
 
+	/* answer all registrations of this message in batched updates */
+	zebra_rnh_batch_begin();
+
 	while (l < hdr->length) {
 		STREAM_GETC(s, flags);
 		STREAM_GETW(s, p.family);
@@ -1120,7 +1126,7 @@ static void zread_rnh_register(ZAPI_HANDLER_ARGS)
 				zlog_debug(
 					"%s: Specified prefix hdr->length %d is too large for a v4 address",
 					__func__, p.prefixlen);
-				return;
+				goto stream_failure;
 			}
 			STREAM_GET(&p.u.prefix4.s_addr, s, IPV4_MAX_BYTELEN);
 			l += IPV4_MAX_BYTELEN;
@@ -1130,7 +1136,7 @@ static void zread_rnh_register(ZAPI_HANDLER_ARGS)
 				zlog_debug(
 					"%s: Specified prefix hdr->length %d is to large for a v6 address",
 					__func__, p.prefixlen);
-				return;
+				goto stream_failure;
 			}
 			STREAM_GET(&p.u.prefix6, s, IPV6_MAX_BYTELEN);
 			l += IPV6_MAX_BYTELEN;
@@ -1139,11 +1145,11 @@ static void zread_rnh_register(ZAPI_HANDLER_ARGS)
 				EC_ZEBRA_UNKNOWN_FAMILY,
 				"rnh_register: Received unknown family type %d\n",
 				p.family);
-			return;
+			goto stream_failure;
 		}
 		rnh = zebra_add_rnh(&p, zvrf_id(zvrf), type, &exist);
 		if (!rnh)
-			return;
+			goto stream_failure;
 
 		orig_flags = rnh->flags;
 		if (type == RNH_NEXTHOP_TYPE) {
@@ -1175,7 +1181,7 @@ static void zread_rnh_register(ZAPI_HANDLER_ARGS)
 	}
 
 stream_failure:
-	return;
+	zebra_rnh_batch_end();
 }
 
 /* Nexthop register */
@@ -1880,6 +1886,214 @@ static void zread_nhg_add(ZAPI_HANDLER_ARGS)
 			   ZAPI_NHG_FAIL_INSTALL);
 }
 
+/*
+ * Cache of the nexthop groups the last few routes of a client resolved to,
+ * keyed on the nexthops as decoded from zapi. Routes sharing nexthops tend
+ * to arrive back to back, e.g. in a BGP table transfer, so most routes of a
+ * batch hit it and skip building, sorting and hashing the nexthop group.
+ */
+#define ZAPI_NHG_CACHE_SIZE 8
+
+/* Message bits that change how the nexthops are read */
+#define ZAPI_NHG_CACHE_MESSAGE (ZAPI_MESSAGE_BACKUP_NEXTHOPS | ZAPI_MESSAGE_SRTE)
+
+struct zapi_nhg_cache_entry {
+	uint32_t key;
+
+	uint8_t type;
+	afi_t afi;
+	safi_t safi;
+	vrf_id_t vrf_id;
+	uint32_t flags;
+	uint32_t message;
+	uint16_t nexthop_num;
+	uint16_t backup_nexthop_num;
+
+	/* Primary then backup nexthops, NULL if the entry is unused */
+	struct zapi_nexthop *nexthops;
+
+	/* The nhe they resolved to, the dplane ref tells if it is still the
+	 * same object
+	 */
+	uint32_t nhe_id;
+	uint32_t dplane_ref;
+};
+
+struct zapi_nhg_cache {
+	struct zapi_nhg_cache_entry entries[ZAPI_NHG_CACHE_SIZE];
+
+	/* Next entry to replace */
+	unsigned int next;
+};
+
+static const struct zapi_nexthop *
+zapi_route_nexthop(const struct zapi_route *api, int i)
+{
+	if (i < api->nexthop_num)
+		return &api->nexthops[i];
+
+	return &api->backup_nexthops[i - api->nexthop_num];
+}
+
+static bool zapi_nhg_cache_usable(const struct zapi_route *api)
+{
+	const struct zapi_nexthop *api_nh;
+	int i;
+
+	/* The client picked the group itself */
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_NHG))
+		return false;
+
+	/* EVPN nexthops register the route with the L3-VNI as they are read */
+	if (CHECK_FLAG(api->flags, ZEBRA_FLAG_EVPN_ROUTE))
+		return false;
+
+	/*
+	 * These are onlink or not depending on the interface, not on what
+	 * the client sent.
+	 */
+	for (i = 0; i < api->nexthop_num + api->backup_nexthop_num; i++) {
+		api_nh = zapi_route_nexthop(api, i);
+		if (api_nh->type == NEXTHOP_TYPE_IPV4_IFINDEX
+		    && !CHECK_FLAG(api_nh->flags, ZAPI_NEXTHOP_FLAG_ONLINK))
+			return false;
+	}
+
+	return true;
+}
+
+static uint32_t zapi_nhg_cache_key(const struct zapi_route *api, afi_t afi,
+				   vrf_id_t vrf_id)
+{
+	uint32_t key;
+
+	key = jhash_3words(api->type, afi, api->safi, vrf_id);
+	key = jhash_2words(api->flags, api->message & ZAPI_NHG_CACHE_MESSAGE,
+			   key);
+	key = jhash(api->nexthops,
+		    api->nexthop_num * sizeof(struct zapi_nexthop), key);
+	key = jhash(api->backup_nexthops,
+		    api->backup_nexthop_num * sizeof(struct zapi_nexthop), key);
+
+	return key;
+}
+
+static void zapi_nhg_cache_entry_clear(struct zapi_nhg_cache_entry *entry)
+{
+	XFREE(MTYPE_ZAPI_NHG_CACHE, entry->nexthops);
+	memset(entry, 0, sizeof(*entry));
+}
+
+static bool zapi_nhg_cache_entry_match(const struct zapi_nhg_cache_entry *entry,
+				       const struct zapi_route *api,
+				       uint32_t key, afi_t afi,
+				       vrf_id_t vrf_id)
+{
+	if (!entry->nexthops || entry->key != key)
+		return false;
+
+	if (entry->type != api->type || entry->afi != afi
+	    || entry->safi != api->safi || entry->vrf_id != vrf_id
+	    || entry->flags != api->flags
+	    || entry->message != (api->message & ZAPI_NHG_CACHE_MESSAGE)
+	    || entry->nexthop_num != api->nexthop_num
+	    || entry->backup_nexthop_num != api->backup_nexthop_num)
+		return false;
+
+	/* zapi_route_decode() zeroes the route, so the padding compares too */
+	if (memcmp(entry->nexthops, api->nexthops,
+		   api->nexthop_num * sizeof(struct zapi_nexthop)))
+		return false;
+
+	return !memcmp(entry->nexthops + api->nexthop_num, api->backup_nexthops,
+		       api->backup_nexthop_num * sizeof(struct zapi_nexthop));
+}
+
+static struct nhg_hash_entry *
+zapi_nhg_cache_lookup(struct zserv *client, const struct zapi_route *api,
+		      uint32_t key, afi_t afi, vrf_id_t vrf_id)
+{
+	struct zapi_nhg_cache_entry *entry;
+	struct nhg_hash_entry *nhe;
+	int i;
+
+	if (!client->nhg_cache)
+		return NULL;
+
+	for (i = 0; i < ZAPI_NHG_CACHE_SIZE; i++) {
+		entry = &client->nhg_cache->entries[i];
+
+		if (!zapi_nhg_cache_entry_match(entry, api, key, afi, vrf_id))
+			continue;
+
+		/* The nhe may have gone away since */
+		nhe = zebra_nhg_lookup_id(entry->nhe_id);
+		if (!nhe || nhe->dplane_ref != entry->dplane_ref) {
+			zapi_nhg_cache_entry_clear(entry);
+			return NULL;
+		}
+
+		client->nhg_cache_hit_cnt++;
+		return nhe;
+	}
+
+	return NULL;
+}
+
+static void zapi_nhg_cache_add(struct zserv *client,
+			       const struct zapi_route *api, uint32_t key,
+			       afi_t afi, vrf_id_t vrf_id,
+			       const struct nhg_hash_entry *nhe)
+{
+	struct zapi_nhg_cache_entry *entry;
+	size_t size;
+
+	client->nhg_cache_miss_cnt++;
+
+	if (!client->nhg_cache)
+		client->nhg_cache = XCALLOC(MTYPE_ZAPI_NHG_CACHE,
+					    sizeof(struct zapi_nhg_cache));
+
+	entry = &client->nhg_cache->entries[client->nhg_cache->next];
+	client->nhg_cache->next =
+		(client->nhg_cache->next + 1) % ZAPI_NHG_CACHE_SIZE;
+
+	zapi_nhg_cache_entry_clear(entry);
+
+	size = api->nexthop_num * sizeof(struct zapi_nexthop);
+	entry->nexthops = XMALLOC(MTYPE_ZAPI_NHG_CACHE,
+				  size + api->backup_nexthop_num
+						 * sizeof(struct zapi_nexthop));
+	memcpy(entry->nexthops, api->nexthops, size);
+	memcpy(entry->nexthops + api->nexthop_num, api->backup_nexthops,
+	       api->backup_nexthop_num * sizeof(struct zapi_nexthop));
+
+	entry->key = key;
+	entry->type = api->type;
+	entry->afi = afi;
+	entry->safi = api->safi;
+	entry->vrf_id = vrf_id;
+	entry->flags = api->flags;
+	entry->message = api->message & ZAPI_NHG_CACHE_MESSAGE;
+	entry->nexthop_num = api->nexthop_num;
+	entry->backup_nexthop_num = api->backup_nexthop_num;
+	entry->nhe_id = nhe->id;
+	entry->dplane_ref = nhe->dplane_ref;
+}
+
+void zserv_nhg_cache_free(struct zserv *client)
+{
+	int i;
+
+	if (!client->nhg_cache)
+		return;
+
+	for (i = 0; i < ZAPI_NHG_CACHE_SIZE; i++)
+		zapi_nhg_cache_entry_clear(&client->nhg_cache->entries[i]);
+
+	XFREE(MTYPE_ZAPI_NHG_CACHE, client->nhg_cache);
+}
+
 static void zread_route_add(ZAPI_HANDLER_ARGS)
 {
 	struct stream *s;
@@ -1892,6 +2106,9 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	int ret;
 	vrf_id_t vrf_id;
 	struct nhg_hash_entry nhe;
+	struct nhg_hash_entry *cached_nhe = NULL;
+	bool nhg_cache;
+	uint32_t nhg_cache_key = 0;
 
 	s = msg;
 	if (zapi_route_decode(s, &api) < 0) {
@@ -1951,6 +2168,20 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_NHG))
 		re->nhe_id = api.nhgid;
 
+	/*
+	 * If a recent route had the same nexthops, use the nhe it resolved
+	 * to rather than building the group again.
+	 */
+	afi = family2afi(api.prefix.family);
+	nhg_cache = zapi_nhg_cache_usable(&api);
+	if (nhg_cache) {
+		nhg_cache_key = zapi_nhg_cache_key(&api, afi, vrf_id);
+		cached_nhe = zapi_nhg_cache_lookup(client, &api, nhg_cache_key,
+						   afi, vrf_id);
+		if (cached_nhe)
+			re->nhe_id = cached_nhe->id;
+	}
+
 	if (!re->nhe_id
 	    && (!zapi_read_nexthops(client, &api.prefix, api.nexthops,
 				    api.flags, api.message, api.nexthop_num,
@@ -1975,7 +2206,6 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_MTU))
 		re->mtu = api.mtu;
 
-	afi = family2afi(api.prefix.family);
 	if (afi != AFI_IP6 && CHECK_FLAG(api.message, ZAPI_MESSAGE_SRCPFX)) {
 		flog_warn(EC_ZEBRA_RX_SRCDEST_WRONG_AFI,
 			  "%s: Received SRC Prefix but afi is not v6",
@@ -2016,6 +2246,11 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	ret = rib_add_multipath_nhe(afi, api.safi, &api.prefix, src_p,
 				    re, &nhe);
 
+	/* 're' is linked in the rib on success, for now */
+	if (nhg_cache && !cached_nhe && ret > 0 && re->nhe)
+		zapi_nhg_cache_add(client, &api, nhg_cache_key, afi, vrf_id,
+				   re->nhe);
+
 	/* At this point, these allocations are not needed: 're' has been
 	 * retained or freed, and if 're' still exists, it is using
 	 * a reference to a shared group object.
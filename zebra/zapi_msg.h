@@ -48,6 +48,9 @@ extern "C" {
 extern void zserv_handle_commands(struct zserv *client,
 				  struct stream_fifo *fifo);
 
+/* Frees the nexthop group cache zebra keeps for the client's routes */
+extern void zserv_nhg_cache_free(struct zserv *client);
+
 extern int zsend_vrf_add(struct zserv *zclient, struct zebra_vrf *zvrf);
 extern int zsend_vrf_delete(struct zserv *zclient, struct zebra_vrf *zvrf);
 extern int zsend_interface_add(struct zserv *zclient, struct interface *ifp);
@@ -25,6 +25,7 @@
 #include "lib/debug.h"
 #include "lib/frratomic.h"
 #include "lib/frr_pthread.h"
+#include "lib/jhash.h"
 #include "lib/memory.h"
 #include "lib/queue.h"
 #include "lib/zebra.h"
@@ -252,6 +253,9 @@ struct zebra_dplane_ctx {
 	uint32_t zd_seq;
 	uint32_t zd_old_seq;
 
+	/* Route generation, 0 for anything but route updates */
+	uint64_t zd_route_gen;
+
 	/* Some updates may be generated by notifications: allow the
 	 * plugin to notice and ignore results from its own notifications.
 	 */
@@ -264,6 +268,9 @@ struct zebra_dplane_ctx {
 	vrf_id_t zd_vrf_id;
 	uint32_t zd_table_id;
 
+	/* Kernel dataplane shard writing a route update */
+	uint8_t zd_kernel_shard;
+
 	char zd_ifname[INTERFACE_NAMSIZ];
 	ifindex_t zd_ifindex;
 
@@ -404,6 +411,12 @@ static struct zebra_dplane_globals {
 
 	_Atomic uint32_t dg_update_yields;
 
+	/* Route generations, see dplane_route_gen_current() */
+	_Atomic uint64_t dg_route_gen;
+	_Atomic uint32_t dg_route_gens_in_flight;
+	_Atomic uint64_t dg_route_gen_floor;
+	_Atomic uint64_t dg_route_gen_retain;
+
 	/* Dataplane pthread */
 	struct frr_pthread *dg_pthread;
 
@@ -418,6 +431,43 @@ static struct zebra_dplane_globals {
 
 } zdplane_info;
 
+/* Number of kernel dataplane shards, fixed at startup */
+static uint32_t dplane_kernel_shards = 1;
+
+/*
+ * Kernel dataplane shards. Route updates are spread over the shards by
+ * namespace and table, see dplane_ctx_kernel_shard_init(). Shard 0 is the
+ * dataplane pthread itself, the others have a pthread and a netlink socket
+ * per namespace of their own. All other updates are written by the
+ * dataplane pthread while the shards are idle, so they stay ordered with
+ * the route updates around them - nexthop groups in particular.
+ */
+struct kernel_dplane_shard {
+	struct frr_pthread *fpt;
+
+	/* Updates handed to the shard, completed in place */
+	struct dplane_ctx_q ctx_q;
+	uint32_t queued;
+
+	_Atomic uint32_t counter;
+	_Atomic uint32_t batches;
+	_Atomic uint32_t errors;
+};
+
+static struct kernel_dplane_shards {
+	struct zebra_dplane_provider *prov;
+
+	/* protects pending */
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	unsigned int pending;
+
+	struct kernel_dplane_shard shards[DPLANE_KERNEL_SHARDS_MAX];
+} kds = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
 /*
  * Lock and unlock for interactions with the zebra 'core' pthread
  */
@@ -433,6 +483,7 @@ static struct zebra_dplane_globals {
 
 /* Prototypes */
 static int dplane_thread_loop(struct thread *event);
+static void kernel_dplane_show_shards(struct vty *vty);
 static void dplane_info_from_zns(struct zebra_dplane_info *ns_info,
 				 struct zebra_ns *zns);
 static enum zebra_dplane_result lsp_update_internal(zebra_lsp_t *lsp,
@@ -503,6 +554,13 @@ static void dplane_ctx_free_internal(struct zebra_dplane_ctx *ctx)
 	case DPLANE_OP_SYS_ROUTE_DELETE:
 	case DPLANE_OP_ROUTE_NOTIFY:
 
+		if (ctx->zd_route_gen) {
+			atomic_fetch_sub_explicit(
+				&zdplane_info.dg_route_gens_in_flight, 1,
+				memory_order_seq_cst);
+			ctx->zd_route_gen = 0;
+		}
+
 		/* Free allocated nexthops */
 		if (ctx->u.rinfo.zd_ng.nexthop) {
 			/* This deals with recursive nexthops too */
@@ -929,6 +987,13 @@ uint32_t dplane_ctx_get_old_seq(const struct zebra_dplane_ctx *ctx)
 	return ctx->zd_old_seq;
 }
 
+uint64_t dplane_ctx_get_route_gen(const struct zebra_dplane_ctx *ctx)
+{
+	DPLANE_CTX_VALID(ctx);
+
+	return ctx->zd_route_gen;
+}
+
 void dplane_ctx_set_vrf(struct zebra_dplane_ctx *ctx, vrf_id_t vrf)
 {
 	DPLANE_CTX_VALID(ctx);
@@ -1821,6 +1886,38 @@ static int dplane_ctx_ns_init(struct zebra_dplane_ctx *ctx,
 	return AOK;
 }
 
+/*
+ * Route updates of one table in one namespace always go to the same kernel
+ * dataplane shard, so they reach the kernel in the order they were made.
+ */
+static void dplane_ctx_kernel_shard_init(struct zebra_dplane_ctx *ctx,
+					 struct zebra_ns *zns)
+{
+	uint32_t shard;
+#if defined(HAVE_NETLINK)
+	int seq;
+#endif
+
+	if (dplane_kernel_shards <= 1)
+		return;
+
+	shard = jhash_2words(zns->ns_id, ctx->zd_table_id, 0)
+		% dplane_kernel_shards;
+	ctx->zd_kernel_shard = shard;
+
+#if defined(HAVE_NETLINK)
+	/* Shards other than the first write through their own socket; the
+	 * sequence number still comes from the namespace's dataplane socket.
+	 */
+	if (shard == 0)
+		return;
+
+	seq = ctx->zd_ns_info.nls.seq;
+	ctx->zd_ns_info.nls = zns->netlink_dplane_shard[shard - 1];
+	ctx->zd_ns_info.nls.seq = seq;
+#endif /* HAVE_NETLINK */
+}
+
 /*
  * Initialize a context block for a route update from zebra data structs.
  */
@@ -1913,6 +2010,7 @@ int dplane_ctx_route_init(struct zebra_dplane_ctx *ctx, enum dplane_op_e op,
 	zvrf = vrf_info_lookup(re->vrf_id);
 	zns = zvrf->zns;
 	dplane_ctx_ns_init(ctx, zns, (op == DPLANE_OP_ROUTE_UPDATE));
+	dplane_ctx_kernel_shard_init(ctx, zns);
 
 #ifdef HAVE_NETLINK
 	{
@@ -2301,6 +2399,106 @@ static int dplane_update_enqueue(struct zebra_dplane_ctx *ctx)
 	return ret;
 }
 
+/*
+ * Stamp a route update with the next generation, and remember it in the dest
+ * so that providers can find what changed since a given generation.
+ */
+static void dplane_route_gen_stamp(struct zebra_dplane_ctx *ctx,
+				   struct route_node *rn)
+{
+	rib_dest_t *dest = rib_dest_from_rnode(rn);
+
+	/* Counted before the generation is handed out, see
+	 * dplane_route_gen_settled().
+	 */
+	atomic_fetch_add_explicit(&zdplane_info.dg_route_gens_in_flight, 1,
+				  memory_order_seq_cst);
+	ctx->zd_route_gen = atomic_fetch_add_explicit(
+				    &zdplane_info.dg_route_gen, 1,
+				    memory_order_seq_cst)
+			    + 1;
+
+	if (dest)
+		dest->dplane_gen = ctx->zd_route_gen;
+}
+
+/*
+ * The prefix changed without an update for the dataplane, still let walks
+ * resuming from an older generation pick it up.
+ */
+static void dplane_route_gen_touch(struct route_node *rn)
+{
+	rib_dest_t *dest;
+
+	if (rn == NULL)
+		return;
+
+	dest = rib_dest_from_rnode(rn);
+	if (dest)
+		dest->dplane_gen = atomic_fetch_add_explicit(
+					   &zdplane_info.dg_route_gen, 1,
+					   memory_order_seq_cst)
+				   + 1;
+}
+
+uint64_t dplane_route_gen_current(void)
+{
+	return atomic_load_explicit(&zdplane_info.dg_route_gen,
+				    memory_order_seq_cst);
+}
+
+uint64_t dplane_route_gen_settled(void)
+{
+	uint64_t gen;
+
+	/*
+	 * Any generation up to 'gen' had its update counted in flight
+	 * before it was handed out, so if nothing is in flight now those
+	 * updates are all done with.
+	 */
+	gen = atomic_load_explicit(&zdplane_info.dg_route_gen,
+				   memory_order_seq_cst);
+	if (atomic_load_explicit(&zdplane_info.dg_route_gens_in_flight,
+				 memory_order_seq_cst))
+		return 0;
+
+	return gen;
+}
+
+uint64_t dplane_route_gen_floor(void)
+{
+	return atomic_load_explicit(&zdplane_info.dg_route_gen_floor,
+				    memory_order_seq_cst);
+}
+
+void dplane_route_gen_invalidate(void)
+{
+	atomic_store_explicit(&zdplane_info.dg_route_gen_floor,
+			      dplane_route_gen_current(), memory_order_seq_cst);
+}
+
+void dplane_route_gen_retain(uint64_t gen)
+{
+	uint64_t old;
+
+	old = atomic_exchange_explicit(&zdplane_info.dg_route_gen_retain, gen,
+				       memory_order_seq_cst);
+
+	/* Free the dests kept for generations not retained anymore */
+	if (gen != old && (gen == 0 || gen > old))
+		rib_retained_gc_schedule();
+}
+
+bool dplane_route_gen_retained(uint64_t gen)
+{
+	uint64_t retain;
+
+	retain = atomic_load_explicit(&zdplane_info.dg_route_gen_retain,
+				      memory_order_seq_cst);
+
+	return retain && gen > retain;
+}
+
 /*
  * Utility that prepares a route update and enqueues it for processing
  */
@@ -2320,6 +2518,10 @@ dplane_route_update_internal(struct route_node *rn,
 	/* Init context with info from zebra data structs */
 	ret = dplane_ctx_route_init(ctx, op, rn, re);
 	if (ret == AOK) {
+		/* Nothing to write if the kernel already has this route */
+		if (CHECK_FLAG(re->status, ROUTE_ENTRY_KERNEL_SAME))
+			dplane_ctx_set_skip_kernel(ctx);
+
 		/* Capture some extra info for update case
 		 * where there's a different 'old' route.
 		 */
@@ -2393,6 +2595,7 @@ dplane_route_update_internal(struct route_node *rn,
 		}
 
 		/* Enqueue context for processing */
+		dplane_route_gen_stamp(ctx, rn);
 		ret = dplane_update_enqueue(ctx);
 	}
 
@@ -2519,6 +2722,7 @@ enum zebra_dplane_result dplane_sys_route_add(struct route_node *rn,
 
 	/* Ignore this event unless a provider plugin has requested it. */
 	if (!zdplane_info.dg_sys_route_notifs) {
+		dplane_route_gen_touch(rn);
 		ret = ZEBRA_DPLANE_REQUEST_SUCCESS;
 		goto done;
 	}
@@ -2543,6 +2747,7 @@ enum zebra_dplane_result dplane_sys_route_del(struct route_node *rn,
 
 	/* Ignore this event unless a provider plugin has requested it. */
 	if (!zdplane_info.dg_sys_route_notifs) {
+		dplane_route_gen_touch(rn);
 		ret = ZEBRA_DPLANE_REQUEST_SUCCESS;
 		goto done;
 	}
@@ -2613,6 +2818,7 @@ dplane_route_notif_update(struct route_node *rn,
 	dplane_ctx_set_notif_provider(new_ctx,
 				      dplane_ctx_get_notif_provider(ctx));
 
+	dplane_route_gen_stamp(new_ctx, rn);
 	ret = dplane_update_enqueue(new_ctx);
 
 done:
@@ -3495,6 +3701,9 @@ int dplane_show_provs_helper(struct vty *vty, bool detailed)
 			", out: %" PRIu64 ", q_max: %" PRIu64 "\n",
 			prov->dp_name, prov->dp_id, in, in_max, out, out_max);
 
+		if (prov == kds.prov && dplane_kernel_shards > 1)
+			kernel_dplane_show_shards(vty);
+
 		DPLANE_LOCK();
 		prov = TAILQ_NEXT(prov, dp_prov_link);
 		DPLANE_UNLOCK();
@@ -3962,6 +4171,202 @@ static void kernel_dplane_handle_result(struct zebra_dplane_ctx *ctx)
 	}
 }
 
+static void kernel_dplane_shard_process(struct kernel_dplane_shard *shard)
+{
+	struct zebra_dplane_ctx *ctx;
+	uint32_t errors = 0;
+
+	kernel_update_multi(&shard->ctx_q);
+
+	TAILQ_FOREACH (ctx, &shard->ctx_q, zd_q_entries)
+		if (dplane_ctx_get_status(ctx) != ZEBRA_DPLANE_REQUEST_SUCCESS)
+			errors++;
+
+	atomic_fetch_add_explicit(&shard->counter, shard->queued,
+				  memory_order_relaxed);
+	atomic_fetch_add_explicit(&shard->batches, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&shard->errors, errors,
+				  memory_order_relaxed);
+	shard->queued = 0;
+}
+
+/* Runs on a shard pthread */
+static int kernel_dplane_shard_work(struct thread *thread)
+{
+	struct kernel_dplane_shard *shard = THREAD_ARG(thread);
+
+	kernel_dplane_shard_process(shard);
+
+	frr_with_mutex(&kds.mtx) {
+		if (--kds.pending == 0)
+			pthread_cond_signal(&kds.cond);
+	}
+
+	return 0;
+}
+
+/*
+ * Writes the updates queued on the shards and waits for all of them to
+ * finish; the completed updates are appended to done_list.
+ */
+static void kernel_dplane_shards_run(struct dplane_ctx_q *done_list)
+{
+	unsigned int i, pending = 0;
+
+	for (i = 1; i < dplane_kernel_shards; i++)
+		if (kds.shards[i].queued)
+			pending++;
+
+	frr_with_mutex(&kds.mtx) {
+		kds.pending = pending;
+	}
+
+	for (i = 1; i < dplane_kernel_shards; i++)
+		if (kds.shards[i].queued)
+			thread_add_event(kds.shards[i].fpt->master,
+					 kernel_dplane_shard_work,
+					 &kds.shards[i], 0, NULL);
+
+	if (kds.shards[0].queued)
+		kernel_dplane_shard_process(&kds.shards[0]);
+
+	frr_with_mutex(&kds.mtx) {
+		while (kds.pending)
+			pthread_cond_wait(&kds.cond, &kds.mtx);
+	}
+
+	for (i = 0; i < dplane_kernel_shards; i++)
+		dplane_ctx_list_append(done_list, &kds.shards[i].ctx_q);
+}
+
+static bool kernel_dplane_is_sharded(const struct zebra_dplane_ctx *ctx)
+{
+	switch (dplane_ctx_get_op(ctx)) {
+	case DPLANE_OP_ROUTE_INSTALL:
+	case DPLANE_OP_ROUTE_UPDATE:
+	case DPLANE_OP_ROUTE_DELETE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* kernel_update_multi(), with the route updates written by the shards */
+static void kernel_dplane_update_sharded(struct dplane_ctx_q *ctx_list)
+{
+	struct dplane_ctx_q done_list, other_list;
+	struct kernel_dplane_shard *shard;
+	struct zebra_dplane_ctx *ctx;
+	bool routes = false;
+
+	TAILQ_INIT(&done_list);
+	TAILQ_INIT(&other_list);
+
+	while ((ctx = dplane_ctx_dequeue(ctx_list))) {
+		if (!kernel_dplane_is_sharded(ctx)) {
+			/* the route updates before it go to the kernel first */
+			if (routes) {
+				kernel_dplane_shards_run(&done_list);
+				routes = false;
+			}
+			TAILQ_INSERT_TAIL(&other_list, ctx, zd_q_entries);
+			continue;
+		}
+
+		if (TAILQ_FIRST(&other_list)) {
+			kernel_update_multi(&other_list);
+			dplane_ctx_list_append(&done_list, &other_list);
+		}
+
+		shard = &kds.shards[ctx->zd_kernel_shard];
+		TAILQ_INSERT_TAIL(&shard->ctx_q, ctx, zd_q_entries);
+		shard->queued++;
+		routes = true;
+	}
+
+	if (routes)
+		kernel_dplane_shards_run(&done_list);
+	if (TAILQ_FIRST(&other_list)) {
+		kernel_update_multi(&other_list);
+		dplane_ctx_list_append(&done_list, &other_list);
+	}
+
+	dplane_ctx_list_append(ctx_list, &done_list);
+}
+
+static int kernel_dplane_start(struct zebra_dplane_provider *prov)
+{
+	struct frr_pthread_attr attr = {
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
+	char name[32], os_name[OS_THREAD_NAMELEN];
+	unsigned int i;
+
+	for (i = 0; i < dplane_kernel_shards; i++)
+		TAILQ_INIT(&kds.shards[i].ctx_q);
+
+	for (i = 1; i < dplane_kernel_shards; i++) {
+		snprintf(name, sizeof(name), "Zebra dplane kernel shard %u", i);
+		snprintf(os_name, sizeof(os_name), "zebra_dp_k%u", i);
+
+		kds.shards[i].fpt = frr_pthread_new(&attr, name, os_name);
+		frr_pthread_run(kds.shards[i].fpt, NULL);
+		frr_pthread_wait_running(kds.shards[i].fpt);
+	}
+
+	return 0;
+}
+
+static int kernel_dplane_fini(struct zebra_dplane_provider *prov, bool early)
+{
+	unsigned int i;
+
+	if (early)
+		return 0;
+
+	/* the dataplane pthread is gone, so the shards are idle */
+	for (i = 1; i < dplane_kernel_shards; i++) {
+		if (!kds.shards[i].fpt)
+			continue;
+
+		frr_pthread_stop(kds.shards[i].fpt, NULL);
+		frr_pthread_destroy(kds.shards[i].fpt);
+		kds.shards[i].fpt = NULL;
+	}
+
+	return 0;
+}
+
+static void kernel_dplane_show_shards(struct vty *vty)
+{
+	struct kernel_dplane_shard *shard;
+	unsigned int i;
+
+	for (i = 0; i < dplane_kernel_shards; i++) {
+		shard = &kds.shards[i];
+
+		vty_out(vty,
+			"  shard %u: in: %u, batches: %u, errors: %u\n", i,
+			atomic_load_explicit(&shard->counter,
+					     memory_order_relaxed),
+			atomic_load_explicit(&shard->batches,
+					     memory_order_relaxed),
+			atomic_load_explicit(&shard->errors,
+					     memory_order_relaxed));
+	}
+}
+
+void dplane_kernel_shard_count_set(uint32_t count)
+{
+	dplane_kernel_shards = count;
+}
+
+uint32_t dplane_kernel_shard_count(void)
+{
+	return dplane_kernel_shards;
+}
+
 /*
  * Kernel provider callback
  */
@@ -3990,7 +4395,10 @@ static int kernel_dplane_process_func(struct zebra_dplane_provider *prov)
 		TAILQ_INSERT_TAIL(&work_list, ctx, zd_q_entries);
 	}
 
-	kernel_update_multi(&work_list);
+	if (dplane_kernel_shards > 1)
+		kernel_dplane_update_sharded(&work_list);
+	else
+		kernel_update_multi(&work_list);
 
 	TAILQ_FOREACH_SAFE (ctx, &work_list, zd_q_entries, tctx) {
 		kernel_dplane_handle_result(ctx);
@@ -4090,10 +4498,11 @@ static void dplane_provider_init(void)
 
 	ret = dplane_provider_register("Kernel",
 				       DPLANE_PRIO_KERNEL,
-				       DPLANE_PROV_FLAGS_DEFAULT, NULL,
+				       DPLANE_PROV_FLAGS_DEFAULT,
+				       kernel_dplane_start,
 				       kernel_dplane_process_func,
-				       NULL,
-				       NULL, NULL);
+				       kernel_dplane_fini,
+				       NULL, &kds.prov);
 
 	if (ret != AOK)
 		zlog_err("Unable to register kernel dplane provider: %d",
@@ -4497,6 +4906,10 @@ static void zebra_dplane_init_internal(void)
 
 	zdplane_info.dg_max_queued_updates = DPLANE_DEFAULT_MAX_QUEUED;
 
+	/* Start above anything an earlier zebra process may have handed out */
+	zdplane_info.dg_route_gen = (uint64_t)time(NULL) << 32;
+	zdplane_info.dg_route_gen_floor = zdplane_info.dg_route_gen;
+
 	/* Register default kernel 'provider' during init */
 	dplane_provider_init();
 }
@@ -266,6 +266,7 @@ void dplane_ctx_set_src(struct zebra_dplane_ctx *ctx, const struct prefix *src);
 bool dplane_ctx_is_update(const struct zebra_dplane_ctx *ctx);
 uint32_t dplane_ctx_get_seq(const struct zebra_dplane_ctx *ctx);
 uint32_t dplane_ctx_get_old_seq(const struct zebra_dplane_ctx *ctx);
+uint64_t dplane_ctx_get_route_gen(const struct zebra_dplane_ctx *ctx);
 void dplane_ctx_set_vrf(struct zebra_dplane_ctx *ctx, vrf_id_t vrf);
 vrf_id_t dplane_ctx_get_vrf(const struct zebra_dplane_ctx *ctx);
 
@@ -613,9 +614,41 @@ uint32_t dplane_get_in_queue_limit(void);
  */
 void dplane_set_in_queue_limit(uint32_t limit, bool set);
 
+/* Number of pthreads the kernel provider writes route updates with, each
+ * with its own netlink socket per namespace. Can only be set at startup,
+ * before the namespaces are initialised.
+ */
+void dplane_kernel_shard_count_set(uint32_t count);
+uint32_t dplane_kernel_shard_count(void);
+
 /* Retrieve the current queue depth of incoming, unprocessed updates */
 uint32_t dplane_get_in_queue_len(void);
 
+/* Route generations: every route update enqueued for the dataplane is stamped
+ * with the next value of a counter, which is also recorded in the rib dest.
+ * Generations keep growing across restarts, so values handed out by an
+ * earlier zebra process are always below dplane_route_gen_floor().
+ */
+uint64_t dplane_route_gen_current(void);
+
+/* Highest generation all updates up to which have been through every
+ * provider, 0 while updates are in flight.
+ */
+uint64_t dplane_route_gen_settled(void);
+
+/* Generations below the floor cannot be used to compute deltas anymore, e.g.
+ * because tables holding deleted prefixes were freed.
+ */
+uint64_t dplane_route_gen_floor(void);
+void dplane_route_gen_invalidate(void);
+
+/* Keep empty dests whose last update is above 'gen' in the rib, so that a
+ * provider can replay their deletion. The rib frees them once 'gen' moves
+ * past their update. 0 stops retaining dests, and frees them all.
+ */
+void dplane_route_gen_retain(uint64_t gen);
+bool dplane_route_gen_retained(uint64_t gen);
+
 /*
  * Vty/cli apis
  */
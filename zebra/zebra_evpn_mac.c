@@ -47,48 +47,46 @@ DEFINE_MTYPE_STATIC(ZEBRA, MAC, "EVPN MAC");
  * Return number of valid MACs in an EVPN's MAC hash table - all
  * remote MACs and non-internal (auto) local MACs count.
  */
+static void num_valid_macs_iter(struct hash_bucket *hb, void *arg)
+{
+	zebra_mac_t *mac = (zebra_mac_t *)hb->data;
+	uint32_t *num_macs = arg;
+
+	if (CHECK_FLAG(mac->flags, ZEBRA_MAC_REMOTE)
+	    || CHECK_FLAG(mac->flags, ZEBRA_MAC_LOCAL)
+	    || !CHECK_FLAG(mac->flags, ZEBRA_MAC_AUTO))
+		(*num_macs)++;
+}
+
 uint32_t num_valid_macs(zebra_evpn_t *zevpn)
 {
-	unsigned int i;
 	uint32_t num_macs = 0;
-	struct hash *hash;
-	struct hash_bucket *hb;
-	zebra_mac_t *mac;
 
-	hash = zevpn->mac_table;
-	if (!hash)
+	if (!zevpn->mac_table)
 		return num_macs;
-	for (i = 0; i < hash->size; i++) {
-		for (hb = hash->index[i]; hb; hb = hb->next) {
-			mac = (zebra_mac_t *)hb->data;
-			if (CHECK_FLAG(mac->flags, ZEBRA_MAC_REMOTE)
-			    || CHECK_FLAG(mac->flags, ZEBRA_MAC_LOCAL)
-			    || !CHECK_FLAG(mac->flags, ZEBRA_MAC_AUTO))
-				num_macs++;
-		}
-	}
+
+	hash_iterate(zevpn->mac_table, num_valid_macs_iter, &num_macs);
 
 	return num_macs;
 }
 
+static void num_dup_detected_macs_iter(struct hash_bucket *hb, void *arg)
+{
+	zebra_mac_t *mac = (zebra_mac_t *)hb->data;
+	uint32_t *num_macs = arg;
+
+	if (CHECK_FLAG(mac->flags, ZEBRA_MAC_DUPLICATE))
+		(*num_macs)++;
+}
+
 uint32_t num_dup_detected_macs(zebra_evpn_t *zevpn)
 {
-	unsigned int i;
 	uint32_t num_macs = 0;
-	struct hash *hash;
-	struct hash_bucket *hb;
-	zebra_mac_t *mac;
 
-	hash = zevpn->mac_table;
-	if (!hash)
+	if (!zevpn->mac_table)
 		return num_macs;
-	for (i = 0; i < hash->size; i++) {
-		for (hb = hash->index[i]; hb; hb = hb->next) {
-			mac = (zebra_mac_t *)hb->data;
-			if (CHECK_FLAG(mac->flags, ZEBRA_MAC_DUPLICATE))
-				num_macs++;
-		}
-	}
+
+	hash_iterate(zevpn->mac_table, num_dup_detected_macs_iter, &num_macs);
 
 	return num_macs;
 }
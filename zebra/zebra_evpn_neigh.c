@@ -89,24 +89,24 @@ struct hash *zebra_neigh_db_create(const char *desc)
 	return hash_create(neigh_hash_keymake, neigh_cmp, desc);
 }
 
+static void num_dup_detected_neighs_iter(struct hash_bucket *hb, void *arg)
+{
+	zebra_neigh_t *nbr = (zebra_neigh_t *)hb->data;
+	uint32_t *num_neighs = arg;
+
+	if (CHECK_FLAG(nbr->flags, ZEBRA_NEIGH_DUPLICATE))
+		(*num_neighs)++;
+}
+
 uint32_t num_dup_detected_neighs(zebra_evpn_t *zevpn)
 {
-	unsigned int i;
 	uint32_t num_neighs = 0;
-	struct hash *hash;
-	struct hash_bucket *hb;
-	zebra_neigh_t *nbr;
 
-	hash = zevpn->neigh_table;
-	if (!hash)
+	if (!zevpn->neigh_table)
 		return num_neighs;
-	for (i = 0; i < hash->size; i++) {
-		for (hb = hash->index[i]; hb; hb = hb->next) {
-			nbr = (zebra_neigh_t *)hb->data;
-			if (CHECK_FLAG(nbr->flags, ZEBRA_NEIGH_DUPLICATE))
-				num_neighs++;
-		}
-	}
+
+	hash_iterate(zevpn->neigh_table, num_dup_detected_neighs_iter,
+		     &num_neighs);
 
 	return num_neighs;
 }
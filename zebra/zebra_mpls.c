@@ -1680,18 +1680,19 @@ static json_object *lsp_json(zebra_lsp_t *lsp)
 }
 
 
+static void hash_get_sorted_list_iter(struct hash_bucket *hb, void *arg)
+{
+	listnode_add_sort((struct list *)arg, hb->data);
+}
+
 /* Return a sorted linked list of the hash contents */
 static struct list *hash_get_sorted_list(struct hash *hash, void *cmp)
 {
-	unsigned int i;
-	struct hash_bucket *hb;
 	struct list *sorted_list = list_new();
 
 	sorted_list->cmp = (int (*)(void *, void *))cmp;
 
-	for (i = 0; i < hash->size; i++)
-		for (hb = hash->index[i]; hb; hb = hb->next)
-			listnode_add_sort(sorted_list, hb->data);
+	hash_iterate(hash, hash_get_sorted_list_iter, sorted_list);
 
 	return sorted_list;
 }
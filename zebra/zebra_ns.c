@@ -124,9 +124,13 @@ int zebra_ns_enable(ns_id_t ns_id, void **info)
 	zns->ns_id = ns_id;
 
 	kernel_init(zns);
+
+	/* Dump everything at once, but read links, addresses and then routes */
+	kernel_read_begin(zns, KERNEL_READ_INTERFACES | KERNEL_READ_ROUTES);
 	interface_list(zns);
 	route_read(zns);
 	kernel_read_pbr_rules(zns);
+	kernel_read_end(zns);
 
 	/* Initiate Table Manager per ZNS */
 	table_manager_enable(ns_id);
@@ -42,6 +42,9 @@ struct nlsock {
 };
 #endif
 
+/* Most pthreads the kernel dataplane provider writes to the kernel with */
+#define DPLANE_KERNEL_SHARDS_MAX 16
+
 struct zebra_ns {
 	/* net-ns name.  */
 	char name[VRF_NAMSIZ];
@@ -53,7 +56,11 @@ struct zebra_ns {
 	struct nlsock netlink;        /* kernel messages */
 	struct nlsock netlink_cmd;    /* command channel */
 	struct nlsock netlink_dplane; /* dataplane channel */
+	/* dataplane channels of the additional kernel dataplane shards */
+	struct nlsock netlink_dplane_shard[DPLANE_KERNEL_SHARDS_MAX - 1];
 	struct thread *t_netlink;
+	/* kernel state being dumped at startup */
+	struct netlink_dumps *netlink_dumps;
 #endif
 
 	struct route_table *if_table;
@@ -66,6 +66,20 @@ static pthread_mutex_t dplane_mutex;
 static struct thread *t_dplane;
 static struct dplane_ctx_q rib_dplane_q;
 
+/*
+ * Empty dests kept for a dataplane provider to replay their deletion,
+ * oldest generation first, and the event freeing them once it moved on.
+ */
+static int rib_retained_cmp(const rib_dest_t *a, const rib_dest_t *b)
+{
+	return numcmp(a->retained_gen, b->retained_gen);
+}
+
+DECLARE_HEAP(rib_retained, rib_dest_t, retained_item, rib_retained_cmp)
+
+static struct rib_retained_head rib_retained_dests;
+static struct thread *t_rib_retained;
+
 DEFINE_HOOK(rib_update, (struct route_node * rn, const char *reason),
 	    (rn, reason))
 
@@ -448,6 +462,178 @@ int zebra_rib_labeled_unicast(struct route_entry *re)
 	return 1;
 }
 
+/*
+ * The routes zebra originated and read back from the kernel at startup
+ * stay in the RIB until rib_sweep_route() runs.  Until then they tell us
+ * what the kernel holds for a prefix, so a route that a client pushes
+ * again after a restart only needs to be written if it differs.
+ */
+static bool rib_route_from_kernel(const struct route_entry *re)
+{
+	return CHECK_FLAG(re->flags, ZEBRA_FLAG_SELFROUTE)
+	       && re->uptime <= zrouter.startup_time;
+}
+
+static struct route_entry *rib_kernel_route_find(struct route_node *rn,
+						 struct route_entry *re)
+{
+	struct route_entry *kre;
+
+	if (rib_route_from_kernel(re))
+		return re;
+
+	RNODE_FOREACH_RE (rn, kre) {
+		if (kre->type == re->type && rib_route_from_kernel(kre))
+			return kre;
+	}
+
+	return NULL;
+}
+
+/* Mirror the MTU the netlink encoder sends down */
+static uint32_t rib_route_kernel_mtu(const struct route_entry *re)
+{
+	if (!re->mtu || (re->nexthop_mtu && re->nexthop_mtu < re->mtu))
+		return re->nexthop_mtu;
+
+	return re->mtu;
+}
+
+/*
+ * Mirror the preferred source the netlink encoder sends down: one per
+ * route, from the first nexthop that has one, a route-map "set src" going
+ * before the resolved source.  Routes read from the kernel carry theirs
+ * in the src of each nexthop.
+ */
+static bool rib_route_kernel_src(const struct route_entry *re, int family,
+				 union g_addr *src)
+{
+	struct nexthop *nexthop;
+
+	for (ALL_NEXTHOPS(re->nhe->nhg, nexthop)) {
+		if (family == AF_INET) {
+			if (nexthop->rmap_src.ipv4.s_addr != INADDR_ANY) {
+				src->ipv4 = nexthop->rmap_src.ipv4;
+				return true;
+			} else if (nexthop->src.ipv4.s_addr != INADDR_ANY) {
+				src->ipv4 = nexthop->src.ipv4;
+				return true;
+			}
+		} else if (family == AF_INET6) {
+			if (!IN6_IS_ADDR_UNSPECIFIED(&nexthop->rmap_src.ipv6)) {
+				src->ipv6 = nexthop->rmap_src.ipv6;
+				return true;
+			} else if (!IN6_IS_ADDR_UNSPECIFIED(&nexthop->src.ipv6)) {
+				src->ipv6 = nexthop->src.ipv6;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static bool rib_route_kernel_src_same(const struct route_entry *re,
+				      const struct route_entry *kre,
+				      int family)
+{
+	union g_addr src = {}, ksrc = {};
+	bool setsrc, ksetsrc;
+
+	setsrc = rib_route_kernel_src(re, family, &src);
+	ksetsrc = rib_route_kernel_src(kre, family, &ksrc);
+
+	if (setsrc != ksetsrc)
+		return false;
+	if (!setsrc)
+		return true;
+
+	if (family == AF_INET)
+		return IPV4_ADDR_SAME(&src.ipv4, &ksrc.ipv4);
+	return IPV6_ADDR_SAME(&src.ipv6, &ksrc.ipv6);
+}
+
+/*
+ * Compare a nexthop with one read from the kernel, as the netlink encoder
+ * sends it: the kernel reports every gateway along with its interface, and
+ * neither the source (compared per route) nor backups go down per nexthop.
+ */
+static bool rib_kernel_nexthop_same(const struct nexthop *nexthop,
+				    const struct nexthop *knh)
+{
+	struct nexthop nh = *nexthop;
+
+	if (nh.type == NEXTHOP_TYPE_IPV4
+	    && knh->type == NEXTHOP_TYPE_IPV4_IFINDEX)
+		nh.type = NEXTHOP_TYPE_IPV4_IFINDEX;
+	else if (nh.type == NEXTHOP_TYPE_IPV6
+		 && knh->type == NEXTHOP_TYPE_IPV6_IFINDEX)
+		nh.type = NEXTHOP_TYPE_IPV6_IFINDEX;
+
+	nh.src = knh->src;
+	UNSET_FLAG(nh.flags, NEXTHOP_FLAG_HAS_BACKUP);
+	nh.backup_num = 0;
+
+	return nexthop_cmp(&nh, knh) == 0;
+}
+
+/*
+ * Compare what installing 're' would put in the kernel with the route
+ * 'kre' that was read from it.  Anything we cannot compare counts as a
+ * difference, the route is then simply installed as usual.
+ */
+static bool rib_kernel_route_same(struct route_node *rn,
+				  struct route_entry *re,
+				  struct route_entry *kre)
+{
+	struct nexthop *nexthop;
+	struct nexthop *knh;
+
+	if (re == kre)
+		return true;
+
+	if (re->type != kre->type || re->tag != kre->tag)
+		return false;
+
+	if (CHECK_FLAG(re->flags, ZEBRA_FLAG_EVPN_ROUTE))
+		return false;
+
+	if (rib_route_kernel_mtu(re) != rib_route_kernel_mtu(kre))
+		return false;
+
+	if (!rib_route_kernel_src_same(re, kre, rn->p.family))
+		return false;
+
+	/* With nexthop objects the route only refers to the group by id */
+	if (zebra_nhg_kernel_nexthops_enabled()
+	    && zebra_nhg_resolve(re->nhe)->id != zebra_nhg_resolve(kre->nhe)->id)
+		return false;
+
+	knh = kre->nhe->nhg.nexthop;
+	for (ALL_NEXTHOPS(re->nhe->nhg, nexthop)) {
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+		    || !NEXTHOP_IS_ACTIVE(nexthop->flags))
+			continue;
+
+		while (knh && CHECK_FLAG(knh->flags, NEXTHOP_FLAG_RECURSIVE))
+			knh = nexthop_next(knh);
+
+		if (!knh || !rib_kernel_nexthop_same(nexthop, knh))
+			return false;
+
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ONLINK)
+		    != CHECK_FLAG(knh->flags, NEXTHOP_FLAG_ONLINK))
+			return false;
+
+		knh = nexthop_next(knh);
+	}
+
+	while (knh && CHECK_FLAG(knh->flags, NEXTHOP_FLAG_RECURSIVE))
+		knh = nexthop_next(knh);
+
+	return knh == NULL;
+}
+
 /* Update flag indicates whether this is a "replace" or not. Currently, this
  * is only used for IPv4.
  */
@@ -459,6 +645,7 @@ void rib_install_kernel(struct route_node *rn, struct route_entry *re,
 	struct zebra_vrf *zvrf = vrf_info_lookup(re->vrf_id);
 	const struct prefix *p, *src_p;
 	enum zebra_dplane_result ret;
+	struct route_entry *kre;
 
 	rib_dest_t *dest = rib_dest_from_rnode(rn);
 
@@ -492,12 +679,34 @@ void rib_install_kernel(struct route_node *rn, struct route_entry *re,
 	 */
 	hook_call(rib_update, rn, "installing in kernel");
 
+	/*
+	 * Skip the kernel write for a route the kernel still holds from
+	 * before a restart; the dataplane result is handled as usual.
+	 */
+	UNSET_FLAG(re->status, ROUTE_ENTRY_KERNEL_SAME);
+	kre = rib_kernel_route_find(rn, re);
+	if (kre) {
+		bool same = rib_kernel_route_same(rn, re, kre);
+
+		if (same)
+			SET_FLAG(re->status, ROUTE_ENTRY_KERNEL_SAME);
+
+		if (zvrf && kre != re) {
+			if (same)
+				zvrf->restart_skipped++;
+			else
+				zvrf->restart_updated++;
+		}
+	}
+
 	/* Send add or update */
 	if (old)
 		ret = dplane_route_update(rn, re, old);
 	else
 		ret = dplane_route_add(rn, re);
 
+	UNSET_FLAG(re->status, ROUTE_ENTRY_KERNEL_SAME);
+
 	switch (ret) {
 	case ZEBRA_DPLANE_REQUEST_QUEUED:
 		SET_FLAG(re->status, ROUTE_ENTRY_QUEUED);
@@ -648,10 +857,18 @@ static int rib_can_delete_dest(rib_dest_t *dest)
 	    || CHECK_FLAG(dest->flags, RIB_DEST_SENT_TO_FPM))
 		return 0;
 
+	/*
+	 * Nor if a dataplane provider may still have to replay the
+	 * prefix deletion.
+	 */
+	if (dplane_route_gen_retained(dest->dplane_gen))
+		return 0;
+
 	return 1;
 }
 
-void zebra_rib_evaluate_rn_nexthops(struct route_node *rn, uint32_t seq)
+void zebra_rib_evaluate_rn_nexthops(struct route_node *rn, uint32_t seq,
+				    bool coalesce)
 {
 	rib_dest_t *dest = rib_dest_from_rnode(rn);
 	struct rnh *rnh;
@@ -726,8 +943,11 @@ void zebra_rib_evaluate_rn_nexthops(struct route_node *rn, uint32_t seq)
 			}
 
 			rnh->seqno = seq;
-			zebra_evaluate_rnh(zvrf, family2afi(p->family), 0,
-					   rnh->type, p);
+			if (coalesce)
+				zebra_rnh_schedule(rnh);
+			else
+				zebra_evaluate_rnh(zvrf, family2afi(p->family),
+						   0, rnh->type, p);
 		}
 
 		rn = rn->parent;
@@ -736,6 +956,56 @@ void zebra_rib_evaluate_rn_nexthops(struct route_node *rn, uint32_t seq)
 	}
 }
 
+static void rib_retained_track(rib_dest_t *dest)
+{
+	if (CHECK_FLAG(dest->flags, RIB_DEST_RETAINED))
+		return;
+
+	if (re_list_first(&dest->routes)
+	    || !dplane_route_gen_retained(dest->dplane_gen))
+		return;
+
+	dest->retained_gen = dest->dplane_gen;
+	SET_FLAG(dest->flags, RIB_DEST_RETAINED);
+	rib_retained_add(&rib_retained_dests, dest);
+}
+
+void rib_retained_untrack(rib_dest_t *dest)
+{
+	if (!CHECK_FLAG(dest->flags, RIB_DEST_RETAINED))
+		return;
+
+	rib_retained_del(&rib_retained_dests, dest);
+	UNSET_FLAG(dest->flags, RIB_DEST_RETAINED);
+}
+
+static int rib_retained_gc(struct thread *thread)
+{
+	rib_dest_t *dest;
+
+	/*
+	 * A dest updated since it was retained goes back on the heap with
+	 * its new generation if that one is still retained.
+	 */
+	while ((dest = rib_retained_first(&rib_retained_dests))
+	       && !dplane_route_gen_retained(dest->retained_gen)) {
+		rib_retained_untrack(dest);
+		rib_gc_dest(dest->rnode);
+	}
+
+	return 0;
+}
+
+/*
+ * Called from any pthread when the retained generation moved on, or
+ * retaining stopped.
+ */
+void rib_retained_gc_schedule(void)
+{
+	thread_add_event(zrouter.master, rib_retained_gc, NULL, 0,
+			 &t_rib_retained);
+}
+
 /*
  * rib_gc_dest
  *
@@ -752,8 +1022,13 @@ int rib_gc_dest(struct route_node *rn)
 	if (!dest)
 		return 0;
 
-	if (!rib_can_delete_dest(dest))
+	if (!rib_can_delete_dest(dest)) {
+		/* Empty dests kept for a dataplane provider are freed once
+		 * it does not need them anymore.
+		 */
+		rib_retained_track(dest);
 		return 0;
+	}
 
 	if (IS_ZEBRA_DEBUG_RIB) {
 		struct zebra_vrf *zvrf;
@@ -762,8 +1037,13 @@ int rib_gc_dest(struct route_node *rn)
 		rnode_debug(rn, zvrf_id(zvrf), "removing dest from table");
 	}
 
-	zebra_rib_evaluate_rn_nexthops(rn, zebra_router_get_next_sequence());
+	/* The dest is going away, so its nexthops must be moved over to
+	 * their new resolving routes right now.
+	 */
+	zebra_rib_evaluate_rn_nexthops(rn, zebra_router_get_next_sequence(),
+				       false);
 
+	rib_retained_untrack(dest);
 	dest->rnode = NULL;
 	rnh_list_fini(&dest->nht);
 	XFREE(MTYPE_RIB_DEST, dest);
@@ -1981,7 +2261,7 @@ static void rib_process_result(struct zebra_dplane_ctx *ctx)
 		break;
 	}
 
-	zebra_rib_evaluate_rn_nexthops(rn, seq);
+	zebra_rib_evaluate_rn_nexthops(rn, seq, true);
 	zebra_rib_evaluate_mpls(rn);
 done:
 
@@ -2224,7 +2504,7 @@ static void rib_process_dplane_notify(struct zebra_dplane_ctx *ctx)
 
 	/* Make any changes visible for lsp and nexthop-tracking processing */
 	zebra_rib_evaluate_rn_nexthops(
-		rn, zebra_router_get_next_sequence());
+		rn, zebra_router_get_next_sequence(), true);
 
 	zebra_rib_evaluate_mpls(rn);
 
@@ -2253,19 +2533,24 @@ static void process_subq_nhg(struct listnode *lnode)
 	rib_nhg_process(ctx);
 }
 
-static void process_subq_route(struct listnode *lnode, uint8_t qindex)
+static void process_subq_route(struct zebra_vrf *zvrf, uint8_t qindex)
 {
+	struct listnode *lnode = listhead(zvrf->mq.subq[qindex]);
 	struct route_node *rnode = NULL;
 	rib_dest_t *dest = NULL;
-	struct zebra_vrf *zvrf = NULL;
+	struct timeval start;
 
 	rnode = listgetdata(lnode);
 	dest = rib_dest_from_rnode(rnode);
 	assert(dest);
 
-	zvrf = rib_dest_vrf(dest);
-
+	/* the node stays on the VRF's queue while it is processed, so
+	 * anything queued meanwhile finds the VRF already scheduled
+	 */
+	monotime(&start);
 	rib_process(rnode);
+	zvrf->mq.process_usec += monotime_since(&start, NULL);
+	zvrf->mq.processed++;
 
 	if (IS_ZEBRA_DEBUG_RIB_DETAILED) {
 		struct route_entry *re = re_list_first(&dest->routes);
@@ -2290,25 +2575,36 @@ static void process_subq_route(struct listnode *lnode, uint8_t qindex)
     }
 #endif
 	route_unlock_node(rnode);
+	list_delete_node(zvrf->mq.subq[qindex], lnode);
+	zvrf->mq.size--;
 }
 
-/* Take a list of route_node structs and return 1, if there was a record
- * picked from it and processed by rib_process(). Don't process more,
- * than one RN record; operate only in the specified sub-queue.
+/* Take a sub-queue and return 1, if there was a record picked from it and
+ * processed. Don't process more than one RN record; operate only in the
+ * specified sub-queue. Route sub-queues hold VRFs, the VRF that got its turn
+ * goes to the back of the sub-queue if it has more route nodes waiting.
  */
 static unsigned int process_subq(struct list *subq, uint8_t qindex)
 {
 	struct listnode *lnode = listhead(subq);
+	struct zebra_vrf *zvrf;
 
 	if (!lnode)
 		return 0;
 
-	if (qindex == route_info[ZEBRA_ROUTE_NHG].meta_q_map)
+	if (qindex == route_info[ZEBRA_ROUTE_NHG].meta_q_map) {
 		process_subq_nhg(lnode);
-	else
-		process_subq_route(lnode, qindex);
+		list_delete_node(subq, lnode);
+		return 1;
+	}
+
+	zvrf = listgetdata(lnode);
+	process_subq_route(zvrf, qindex);
 
-	list_delete_node(subq, lnode);
+	if (listcount(zvrf->mq.subq[qindex]))
+		listnode_move_to_tail(subq, lnode);
+	else
+		list_delete_node(subq, lnode);
 
 	return 1;
 }
@@ -2372,6 +2668,7 @@ static int rib_meta_queue_add(struct meta_queue *mq, void *data)
 	struct route_node *rn = NULL;
 	struct route_entry *re = NULL, *curr_re = NULL;
 	uint8_t qindex = MQ_SIZE, curr_qindex = MQ_SIZE;
+	struct zebra_vrf *zvrf;
 
 	rn = (struct route_node *)data;
 
@@ -2397,10 +2694,16 @@ static int rib_meta_queue_add(struct meta_queue *mq, void *data)
 		return -1;
 	}
 
+	zvrf = rib_dest_vrf(rib_dest_from_rnode(rn));
+	if (!listcount(zvrf->mq.subq[qindex]))
+		listnode_add(mq->subq[qindex], zvrf);
+
 	SET_FLAG(rib_dest_from_rnode(rn)->flags, RIB_ROUTE_QUEUED(qindex));
-	listnode_add(mq->subq[qindex], rn);
+	listnode_add(zvrf->mq.subq[qindex], rn);
 	route_lock_node(rn);
 	mq->size++;
+	if (++zvrf->mq.size > zvrf->mq.max_size)
+		zvrf->mq.max_size = zvrf->mq.size;
 
 	if (IS_ZEBRA_DEBUG_RIB_DETAILED)
 		rnode_debug(rn, re->vrf_id, "queued rn %p into sub-queue %u",
@@ -2504,6 +2807,41 @@ void meta_queue_free(struct meta_queue *mq)
 	XFREE(MTYPE_WORK_QUEUE, mq);
 }
 
+void meta_queue_vrf_init(struct meta_queue_vrf *mqv)
+{
+	unsigned i;
+
+	for (i = 0; i < MQ_SIZE; i++)
+		mqv->subq[i] = list_new();
+}
+
+void meta_queue_vrf_free(struct meta_queue_vrf *mqv)
+{
+	unsigned i;
+
+	for (i = 0; i < MQ_SIZE; i++)
+		list_delete(&mqv->subq[i]);
+}
+
+void rib_meta_queue_vrf_clean(struct zebra_vrf *zvrf)
+{
+	struct route_node *rnode;
+	unsigned i;
+
+	for (i = 0; i < MQ_SIZE; i++) {
+		if (!listcount(zvrf->mq.subq[i]))
+			continue;
+
+		while ((rnode = listnode_head(zvrf->mq.subq[i]))) {
+			route_unlock_node(rnode);
+			listnode_delete(zvrf->mq.subq[i], rnode);
+			zrouter.mq->size--;
+			zvrf->mq.size--;
+		}
+		listnode_delete(zrouter.mq->subq[i], zvrf);
+	}
+}
+
 /* initialise zebra rib work queue */
 static void rib_queue_init(void)
 {
@@ -3304,8 +3642,8 @@ void rib_delete(afi_t afi, safi_t safi, vrf_id_t vrf_id, int type,
 	 * when zebra is under load.
 	 */
 	if (connected_down)
-		zebra_rib_evaluate_rn_nexthops(rn,
-					       zebra_router_get_next_sequence());
+		zebra_rib_evaluate_rn_nexthops(
+			rn, zebra_router_get_next_sequence(), false);
 	route_unlock_node(rn);
 	return;
 }
@@ -3560,10 +3898,13 @@ void rib_sweep_table(struct route_table *table)
 	struct route_entry *re;
 	struct route_entry *next;
 	struct nexthop *nexthop;
+	struct zebra_vrf *zvrf;
 
 	if (!table)
 		return;
 
+	zvrf = rib_table_info(table)->zvrf;
+
 	if (IS_ZEBRA_DEBUG_RIB)
 		zlog_debug("%s: starting", __func__);
 
@@ -3611,6 +3952,9 @@ void rib_sweep_table(struct route_table *table)
 
 			rib_uninstall_kernel(rn, re);
 			rib_delnode(rn, re);
+
+			if (zvrf)
+				zvrf->restart_deleted++;
 		}
 	}
 
@@ -3623,6 +3967,7 @@ int rib_sweep_route(struct thread *t)
 {
 	struct vrf *vrf;
 	struct zebra_vrf *zvrf;
+	uint64_t skipped = 0, updated = 0, deleted = 0;
 
 	RB_FOREACH (vrf, vrf_id_head, &vrfs_by_id) {
 		if ((zvrf = vrf->info) == NULL)
@@ -3635,6 +3980,19 @@ int rib_sweep_route(struct thread *t)
 	zebra_router_sweep_route();
 	zebra_router_sweep_nhgs();
 
+	RB_FOREACH (vrf, vrf_id_head, &vrfs_by_id) {
+		if ((zvrf = vrf->info) == NULL)
+			continue;
+
+		skipped += zvrf->restart_skipped;
+		updated += zvrf->restart_updated;
+		deleted += zvrf->restart_deleted;
+	}
+
+	zlog_info("Kernel routes reconciled: %" PRIu64 " unchanged, %" PRIu64
+		  " updated, %" PRIu64 " deleted",
+		  skipped, updated, deleted);
+
 	return 0;
 }
 
@@ -3924,6 +4282,7 @@ void rib_init(void)
 	check_route_info();
 
 	rib_queue_init();
+	rib_retained_init(&rib_retained_dests);
 
 	/* Init dataplane, and register for results */
 	pthread_mutex_init(&dplane_mutex, NULL);
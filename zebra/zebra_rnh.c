@@ -53,6 +53,20 @@
 
 DEFINE_MTYPE_STATIC(ZEBRA, RNH, "Nexthop tracking object")
 
+DECLARE_LIST(rnh_pending, struct rnh, pending_item);
+
+/* Nexthops whose resolving routes changed, re-evaluated together when the
+ * coalescing timer fires.
+ */
+static struct rnh_pending_head rnh_pending;
+static struct thread *t_rnh_pending;
+
+/* While non-zero, updates to clients are collected into
+ * ZEBRA_NEXTHOP_UPDATE_BATCH messages, see zebra_rnh_batch_begin().
+ */
+static int rnh_batch_depth;
+static struct stream *rnh_batch_entry;
+
 static void free_state(vrf_id_t vrf_id, struct route_entry *re,
 		       struct route_node *rn);
 static void copy_state(struct rnh *rnh, const struct route_entry *re,
@@ -63,6 +77,7 @@ static int zebra_client_cleanup_rnh(struct zserv *client);
 
 void zebra_rnh_init(void)
 {
+	rnh_pending_init(&rnh_pending);
 	hook_register(zserv_client_close, zebra_client_cleanup_rnh);
 }
 
@@ -219,6 +234,8 @@ void zebra_free_rnh(struct rnh *rnh)
 	struct route_table *table;
 
 	zebra_rnh_remove_from_routing_table(rnh);
+	if (CHECK_FLAG(rnh->flags, ZEBRA_NHT_PENDING))
+		rnh_pending_del(&rnh_pending, rnh);
 	rnh->flags |= ZEBRA_NHT_DELETED;
 	list_delete(&rnh->client_list);
 	list_delete(&rnh->zebra_pseudowire_list);
@@ -898,6 +915,55 @@ void zebra_evaluate_rnh(struct zebra_vrf *zvrf, afi_t afi, int force,
 	}
 }
 
+static int zebra_rnh_process_pending(struct thread *thread)
+{
+	struct zebra_vrf *zvrf;
+	struct rnh *rnh;
+
+	zebra_rnh_batch_begin();
+	while ((rnh = rnh_pending_pop(&rnh_pending))) {
+		UNSET_FLAG(rnh->flags, ZEBRA_NHT_PENDING);
+
+		zvrf = zebra_vrf_lookup_by_id(rnh->vrf_id);
+		if (!zvrf)
+			continue;
+
+		zebra_evaluate_rnh(zvrf, family2afi(rnh->node->p.family), 0,
+				   rnh->type, &rnh->node->p);
+	}
+	zebra_rnh_batch_end();
+
+	return 0;
+}
+
+/*
+ * Queue a tracked entry whose resolving route changed for re-evaluation.
+ * Entries are collected for up to the coalescing time so that a burst of
+ * route changes results in a single evaluation per entry, with the updates
+ * to each client sent in batches.
+ */
+void zebra_rnh_schedule(struct rnh *rnh)
+{
+	struct zebra_vrf *zvrf;
+
+	if (!zrouter.nht_coalesce_time) {
+		zvrf = zebra_vrf_lookup_by_id(rnh->vrf_id);
+		if (zvrf)
+			zebra_evaluate_rnh(zvrf,
+					   family2afi(rnh->node->p.family), 0,
+					   rnh->type, &rnh->node->p);
+		return;
+	}
+
+	if (CHECK_FLAG(rnh->flags, ZEBRA_NHT_PENDING))
+		return;
+
+	SET_FLAG(rnh->flags, ZEBRA_NHT_PENDING);
+	rnh_pending_add_tail(&rnh_pending, rnh);
+	thread_add_timer_msec(zrouter.master, zebra_rnh_process_pending, NULL,
+			      zrouter.nht_coalesce_time, &t_rnh_pending);
+}
+
 void zebra_print_rnh_table(vrf_id_t vrfid, afi_t afi, struct vty *vty,
 			   enum rnh_type type, struct prefix *p)
 {
@@ -1087,11 +1153,75 @@ static int compare_state(struct route_entry *r1, struct route_entry *r2)
 	return 0;
 }
 
-int zebra_send_rnh_update(struct rnh *rnh, struct zserv *client,
-			  enum rnh_type type, vrf_id_t vrf_id,
-			  uint32_t srte_color)
+/*
+ * Collect the updates sent to clients into ZEBRA_NEXTHOP_UPDATE_BATCH
+ * messages until the matching zebra_rnh_batch_end().  Calls may nest.
+ */
+void zebra_rnh_batch_begin(void)
+{
+	if (rnh_batch_depth++ == 0)
+		rnh_batch_entry = stream_new(ZEBRA_MAX_PACKET_SIZ
+					     - ZEBRA_HEADER_SIZE - 4);
+}
+
+static void zebra_rnh_batch_send(struct zserv *client)
+{
+	struct stream *s = client->nht_batch;
+
+	client->nht_batch = NULL;
+	stream_putw_at(s, 0, stream_get_endp(s));
+	zserv_send_message(client, s);
+}
+
+void zebra_rnh_batch_end(void)
+{
+	struct listnode *node;
+	struct zserv *client;
+
+	if (--rnh_batch_depth)
+		return;
+
+	stream_free(rnh_batch_entry);
+	rnh_batch_entry = NULL;
+
+	for (ALL_LIST_ELEMENTS_RO(zrouter.client_list, node, client))
+		if (client->nht_batch)
+			zebra_rnh_batch_send(client);
+}
+
+/*
+ * Append an encoded update to the client's open batch.  A batch holds the
+ * updates of one command and VRF, each prefixed by its length.
+ */
+static void zebra_rnh_batch_add(struct zserv *client, int cmd, vrf_id_t vrf_id,
+				struct stream *entry)
+{
+	struct stream *s = client->nht_batch;
+	size_t len = stream_get_endp(entry);
+
+	if (s
+	    && (stream_getw_from(s, ZEBRA_HEADER_SIZE) != cmd
+		|| stream_getl_from(s, 4) != vrf_id
+		|| STREAM_WRITEABLE(s) < len + 2)) {
+		zebra_rnh_batch_send(client);
+		s = NULL;
+	}
+
+	if (!s) {
+		s = stream_new(ZEBRA_MAX_PACKET_SIZ);
+		zclient_create_header(s, ZEBRA_NEXTHOP_UPDATE_BATCH, vrf_id);
+		stream_putw(s, cmd);
+		client->nht_batch = s;
+	}
+
+	stream_putw(s, len);
+	stream_put(s, STREAM_DATA(entry), len);
+}
+
+/* Encode the body of a nexthop or import check update for rnh */
+static int zebra_rnh_encode_update(struct stream *s, struct rnh *rnh,
+				   uint32_t srte_color)
 {
-	struct stream *s = NULL;
 	struct route_entry *re;
 	unsigned long nump;
 	uint8_t num;
@@ -1099,17 +1229,10 @@ int zebra_send_rnh_update(struct rnh *rnh, struct zserv *client,
 	struct route_node *rn;
 	int ret;
 	uint32_t message = 0;
-	int cmd = (type == RNH_IMPORT_CHECK_TYPE) ? ZEBRA_IMPORT_CHECK_UPDATE
-						  : ZEBRA_NEXTHOP_UPDATE;
 
 	rn = rnh->node;
 	re = rnh->state;
 
-	/* Get output stream. */
-	s = stream_new(ZEBRA_MAX_PACKET_SIZ);
-
-	zclient_create_header(s, cmd, vrf_id);
-
 	/* Message flags. */
 	if (srte_color)
 		SET_FLAG(message, ZAPI_MESSAGE_SRTE);
@@ -1129,7 +1252,7 @@ int zebra_send_rnh_update(struct rnh *rnh, struct zserv *client,
 		flog_err(EC_ZEBRA_RNH_UNKNOWN_FAMILY,
 			 "%s: Unknown family (%d) notification attempted\n",
 			 __func__, rn->p.family);
-		goto failure;
+		return -1;
 	}
 	if (srte_color)
 		stream_putl(s, srte_color);
@@ -1152,7 +1275,7 @@ int zebra_send_rnh_update(struct rnh *rnh, struct zserv *client,
 				zapi_nexthop_from_nexthop(&znh, nh);
 				ret = zapi_nexthop_encode(s, &znh, 0, message);
 				if (ret < 0)
-					goto failure;
+					return -1;
 
 				num++;
 			}
@@ -1166,7 +1289,7 @@ int zebra_send_rnh_update(struct rnh *rnh, struct zserv *client,
 						s, &znh, 0 /* flags */,
 						0 /* message */);
 					if (ret < 0)
-						goto failure;
+						return -1;
 
 					num++;
 				}
@@ -1180,16 +1303,42 @@ int zebra_send_rnh_update(struct rnh *rnh, struct zserv *client,
 		stream_putl(s, 0); // metric
 		stream_putc(s, 0); // nexthops
 	}
-	stream_putw_at(s, 0, stream_get_endp(s));
+
+	return 0;
+}
+
+int zebra_send_rnh_update(struct rnh *rnh, struct zserv *client,
+			  enum rnh_type type, vrf_id_t vrf_id,
+			  uint32_t srte_color)
+{
+	struct stream *s = NULL;
+	int cmd = (type == RNH_IMPORT_CHECK_TYPE) ? ZEBRA_IMPORT_CHECK_UPDATE
+						  : ZEBRA_NEXTHOP_UPDATE;
 
 	client->nh_last_upd_time = monotime(NULL);
 	client->last_write_cmd = cmd;
-	return zserv_send_message(client, s);
 
-failure:
+	if (rnh_batch_depth) {
+		stream_reset(rnh_batch_entry);
+		if (zebra_rnh_encode_update(rnh_batch_entry, rnh, srte_color)
+		    < 0)
+			return -1;
 
-	stream_free(s);
-	return -1;
+		zebra_rnh_batch_add(client, cmd, vrf_id, rnh_batch_entry);
+		return 0;
+	}
+
+	/* Get output stream. */
+	s = stream_new(ZEBRA_MAX_PACKET_SIZ);
+
+	zclient_create_header(s, cmd, vrf_id);
+	if (zebra_rnh_encode_update(s, rnh, srte_color) < 0) {
+		stream_free(s);
+		return -1;
+	}
+	stream_putw_at(s, 0, stream_get_endp(s));
+
+	return zserv_send_message(client, s);
 }
 
 static void print_nh(struct nexthop *nexthop, struct vty *vty)
@@ -59,6 +59,9 @@ extern void zebra_remove_rnh_client(struct rnh *rnh, struct zserv *client,
 				    enum rnh_type type);
 extern void zebra_evaluate_rnh(struct zebra_vrf *zvrf, afi_t afi, int force,
 			       enum rnh_type type, struct prefix *p);
+extern void zebra_rnh_schedule(struct rnh *rnh);
+extern void zebra_rnh_batch_begin(void);
+extern void zebra_rnh_batch_end(void);
 extern void zebra_print_rnh_table(vrf_id_t vrfid, afi_t afi, struct vty *vty,
 				  enum rnh_type type, struct prefix *p);
 
@@ -30,6 +30,7 @@
 #include "zebra_vxlan.h"
 #include "zebra_mlag.h"
 #include "zebra_nhg.h"
+#include "zebra_dplane.h"
 #include "debug.h"
 
 DEFINE_MTYPE_STATIC(ZEBRA, RIB_TABLE_INFO, "RIB table info")
@@ -182,6 +183,9 @@ static void zebra_router_free_table(struct zebra_router_table *zrt)
 
 	table_info = route_table_get_info(zrt->table);
 	route_table_finish(zrt->table);
+
+	/* Deleted prefixes kept for dataplane replays went with the table */
+	dplane_route_gen_invalidate();
 	RB_REMOVE(zebra_router_table_head, &zrouter.tables, zrt);
 
 	XFREE(MTYPE_RIB_TABLE_INFO, table_info);
@@ -262,6 +266,7 @@ void zebra_router_init(void)
 	zrouter.sequence_num = 0;
 
 	zrouter.packets_to_process = ZEBRA_ZAPI_PACKETS_TO_PROCESS;
+	zrouter.nht_coalesce_time = ZEBRA_NHT_COALESCE_TIME;
 
 	zrouter.rtadv_sock = -1;
 
@@ -159,6 +159,10 @@ struct zebra_router {
 #define ZEBRA_ZAPI_PACKETS_TO_PROCESS 1000
 	_Atomic uint32_t packets_to_process;
 
+	/* Window in which nexthop tracking re-evaluations are coalesced */
+#define ZEBRA_NHT_COALESCE_TIME 10
+	uint32_t nht_coalesce_time;
+
 	/* Mlag information for the router */
 	struct zebra_mlag_info mlag_info;
 
@@ -176,6 +176,14 @@ struct zebra_vrf {
 	uint64_t lsp_installs;
 	uint64_t lsp_removals;
 
+	/* Routes reconciled against the kernel after a restart */
+	uint64_t restart_skipped;
+	uint64_t restart_updated;
+	uint64_t restart_deleted;
+
+	/* Route nodes waiting on the meta-queue */
+	struct meta_queue_vrf mq;
+
 #if defined(HAVE_RTADV)
 	struct rtadv rtadv;
 #endif /* HAVE_RTADV */
@@ -3389,6 +3389,33 @@ DEFUN_HIDDEN (no_zebra_workqueue_timer,
 	return CMD_SUCCESS;
 }
 
+DEFUN_HIDDEN (zebra_nht_coalesce_timer,
+	      zebra_nht_coalesce_timer_cmd,
+	      "zebra nexthop-tracking coalesce-time (0-10000)",
+	      ZEBRA_STR
+	      "Nexthop tracking\n"
+	      "Time to coalesce nexthop re-evaluations for\n"
+	      "Time in milliseconds\n")
+{
+	zrouter.nht_coalesce_time = strtoul(argv[3]->arg, NULL, 10);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_HIDDEN (no_zebra_nht_coalesce_timer,
+	      no_zebra_nht_coalesce_timer_cmd,
+	      "no zebra nexthop-tracking coalesce-time [(0-10000)]",
+	      NO_STR
+	      ZEBRA_STR
+	      "Nexthop tracking\n"
+	      "Time to coalesce nexthop re-evaluations for\n"
+	      "Time in milliseconds\n")
+{
+	zrouter.nht_coalesce_time = ZEBRA_NHT_COALESCE_TIME;
+
+	return CMD_SUCCESS;
+}
+
 DEFUN (no_ip_zebra_import_table,
        no_ip_zebra_import_table_cmd,
        "no ip import-table (1-252) [distance (1-255)] [route-map NAME]",
@@ -3435,6 +3462,10 @@ static int config_write_protocol(struct vty *vty)
 		vty_out(vty, "zebra zapi-packets %u\n",
 			zrouter.packets_to_process);
 
+	if (zrouter.nht_coalesce_time != ZEBRA_NHT_COALESCE_TIME)
+		vty_out(vty, "zebra nexthop-tracking coalesce-time %u\n",
+			zrouter.nht_coalesce_time);
+
 	enum multicast_mode ipv4_multicast_mode = multicast_mode_ipv4_get();
 
 	if (ipv4_multicast_mode != MCAST_NO_CONFIG)
@@ -3496,6 +3527,35 @@ DEFUN (show_zebra,
 			zvrf->lsp_removals);
 	}
 
+	vty_out(vty,
+		"\n                            RIB Queue  RIB Queue  Processed  Avg Time\n");
+	vty_out(vty,
+		"VRF                         Depth      Max Depth  Routes     (usec)\n");
+
+	RB_FOREACH (vrf, vrf_name_head, &vrfs_by_name) {
+		struct zebra_vrf *zvrf = vrf->info;
+
+		vty_out(vty, "%-25s %10u %10u %10" PRIu64 " %10" PRIu64 "\n",
+			vrf->name, zvrf->mq.size, zvrf->mq.max_size,
+			zvrf->mq.processed,
+			zvrf->mq.processed
+				? zvrf->mq.process_usec / zvrf->mq.processed
+				: 0);
+	}
+
+	vty_out(vty,
+		"\n                            Restart    Restart    Restart\n");
+	vty_out(vty,
+		"VRF                         Skipped    Updated    Deleted\n");
+
+	RB_FOREACH (vrf, vrf_name_head, &vrfs_by_name) {
+		struct zebra_vrf *zvrf = vrf->info;
+
+		vty_out(vty, "%-25s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+			vrf->name, zvrf->restart_skipped,
+			zvrf->restart_updated, zvrf->restart_deleted);
+	}
+
 	return CMD_SUCCESS;
 }
 
@@ -3894,6 +3954,8 @@ void zebra_vty_init(void)
 	install_element(CONFIG_NODE, &no_ip_zebra_import_table_cmd);
 	install_element(CONFIG_NODE, &zebra_workqueue_timer_cmd);
 	install_element(CONFIG_NODE, &no_zebra_workqueue_timer_cmd);
+	install_element(CONFIG_NODE, &zebra_nht_coalesce_timer_cmd);
+	install_element(CONFIG_NODE, &no_zebra_nht_coalesce_timer_cmd);
 	install_element(CONFIG_NODE, &zebra_packet_process_cmd);
 	install_element(CONFIG_NODE, &no_zebra_packet_process_cmd);
 	install_element(CONFIG_NODE, &nexthop_group_use_enable_cmd);
@@ -5537,6 +5537,26 @@ stream_failure:
 	return;
 }
 
+static int kernel_read_begin_ns(struct ns *ns,
+				void *_in_param __attribute__((unused)),
+				void **out_param __attribute__((unused)))
+{
+	struct zebra_ns *zns = ns->info;
+
+	kernel_read_begin(zns, KERNEL_READ_NEIGHBORS);
+	return NS_WALK_CONTINUE;
+}
+
+static int kernel_read_end_ns(struct ns *ns,
+			      void *_in_param __attribute__((unused)),
+			      void **out_param __attribute__((unused)))
+{
+	struct zebra_ns *zns = ns->info;
+
+	kernel_read_end(zns);
+	return NS_WALK_CONTINUE;
+}
+
 static int macfdb_read_ns(struct ns *ns,
 			  void *_in_param __attribute__((unused)),
 			  void **out_param __attribute__((unused)))
@@ -5607,11 +5627,16 @@ void zebra_vxlan_advertise_all_vni(ZAPI_HANDLER_ARGS)
 		hash_iterate(zvrf->evpn_table,
 			     zebra_evpn_gw_macip_add_for_evpn_hash, NULL);
 
+		/* Dump the MAC FDB and neighbors of all namespaces at once */
+		ns_walk_func(kernel_read_begin_ns, NULL, NULL);
+
 		/* Read the MAC FDB */
 		ns_walk_func(macfdb_read_ns, NULL, NULL);
 
 		/* Read neighbors */
 		ns_walk_func(neigh_read_ns, NULL, NULL);
+
+		ns_walk_func(kernel_read_end_ns, NULL, NULL);
 	} else {
 		/* Cleanup VTEPs for all EVPNs - uninstall from
 		 * kernel and free entries.
@@ -207,21 +207,19 @@ static void zserv_client_fail(struct zserv *client)
  * itself. If the socket ends up throwing EWOULDBLOCK, the remaining data is
  * buffered and the function reschedules itself.
  *
- * The utility of the buffer is that it allows us to vastly reduce lock
- * contention by allowing us to pop *all* messages off the output queue at once
- * instead of locking and unlocking each time we want to pop a single message
- * off the queue. The same thing could arguably be accomplished faster by
- * allowing the main thread to write directly into the buffer instead of
- * enqueuing packets onto an intermediary queue, but the intermediary queue
- * allows us to expose information about input and output queues to the user in
- * terms of number of packets rather than size of data.
+ * The output queue is lock-free; this function is its only consumer and takes
+ * the messages that are on it when it starts. The same thing could arguably be
+ * accomplished faster by allowing the main thread to write directly into the
+ * buffer instead of enqueuing packets onto an intermediary queue, but the
+ * intermediary queue allows us to expose information about input and output
+ * queues to the user in terms of number of packets rather than size of data.
  */
 static int zserv_write(struct thread *thread)
 {
 	struct zserv *client = THREAD_ARG(thread);
 	struct stream *msg;
 	uint32_t wcmd = 0;
-	struct stream_fifo *cache;
+	size_t count;
 
 	/* If we have any data pending, try to flush it first */
 	switch (buffer_flush_all(client->wb, client->sock)) {
@@ -231,34 +229,22 @@ static int zserv_write(struct thread *thread)
 		atomic_store_explicit(&client->last_write_time,
 				      (uint32_t)monotime(NULL),
 				      memory_order_relaxed);
+		atomic_fetch_add_explicit(&client->obuf_blocked_cnt, 1,
+					  memory_order_relaxed);
 		zserv_client_event(client, ZSERV_CLIENT_WRITE);
 		return 0;
 	case BUFFER_EMPTY:
 		break;
 	}
 
-	cache = stream_fifo_new();
-
-	frr_with_mutex(&client->obuf_mtx) {
-		while (stream_fifo_head(client->obuf_fifo))
-			stream_fifo_push(cache,
-					 stream_fifo_pop(client->obuf_fifo));
-	}
-
-	if (cache->tail) {
-		msg = cache->tail;
-		stream_set_getp(msg, 0);
+	/* only take what is there now, the main pthread may keep pushing */
+	count = stream_mpsc_count(&client->obuf_queue);
+	while (count-- && (msg = stream_mpsc_pop(&client->obuf_queue))) {
 		wcmd = stream_getw_from(msg, ZAPI_HEADER_CMD_LOCATION);
-	}
-
-	while (stream_fifo_head(cache)) {
-		msg = stream_fifo_pop(cache);
 		buffer_put(client->wb, STREAM_DATA(msg), stream_get_endp(msg));
 		stream_free(msg);
 	}
 
-	stream_fifo_free(cache);
-
 	/* If we have any data pending, try to flush it first */
 	switch (buffer_flush_all(client->wb, client->sock)) {
 	case BUFFER_ERROR:
@@ -267,6 +253,8 @@ static int zserv_write(struct thread *thread)
 		atomic_store_explicit(&client->last_write_time,
 				      (uint32_t)monotime(NULL),
 				      memory_order_relaxed);
+		atomic_fetch_add_explicit(&client->obuf_blocked_cnt, 1,
+					  memory_order_relaxed);
 		zserv_client_event(client, ZSERV_CLIENT_WRITE);
 		return 0;
 	case BUFFER_EMPTY:
@@ -433,11 +421,7 @@ static int zserv_read(struct thread *thread)
 				      memory_order_relaxed);
 
 		/* publish read packets on client's input queue */
-		frr_with_mutex(&client->ibuf_mtx) {
-			while (cache->head)
-				stream_fifo_push(client->ibuf_fifo,
-						 stream_fifo_pop(cache));
-		}
+		stream_mpsc_push_fifo(&client->ibuf_queue, cache);
 
 		/* Schedule job to process those packets */
 		zserv_event(client, ZSERV_PROCESS_MESSAGES);
@@ -502,22 +486,22 @@ static int zserv_process_messages(struct thread *thread)
 	struct stream_fifo *cache = stream_fifo_new();
 	uint32_t p2p = zrouter.packets_to_process;
 	bool need_resched = false;
+	uint32_t i;
 
-	frr_with_mutex(&client->ibuf_mtx) {
-		uint32_t i;
-		for (i = 0; i < p2p && stream_fifo_head(client->ibuf_fifo);
-		     ++i) {
-			msg = stream_fifo_pop(client->ibuf_fifo);
-			stream_fifo_push(cache, msg);
-		}
-
-		msg = NULL;
+	for (i = 0; i < p2p; ++i) {
+		msg = stream_mpsc_pop(&client->ibuf_queue);
+		if (!msg)
+			break;
+		stream_fifo_push(cache, msg);
+	}
 
-		/* Need to reschedule processing work if there are still
-		 * packets in the fifo.
-		 */
-		if (stream_fifo_head(client->ibuf_fifo))
-			need_resched = true;
+	/* Need to reschedule processing work if there are still
+	 * packets in the queue.
+	 */
+	if (i == p2p && stream_mpsc_count(&client->ibuf_queue)) {
+		need_resched = true;
+		atomic_fetch_add_explicit(&client->ibuf_backlog_cnt, 1,
+					  memory_order_relaxed);
 	}
 
 	/* Process the batch of messages */
@@ -535,9 +519,7 @@ static int zserv_process_messages(struct thread *thread)
 
 int zserv_send_message(struct zserv *client, struct stream *msg)
 {
-	frr_with_mutex(&client->obuf_mtx) {
-		stream_fifo_push(client->obuf_fifo, msg);
-	}
+	stream_mpsc_push(&client->obuf_queue, msg);
 
 	zserv_client_event(client, ZSERV_CLIENT_WRITE);
 
@@ -549,15 +531,7 @@ int zserv_send_message(struct zserv *client, struct stream *msg)
  */
 int zserv_send_batch(struct zserv *client, struct stream_fifo *fifo)
 {
-	struct stream *msg;
-
-	frr_with_mutex(&client->obuf_mtx) {
-		msg = stream_fifo_pop(fifo);
-		while (msg) {
-			stream_fifo_push(client->obuf_fifo, msg);
-			msg = stream_fifo_pop(fifo);
-		}
-	}
+	stream_mpsc_push_fifo(&client->obuf_queue, fifo);
 
 	zserv_client_event(client, ZSERV_CLIENT_WRITE);
 
@@ -617,17 +591,14 @@ static void zserv_client_free(struct zserv *client)
 		stream_free(client->ibuf_work);
 	if (client->obuf_work)
 		stream_free(client->obuf_work);
-	if (client->ibuf_fifo)
-		stream_fifo_free(client->ibuf_fifo);
-	if (client->obuf_fifo)
-		stream_fifo_free(client->obuf_fifo);
+	if (client->nht_batch)
+		stream_free(client->nht_batch);
+	zserv_nhg_cache_free(client);
+	stream_mpsc_fini(&client->ibuf_queue);
+	stream_mpsc_fini(&client->obuf_queue);
 	if (client->wb)
 		buffer_free(client->wb);
 
-	/* Free buffer mutexes */
-	pthread_mutex_destroy(&client->obuf_mtx);
-	pthread_mutex_destroy(&client->ibuf_mtx);
-
 	/* Free bitmaps. */
 	for (afi_t afi = AFI_IP; afi < AFI_MAX; afi++) {
 		for (int i = 0; i < ZEBRA_ROUTE_MAX; i++) {
@@ -741,12 +712,10 @@ static struct zserv *zserv_client_create(int sock)
 
 	/* Make client input/output buffer. */
 	client->sock = sock;
-	client->ibuf_fifo = stream_fifo_new();
-	client->obuf_fifo = stream_fifo_new();
+	stream_mpsc_init(&client->ibuf_queue);
+	stream_mpsc_init(&client->obuf_queue);
 	client->ibuf_work = stream_new(stream_size);
 	client->obuf_work = stream_new(stream_size);
-	pthread_mutex_init(&client->ibuf_mtx, NULL);
-	pthread_mutex_init(&client->obuf_mtx, NULL);
 	client->wb = buffer_new(0);
 	TAILQ_INIT(&(client->gr_info_queue));
 
@@ -996,6 +965,18 @@ static char *zserv_time_buf(time_t *time1, char *buf, int buflen)
 	return buf;
 }
 
+static void zebra_show_client_queue(struct vty *vty, const char *name,
+				    struct stream_mpsc *queue,
+				    _Atomic uint32_t *stalls)
+{
+	vty_out(vty, "%-12s%-12zu%-12zu%-12zu%-12u\n", name,
+		stream_mpsc_count(queue),
+		atomic_load_explicit(&queue->max_count, memory_order_relaxed),
+		atomic_load_explicit(&queue->push_retries,
+				     memory_order_relaxed),
+		atomic_load_explicit(stalls, memory_order_relaxed));
+}
+
 /* Display client info details */
 static void zebra_show_client_detail(struct vty *vty, struct zserv *client)
 {
@@ -1075,6 +1056,8 @@ static void zebra_show_client_detail(struct vty *vty, struct zserv *client)
 		client->v6_nh_watch_add_cnt, 0, client->v6_nh_watch_rem_cnt);
 	vty_out(vty, "VxLAN SG    %-12u%-12u%-12u\n", client->vxlan_sg_add_cnt,
 		0, client->vxlan_sg_del_cnt);
+	vty_out(vty, "Nexthop group cache hits: %u misses: %u\n",
+		client->nhg_cache_hit_cnt, client->nhg_cache_miss_cnt);
 	vty_out(vty, "Interface Up Notifications: %u\n", client->ifup_cnt);
 	vty_out(vty, "Interface Down Notifications: %u\n", client->ifdown_cnt);
 	vty_out(vty, "VNI add notifications: %u\n", client->vniadd_cnt);
@@ -1106,11 +1089,13 @@ static void zebra_show_client_detail(struct vty *vty, struct zserv *client)
 		}
 	}
 
-#if defined DEV_BUILD
-	vty_out(vty, "Input Fifo: %zu:%zu Output Fifo: %zu:%zu\n",
-		client->ibuf_fifo->count, client->ibuf_fifo->max_count,
-		client->obuf_fifo->count, client->obuf_fifo->max_count);
-#endif
+	vty_out(vty, "\n");
+	vty_out(vty, "Queue       Depth       Max         Retries     Stalls\n");
+	vty_out(vty, "================================================== \n");
+	zebra_show_client_queue(vty, "Input", &client->ibuf_queue,
+				&client->ibuf_backlog_cnt);
+	zebra_show_client_queue(vty, "Output", &client->obuf_queue,
+				&client->obuf_blocked_cnt);
 	vty_out(vty, "\n");
 }
 
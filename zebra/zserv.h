@@ -104,16 +104,24 @@ struct zserv {
 	int busy_count;
 	bool is_closed;
 
-	/* Input/output buffer to the client. */
-	pthread_mutex_t ibuf_mtx;
-	struct stream_fifo *ibuf_fifo;
-	pthread_mutex_t obuf_mtx;
-	struct stream_fifo *obuf_fifo;
+	/* Input/output queues to the client. The client pthread is the only
+	 * consumer of obuf_queue and the main pthread of ibuf_queue.
+	 */
+	struct stream_mpsc ibuf_queue;
+	struct stream_mpsc obuf_queue;
 
 	/* Private I/O buffers */
 	struct stream *ibuf_work;
 	struct stream *obuf_work;
 
+	/* Nexthop updates being collected into a batch message, only used on
+	 * the main pthread
+	 */
+	struct stream *nht_batch;
+
+	/* Nexthop groups of the last routes, only used on the main pthread */
+	struct zapi_nhg_cache *nhg_cache;
+
 	/* Buffer of data waiting to be written to client. */
 	struct buffer *wb;
 
@@ -198,6 +206,8 @@ struct zserv {
 	uint32_t local_es_del_cnt;
 	uint32_t local_es_evi_add_cnt;
 	uint32_t local_es_evi_del_cnt;
+	uint32_t nhg_cache_hit_cnt;
+	uint32_t nhg_cache_miss_cnt;
 	uint32_t error_cnt;
 
 	time_t nh_reg_time;
@@ -223,6 +233,11 @@ struct zserv {
 	/* command code of last message written */
 	_Atomic uint32_t last_write_cmd;
 
+	/* rounds in which the main pthread left input for later */
+	_Atomic uint32_t ibuf_backlog_cnt;
+	/* writes that could not flush all output to the socket */
+	_Atomic uint32_t obuf_blocked_cnt;
+
 	/*
 	 * Number of instances configured with
 	 * graceful restart